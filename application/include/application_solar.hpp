@@ -2,10 +2,28 @@
 #define APPLICATION_SOLAR_HPP
 
 #include "GeometryNode.hpp"
+#include "bvh.hpp"
+#include "depth_pyramid.hpp"
+#include "ephemeris.hpp"
+#include "gpu_culler.hpp"
 #include "SceneGraph.hpp"
 #include "application.hpp"
+#include "meshlet.hpp"
 #include "model.hpp"
+#include "nbody_system.hpp"
+#include "occlusion_buffer.hpp"
+#include "orbit_set.hpp"
 #include "structs.hpp"
+#include "sphere_terrain.hpp"
+#include "texture_array.hpp"
+#include "texture_residency.hpp"
+#include "texture_streamer.hpp"
+#include "triple_buffer.hpp"
+#include "virtual_texture.hpp"
+#include "virtual_texture_feedback.hpp"
+
+#include <future>
+#include <memory>
 
 // gpu representation of model
 class ApplicationSolar : public Application {
@@ -22,12 +40,46 @@ class ApplicationSolar : public Application {
   // handle resizing
   void resizeCallback(unsigned width, unsigned height);
 
+  // step the gravity of the bodies, if switched on
+  void simulate(double dt);
+  // hand the positions of the bodies at the last steps to update()
+  void publish(double wall_time);
+  // select levels of detail and stream texture levels for the current view
+  void update();
   // draw all objects
   void render() const;
 
  protected:
   // Rendering the Scene with all the Nodes and thier relative distances
   void render_scene(Node* root, glm::fmat4 const& solar_system_origin) const;
+  // state of the bodies at the last two simulation steps
+  struct body_snapshot {
+    double previous_time;
+    double time;
+    // simulated time frames rendered at when published at wall_time, and
+    // simulated seconds per wall second since then, 0 while paused
+    double render_time;
+    double wall_time;
+    double scale;
+    // steps were stretched by time warp
+    bool stretched;
+    // positions of the orbit_nodes relative to the focus of their orbits
+    std::vector<glm::fvec3> previous_positions;
+    std::vector<glm::fvec3> positions;
+    glm::fvec3 previous_sun;
+    glm::fvec3 sun;
+  };
+
+  // move the planets and moons to their places at the time of the frame,
+  // interpolated between the steps of the snapshot
+  void place_bodies(Node* root, body_snapshot const& snapshot) const;
+  // positions on the body_orbits at time
+  void solve_orbits(double time, std::vector<glm::fvec3>& positions) const;
+  // mark the planet subtrees and bodies outside of the view frustum, whole
+  // subtrees are tested first, then the bodies hidden behind others
+  void cull_scene(Node* root);
+  // world space sphere around the geometry of a planet or moon holder
+  glm::fvec4 body_bounds(Node* holder) const;
 
   void render_stars() const;
   void render_orbits() const;
@@ -36,22 +88,56 @@ class ApplicationSolar : public Application {
   void render_planet(Node* planet,
                      PointLightNode* sun,
                      uint32_t const planet_index) const;
+  // draw a small body as a ray traced sphere on a quad
+  void render_impostor(Node* planet,
+                       PointLightNode* sun,
+                       uint32_t const planet_index) const;
+  // draw the bodies of the gpu culler, one multi draw per level of detail
+  // and one of the impostors
+  void render_instanced(PointLightNode* sun) const;
   void render_skybox() const;
   void renderScreenQuad() const;
+  // print triangle and texture memory counts of the last frame
+  void printStats() const;
+  // render the tiles the virtual textures need into the feedback buffer
+  void renderFeedback();
+  // upload layout of the virtual texture to the bound program
+  void uploadVirtualTexture(std::string const& program, std::size_t id) const;
+  // terrain the geometry is drawn with instead of the sphere, or null
+  sphere_terrain* terrainOf(GeometryNode const* geometry) const;
+  // index of the geometry in texture_files
+  std::size_t textureIndexOf(GeometryNode const* geometry) const;
+  // whether the geometry is drawn by render_instanced instead of on its own
+  bool drawnInstanced(GeometryNode const* geometry) const;
 
   /////////////////////////////////////////////////////////////////////////////////////////
   // initializing the SceneGraph, the Shader and the Geometry
 
-  void initialize_scene_graph();
-  void initialize_stars(unsigned int const stars_count);
-  void initialize_orbits(unsigned int const num);
-  void initializeScreenQuad();
+  // stages of the startup task graph, those filling a parameter run on the
+  // workers, those taking it upload the result on the gl thread
+  void initialize_scene_graph(model const& planet_model);
+  void initialize_stars(unsigned int const stars_count,
+                        std::vector<GLfloat>& star_vector);
+  void initialize_orbits(unsigned int const num, std::vector<GLfloat>& orbits);
+  void initializeScreenQuad(model const& screenquad_model);
+  void initializeImpostor();
+  // gpu culler and texture array, if the context supports them
+  void initializeGpuBodies();
   void initializeShaderPrograms();
-  void initializeGeometry(model& planet_model);
+  void buildPlanetLods(std::vector<model>& lods);
+  void buildOccluderLods();
+  void initializeGeometry(std::vector<model> const& lods);
   void initializeGeometry(std::vector<GLfloat> const& stars,
                           unsigned int const& index);
+  void decodeTextures();
   void initializeTextures();
-  void initializeSkybox();
+  void initializeVirtualTextures();
+  void decodeHeightmaps(
+      std::vector<std::pair<GeometryNode*, pixel_data>>& heightmaps);
+  void initializeTerrains(
+      std::vector<std::pair<GeometryNode*, pixel_data>> const& heightmaps);
+  void loadSkybox(model& skybox_model);
+  void initializeSkybox(model const& skybox_model);
   void initializeFramebuffer(unsigned int width = 600u,
                              unsigned int height = 450u);
 
@@ -81,46 +167,142 @@ class ApplicationSolar : public Application {
   void create_planet(std::string const& planet_name,
                      model const& planet_model,
                      glm::fvec3 const& planet_color,
-                     std::string const& texture_name);
+                     std::string const& texture_name,
+                     orbital_elements const& orbit);
 
   // Creating the moon and assigning it to the desired Planet
   void create_moon_for_planet(std::string const& planet_name,
                               std::string const& moon_name,
                               model const& moon_model,
                               glm::fvec3 const& moon_color,
-                              std::string const& texture_name);
+                              std::string const& texture_name,
+                              orbital_elements const& orbit);
+  // collect the orbits of the planets and moons into body_orbits
+  void initializeOrbits();
+  // map the series of the body_orbits cached in the resources, or fit and
+  // cache them if the orbits changed
+  void initializeEphemeris();
+  // change the clock or the gravity between two simulation steps
+  void controlSimulation(int key);
+  // put the sun and the planets into gravity_bodies where their orbits
+  // are at the last simulation step
+  void initializeGravity();
 
-  // The Matrix that creates the Planet and gives it's relative distance and
-  // speed in the Solar system
-  void process_planet_matrix(Node* planet,
-                             glm::fvec3& distance,
-                             glm::fmat4 const& solar_system_origin,
-                             int speed_factor) const;
-
-  // The Matrix that creates the moon and gives its relative distance and size
-  void process_moon_matrix(Node* moon,
-                           Node* planet,
-                           glm::fvec3 const& distance_from_planet,
-                           glm::fvec3 const& moon_size) const;
+  // The Matrix that places a body at its position relative to the focus of
+  // its orbit, turned around its axis at time and scaled to its size
+  void process_body_matrix(Node* body,
+                           glm::fmat4 const& focus,
+                           glm::fvec3 const& position,
+                           float size,
+                           double time) const;
 
   // Creating a SceneGraph
   SceneGraph scene_graph;
 
   // cpu representation of model
-  model_object planet_object;
+  // levels of detail of the planet sphere, finest first
+  std::vector<model_object> planet_lods;
+  // object space error of each of the planet_lods
+  std::vector<float> planet_lod_errors;
+  // clusters of the index buffer of each of the planet_lods
+  std::vector<std::vector<meshlet>> planet_meshlets;
   model_object star_object;
   model_object orbit_object;
   model_object skybox_object;
   model_object screenquad_object;
+  // strip of four indices, the corners follow from the vertex ids
+  model_object impostor_object;
 
   texture_object skybox_texture_object = {0, GL_TEXTURE_CUBE_MAP};
   std::vector<pixel_data> skybox_textures;
 
+  // geometry nodes and the texture files they are drawn with
+  std::vector<std::pair<GeometryNode*, std::string>> texture_files;
+  // pixels of the texture files, decoded by the job system
+  std::vector<std::future<pixel_data>> decoded_textures;
+  // uploads the decoded textures over several frames
+  texture_streamer texture_stream;
+  // gpu memory for the mip levels of the texture_files
+  static const std::size_t texture_budget = 32u << 20;
+  // streams in the mip levels of the texture_files the view requires,
+  // ids are the indices into texture_files
+  texture_residency texture_residents;
+
   // camera transform matrix
   glm::fmat4 m_view_transform;
   // camera projection matrix
   glm::fmat4 m_view_projection;
 
+  // virtual textures of the texture_files which have a tile pyramid next to
+  // them, ids are the indices into this vector
+  std::vector<std::pair<GeometryNode*, std::unique_ptr<virtual_texture>>> virtual_textures;
+  // tiles the virtual textures were drawn with
+  virtual_texture_feedback vt_feedback;
+
+  // geometry nodes drawn as quadtree terrain for close-ups
+  std::vector<std::pair<GeometryNode*, std::unique_ptr<sphere_terrain>>> terrains;
+
+  // holders of the planets and moons, and a tree over their bounds in the
+  // last frame whose ids are the indices into body_holders
+  std::vector<Node*> body_holders;
+  bvh body_tree;
+  // orbits of the nodes in orbit_nodes, parents before their moons
+  orbit_set body_orbits;
+  std::vector<Node*> orbit_nodes;
+  // positions on the body_orbits over the first hour, looked up instead of
+  // solving the orbits, null if they could not be fitted
+  std::unique_ptr<ephemeris> body_ephemeris;
+  // mutual gravity of the sun and the planets instead of their orbits,
+  // toggled with G, moons stay on their orbits around the moving planets
+  nbody_system gravity_bodies;
+  // particle of each of the orbit_nodes in gravity_bodies, the sun is
+  // particle 0 and moons have none
+  std::vector<std::size_t> gravity_ids;
+  bool m_gravity;
+  // positions of the gravity_bodies before the last step, frames are
+  // interpolated from them
+  std::vector<glm::fvec3> m_gravity_previous;
+  // bodies of the simulation steps for the render thread, the orbits and
+  // gravity above are only used by the steps, or with m_clock_mutex held
+  triple_buffer<body_snapshot> body_snapshots;
+  // depth of the bodies in view rasterized on the cpu
+  occlusion_buffer occluders;
+  // levels of detail of the occluder sphere simplified from the sphere
+  // model, finest first, with the object space error of each
+  std::vector<model> occluder_lods;
+  std::vector<float> occluder_lod_errors;
+  // culls the body_holders and writes their draws on the gpu instead, null
+  // if the context has no compute shaders
+  std::unique_ptr<gpu_culler> gpu_bodies;
+  // textures of the texture_files for the draws of the gpu_bodies, layers
+  // are the indices into texture_files
+  std::unique_ptr<texture_array> planet_layers;
+  // depth of the last frame, the bodies behind it are not drawn
+  depth_pyramid hiz;
+  // matrix of the frame drawn after the last update, false after resizes
+  glm::fmat4 m_rendered_view_projection;
+  bool m_depth_rendered;
+  // centers of the body_holders and the farthest any of them moved in the
+  // last update, the depth pyramid lags behind by that much per frame
+  std::vector<glm::fvec3> m_body_centers;
+  float m_body_motion;
+
+  // height of the framebuffer in pixels
+  float m_viewport_height;
+  // visible meshlets of the selected level of each of the texture_files
+  std::vector<meshlet_draws> planet_draws;
+  // which of the texture_files are too small on screen for their mesh
+  std::vector<bool> planet_impostors;
+  // triangles of the planet levels selected in the last update and of the
+  // finest level for comparison
+  std::size_t m_planet_triangles;
+  std::size_t m_planet_triangles_finest;
+  std::size_t m_planet_impostors;
+  // bodies in the view frustum but hidden behind others in the last update,
+  // by the occlusion buffer and by the depth pyramid
+  std::size_t m_bodies_occluded;
+  std::size_t m_bodies_hiz_occluded;
+
   texture_object FB_color_attachment;
   texture_object FB_depth_attachment;
   texture_object framebuffer;
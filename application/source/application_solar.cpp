@@ -1,8 +1,11 @@
 #include "application_solar.hpp"
 #include "window_handler.hpp"
 
+#include "frustum_culling.hpp"
+#include "job_system.hpp"
 #include "model_loader.hpp"
 #include "shader_loader.hpp"
+#include "task_graph.hpp"
 #include "texture_loader.hpp"
 
 #include "utils.hpp"
@@ -15,56 +18,418 @@ using namespace gl;
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <ctime>
+#include <fstream>
 #include <iostream>
+#include <map>
+
+// units of the virtual texture samplers, above those of the planets and
+// within the 48 units every gl 3.2 context has
+static GLint const vt_indirection_unit = 46;
+static GLint const vt_cache_unit = 47;
+// unit of the depth pyramid in the culling compute shader
+static GLint const hiz_unit = 45;
+// unit of the texture array of the instanced bodies
+static GLint const layers_unit = 44;
+// attribute of the instanced body ids
+static GLuint const body_id_location = 4;
+// bodies smaller on screen in pixels are drawn as impostors
+static float const impostor_diameter = 16.0f;
+// leapfrog substeps of gravity per simulation step, each at most a tick long
+static std::size_t const max_gravity_substeps = 64;
+// time warp of gravity, a clock step of 8 per frame stays within the
+// substeps above about 25 frames per second
+static double const max_gravity_scale = 100.0;
 
 /* ----------------------- constructor and destructor ----------------------- */
 
 ApplicationSolar::ApplicationSolar(std::string const& resource_path)
     : Application{resource_path},
       scene_graph{},
-      planet_object{},
+      planet_lods{},
+      planet_lod_errors{},
+      planet_meshlets{},
       star_object{},
       orbit_object{},
       skybox_object{},
       screenquad_object{},
+      impostor_object{},
       skybox_texture_object{0, GL_TEXTURE_CUBE_MAP},
       skybox_textures{},
+      texture_files{},
+      decoded_textures{},
+      texture_stream{},
+      texture_residents{texture_stream, texture_budget},
+      virtual_textures{},
+      vt_feedback{initial_resolution.x, initial_resolution.y},
+      terrains{},
+      body_holders{},
+      body_tree{},
+      body_orbits{},
+      orbit_nodes{},
+      body_ephemeris{},
+      gravity_bodies{},
+      gravity_ids{},
+      m_gravity{false},
+      m_gravity_previous{},
+      body_snapshots{},
+      occluders{},
+      occluder_lods{},
+      occluder_lod_errors{},
+      gpu_bodies{},
+      planet_layers{},
+      hiz{initial_resolution.x, initial_resolution.y},
+      m_rendered_view_projection{},
+      m_depth_rendered{false},
+      m_body_centers{},
+      m_body_motion{0.0f},
+      m_viewport_height{float(initial_resolution.y)},
+      m_planet_triangles{0},
+      m_planet_triangles_finest{0},
+      m_planet_impostors{0},
+      m_bodies_occluded{0},
+      m_bodies_hiz_occluded{0},
       FB_color_attachment{},
       FB_depth_attachment{},
       framebuffer{},
       m_view_transform{},
       m_view_projection{
           utils::calculate_projection_matrix(initial_aspect_ratio)} {
-  initialize_scene_graph();
-  initialize_stars(3000);
-  initialize_orbits(720);
-  initializeTextures();
-  initializeSkybox();
-  initializeScreenQuad();
-  initializeFramebuffer();
-  initializeShaderPrograms();
+  // cpu stages run on the workers, gl stages here as soon as their inputs
+  // are ready, the results are handed on in these
+  std::vector<model> lod_models{};
+  std::vector<GLfloat> star_vertices{};
+  std::vector<GLfloat> orbit_vertices{};
+  model skybox_model{};
+  model screenquad_model{};
+  std::vector<std::pair<GeometryNode*, pixel_data>> heightmaps{};
+  job_system::affinity const gl = job_system::affinity::main_thread;
+
+  task_graph startup{};
+  startup.add("planet_lods", {}, [&]() { buildPlanetLods(lod_models); });
+  startup.add("occluder_lods", {}, [&]() { buildOccluderLods(); });
+  startup.add("planet_geometry", {"planet_lods"},
+              [&]() { initializeGeometry(lod_models); }, gl);
+  startup.add("scene_graph", {"planet_lods"},
+              [&]() { initialize_scene_graph(lod_models.front()); });
+  startup.add("ephemeris", {"scene_graph"}, [&]() { initializeEphemeris(); });
+  startup.add("heightmaps", {"scene_graph"},
+              [&]() { decodeHeightmaps(heightmaps); });
+  // asks the context for etc2 support and queues the decoding
+  // after the heightmaps, which decode earth and moon into the cache first,
+  // so both read one decoded file and only one of them writes its cache
+  startup.add("decode_textures", {"scene_graph", "heightmaps"},
+              [&]() { decodeTextures(); }, gl);
+  startup.add("textures", {"decode_textures"},
+              [&]() { initializeTextures(); }, gl);
+  startup.add("virtual_textures", {"scene_graph"},
+              [&]() { initializeVirtualTextures(); }, gl);
+  startup.add("terrains", {"heightmaps"},
+              [&]() { initializeTerrains(heightmaps); }, gl);
+  startup.add("stars", {}, [&]() { initialize_stars(3000, star_vertices); });
+  startup.add("star_geometry", {"stars"},
+              [&]() { initializeGeometry(star_vertices, 1); }, gl);
+  startup.add("orbits", {}, [&]() { initialize_orbits(720, orbit_vertices); });
+  startup.add("orbit_geometry", {"orbits"},
+              [&]() { initializeGeometry(orbit_vertices, 2); }, gl);
+  startup.add("skybox_files", {}, [&]() { loadSkybox(skybox_model); });
+  startup.add("skybox", {"skybox_files"},
+              [&]() { initializeSkybox(skybox_model); }, gl);
+  startup.add("screenquad_model", {}, [&]() {
+    screenquad_model =
+        model_loader::obj(m_resource_path + "models/quad.obj", model::TEXCOORD);
+  });
+  startup.add("screenquad", {"screenquad_model"},
+              [&]() { initializeScreenQuad(screenquad_model); }, gl);
+  startup.add("impostor", {}, [&]() { initializeImpostor(); }, gl);
+  startup.add("framebuffer", {}, [&]() { initializeFramebuffer(); }, gl);
+  startup.add("gpu_culler", {"scene_graph", "planet_geometry", "impostor"},
+              [&]() { initializeGpuBodies(); }, gl);
+  startup.add("shader_programs", {"gpu_culler"},
+              [&]() { initializeShaderPrograms(); }, gl);
+  startup.run();
+  startup.print_critical_path(std::cout);
+
+  // bodies are placed from the first snapshot on
+  publish(glfwGetTime());
+  startSimulationThread();
 }
 
 ApplicationSolar::~ApplicationSolar() {
-  glDeleteBuffers(1, &planet_object.vertex_BO);
-  glDeleteBuffers(1, &planet_object.element_BO);
-  glDeleteVertexArrays(1, &planet_object.vertex_AO);
+  // the steps use the orbits and gravity below
+  stopSimulationThread();
+
+  for (auto& planet_lod : planet_lods) {
+    glDeleteBuffers(1, &planet_lod.vertex_BO);
+    glDeleteBuffers(1, &planet_lod.element_BO);
+    glDeleteVertexArrays(1, &planet_lod.vertex_AO);
+  }
 
   glDeleteBuffers(1, &star_object.vertex_BO);
   glDeleteVertexArrays(1, &star_object.vertex_AO);
 
   glDeleteBuffers(1, &orbit_object.vertex_BO);
   glDeleteVertexArrays(1, &orbit_object.vertex_AO);
+
+  glDeleteBuffers(1, &impostor_object.element_BO);
+  glDeleteVertexArrays(1, &impostor_object.vertex_AO);
 }
 
 /* ----------------- Rendering the Solar System Application ----------------- */
 
+void ApplicationSolar::simulate(double dt) {
+  if (!m_gravity) {
+    // the orbits are solved for any time
+    return;
+  }
+  for (std::size_t id = 0; id < gravity_bodies.size(); ++id) {
+    m_gravity_previous[id] = gravity_bodies.position(id);
+  }
+  // steps stretched by time warp are split up to keep the leapfrog stable,
+  // the warp is limited so they rarely hit the limit, only very slow frames
+  // give up accuracy for the frame rate
+  std::size_t const substeps = std::min(
+      max_gravity_substeps, std::size_t(std::ceil(dt / m_clock.tick() - 1e-9)));
+  for (std::size_t i = 0; i < substeps; ++i) {
+    gravity_bodies.step(float(dt / double(substeps)));
+  }
+}
+
+void ApplicationSolar::publish(double wall_time) {
+  body_snapshot& snapshot = body_snapshots.back();
+  snapshot.previous_time = m_clock.previous_time();
+  snapshot.time = m_clock.time();
+  snapshot.render_time = m_clock.render_time();
+  snapshot.wall_time = wall_time;
+  snapshot.scale = m_clock.paused() ? 0.0 : m_clock.scale();
+  snapshot.stretched = m_clock.step() > 1.5 * m_clock.tick();
+
+  // the moons follow their orbits around the planets in gravity as well
+  solve_orbits(snapshot.previous_time, snapshot.previous_positions);
+  solve_orbits(snapshot.time, snapshot.positions);
+  snapshot.previous_sun = glm::fvec3{0.0f};
+  snapshot.sun = glm::fvec3{0.0f};
+  if (m_gravity) {
+    snapshot.previous_sun = m_gravity_previous[0];
+    snapshot.sun = gravity_bodies.position(0);
+    for (std::size_t i = 0; i < orbit_nodes.size(); ++i) {
+      if (gravity_ids[i] != std::size_t(-1)) {
+        snapshot.previous_positions[i] = m_gravity_previous[gravity_ids[i]];
+        snapshot.positions[i] = gravity_bodies.position(gravity_ids[i]);
+      }
+    }
+  }
+  body_snapshots.publish();
+}
+
+void ApplicationSolar::update() {
+  // everything below uses the transforms of this frame, from the newest
+  // steps of the simulation thread
+  place_bodies(scene_graph.getRoot(), body_snapshots.front());
+
+  // bodies where they are drawn, for spatial queries
+  body_holders.clear();
+  std::vector<glm::fvec4> body_spheres{};
+  for (auto planet : scene_graph.getRoot()->getChildrenList()) {
+    if (planet->getName() == "camera") {
+      continue;
+    }
+    body_holders.push_back(planet);
+    body_spheres.push_back(body_bounds(planet));
+    for (auto moon : planet->getChildrenList()) {
+      if (moon->getName() == "holder_moon") {
+        body_holders.push_back(moon);
+        body_spheres.push_back(body_bounds(moon));
+      }
+    }
+  }
+  body_tree.update(body_spheres);
+
+  // occluders move as well, so the pyramid of an older frame only hides a
+  // body grown by the farthest motion since then
+  m_body_motion = 0.0f;
+  for (std::size_t id = 0; id < body_spheres.size(); ++id) {
+    glm::fvec3 const center{body_spheres[id]};
+    if (id < m_body_centers.size()) {
+      m_body_motion = std::max(m_body_motion, glm::length(center - m_body_centers[id]));
+    }
+  }
+  m_body_centers.resize(body_spheres.size());
+  for (std::size_t id = 0; id < body_spheres.size(); ++id) {
+    m_body_centers[id] = glm::fvec3{body_spheres[id]};
+  }
+
+  // depth of the last frame, before the scene framebuffer is cleared again
+  if (m_depth_rendered) {
+    hiz.build(FB_depth_attachment.handle, m_shaders.at("hiz_reduce").handle,
+              m_rendered_view_projection);
+    hiz.resolve();
+  }
+
+  if (gpu_bodies) {
+    // the compute shader decides which bodies are drawn
+    for (auto planet : scene_graph.getRoot()->getChildrenList()) {
+      planet->setCulled(false);
+      for (auto child : planet->getChildrenList()) {
+        child->setCulled(false);
+        for (auto moon_geometry : child->getChildrenList()) {
+          moon_geometry->setCulled(false);
+        }
+      }
+    }
+    m_bodies_occluded = 0;
+  }
+  else {
+    cull_scene(scene_graph.getRoot());
+  }
+  m_rendered_view_projection = m_view_projection * glm::inverse(m_view_transform);
+  m_depth_rendered = true;
+
+  glm::fmat4 const view_matrix = glm::inverse(m_view_transform);
+  for (auto& terrain : terrains) {
+    // object space of the unit sphere
+    glm::fmat4 const model_matrix =
+        terrain.first->getParent()->getWorldTransform();
+    glm::fvec3 const camera{glm::inverse(model_matrix) * m_view_transform[3]};
+    terrain.second->update(
+        camera,
+        utils::frustum_planes(m_view_projection * view_matrix * model_matrix),
+        8);
+  }
+
+  m_planet_triangles = 0;
+  m_planet_triangles_finest = 0;
+  m_planet_impostors = 0;
+  planet_draws.resize(texture_files.size());
+  planet_impostors.resize(texture_files.size());
+  for (std::size_t i = 0; i < texture_files.size(); ++i) {
+    // the holder carries the scale
+    glm::fmat4 const model_matrix =
+        texture_files[i].first->getParent()->getWorldTransform();
+    glm::fvec4 const center = view_matrix * model_matrix[3];
+    float const radius = glm::length(glm::fvec3{model_matrix[0]});
+
+    // projected diameter in pixels, the camera looks along -z and the
+    // closest point of the sphere determines the finest level
+    float const depth = -center.z - radius;
+    float const diameter =
+        depth > 0.0f
+            ? radius / depth * m_view_projection[1][1] * m_viewport_height
+            : m_viewport_height;
+    // the visible half of the texture wraps around the diameter
+    texture_residents.request(i, 2.0f * diameter);
+
+    // errors of the unit sphere grow with the scale like the diameter
+    GeometryNode* geometry = texture_files[i].first;
+    std::size_t const lod = geometry->selectLod(0.5f * diameter);
+    sphere_terrain const* terrain = terrainOf(geometry);
+    planet_impostors[i] = diameter < impostor_diameter;
+    if (planet_impostors[i]) {
+      // a quad of two triangles
+      planet_draws[i] = meshlet_draws{};
+      m_planet_triangles += 2;
+      ++m_planet_impostors;
+    }
+    else if (terrain) {
+      planet_draws[i] = meshlet_draws{};
+      m_planet_triangles += terrain->triangles();
+    }
+    else if (gpu_bodies) {
+      // whole levels are drawn through the indirect commands
+      planet_draws[i] = meshlet_draws{};
+      m_planet_triangles += std::size_t(planet_lods[lod].num_elements) / 3;
+    }
+    else {
+      // clusters facing away or outside of the view are skipped
+      glm::fvec3 const camera{glm::inverse(model_matrix) * m_view_transform[3]};
+      cull_meshlets(
+          planet_meshlets[lod], camera,
+          utils::frustum_planes(m_view_projection * view_matrix * model_matrix),
+          planet_draws[i]);
+      m_planet_triangles += planet_draws[i].num_triangles;
+    }
+    m_planet_triangles_finest +=
+        std::size_t(planet_lods.front().num_elements) / 3;
+  }
+  texture_residents.update();
+
+  if (gpu_bodies) {
+    // the pyramid texture is one frame old
+    GLuint const cull_program = m_shaders.at("gpu_cull").handle;
+    glUseProgram(cull_program);
+    glActiveTexture(GL_TEXTURE0 + hiz_unit);
+    glBindTexture(GL_TEXTURE_2D, hiz.texture());
+    glUniform1i(glGetUniformLocation(cull_program, "hiz_Pyramid"), hiz_unit);
+    glUniform1i(glGetUniformLocation(cull_program, "hiz_Levels"),
+                hiz.built() ? GLint(hiz.num_levels()) : 0);
+    glUniformMatrix4fv(glGetUniformLocation(cull_program, "hiz_ViewProjection"),
+                       1, GL_FALSE, glm::value_ptr(hiz.view_projection()));
+    glUniform1f(glGetUniformLocation(cull_program, "hiz_Inflation"),
+                m_body_motion);
+
+    // only bodies which moved or changed their level are uploaded, the
+    // group is the level or the impostors after the levels
+    GLuint const impostor_group = GLuint(planet_lods.size());
+    for (std::size_t id = 0; id < body_holders.size(); ++id) {
+      GeometryNode const* geometry =
+          static_cast<GeometryNode*>(body_holders[id]->getChildrenList().front());
+      std::size_t const file_index = textureIndexOf(geometry);
+      GLuint group = gpu_culler::no_group;
+      GLuint num_indices = GLuint(planet_lods[geometry->getLod()].num_elements);
+      if (drawnInstanced(geometry) && planet_impostors[file_index]) {
+        group = impostor_group;
+        num_indices = GLuint(impostor_object.num_elements);
+      }
+      else if (drawnInstanced(geometry)) {
+        group = GLuint(geometry->getLod());
+      }
+      gpu_bodies->set_body(id, body_holders[id]->getWorldTransform(),
+                           geometry->getBoundingSphere(), group,
+                           GLuint(file_index), num_indices);
+    }
+    gpu_bodies->cull(m_shaders.at("gpu_cull").handle,
+                     utils::frustum_planes(m_view_projection * view_matrix));
+  }
+
+  if (!virtual_textures.empty()) {
+    // tiles seen a few frames ago, the read back finishes asynchronously
+    vt_feedback.resolve([this](std::size_t id, std::size_t level,
+                               std::size_t x, std::size_t y) {
+      if (id < virtual_textures.size()) {
+        virtual_textures[id].second->request(level, x, y);
+      }
+    });
+    for (auto& virtual_tex : virtual_textures) {
+      virtual_tex.second->update(8);
+    }
+    renderFeedback();
+  }
+
+  // limit the pixels uploaded per frame so streaming textures causes no hitch
+  texture_stream.update(1 << 20);
+
+  if (planet_layers) {
+    // layers follow the placeholder, the streamed texture and its resident
+    // levels
+    GLuint const layer_program = m_shaders.at("texture_layer").handle;
+    for (std::size_t i = 0; i < texture_files.size(); ++i) {
+      planet_layers->set_layer(layer_program, i,
+                               texture_files[i].first->getTextureObj(),
+                               texture_residents.base_level(i));
+    }
+    planet_layers->update_mipmaps();
+  }
+}
+
 void ApplicationSolar::render() const {
   // ---- Bind Framebuffer Object to render the scene to it ----
   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.handle);
@@ -103,10 +468,6 @@ void ApplicationSolar::render_orbits() const {
 void ApplicationSolar::render_scene(
     Node* root,
     glm::fmat4 const& solar_system_origin) const {
-  int planet_rotation_speed_factor = 1;
-  glm::vec4 origin = solar_system_origin * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
-  glm::vec3 distance = glm::vec3{origin.x, origin.y, origin.z};
-
   auto sol = root->getChildrenList();
   PointLightNode* sun_temp = static_cast<PointLightNode*>(
       root->getChild("holder_sun")->getChild("point_light"));
@@ -117,36 +478,199 @@ void ApplicationSolar::render_scene(
   for (auto planet : sol) {
     // ignore rendering the camera
     if (planet->getName() != "camera") {
-      // calculate the matrix of each planet
-      process_planet_matrix(planet, distance, solar_system_origin,
-                            planet_rotation_speed_factor);
-
-      // use it to get the image for this frame
-      render_planet(planet, sun_temp, texture_index);
-
-      auto moons = planet->getChildrenList();
-      uint32_t moon_texture_index = sol.size();
-      if (!moons.empty()) {
-        glm::fvec3 moon_distance_from_planet = glm::fvec3{2.0f, 0.0f, 0.0f};
-        glm::fvec3 moon_size = glm::fvec3{0.5f};
+      // the planet and its moons are skipped together if all are outside
+      if (!planet->isCulled()) {
+        // use it to get the image for this frame
+        if (!planet->getChildrenList().front()->isCulled()) {
+          render_planet(planet, sun_temp, texture_index);
+        }
 
-        for (auto moon : moons) {
+        uint32_t moon_texture_index = sol.size();
+        for (auto moon : planet->getChildrenList()) {
           if (moon->getName() == "holder_moon") {
-            process_moon_matrix(moon, planet, moon_distance_from_planet,
-                                moon_size);
-
-            render_planet(moon, sun_temp, moon_texture_index);
+            if (!moon->isCulled()) {
+              render_planet(moon, sun_temp, moon_texture_index);
+            }
             ++moon_texture_index;
           }
         }
       }
-
-      // lazy increment for the next planet
-      distance += glm::fvec3{4.0f, 0.0f, 0.0f};
-      ++planet_rotation_speed_factor;
       ++texture_index;
     }
   }
+
+  if (gpu_bodies) {
+    render_instanced(sun_temp);
+  }
+}
+
+void ApplicationSolar::place_bodies(Node* root,
+                                    body_snapshot const& snapshot) const {
+  glm::fmat4 const solar_system_origin = root->getWorldTransform();
+  // the frame lies between the last two steps as far as the wall clock
+  // moved on since they were published, one time for all bodies so they
+  // stay in step within a frame
+  double const elapsed = glfwGetTime() - snapshot.wall_time;
+  double const time =
+      std::min(std::max(snapshot.render_time + elapsed * snapshot.scale,
+                        snapshot.previous_time),
+               snapshot.time);
+  // steps stretched by time warp are too far apart to interpolate
+  float const alpha =
+      snapshot.stretched || snapshot.time <= snapshot.previous_time
+          ? 1.0f
+          : float((time - snapshot.previous_time) /
+                  (snapshot.time - snapshot.previous_time));
+
+  Node* sun = root->getChild("holder_sun");
+  if (sun != nullptr) {
+    glm::fmat4 const sun_matrix = glm::translate(
+        solar_system_origin,
+        glm::mix(snapshot.previous_sun, snapshot.sun, alpha));
+    // one turn in 2 pi seconds, reduced in double for warped times
+    float const angle = float(std::fmod(time, 2.0 * glm::pi<double>()));
+    sun->setWorldTransform(
+        glm::rotate(sun_matrix, angle, glm::fvec3{0.0f, 1.0f, 0.0f}) *
+        glm::scale(glm::fvec3{1.8f}));
+  }
+
+  // planets are placed before their moons
+  for (std::size_t i = 0; i < orbit_nodes.size(); ++i) {
+    Node* body = orbit_nodes[i];
+    glm::fvec3 const position = glm::mix(snapshot.previous_positions[i],
+                                         snapshot.positions[i], alpha);
+    if (body->getParent() == root) {
+      process_body_matrix(body, solar_system_origin, position, 1.8f, time);
+    } else {
+      // moons circle the center of their planet, without its turn and size
+      glm::fvec4 const center = body->getParent()->getWorldTransform() *
+                                glm::fvec4{0.0f, 0.0f, 0.0f, 1.0f};
+      process_body_matrix(body, glm::translate(glm::fvec3{center}), position,
+                          0.9f, time);
+    }
+  }
+}
+
+void ApplicationSolar::solve_orbits(double time,
+                                    std::vector<glm::fvec3>& positions) const {
+  // all orbits looked up or solved in one pass
+  if (body_ephemeris && time >= body_ephemeris->start() &&
+      time < body_ephemeris->end()) {
+    body_ephemeris->evaluate(time, positions);
+  } else {
+    body_orbits.evaluate(time, positions);
+  }
+}
+
+void ApplicationSolar::cull_scene(Node* root) {
+  std::array<glm::fvec4, 6> const frustum =
+      utils::frustum_planes(m_view_projection * glm::inverse(m_view_transform));
+
+  // bounds of each planet merged with the ones of its moons
+  std::vector<Node*> subtrees{};
+  frustum_culling::sphere_list spheres{};
+  for (auto planet : root->getChildrenList()) {
+    if (planet->getName() == "camera") {
+      continue;
+    }
+    glm::fvec4 bounds = body_bounds(planet);
+    for (auto moon : planet->getChildrenList()) {
+      if (moon->getName() == "holder_moon") {
+        moon->setWorldBounds(body_bounds(moon));
+        bounds = frustum_culling::merge(bounds, moon->getWorldBounds());
+      }
+    }
+    planet->setWorldBounds(bounds);
+    subtrees.push_back(planet);
+    spheres.push_back(bounds);
+  }
+  std::vector<std::uint8_t> visible{};
+  frustum_culling::test(frustum, spheres, visible);
+
+  // the bodies of the visible subtrees are tested in one more batch
+  std::vector<Node*> bodies{};
+  std::vector<Node*> holders{};
+  spheres.clear();
+  for (std::size_t i = 0; i < subtrees.size(); ++i) {
+    subtrees[i]->setCulled(!visible[i]);
+    if (!visible[i]) {
+      continue;
+    }
+    bodies.push_back(subtrees[i]->getChildrenList().front());
+    holders.push_back(subtrees[i]);
+    spheres.push_back(body_bounds(subtrees[i]));
+    for (auto moon : subtrees[i]->getChildrenList()) {
+      if (moon->getName() == "holder_moon") {
+        bodies.push_back(moon);
+        holders.push_back(moon);
+        spheres.push_back(moon->getWorldBounds());
+      }
+    }
+  }
+  frustum_culling::test(frustum, spheres, visible);
+  for (std::size_t i = 0; i < bodies.size(); ++i) {
+    bodies[i]->setCulled(!visible[i]);
+  }
+
+  // the bodies in view occlude each other, the occluder levels lie inside
+  // every unit sphere and terrain so no visible body is hidden
+  glm::fmat4 const view_matrix = glm::inverse(m_view_transform);
+  glm::fmat4 const view_projection = m_view_projection * view_matrix;
+  occluders.clear();
+  for (std::size_t i = 0; i < bodies.size(); ++i) {
+    if (!visible[i]) {
+      continue;
+    }
+    // coarsest level whose error stays within a pixel of the occlusion
+    // buffer, the error of the unit sphere grows with the scale
+    glm::fmat4 const model_matrix = holders[i]->getWorldTransform();
+    float const radius = glm::length(glm::fvec3{model_matrix[0]});
+    float const depth = -(view_matrix * model_matrix[3]).z - radius;
+    std::size_t level = 0;
+    if (depth > 0.0f) {
+      float const pixels_per_unit = 0.5f * m_view_projection[1][1] *
+                                    float(occluders.height()) * radius / depth;
+      level = occluder_lods.size() - 1;
+      while (level > 0 &&
+             occluder_lod_errors[level] * pixels_per_unit > 1.0f) {
+        --level;
+      }
+    }
+    occluders.add_occluder(occluder_lods[level],
+                           view_projection * model_matrix);
+  }
+  occluders.rasterize();
+  m_bodies_occluded = 0;
+  m_bodies_hiz_occluded = 0;
+  // the read back depth is older than the last frame by its age
+  float const inflation = float(hiz.readback_age() + 1) * m_body_motion;
+  for (std::size_t i = 0; i < bodies.size(); ++i) {
+    glm::fvec4 const sphere{spheres.x[i], spheres.y[i], spheres.z[i],
+                            spheres.radius[i]};
+    if (!visible[i]) {
+      continue;
+    }
+    if (!occluders.visible(sphere, view_projection)) {
+      bodies[i]->setCulled(true);
+      ++m_bodies_occluded;
+    }
+    else if (!hiz.visible(sphere + glm::fvec4{0.0f, 0.0f, 0.0f, inflation})) {
+      bodies[i]->setCulled(true);
+      ++m_bodies_hiz_occluded;
+    }
+  }
+}
+
+glm::fvec4 ApplicationSolar::body_bounds(Node* holder) const {
+  GeometryNode const* geometry =
+      static_cast<GeometryNode*>(holder->getChildrenList().front());
+  glm::fvec4 sphere = geometry->getBoundingSphere();
+  // terrain rises above the unit sphere
+  sphere_terrain const* terrain = terrainOf(geometry);
+  if (terrain) {
+    sphere.w *= terrain->radius();
+  }
+  return frustum_culling::transform(holder->getWorldTransform(), sphere);
 }
 
 // Rendering the Planet using the shader
@@ -156,6 +680,17 @@ void ApplicationSolar::render_planet(Node* planet,
   GeometryNode* planet_geo =
       static_cast<GeometryNode*>(planet->getChildrenList().front());
 
+  if (drawnInstanced(planet_geo)) {
+    return;
+  }
+
+  // chosen in update by the size on screen
+  std::size_t const file_index = textureIndexOf(planet_geo);
+  if (file_index < planet_impostors.size() && planet_impostors[file_index]) {
+    render_impostor(planet, point_light, planet_index);
+    return;
+  }
+
   // bind shader to upload uniforms
   glUseProgram(m_shaders.at("planet").handle);
 
@@ -193,24 +728,316 @@ void ApplicationSolar::render_planet(Node* planet,
   glUniform3f(glGetUniformLocation(m_shaders.at("planet").handle, "light_Pos"),
               light_position.x, light_position.y, light_position.z);
 
+  // samplers of different types must not share a unit, even if unused
+  GLuint const planet_program = m_shaders.at("planet").handle;
+  glUniform1i(glGetUniformLocation(planet_program, "vt_Indirection"),
+              vt_indirection_unit);
+  glUniform1i(glGetUniformLocation(planet_program, "vt_Cache"), vt_cache_unit);
+
+  // draw the virtual texture instead if the planet has one
+  auto virtual_tex =
+      std::find_if(virtual_textures.begin(), virtual_textures.end(),
+                   [planet_geo](std::pair<GeometryNode*, std::unique_ptr<virtual_texture>> const& entry) {
+                     return entry.first == planet_geo;
+                   });
+  glUniform1i(glGetUniformLocation(planet_program, "vt_Enabled"),
+              virtual_tex != virtual_textures.end());
+  if (virtual_tex != virtual_textures.end()) {
+    virtual_texture const& vt = *virtual_tex->second;
+    glActiveTexture(GL_TEXTURE0 + vt_indirection_unit);
+    glBindTexture(vt.indirection_texture().target,
+                  vt.indirection_texture().handle);
+    glActiveTexture(GL_TEXTURE0 + vt_cache_unit);
+    glBindTexture(vt.cache_texture().target, vt.cache_texture().handle);
+
+    uploadVirtualTexture(
+        "planet", std::size_t(virtual_tex - virtual_textures.begin()));
+    glUniform1f(glGetUniformLocation(planet_program, "vt_Border"),
+                float(vt.pyramid().border()));
+    glUniform1f(glGetUniformLocation(planet_program, "vt_CacheSize"),
+                float(vt.cache_size()));
+  }
+
   // draw the planet's texture
   texture_object planet_texture_object = planet_geo->getTextureObj();
 
   glActiveTexture(GL_TEXTURE1 + planet_index);
   glBindTexture(planet_texture_object.target, planet_texture_object.handle);
 
+  // sampler takes the texture unit, not the texture handle
   glUniform1i(
       glGetUniformLocation(m_shaders.at("planet").handle, "planet_Texture"),
-      planet_texture_object.handle);
+      GLint(1 + planet_index));
+
+  GLint const morph_range_location =
+      glGetUniformLocation(planet_program, "morph_Range");
+  sphere_terrain const* terrain = terrainOf(planet_geo);
+  if (terrain) {
+    glm::fvec3 const camera{glm::inverse(model_matrix) * m_view_transform[3]};
+    glUniform3f(glGetUniformLocation(planet_program, "camera_Position"),
+                camera.x, camera.y, camera.z);
+    // chunks chosen in update, each morphs over its own range
+    for (auto const& chunk : terrain->selection()) {
+      glUniform2f(morph_range_location, chunk.morph_start, chunk.morph_end);
+      glBindVertexArray(chunk.vertex_AO);
+      glDrawElements(GL_TRIANGLES, terrain->num_elements(), model::INDEX.type,
+                     NULL);
+    }
+    return;
+  }
+  glUniform2f(morph_range_location, 0.0f, 0.0f);
+
+  // bind the VAO of the selected level of detail
+  model_object const& planet_lod = planet_lods[planet_geo->getLod()];
+  glBindVertexArray(planet_lod.vertex_AO);
+
+  // draw the command the compute shader wrote in update, no instance if
+  // the body was culled
+  auto body = std::find(body_holders.begin(), body_holders.end(), planet);
+  if (gpu_bodies && body != body_holders.end()) {
+    std::size_t const id = std::size_t(body - body_holders.begin());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpu_bodies->command_buffer());
+    glDrawElementsIndirect(planet_lod.draw_mode, model::INDEX.type,
+                           reinterpret_cast<GLvoid const*>(id * gpu_culler::command_bytes));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return;
+  }
 
-  // bind the VAO to draw
-  glBindVertexArray(planet_object.vertex_AO);
+  // draw the meshlets which survived culling in update
+  if (file_index < planet_draws.size()) {
+    meshlet_draws const& draws = planet_draws[file_index];
+    glMultiDrawElements(planet_lod.draw_mode, draws.counts.data(),
+                        model::INDEX.type, draws.offsets.data(),
+                        GLsizei(draws.counts.size()));
+    return;
+  }
 
   // draw bound vertex array using bound shader
-  glDrawElements(planet_object.draw_mode, planet_object.num_elements,
+  glDrawElements(planet_lod.draw_mode, planet_lod.num_elements,
                  model::INDEX.type, NULL);
 }
 
+void ApplicationSolar::render_impostor(Node* planet,
+                                       PointLightNode* point_light,
+                                       uint32_t const planet_index) const {
+  GeometryNode* planet_geo =
+      static_cast<GeometryNode*>(planet->getChildrenList().front());
+  GLuint const impostor_program = m_shaders.at("impostor").handle;
+  glUseProgram(impostor_program);
+
+  glm::fmat4 const model_matrix = planet->getWorldTransform();
+  glUniformMatrix4fv(m_shaders.at("impostor").u_locs.at("ModelMatrix"), 1,
+                     GL_FALSE, glm::value_ptr(model_matrix));
+
+  // lit like the meshes
+  glUniform3f(glGetUniformLocation(impostor_program, "light_Color"),
+              point_light->getlightColour().x, point_light->getlightColour().y,
+              point_light->getlightColour().z);
+  glUniform1f(glGetUniformLocation(impostor_program, "light_Intensity"),
+              point_light->getlightIntesity());
+  glm::fvec4 const light_position =
+      point_light->getWorldTransform() * glm::fvec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glUniform3f(glGetUniformLocation(impostor_program, "light_Pos"),
+              light_position.x, light_position.y, light_position.z);
+
+  texture_object planet_texture_object = planet_geo->getTextureObj();
+  glActiveTexture(GL_TEXTURE1 + planet_index);
+  glBindTexture(planet_texture_object.target, planet_texture_object.handle);
+  glUniform1i(glGetUniformLocation(impostor_program, "planet_Texture"),
+              GLint(1 + planet_index));
+
+  glBindVertexArray(impostor_object.vertex_AO);
+  glDrawArrays(impostor_object.draw_mode, 0, impostor_object.num_elements);
+}
+
+void ApplicationSolar::render_instanced(PointLightNode* point_light) const {
+  glm::fvec4 const light_position =
+      point_light->getWorldTransform() * glm::fvec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glActiveTexture(GL_TEXTURE0 + layers_unit);
+  glBindTexture(planet_layers->texture().target,
+                planet_layers->texture().handle);
+  for (std::string const name : {"planet_instanced", "impostor_instanced"}) {
+    GLuint const program = m_shaders.at(name).handle;
+    glUseProgram(program);
+    glUniform3f(glGetUniformLocation(program, "light_Color"),
+                point_light->getlightColour().x,
+                point_light->getlightColour().y,
+                point_light->getlightColour().z);
+    glUniform1f(glGetUniformLocation(program, "light_Intensity"),
+                point_light->getlightIntesity());
+    glUniform3f(glGetUniformLocation(program, "light_Pos"), light_position.x,
+                light_position.y, light_position.z);
+    glUniform1i(glGetUniformLocation(program, "planet_Textures"), layers_unit);
+  }
+
+  // the commands of bodies in other groups or culled draw no instance
+  glUseProgram(m_shaders.at("planet_instanced").handle);
+  for (std::size_t lod = 0; lod < planet_lods.size(); ++lod) {
+    glBindVertexArray(planet_lods[lod].vertex_AO);
+    gpu_bodies->draw_group(GLuint(lod), planet_lods[lod].draw_mode,
+                           model::INDEX.type);
+  }
+  // two triangles each
+  glUseProgram(m_shaders.at("impostor_instanced").handle);
+  glBindVertexArray(impostor_object.vertex_AO);
+  gpu_bodies->draw_group(GLuint(planet_lods.size()), impostor_object.draw_mode,
+                         model::INDEX.type);
+}
+
+sphere_terrain* ApplicationSolar::terrainOf(GeometryNode const* geometry) const {
+  for (auto const& terrain : terrains) {
+    if (terrain.first == geometry) {
+      return terrain.second.get();
+    }
+  }
+  return nullptr;
+}
+
+std::size_t ApplicationSolar::textureIndexOf(GeometryNode const* geometry) const {
+  auto texture_file =
+      std::find_if(texture_files.begin(), texture_files.end(),
+                   [geometry](std::pair<GeometryNode*, std::string> const& entry) {
+                     return entry.first == geometry;
+                   });
+  return std::size_t(texture_file - texture_files.begin());
+}
+
+bool ApplicationSolar::drawnInstanced(GeometryNode const* geometry) const {
+  if (!gpu_bodies || terrainOf(geometry)) {
+    return false;
+  }
+  // virtual textures have their own samplers
+  return std::none_of(virtual_textures.begin(), virtual_textures.end(),
+                      [geometry](std::pair<GeometryNode*, std::unique_ptr<virtual_texture>> const& entry) {
+                        return entry.first == geometry;
+                      });
+}
+
+void ApplicationSolar::printStats() const {
+  std::cout << "planet triangles: " << m_planet_triangles << " of "
+            << m_planet_triangles_finest << " at full detail, "
+            << m_planet_impostors << " bodies as impostors" << std::endl;
+  // bodies inside the view frustum and not occluded
+  std::size_t bodies_visible = 0;
+  std::size_t bodies_culled = 0;
+  for (auto planet : scene_graph.getRoot()->getChildrenList()) {
+    if (planet->getName() == "camera") {
+      continue;
+    }
+    std::size_t& planet_count = planet->getChildrenList().front()->isCulled() ? bodies_culled : bodies_visible;
+    ++planet_count;
+    for (auto moon : planet->getChildrenList()) {
+      if (moon->getName() == "holder_moon") {
+        std::size_t& moon_count = moon->isCulled() ? bodies_culled : bodies_visible;
+        ++moon_count;
+      }
+    }
+  }
+  if (gpu_bodies) {
+    std::size_t const gpu_visible = gpu_bodies->visible_bodies();
+    std::cout << "bodies: " << gpu_visible << " visible, "
+              << gpu_bodies->num_bodies() - gpu_visible
+              << " culled on the gpu, " << gpu_bodies->occluded_bodies()
+              << " of them by the depth pyramid, "
+              << gpu_bodies->uploaded_bytes() << " bytes uploaded"
+              << std::endl;
+  }
+  else {
+    std::cout << "bodies: " << bodies_visible << " visible, " << bodies_culled
+              << " culled, " << m_bodies_occluded << " of them occluded, "
+              << m_bodies_hiz_occluded << " by the depth pyramid "
+              << hiz.readback_age() << " frames old" << std::endl;
+  }
+  {
+    // the simulation thread steps in between
+    std::lock_guard<std::mutex> lock{m_clock_mutex};
+    std::cout << "time: " << m_clock.render_time() << " s at "
+              << m_clock.scale() << "x" << (m_clock.paused() ? ", paused" : "")
+              << (m_clock.deterministic() ? ", deterministic" : "") << ", "
+              << m_clock.steps() << " steps on the simulation thread"
+              << std::endl;
+    if (m_gravity) {
+      std::cout << "gravity: " << gravity_bodies.size() << " bodies, "
+                << gravity_bodies.interactions() << " interactions per step"
+                << std::endl;
+    }
+  }
+
+  // picking and proximity through the body tree
+  glm::fvec3 const camera{m_view_transform[3]};
+  std::size_t target = 0;
+  float target_distance = 0.0f;
+  if (body_tree.raycast(camera, -glm::fvec3{m_view_transform[2]}, target,
+                        target_distance)) {
+    std::cout << "looking at " << body_holders[target]->getName() << " in "
+              << target_distance << " units" << std::endl;
+  }
+  std::vector<std::size_t> closest{};
+  body_tree.nearest(camera, 3, closest);
+  std::cout << "closest bodies:";
+  for (std::size_t id : closest) {
+    std::cout << " " << body_holders[id]->getName();
+  }
+  std::cout << std::endl;
+  std::cout << "texture levels: " << (texture_residents.resident_bytes() >> 10)
+            << " KiB resident, " << (texture_residents.pending_bytes() >> 10)
+            << " KiB pending" << std::endl;
+  for (auto const& virtual_tex : virtual_textures) {
+    std::cout << "virtual texture tiles: "
+              << virtual_tex.second->resident_tiles() << " resident, "
+              << virtual_tex.second->pending_tiles() << " pending"
+              << std::endl;
+  }
+  for (auto const& terrain : terrains) {
+    std::cout << "terrain chunks: " << terrain.second->selection().size()
+              << " drawn, " << terrain.second->resident_chunks()
+              << " resident, " << terrain.second->pending_chunks()
+              << " pending" << std::endl;
+  }
+}
+
+void ApplicationSolar::renderFeedback() {
+  vt_feedback.begin();
+  glUseProgram(m_shaders.at("vt_feedback").handle);
+
+  for (std::size_t i = 0; i < virtual_textures.size(); ++i) {
+    // world transform placed in update like for the texture residency
+    glm::fmat4 const model_matrix =
+        virtual_textures[i].first->getParent()->getWorldTransform();
+    glUniformMatrix4fv(m_shaders.at("vt_feedback").u_locs.at("ModelMatrix"),
+                       1, GL_FALSE, glm::value_ptr(model_matrix));
+
+    uploadVirtualTexture("vt_feedback", i);
+    glUniform1i(
+        glGetUniformLocation(m_shaders.at("vt_feedback").handle, "vt_Id"),
+        GLint(i));
+    glUniform1f(glGetUniformLocation(m_shaders.at("vt_feedback").handle,
+                                     "vt_LodBias"),
+                vt_feedback.lod_bias());
+
+    model_object const& planet_lod =
+        planet_lods[virtual_textures[i].first->getLod()];
+    glBindVertexArray(planet_lod.vertex_AO);
+    glDrawElements(planet_lod.draw_mode, planet_lod.num_elements,
+                   model::INDEX.type, NULL);
+  }
+
+  vt_feedback.end();
+}
+
+void ApplicationSolar::uploadVirtualTexture(std::string const& program,
+                                            std::size_t id) const {
+  tile_pyramid const& pyramid = virtual_textures[id].second->pyramid();
+  GLuint const handle = m_shaders.at(program).handle;
+
+  glUniform2f(glGetUniformLocation(handle, "vt_Size"), float(pyramid.width()),
+              float(pyramid.height()));
+  glUniform1f(glGetUniformLocation(handle, "vt_TileSize"),
+              float(pyramid.tile_size()));
+  glUniform1i(glGetUniformLocation(handle, "vt_Levels"),
+              GLint(pyramid.num_levels()));
+}
+
 void ApplicationSolar::render_skybox() const {
   // disable writing to the depth buffers (to draw transparent objects like
   // skybox)
@@ -254,52 +1081,25 @@ void ApplicationSolar::renderScreenQuad() const {
 
 /* ----------------------- calculate transform matrix ----------------------- */
 
-// calculate planet world matrix
-void ApplicationSolar::process_planet_matrix(
-    Node* planet,
-    glm::fvec3& distance,
-    glm::fmat4 const& solar_system_origin,
-    int speed_factor) const {
-  // calculate the planet's matrix when it's translated to the correct
-  // distance from the root.
-  glm::fmat4 planet_matrix;
-
-  if (planet->getName() == "holder_sun") {
-    planet_matrix = glm::rotate(solar_system_origin, float(glfwGetTime()),
-                                glm::fvec3{0.0f, 1.0f, 0.0f}) *
-                    glm::scale(glm::fvec3{1.8f});
-  } else {
-    /* -------------------- planet revolution around the sun
-     * -------------------- */
-    planet_matrix = glm::rotate(solar_system_origin,
-                                2 * float(glfwGetTime() / speed_factor),
-                                glm::fvec3{0.0f, 1.0f, 0.0f}) *
-                    glm::scale(glm::fvec3{1.8f}) * glm::translate(distance);
-
-    /* --------------------- planet rotation around its axis
-     * -------------------- */
-    planet_matrix =
-        glm::rotate(planet_matrix, 10 * float(glfwGetTime() / speed_factor),
-                    glm::fvec3{0.0f, 1.0f, 0.0f});
-  }
-  planet->setWorldTransform(planet_matrix);
-}
+// calculate the world matrix of a planet or moon on its orbit
+void ApplicationSolar::process_body_matrix(Node* body,
+                                           glm::fmat4 const& focus,
+                                           glm::fvec3 const& position,
+                                           float size,
+                                           double time) const {
+  glm::fmat4 body_matrix = focus * glm::translate(position);
+
+  /* --------------------- body rotation around its axis --------------------- */
+  float const rotation_period = body->getOrbit()->rotation_period;
+  if (rotation_period > 0.0f) {
+    // turns counted in double, float time would stutter after a while
+    double const turns = time / double(rotation_period);
+    float const angle =
+        2.0f * glm::pi<float>() * float(turns - std::floor(turns));
+    body_matrix = glm::rotate(body_matrix, angle, glm::fvec3{0.0f, 1.0f, 0.0f});
+  }
 
-// The Moon Matrix with relativity to its Parent Planet
-void ApplicationSolar::process_moon_matrix(
-    Node* moon,
-    Node* planet,
-    glm::fvec3 const& distance_from_planet,
-    glm::fvec3 const& moon_size) const {
-  // multiplication to bring it to the same world coordinate system
-  glm::fmat4 moon_matrix =
-      glm::rotate(planet->getWorldTransform(), float(glfwGetTime()),
-                  glm::fvec3{0.0f, 1.0f, 0.0f}) *
-      glm::translate(distance_from_planet) * glm::scale(moon_size);
-  moon_matrix = glm::rotate(moon_matrix, 10 * float(glfwGetTime() / 2),
-                            glm::fvec3{0.0f, 1.0f, 0.0f});
-
-  moon->setWorldTransform(moon_matrix);
+  body->setWorldTransform(body_matrix * glm::scale(glm::fvec3{size}));
 }
 
 /* --------------------- setting the view of the Camera --------------------- */
@@ -334,6 +1134,22 @@ void ApplicationSolar::uploadView() {
   glUseProgram(m_shaders.at("skybox").handle);
   glUniformMatrix4fv(m_shaders.at("skybox").u_locs.at("ViewMatrix"), 1,
                      GL_FALSE, glm::value_ptr(view_matrix));
+
+  glUseProgram(m_shaders.at("impostor").handle);
+  glUniformMatrix4fv(m_shaders.at("impostor").u_locs.at("ViewMatrix"), 1,
+                     GL_FALSE, glm::value_ptr(view_matrix));
+
+  glUseProgram(m_shaders.at("vt_feedback").handle);
+  glUniformMatrix4fv(m_shaders.at("vt_feedback").u_locs.at("ViewMatrix"), 1,
+                     GL_FALSE, glm::value_ptr(view_matrix));
+
+  if (gpu_bodies) {
+    for (std::string const name : {"planet_instanced", "impostor_instanced"}) {
+      glUseProgram(m_shaders.at(name).handle);
+      glUniformMatrix4fv(m_shaders.at(name).u_locs.at("ViewMatrix"), 1, GL_FALSE,
+                         glm::value_ptr(view_matrix));
+    }
+  }
 }
 
 // Uploading the Projection to be processed by the GPU from the Memory
@@ -356,6 +1172,22 @@ void ApplicationSolar::uploadProjection() {
   glUseProgram(m_shaders.at("skybox").handle);
   glUniformMatrix4fv(m_shaders.at("skybox").u_locs.at("ProjectionMatrix"), 1,
                      GL_FALSE, glm::value_ptr(m_view_projection));
+
+  glUseProgram(m_shaders.at("impostor").handle);
+  glUniformMatrix4fv(m_shaders.at("impostor").u_locs.at("ProjectionMatrix"), 1,
+                     GL_FALSE, glm::value_ptr(m_view_projection));
+
+  glUseProgram(m_shaders.at("vt_feedback").handle);
+  glUniformMatrix4fv(m_shaders.at("vt_feedback").u_locs.at("ProjectionMatrix"),
+                     1, GL_FALSE, glm::value_ptr(m_view_projection));
+
+  if (gpu_bodies) {
+    for (std::string const name : {"planet_instanced", "impostor_instanced"}) {
+      glUseProgram(m_shaders.at(name).handle);
+      glUniformMatrix4fv(m_shaders.at(name).u_locs.at("ProjectionMatrix"), 1, GL_FALSE,
+                         glm::value_ptr(m_view_projection));
+    }
+  }
 }
 
 // update uniform locations
@@ -367,10 +1199,7 @@ void ApplicationSolar::uploadUniforms() {
 
 /* ------------------------ initialization functions ------------------------ */
 
-void ApplicationSolar::initializeScreenQuad() {
-  model screenquad_model =
-      model_loader::obj(m_resource_path + "models/quad.obj", model::TEXCOORD);
-
+void ApplicationSolar::initializeScreenQuad(model const& screenquad_model) {
   // generate vertex array object
   glGenVertexArrays(1, &screenquad_object.vertex_AO);
   // bind the array for attaching buffers
@@ -391,20 +1220,56 @@ void ApplicationSolar::initializeScreenQuad() {
   // first attribute is 3 floats with no offset & stride
   glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type,
                         GL_FALSE, screenquad_model.vertex_bytes,
-                        screenquad_model.offsets[model::POSITION]);
+                        screenquad_model.offsets.at(model::POSITION));
 
   // activate second attribute on gpu
   glEnableVertexAttribArray(1);
   // first attribute is 3 floats with no offset & stride
   glVertexAttribPointer(1, model::TEXCOORD.components, model::TEXCOORD.type,
                         GL_FALSE, screenquad_model.vertex_bytes,
-                        screenquad_model.offsets[model::TEXCOORD]);
+                        screenquad_model.offsets.at(model::TEXCOORD));
 
   // store type of primitive to draw
   screenquad_object.draw_mode = GL_TRIANGLE_STRIP;
   // transfer number of indices to model object
   screenquad_object.num_elements = GLsizei(screenquad_model.indices.size());
 }
+void ApplicationSolar::initializeImpostor() {
+  // the vertex shader places the corners, core profiles still need an array
+  glGenVertexArrays(1, &impostor_object.vertex_AO);
+  glBindVertexArray(impostor_object.vertex_AO);
+  impostor_object.draw_mode = GL_TRIANGLE_STRIP;
+  impostor_object.num_elements = 4;
+
+  // the indirect draws of the gpu culler index the vertices
+  GLuint const indices[4] = {0, 1, 2, 3};
+  glGenBuffers(1, &impostor_object.element_BO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, impostor_object.element_BO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+}
+
+void ApplicationSolar::initializeGpuBodies() {
+  if (!gpu_culler::supported()) {
+    return;
+  }
+  // one slot for every planet and moon, one group for every level of detail
+  // and one for the impostors
+  gpu_bodies.reset(
+      new gpu_culler{texture_files.size(), planet_lods.size() + 1});
+  for (auto const& planet_lod : planet_lods) {
+    glBindVertexArray(planet_lod.vertex_AO);
+    gpu_bodies->bind_body_ids(body_id_location);
+  }
+  glBindVertexArray(impostor_object.vertex_AO);
+  gpu_bodies->bind_body_ids(body_id_location);
+  glBindVertexArray(0);
+
+  // as large as the bundled textures, 2.7 MiB a layer with the mip chain
+  planet_layers.reset(new texture_array{1024, 512, texture_files.size()});
+}
+
 void ApplicationSolar::initializeFramebuffer(unsigned width, unsigned height) {
   glActiveTexture(GL_TEXTURE2);  // 0 is for textures, 1 for normalmapping
 
@@ -429,12 +1294,17 @@ void ApplicationSolar::initializeFramebuffer(unsigned width, unsigned height) {
 
   /* ------------------------ init the Depth Attachment -----------------------
    */
-  glGenRenderbuffers(1, &FB_depth_attachment.handle);
-  glBindRenderbuffer(GL_RENDERBUFFER, FB_depth_attachment.handle);
-
-  // Parameters are: GL_RENDERBUFFER, internalformat (here depth format?),
-  // width, height
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, width, height);
+  // a texture, the depth pyramid is reduced from it
+  glGenTextures(1, &FB_depth_attachment.handle);
+  glBindTexture(GL_TEXTURE_2D, FB_depth_attachment.handle);
+  // read texel by texel, a single level
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0,
+               GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
   // -------- then use both to create the Framebuffer --------
   // Define Framebuffer
@@ -443,8 +1313,8 @@ void ApplicationSolar::initializeFramebuffer(unsigned width, unsigned height) {
   // Define Attachments
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                        FB_color_attachment.handle, 0);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, FB_depth_attachment.handle);
+  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                       FB_depth_attachment.handle, 0);
   // Define which Buffers to write
   GLenum draw_buffers[1] = {GL_COLOR_ATTACHMENT0};
   glDrawBuffers(1, draw_buffers);
@@ -455,78 +1325,93 @@ void ApplicationSolar::initializeFramebuffer(unsigned width, unsigned height) {
   }
 }
 
-void ApplicationSolar::initializeTextures() {
-  auto const& planets = scene_graph.getRoot()->getChildrenList();
-
-  // initialize the texture object for the planet
-  uint32_t texture_index = 0;
-  for (auto planet : planets) {
-    if (!(planet->getName() == "camera")) {
-      GeometryNode* planet_geo =
-          static_cast<GeometryNode*>(planet->getChildrenList().front());
-
-      auto planet_texture = planet_geo->getTexture();
-      planet_geo->setTextureObjAttribute(0, GL_TEXTURE_2D);
-
-      auto texture_object = planet_geo->getTextureObj();
-
-      glActiveTexture(GL_TEXTURE1 + texture_index);
-      glGenTextures(1, &(texture_object.handle));
-
-      glBindTexture(texture_object.target, texture_object.handle);
-
-      glTexParameteri(texture_object.target, GL_TEXTURE_WRAP_S,
-                      GL_CLAMP_TO_EDGE);
-      glTexParameteri(texture_object.target, GL_TEXTURE_WRAP_T,
-                      GL_CLAMP_TO_EDGE);
-
-      glTexParameteri(texture_object.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-      glTexParameteri(texture_object.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-      glTexImage2D(texture_object.target, 0, planet_texture.channels,
-                   planet_texture.width, planet_texture.height, 0,
-                   planet_texture.channels, planet_texture.channel_type,
-                   planet_texture.ptr());
-      glGenerateMipmap(texture_object.target);
-
-      planet_geo->setTextureObj(texture_object);
-
-      // initialize the texture object for the moon if exist
-      uint32_t moon_texture_index = planets.size();
-
-      auto moon = planet->getChild("holder_moon");
-      if (moon != nullptr) {
-        auto moon_geo =
-            static_cast<GeometryNode*>(moon->getChildrenList().front());
-
-        auto moon_texture = moon_geo->getTexture();
-        moon_geo->setTextureObjAttribute(0, GL_TEXTURE_2D);
-
-        auto moon_texture_obj = moon_geo->getTextureObj();
-
-        glActiveTexture(GL_TEXTURE1 + moon_texture_index);
-        glGenTextures(1, &moon_texture_obj.handle);
-        glBindTexture(GL_TEXTURE_2D, moon_texture_obj.handle);
-
-        glTexParameteri(texture_object.target, GL_TEXTURE_WRAP_S,
-                        GL_CLAMP_TO_EDGE);
-        glTexParameteri(texture_object.target, GL_TEXTURE_WRAP_T,
-                        GL_CLAMP_TO_EDGE);
+// start decoding all texture files, the gl thread continues with the other
+// initialization meanwhile
+void ApplicationSolar::decodeTextures() {
+  std::vector<std::string> file_names{};
+  for (auto const& texture_file : texture_files) {
+    file_names.push_back(texture_file.second);
+  }
+  // scene textures take an eighth of the memory when the gpu can sample etc2
+  bool const compressed = utils::supports_compressed_format(GL_COMPRESSED_RGB8_ETC2);
+  decoded_textures = texture_loader::files(file_names, compressed);
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR);  // scale down
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-                        GL_LINEAR);  // scale up (render texture on area bigger
-                                     // than the texture)
+void ApplicationSolar::initializeTextures() {
+  // create the texture objects up front and stream the pixels in over the
+  // next frames, the placeholder is drawn until a texture is complete
+  for (std::size_t i = 0; i < texture_files.size(); ++i) {
+    GeometryNode* geometry = texture_files[i].first;
+
+    texture_object texture{0, GL_TEXTURE_2D};
+    glGenTextures(1, &texture.handle);
+    glBindTexture(texture.target, texture.handle);
+
+    // texcoords of the spheres continue beyond 1 across the seam
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(texture.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);  // scale down
+    glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER,
+                    GL_LINEAR);  // scale up (render texture on area bigger
+                                 // than the texture)
+
+    geometry->setTextureObj(texture_stream.placeholder());
+
+    // the loader built the mip chain, so small planets and moons sample
+    // a level matching their size on screen, finer levels are only
+    // resident while they are large enough
+    texture_residents.add(texture, std::move(decoded_textures[i]),
+                          [geometry](texture_object const& ready) {
+                            geometry->setTextureObj(ready);
+                          });
+  }
+}
 
-        glTexImage2D(GL_TEXTURE_2D, 0, moon_texture.channels,
-                     moon_texture.width, moon_texture.height, 0,
-                     moon_texture.channels, moon_texture.channel_type,
-                     moon_texture.ptr());
-      }
+// a tile pyramid "<texture name>.vtex" next to a texture replaces it, it is
+// written offline by vt_tiler from a far larger version of the texture
+void ApplicationSolar::initializeVirtualTextures() {
+  for (auto const& texture_file : texture_files) {
+    std::string const& file_name = texture_file.second;
+    std::string const tile_file =
+        file_name.substr(0, file_name.find_last_of('.')) + ".vtex";
+    if (!std::ifstream{tile_file}) {
+      continue;
+    }
+    virtual_textures.emplace_back(
+        texture_file.first,
+        std::unique_ptr<virtual_texture>{new virtual_texture{tile_file}});
+    std::cout << "virtual texture " << tile_file << std::endl;
+  }
+}
 
-      ++texture_index;
+// bodies which the camera can approach get a terrain, displaced by
+// "<texture name>_height.png" or the red channel of the texture without one
+void ApplicationSolar::decodeHeightmaps(
+    std::vector<std::pair<GeometryNode*, pixel_data>>& heightmaps) {
+  for (auto const& texture_file : texture_files) {
+    std::string const& file_name = texture_file.second;
+    std::string const name = file_name.substr(file_name.find_last_of('/') + 1);
+    if (name != "earthmap1k.png" && name != "moonmap1k.png") {
+      continue;
     }
+    std::string const height_file =
+        file_name.substr(0, file_name.find_last_of('.')) + "_height.png";
+    heightmaps.emplace_back(
+        texture_file.first,
+        texture_loader::file(std::ifstream{height_file} ? height_file
+                                                        : file_name));
+  }
+}
+
+void ApplicationSolar::initializeTerrains(
+    std::vector<std::pair<GeometryNode*, pixel_data>> const& heightmaps) {
+  for (auto const& heightmap : heightmaps) {
+    terrains.emplace_back(
+        heightmap.first,
+        std::unique_ptr<sphere_terrain>{
+            new sphere_terrain{heightmap.second, 0.02f}});
   }
 }
 
@@ -544,6 +1429,26 @@ void ApplicationSolar::initializeShaderPrograms() {
   m_shaders.at("planet").u_locs["ViewMatrix"] = -1;
   m_shaders.at("planet").u_locs["ProjectionMatrix"] = -1;
 
+  // planets with virtual textures write the tiles they need
+  m_shaders.emplace(
+      "vt_feedback",
+      shader_program{
+          {{GL_VERTEX_SHADER, m_resource_path + "shaders/planet.vert"},
+           {GL_FRAGMENT_SHADER, m_resource_path + "shaders/vt_feedback.frag"}}});
+  m_shaders.at("vt_feedback").u_locs["ModelMatrix"] = -1;
+  m_shaders.at("vt_feedback").u_locs["ViewMatrix"] = -1;
+  m_shaders.at("vt_feedback").u_locs["ProjectionMatrix"] = -1;
+
+  // bodies too small on screen for their mesh
+  m_shaders.emplace(
+      "impostor",
+      shader_program{
+          {{GL_VERTEX_SHADER, m_resource_path + "shaders/impostor.vert"},
+           {GL_FRAGMENT_SHADER, m_resource_path + "shaders/impostor.frag"}}});
+  m_shaders.at("impostor").u_locs["ModelMatrix"] = -1;
+  m_shaders.at("impostor").u_locs["ViewMatrix"] = -1;
+  m_shaders.at("impostor").u_locs["ProjectionMatrix"] = -1;
+
   // store shader program stars in container
   m_shaders.emplace(
       "stars",
@@ -581,14 +1486,53 @@ void ApplicationSolar::initializeShaderPrograms() {
            {GL_FRAGMENT_SHADER, m_resource_path + "shaders/screenquad.frag"}}});
 
   m_shaders.at("screenquad").u_locs["FBTexture"] = -1;
+
+  // reduces the depth of the last frame into the pyramid
+  m_shaders.emplace(
+      "hiz_reduce",
+      shader_program{
+          {{GL_VERTEX_SHADER, m_resource_path + "shaders/hiz_reduce.vert"},
+           {GL_FRAGMENT_SHADER, m_resource_path + "shaders/hiz_reduce.frag"}}});
+
+  // culls the bodies and writes their draws, needs compute shaders
+  if (gpu_bodies) {
+    m_shaders.emplace(
+        "gpu_cull",
+        shader_program{
+            {{GL_COMPUTE_SHADER, m_resource_path + "shaders/gpu_cull.comp"}}});
+
+    // draw the culled bodies reading them from the body buffer
+    m_shaders.emplace(
+        "planet_instanced",
+        shader_program{
+            {{GL_VERTEX_SHADER,
+              m_resource_path + "shaders/planet_instanced.vert"},
+             {GL_FRAGMENT_SHADER,
+              m_resource_path + "shaders/planet_instanced.frag"}}});
+    m_shaders.at("planet_instanced").u_locs["ViewMatrix"] = -1;
+    m_shaders.at("planet_instanced").u_locs["ProjectionMatrix"] = -1;
+    m_shaders.emplace(
+        "impostor_instanced",
+        shader_program{
+            {{GL_VERTEX_SHADER,
+              m_resource_path + "shaders/impostor_instanced.vert"},
+             {GL_FRAGMENT_SHADER,
+              m_resource_path + "shaders/impostor_instanced.frag"}}});
+    m_shaders.at("impostor_instanced").u_locs["ViewMatrix"] = -1;
+    m_shaders.at("impostor_instanced").u_locs["ProjectionMatrix"] = -1;
+
+    // draws the textures into the layers of the texture array
+    m_shaders.emplace(
+        "texture_layer",
+        shader_program{
+            {{GL_VERTEX_SHADER, m_resource_path + "shaders/texture_layer.vert"},
+             {GL_FRAGMENT_SHADER,
+              m_resource_path + "shaders/texture_layer.frag"}}});
+  }
 }
 
 // Populate the scene_graph with all the necessary nodes
-void ApplicationSolar::initialize_scene_graph() {
-  // load the model to be used in geometry nodes creation and shader
-  model planet_model;
-  initializeGeometry(planet_model);
-
+void ApplicationSolar::initialize_scene_graph(model const& planet_model) {
   // Create root node as a pointer to prevent it being destroyed in stack
   Node* root_node = new Node{"root"};
   scene_graph.setRoot(root_node);
@@ -597,33 +1541,62 @@ void ApplicationSolar::initialize_scene_graph() {
   // Build the entire graph one nodes at a time (with geometry for the planets)
   create_camera("camera");
   create_sun("holder_sun", planet_model, glm::fvec3{1.0f, 1.0f, 1.0f});
+  // elements of the real planets, the k-th planet at 7.2 k going around
+  // in pi k seconds and turning in a tenth of that
+  auto const planet_orbit = [](float k, float eccentricity, float inclination,
+                               float ascending_node, float periapsis,
+                               float mean_anomaly) {
+    float const pi = glm::pi<float>();
+    return orbital_elements{7.2f * k,       eccentricity,
+                            inclination,    ascending_node,
+                            periapsis,      mean_anomaly,
+                            pi * k,         2.0f * pi * k / 10.0f};
+  };
   create_planet("holder_mercury", planet_model, glm::fvec3{1.0f, 1.0f, 0.3f},
-                "mercurymap.png");
+                "mercurymap.png",
+                planet_orbit(1.0f, 0.2056f, 0.1222f, 0.843f, 0.508f, 3.051f));
   create_planet("holder_venus", planet_model, glm::fvec3{0.8f, 0.1f, 0.4f},
-                "venusmap.png");
+                "venusmap.png",
+                planet_orbit(2.0f, 0.0068f, 0.0592f, 1.338f, 0.958f, 0.875f));
   create_planet("holder_earth", planet_model, glm::fvec3{0.1f, 1.0f, 0.8f},
-                "earthmap1k.png");
+                "earthmap1k.png",
+                planet_orbit(3.0f, 0.0167f, 0.0f, 0.0f, 1.993f, 6.257f));
   create_planet("holder_mars", planet_model, glm::fvec3{0.8f, 0.2f, 0.7f},
-                "mars_1k_color.png");
+                "mars_1k_color.png",
+                planet_orbit(4.0f, 0.0934f, 0.0323f, 0.865f, 5.0f, 0.338f));
   create_planet("holder_jupiter", planet_model, glm::fvec3{0.8f, 1.0f, 0.1f},
-                "jupitermap.png");
+                "jupitermap.png",
+                planet_orbit(5.0f, 0.0489f, 0.0228f, 1.754f, 4.78f, 0.349f));
   create_planet("holder_saturn", planet_model, glm::fvec3{0.8f, 0.4f, 0.6f},
-                "saturnmap.png");
+                "saturnmap.png",
+                planet_orbit(6.0f, 0.0565f, 0.0434f, 1.984f, 5.924f, 5.533f));
   create_planet("holder_uranus", planet_model, glm::fvec3{0.6f, 0.7f, 0.2f},
-                "uranusmap.png");
+                "uranusmap.png",
+                planet_orbit(7.0f, 0.0457f, 0.0135f, 1.292f, 1.691f, 2.482f));
   create_planet("holdqer_neptune", planet_model, glm::fvec3{0.3f, 0.3f, 0.7f},
-                "neptunemap.png");
+                "neptunemap.png",
+                planet_orbit(8.0f, 0.0113f, 0.0309f, 2.3f, 4.768f, 4.472f));
 
   // Craeting the Moon's obit and attaching it to the Earths Orbit
-  create_moon_for_planet("holder_earth", "holder_moon", planet_model,
-                         glm::fvec3{0.3, 0.3, 0.8}, "moonmap1k.png");
+  float const pi = glm::pi<float>();
+  create_moon_for_planet(
+      "holder_earth", "holder_moon", planet_model, glm::fvec3{0.3, 0.3, 0.8},
+      "moonmap1k.png",
+      orbital_elements{3.6f, 0.0549f, 0.0898f, 2.183f, 5.553f, 2.361f,
+                       2.0f * pi, 2.0f * pi / 5.0f});
+  initializeOrbits();
+
+  // all bodies share the levels of detail of the sphere
+  for (auto const& texture_file : texture_files) {
+    texture_file.first->setLodErrors(planet_lod_errors);
+  }
 
   // Printing the Scenegraph
   std::cout << scene_graph.printGraph() << std::endl;
 }
 
-void ApplicationSolar::initialize_stars(unsigned int const stars_count) {
-  std::vector<gl::GLfloat> star_vector;
+void ApplicationSolar::initialize_stars(unsigned int const stars_count,
+                                        std::vector<GLfloat>& star_vector) {
   std::srand(std::time(nullptr));
   star_vector.resize(stars_count * 6);
   for (unsigned int i = 0; i < stars_count; ++i) {
@@ -636,16 +1609,29 @@ void ApplicationSolar::initialize_stars(unsigned int const stars_count) {
       star_vector.insert(star_vector.begin() + (i * 6 + index) + 3, color_elem);
     }
   }
+}
+
+// parse the skybox model and decode its faces
+void ApplicationSolar::loadSkybox(model& skybox_model) {
+  skybox_model =
+      model_loader::obj(m_resource_path + "models/skybox.obj", model::NORMAL);
 
-  initializeGeometry(star_vector, 1);
+  // loaded with the cube map api, which expects uncompressed faces
+  std::vector<std::string> const faces{"back", "down", "front",
+                                       "left", "right", "up"};
+  skybox_textures.resize(faces.size());
+  job_system::shared().parallel_for(
+      faces.size(), 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+          skybox_textures[i] = texture_loader::file(
+              m_resource_path + "textures/skybox_" + faces[i] + ".png");
+        }
+      });
 }
 
-void ApplicationSolar::initializeSkybox() {
+void ApplicationSolar::initializeSkybox(model const& skybox_model) {
   /* ------------------------- initialize skybox model ------------------------
    */
-  model skybox_model =
-      model_loader::obj(m_resource_path + "models/skybox.obj", model::NORMAL);
-
   // generate vertex array object
   glGenVertexArrays(1, &skybox_object.vertex_AO);
   // bind the array for attaching buffers
@@ -664,7 +1650,7 @@ void ApplicationSolar::initializeSkybox() {
   // first attribute is 3 floats with no offset & stride
   glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type,
                         GL_FALSE, skybox_model.vertex_bytes,
-                        skybox_model.offsets[model::POSITION]);
+                        skybox_model.offsets.at(model::POSITION));
 
   // generate generic buffer
   glGenBuffers(1, &skybox_object.element_BO);
@@ -686,19 +1672,6 @@ void ApplicationSolar::initializeSkybox() {
   glGenTextures(1, &skybox_texture_object.handle);
   glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_texture_object.handle);
 
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_back.png"));
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_down.png"));
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_front.png"));
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_left.png"));
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_right.png"));
-  skybox_textures.push_back(
-      texture_loader::file(m_resource_path + "textures/skybox_up.png"));
-
   for (uint i = 0; i < skybox_textures.size(); i++) {
     glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
                  skybox_textures[i].channels, skybox_textures[i].width,
@@ -712,66 +1685,95 @@ void ApplicationSolar::initializeSkybox() {
   }
 }
 
-void ApplicationSolar::initialize_orbits(unsigned int const num) {
-  std::vector<GLfloat> orbits;
+void ApplicationSolar::initialize_orbits(unsigned int const num,
+                                         std::vector<GLfloat>& orbits) {
   for (unsigned int i = 0; i < num; ++i) {
     std::vector<GLfloat> xyz{cosf(i * M_PI / (num / 2)), 0,
                              sinf(i * M_PI / (num / 2))};
     orbits.insert(orbits.begin() + 3 * i, xyz.begin(), xyz.end());
   }
-
-  initializeGeometry(orbits, 2);
 }
 
-// initializeGeometry when there is model to be used
-void ApplicationSolar::initializeGeometry(model& planet_model) {
-  planet_model = model_loader::obj(m_resource_path + "models/sphere.obj",
-                                   model::NORMAL | model::TEXCOORD);
-
-  // generate vertex array object
-  glGenVertexArrays(1, &planet_object.vertex_AO);
-  // bind the array for attaching buffers
-  glBindVertexArray(planet_object.vertex_AO);
-
-  // generate generic buffer
-  glGenBuffers(1, &planet_object.vertex_BO);
-  // bind this as an vertex array buffer containing all attributes
-  glBindBuffer(GL_ARRAY_BUFFER, planet_object.vertex_BO);
-  // configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * planet_model.data.size(),
-               planet_model.data.data(), GL_STATIC_DRAW);
-
-  // activate first attribute on gpu
-  glEnableVertexAttribArray(0);
-  // first attribute is 3 floats with no offset & stride
-  glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type,
-                        GL_FALSE, planet_model.vertex_bytes,
-                        planet_model.offsets[model::POSITION]);
-  // activate second attribute on gpu
-  glEnableVertexAttribArray(1);
-  // second attribute is 3 floats with no offset & stride
-  glVertexAttribPointer(1, model::NORMAL.components, model::NORMAL.type,
-                        GL_FALSE, planet_model.vertex_bytes,
-                        planet_model.offsets[model::NORMAL]);
-
-  // generate generic buffer
-  glGenBuffers(1, &planet_object.element_BO);
-  // bind this as an vertex array buffer containing all attributes
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planet_object.element_BO);
-  // configure currently bound array buffer
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               model::INDEX.size * planet_model.indices.size(),
-               planet_model.indices.data(), GL_STATIC_DRAW);
+// levels of detail of the planet sphere with their errors and meshlets,
+// distant planets are drawn with fewer subdivisions of the icosphere
+void ApplicationSolar::buildPlanetLods(std::vector<model>& lods) {
+  lods.clear();
+  planet_lod_errors.clear();
+  planet_meshlets.clear();
+  for (std::size_t subdivisions = 4; subdivisions > 0; --subdivisions) {
+    // copy of the shared sphere, the meshlets reorder its indices
+    lods.push_back(model_loader::icosphere(
+        subdivisions, model::NORMAL | model::TEXCOORD));
+    planet_lod_errors.push_back(model_loader::sphere_error(lods.back()));
+    planet_meshlets.push_back(model_loader::meshlets(lods.back()));
+  }
+}
 
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, model::TEXCOORD.components, model::TEXCOORD.type,
-                        GL_FALSE, planet_model.vertex_bytes,
-                        planet_model.offsets[model::TEXCOORD]);
+// the vertices of every level are vertices of the sphere, scaled to lie on or
+// inside the unit sphere, so each level lies inside the body it occludes
+void ApplicationSolar::buildOccluderLods() {
+  model sphere = model_loader::obj(m_resource_path + "models/sphere.obj");
+  float radius = 0.0f;
+  for (std::size_t i = 0; i + 2 < sphere.data.size(); i += 3) {
+    radius = std::max(radius, glm::length(glm::fvec3{
+        sphere.data[i], sphere.data[i + 1], sphere.data[i + 2]}));
+  }
+  for (auto& value : sphere.data) {
+    value /= radius;
+  }
+  occluder_lods = model_loader::lod_chain(sphere, 7, occluder_lod_errors);
+}
 
-  // store type of primitive to draw
-  planet_object.draw_mode = GL_TRIANGLES;
-  // transfer number of indices to model object
-  planet_object.num_elements = GLsizei(planet_model.indices.size());
+// initializeGeometry when there is model to be used
+void ApplicationSolar::initializeGeometry(std::vector<model> const& lods) {
+  for (auto const& lod : lods) {
+    model_object planet_object{};
+    // generate vertex array object
+    glGenVertexArrays(1, &planet_object.vertex_AO);
+    // bind the array for attaching buffers
+    glBindVertexArray(planet_object.vertex_AO);
+
+    // generate generic buffer
+    glGenBuffers(1, &planet_object.vertex_BO);
+    // bind this as an vertex array buffer containing all attributes
+    glBindBuffer(GL_ARRAY_BUFFER, planet_object.vertex_BO);
+    // configure currently bound array buffer
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * lod.data.size(),
+                 lod.data.data(), GL_STATIC_DRAW);
+
+    // activate first attribute on gpu
+    glEnableVertexAttribArray(0);
+    // first attribute is 3 floats with no offset & stride
+    glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type,
+                          GL_FALSE, lod.vertex_bytes,
+                          lod.offsets.at(model::POSITION));
+    // activate second attribute on gpu
+    glEnableVertexAttribArray(1);
+    // second attribute is 3 floats with no offset & stride
+    glVertexAttribPointer(1, model::NORMAL.components, model::NORMAL.type,
+                          GL_FALSE, lod.vertex_bytes,
+                          lod.offsets.at(model::NORMAL));
+
+    // generate generic buffer
+    glGenBuffers(1, &planet_object.element_BO);
+    // bind this as an vertex array buffer containing all attributes
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planet_object.element_BO);
+    // configure currently bound array buffer
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 model::INDEX.size * lod.indices.size(),
+                 lod.indices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, model::TEXCOORD.components, model::TEXCOORD.type,
+                          GL_FALSE, lod.vertex_bytes,
+                          lod.offsets.at(model::TEXCOORD));
+
+    // store type of primitive to draw
+    planet_object.draw_mode = GL_TRIANGLES;
+    // transfer number of indices to model object
+    planet_object.num_elements = GLsizei(lod.indices.size());
+    planet_lods.push_back(planet_object);
+  }
 }
 
 // initializeGeometry when only array of data is available
@@ -885,9 +1887,11 @@ void ApplicationSolar::create_sun(std::string const& sun_name,
   // As a normal node pointer until light is fully implemented
   Node* sun_holder = new Node{sun_name};
 
-  GeometryNode* sun_geometry = new GeometryNode{
-      "sun_geometry", sun_model, sun_color,
-      texture_loader::file(m_resource_path + "textures/sunmap.png")};
+  GeometryNode* sun_geometry =
+      new GeometryNode{"sun_geometry", sun_model, sun_color, pixel_data{}};
+  // texture is decoded in the background
+  texture_files.emplace_back(sun_geometry,
+                             m_resource_path + "textures/sunmap.png");
 
   // Create its the point light
   PointLightNode* sun_point_light = new PointLightNode{"point_light"};
@@ -907,17 +1911,21 @@ void ApplicationSolar::create_sun(std::string const& sun_name,
 void ApplicationSolar::create_planet(std::string const& planet_name,
                                      model const& planet_model,
                                      glm::fvec3 const& planet_color,
-                                     std::string const& texture_name) {
+                                     std::string const& texture_name,
+                                     orbital_elements const& orbit) {
   // Create it as node pointer to prevent it being destroyed
   Node* planet = new Node{planet_name};
+  planet->setOrbit(orbit);
 
   // Attach the planet node to the root directly
   scene_graph.getRoot()->addChild(planet);
 
   // Create its the geometry
   GeometryNode* geometry = new GeometryNode{
-      "geometry_" + planet_name, planet_model, planet_color,
-      texture_loader::file(m_resource_path + "textures/" + texture_name)};
+      "geometry_" + planet_name, planet_model, planet_color, pixel_data{}};
+  // texture is decoded in the background
+  texture_files.emplace_back(geometry,
+                             m_resource_path + "textures/" + texture_name);
 
   // Attach its geometry to the planet node
   planet->addChild(geometry);
@@ -928,25 +1936,149 @@ void ApplicationSolar::create_moon_for_planet(std::string const& planet_name,
                                               std::string const& moon_name,
                                               model const& moon_model,
                                               glm::fvec3 const& moon_color,
-                                              std::string const& texture_name) {
+                                              std::string const& texture_name,
+                                              orbital_elements const& orbit) {
   // find the planet by its name and assign it to a in place variable
   auto wanted_planet = (scene_graph.getRoot())->getChild(planet_name);
 
   if (wanted_planet != nullptr) {
     // Create it as node pointer to prevent it being destroyed
     Node* moon = new Node{moon_name};
+    moon->setOrbit(orbit);
     wanted_planet->addChild(moon);
 
     // Create its the geometry with the model
     GeometryNode* moon_geometry = new GeometryNode{
-        "geometry_" + moon_name, moon_model, moon_color,
-        texture_loader::file(m_resource_path + "textures/" + texture_name)};
+        "geometry_" + moon_name, moon_model, moon_color, pixel_data{}};
+    // texture is decoded in the background
+    texture_files.emplace_back(moon_geometry,
+                               m_resource_path + "textures/" + texture_name);
 
     // add the geometry to the moon
     moon->addChild(moon_geometry);
   }
 }
 
+// Add the orbit of every planet and moon, planets before their moons
+void ApplicationSolar::initializeOrbits() {
+  body_orbits.clear();
+  orbit_nodes.clear();
+  for (auto planet : scene_graph.getRoot()->getChildrenList()) {
+    if (planet->getOrbit() == nullptr) {
+      continue;
+    }
+    orbit_nodes.push_back(planet);
+    for (auto moon : planet->getChildrenList()) {
+      if (moon->getOrbit() != nullptr) {
+        orbit_nodes.push_back(moon);
+      }
+    }
+  }
+  for (auto body : orbit_nodes) {
+    body_orbits.add(*body->getOrbit());
+  }
+}
+
+// Series of the orbits over the first hour, cached next to the resources
+void ApplicationSolar::initializeEphemeris() {
+  // fnv-1a hash of the elements, series of other orbits are outdated
+  std::uint64_t key = 14695981039346656037ull;
+  for (auto body : orbit_nodes) {
+    unsigned char const* bytes =
+        reinterpret_cast<unsigned char const*>(body->getOrbit());
+    for (std::size_t i = 0; i < sizeof(orbital_elements); ++i) {
+      key = (key ^ bytes[i]) * 1099511628211ull;
+    }
+  }
+  // series of degree 16 over 2 seconds are as exact as the orbit solver
+  double const length = 3600.0;
+  double const segment_length = 2.0;
+  std::size_t const degree = 16;
+
+  std::string const file_name = m_resource_path + "ephemeris.bin";
+  try {
+    body_ephemeris.reset(new ephemeris{file_name});
+    if (body_ephemeris->key() != key ||
+        body_ephemeris->num_bodies() != body_orbits.size() ||
+        body_ephemeris->end() < length ||
+        body_ephemeris->segment_length() != segment_length ||
+        body_ephemeris->degree() != degree) {
+      body_ephemeris.reset();
+    }
+  }
+  catch (std::exception const&) {
+    // no usable cache
+    body_ephemeris.reset();
+  }
+  if (body_ephemeris) {
+    return;
+  }
+
+  body_ephemeris.reset(new ephemeris{
+      body_orbits.size(), 0.0, length, segment_length, degree,
+      [this](double time, std::vector<glm::fvec3>& positions) {
+        body_orbits.evaluate(time, positions);
+      },
+      key});
+  try {
+    body_ephemeris->write(file_name);
+  }
+  catch (std::exception const& error) {
+    // resource directory may be read only, the series are still usable
+    std::cerr << error.what() << std::endl;
+  }
+}
+
+// Start the sun and the planets where their orbits are, with the speed of
+// their orbits around the sun alone
+void ApplicationSolar::initializeGravity() {
+  // the sun keeps the year of the earth, the others move by its gravity
+  float const pi = glm::pi<float>();
+  float const earth_axis = 21.6f;
+  float const earth_year = 3.0f * pi;
+  float const sun_mass =
+      4.0f * pi * pi * std::pow(earth_axis, 3.0f) / (earth_year * earth_year);
+  // masses of the planets relative to the sun, a tenth of the real ones as
+  // the planets are much closer to each other than in the real system
+  std::map<std::string, float> const mass_ratios{
+      {"holder_mercury", 1.66e-8f}, {"holder_venus", 2.45e-7f},
+      {"holder_earth", 3.0e-7f},    {"holder_mars", 3.23e-8f},
+      {"holder_jupiter", 9.55e-5f}, {"holder_saturn", 2.86e-5f},
+      {"holder_uranus", 4.37e-6f},  {"holdqer_neptune", 5.15e-6f}};
+
+  // the state of the last step, frames interpolate towards it
+  double const time = m_clock.time();
+  std::vector<glm::fvec3> positions{};
+  std::vector<glm::fvec3> later_positions{};
+  body_orbits.evaluate(time, positions);
+  body_orbits.evaluate(time + 1e-3, later_positions);
+
+  gravity_bodies.clear();
+  gravity_ids.assign(orbit_nodes.size(), std::size_t(-1));
+  gravity_bodies.add(glm::fvec3{0.0f}, glm::fvec3{0.0f}, sun_mass);
+  for (std::size_t i = 0; i < orbit_nodes.size(); ++i) {
+    Node* body = orbit_nodes[i];
+    if (body->getParent() != scene_graph.getRoot()) {
+      continue;
+    }
+    // along the orbit, as fast as the sun pulls on an orbit of its size
+    float const radius = glm::length(positions[i]);
+    float const speed = std::sqrt(
+        sun_mass * (2.0f / radius - 1.0f / body->getOrbit()->semi_major_axis));
+    glm::fvec3 const direction =
+        glm::normalize(later_positions[i] - positions[i]);
+    auto const ratio = mass_ratios.find(body->getName());
+    float const mass =
+        sun_mass * (ratio != mass_ratios.end() ? ratio->second : 1e-7f);
+    gravity_ids[i] =
+        gravity_bodies.add(positions[i], direction * speed, mass);
+  }
+  m_gravity_previous.resize(gravity_bodies.size());
+  for (std::size_t id = 0; id < gravity_bodies.size(); ++id) {
+    m_gravity_previous[id] = gravity_bodies.position(id);
+  }
+}
+
 /* ------------------ callback functions for window events ------------------ */
 
 // handle key inputs
@@ -1030,6 +2162,59 @@ void ApplicationSolar::keyCallback(int key, int action, int mods) {
     uploadView();
     std::cout << "key X pressed: camera Rotate AntiClockwise" << std::endl;
   }
+
+  else if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+    printStats();
+  }
+  // clock and gravity, pressed or held for scrubbing
+  else if (((key == GLFW_KEY_G || key == GLFW_KEY_P || key == GLFW_KEY_MINUS ||
+             key == GLFW_KEY_EQUAL || key == GLFW_KEY_T) &&
+            action == GLFW_PRESS) ||
+           ((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) &&
+            (action == GLFW_PRESS || action == GLFW_REPEAT))) {
+    controlSimulation(key);
+  }
+}
+
+// change the clock or the gravity between two simulation steps
+void ApplicationSolar::controlSimulation(int key) {
+  std::lock_guard<std::mutex> lock{m_clock_mutex};
+  // switch between the orbits and the gravity of the bodies
+  if (key == GLFW_KEY_G) {
+    if (!m_gravity) {
+      initializeGravity();
+      m_clock.set_scale(std::min(max_gravity_scale, m_clock.scale()));
+    }
+    m_gravity = !m_gravity;
+  }
+  // scrub the scene time back and forth, gravity starts over from the
+  // orbits there
+  else if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) {
+    double const offset = key == GLFW_KEY_LEFT_BRACKET ? -10.0 : 10.0;
+    m_clock.seek(std::max(0.0, m_clock.render_time() + offset));
+    if (m_gravity) {
+      initializeGravity();
+    }
+  }
+  // pause and warp the simulation by factors of ten up to a million, or a
+  // hundred with gravity
+  else if (key == GLFW_KEY_P) {
+    m_clock.set_paused(!m_clock.paused());
+  }
+  else if (key == GLFW_KEY_MINUS) {
+    m_clock.set_scale(std::max(0.01, m_clock.scale() / 10.0));
+  }
+  else if (key == GLFW_KEY_EQUAL) {
+    double const max_scale = m_gravity ? max_gravity_scale : 1e6;
+    m_clock.set_scale(std::min(max_scale, m_clock.scale() * 10.0));
+  }
+  // every round of the simulation thread takes exactly one step, for
+  // repeatable runs
+  else if (key == GLFW_KEY_T) {
+    m_clock.set_deterministic(!m_clock.deterministic(), m_clock.tick());
+  }
+  // frames follow the change right away
+  publish(glfwGetTime());
 }
 
 // handle delta mouse movement input
@@ -1049,6 +2234,11 @@ void ApplicationSolar::resizeCallback(unsigned width, unsigned height) {
   m_view_projection =
       utils::calculate_projection_matrix(float(width) / float(height));
   initializeFramebuffer(width, height);
+  vt_feedback.resize(width, height);
+  // the new depth texture holds no frame yet
+  hiz.resize(width, height);
+  m_depth_rendered = false;
+  m_viewport_height = float(height);
   // upload new projection matrix
   uploadProjection();
 }
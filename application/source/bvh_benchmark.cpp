@@ -0,0 +1,191 @@
+#include "bvh.hpp"
+#include "utils.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// microseconds per call of the function, run count times
+static double time_per_call(std::size_t count, std::function<void(std::size_t)> const& function) {
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    function(i);
+  }
+  std::chrono::duration<double, std::micro> const duration = std::chrono::steady_clock::now() - start;
+  return duration.count() / double(count);
+}
+
+static void print(std::string const& query, double tree_time, double brute_time, bool match) {
+  std::cout << "  " << std::left << std::setw(9) << query << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << tree_time << " us" << std::setw(14) << brute_time << " us"
+            << std::setw(10) << brute_time / tree_time << "x" << (match ? "" : "  MISMATCH") << std::endl;
+}
+
+// compare the bvh queries with brute force over random spheres of constant
+// density, from a thousand up to max_bodies
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const max_bodies = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::size_t const num_queries = argc > 2 ? std::stoul(argv[2]) : 100;
+    std::size_t const k = 8;
+    std::mt19937 random{42};
+
+    for (std::size_t bodies = 1000; bodies <= max_bodies; bodies *= 10) {
+      float const side = 4.0f * std::cbrt(float(bodies));
+      std::uniform_real_distribution<float> coordinate{0.0f, side};
+      std::uniform_real_distribution<float> radius{0.2f, 1.0f};
+      std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+
+      std::vector<glm::fvec4> spheres(bodies);
+      for (auto& sphere : spheres) {
+        sphere = glm::fvec4{coordinate(random), coordinate(random), coordinate(random), radius(random)};
+      }
+
+      bvh tree{};
+      auto const start = std::chrono::steady_clock::now();
+      tree.build(spheres);
+      std::chrono::duration<double, std::milli> const build_time = std::chrono::steady_clock::now() - start;
+
+      // bodies drift a little every frame
+      double const update_time = time_per_call(10, [&](std::size_t) {
+        for (auto& sphere : spheres) {
+          sphere += glm::fvec4{unit(random), unit(random), unit(random), 0.0f} * 0.1f;
+        }
+        tree.update(spheres);
+      });
+
+      std::vector<glm::fvec3> points(num_queries);
+      std::vector<glm::fvec3> directions(num_queries);
+      std::vector<std::array<glm::fvec4, 6>> frustums(num_queries);
+      for (std::size_t i = 0; i < num_queries; ++i) {
+        points[i] = glm::fvec3{coordinate(random), coordinate(random), coordinate(random)};
+        directions[i] = glm::normalize(glm::fvec3{unit(random), unit(random), unit(random)} + 0.01f);
+        glm::fmat4 const view = glm::lookAt(points[i], points[i] + directions[i], glm::fvec3{0.0f, 1.0f, 0.0f});
+        frustums[i] = utils::frustum_planes(glm::perspective(1.0f, 1.5f, 0.1f, 20.0f) * view);
+      }
+
+      std::cout << bodies << " bodies: build " << std::fixed << std::setprecision(2) << build_time.count()
+                << " ms, update " << update_time / 1000.0 << " ms, " << tree.builds() << " builds, cost "
+                << tree.cost() << std::endl;
+      std::cout << "  query             bvh         brute   speedup" << std::endl;
+
+      // rays
+      std::vector<std::size_t> tree_hits(num_queries);
+      std::vector<float> tree_distances(num_queries);
+      double const ray_tree = time_per_call(num_queries, [&](std::size_t i) {
+        if (!tree.raycast(points[i], directions[i], tree_hits[i], tree_distances[i])) {
+          tree_hits[i] = bodies;
+        }
+      });
+      std::vector<std::size_t> brute_hits(num_queries);
+      double const ray_brute = time_per_call(num_queries, [&](std::size_t i) {
+        float closest = std::numeric_limits<float>::max();
+        brute_hits[i] = bodies;
+        for (std::size_t id = 0; id < bodies; ++id) {
+          glm::fvec3 const offset = points[i] - glm::fvec3{spheres[id]};
+          float const b = glm::dot(offset, directions[i]);
+          float const discriminant = b * b - glm::dot(offset, offset) + spheres[id].w * spheres[id].w;
+          if (discriminant < 0.0f) {
+            continue;
+          }
+          float t = -b - std::sqrt(discriminant);
+          t = t < 0.0f ? -b + std::sqrt(discriminant) : t;
+          if (t >= 0.0f && t < closest) {
+            closest = t;
+            brute_hits[i] = id;
+          }
+        }
+      });
+      print("ray", ray_tree, ray_brute, tree_hits == brute_hits);
+
+      // spheres
+      std::vector<std::vector<std::size_t>> tree_sets(num_queries);
+      double const overlap_tree = time_per_call(num_queries, [&](std::size_t i) {
+        tree.overlap(glm::fvec4{points[i], 3.0f}, tree_sets[i]);
+      });
+      std::vector<std::vector<std::size_t>> brute_sets(num_queries);
+      double const overlap_brute = time_per_call(num_queries, [&](std::size_t i) {
+        for (std::size_t id = 0; id < bodies; ++id) {
+          if (glm::length(glm::fvec3{spheres[id]} - points[i]) <= 3.0f + spheres[id].w) {
+            brute_sets[i].push_back(id);
+          }
+        }
+      });
+      bool overlap_match = true;
+      for (std::size_t i = 0; i < num_queries; ++i) {
+        std::sort(tree_sets[i].begin(), tree_sets[i].end());
+        overlap_match = overlap_match && tree_sets[i] == brute_sets[i];
+        brute_sets[i].clear();
+      }
+      print("sphere", overlap_tree, overlap_brute, overlap_match);
+
+      // frustums
+      double const frustum_tree = time_per_call(num_queries, [&](std::size_t i) {
+        tree.frustum(frustums[i], tree_sets[i]);
+      });
+      double const frustum_brute = time_per_call(num_queries, [&](std::size_t i) {
+        for (std::size_t id = 0; id < bodies; ++id) {
+          bool inside = true;
+          for (glm::fvec4 const& plane : frustums[i]) {
+            inside = inside && glm::dot(glm::fvec3{plane}, glm::fvec3{spheres[id]}) + plane.w >= -spheres[id].w;
+          }
+          if (inside) {
+            brute_sets[i].push_back(id);
+          }
+        }
+      });
+      bool frustum_match = true;
+      for (std::size_t i = 0; i < num_queries; ++i) {
+        std::sort(tree_sets[i].begin(), tree_sets[i].end());
+        frustum_match = frustum_match && tree_sets[i] == brute_sets[i];
+        brute_sets[i].clear();
+      }
+      print("frustum", frustum_tree, frustum_brute, frustum_match);
+
+      // nearest, compared by distance since ties may order differently
+      auto const surface_distance = [&](std::size_t id, glm::fvec3 const& point) {
+        return std::max(0.0f, glm::length(point - glm::fvec3{spheres[id]}) - spheres[id].w);
+      };
+      double const nearest_tree = time_per_call(num_queries, [&](std::size_t i) {
+        tree.nearest(points[i], k, tree_sets[i]);
+      });
+      double const nearest_brute = time_per_call(num_queries, [&](std::size_t i) {
+        std::vector<std::pair<float, std::size_t>> distances(bodies);
+        for (std::size_t id = 0; id < bodies; ++id) {
+          distances[id] = std::make_pair(surface_distance(id, points[i]), id);
+        }
+        std::partial_sort(distances.begin(), distances.begin() + long(k), distances.end());
+        for (std::size_t j = 0; j < k; ++j) {
+          brute_sets[i].push_back(distances[j].second);
+        }
+      });
+      bool nearest_match = true;
+      for (std::size_t i = 0; i < num_queries; ++i) {
+        for (std::size_t j = 0; j < k; ++j) {
+          nearest_match = nearest_match && tree_sets[i].size() == k &&
+                          surface_distance(tree_sets[i][j], points[i]) == surface_distance(brute_sets[i][j], points[i]);
+        }
+      }
+      print("nearest", nearest_tree, nearest_brute, nearest_match);
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// some arithmetic per item, so the loop is not bound by memory
+static void kernel(std::vector<float>& values, std::size_t first, std::size_t last) {
+  for (std::size_t i = first; i < last; ++i) {
+    float value = float(i);
+    for (int iteration = 0; iteration < 32; ++iteration) {
+      value = std::sqrt(value * 0.5f + 1.0f) + std::sin(value);
+    }
+    values[i] = value;
+  }
+}
+
+// seconds of the fastest of some runs
+template <typename F>
+static double best_of(std::size_t runs, F const& function) {
+  double best = 1e30;
+  for (std::size_t run = 0; run < runs; ++run) {
+    auto const start = std::chrono::steady_clock::now();
+    function();
+    std::chrono::duration<double> const duration = std::chrono::steady_clock::now() - start;
+    best = std::min(best, duration.count());
+  }
+  return best;
+}
+
+// runs a parallel_for over a compute bound loop and spawns many small tasks
+// from one task on pools of growing size, the first row runs the loop on the
+// calling thread alone
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const max_threads = argc > 1 ? std::stoul(argv[1])
+                                             : std::max(2u, std::thread::hardware_concurrency());
+    std::size_t const num_items = argc > 2 ? std::stoul(argv[2]) : 1 << 20;
+    std::size_t const grain = 1024;
+    std::size_t const num_tasks = 100000;
+    std::size_t const runs = 5;
+    std::vector<float> values(num_items);
+
+    double const serial = best_of(runs, [&]() { kernel(values, 0, num_items); });
+    std::cout << "items: " << num_items << ", grain: " << grain << std::endl;
+    std::cout << "threads   parallel_for   speedup   efficiency      tasks/s" << std::endl;
+    std::cout << std::setw(7) << 1 << std::fixed << std::setprecision(1) << std::setw(12)
+              << 1000.0 * serial << " ms" << std::setprecision(2) << std::setw(10) << 1.0
+              << std::setw(13) << 1.0 << std::setw(13) << "-" << std::endl;
+
+    for (std::size_t threads = 2; threads <= max_threads; ++threads) {
+      job_system jobs{threads - 1};
+      double const parallel = best_of(runs, [&]() {
+        jobs.parallel_for(num_items, grain, [&](std::size_t first, std::size_t last) {
+          kernel(values, first, last);
+        });
+      });
+
+      // one task spawns them all into its deque, the others steal them
+      std::atomic<std::size_t> done{0};
+      double const spawning = best_of(runs, [&]() {
+        jobs.wait(jobs.run([&]() {
+          std::vector<job_system::handle> tasks{};
+          tasks.reserve(num_tasks);
+          for (std::size_t task = 0; task < num_tasks; ++task) {
+            tasks.push_back(jobs.run([&done]() { ++done; }));
+          }
+          jobs.wait(tasks);
+        }));
+      });
+      if (done != runs * num_tasks) {
+        throw std::logic_error("job_benchmark: tasks got lost");
+      }
+
+      double const speedup = serial / parallel;
+      std::cout << std::setw(7) << threads << std::fixed << std::setprecision(1) << std::setw(12)
+                << 1000.0 * parallel << " ms" << std::setprecision(2) << std::setw(10) << speedup
+                << std::setw(13) << speedup / double(threads) << std::scientific << std::setprecision(2)
+                << std::setw(13) << double(num_tasks) / spawning << std::defaultfloat << std::endl;
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+#include "job_system.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// stresses the job system with every kind of work it is given in the
+// framework, repeated so that races have a chance to show
+// build with -DCMAKE_CXX_FLAGS=-fsanitize=thread to let the sanitizer check
+// the deques and counters for data races as well
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "job_system_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// every item is visited once, from a task as well
+static void test_parallel_for(job_system& jobs) {
+  std::vector<long> values(100000, 0);
+  jobs.parallel_for(values.size(), 1000, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      values[i] += long(i);
+    }
+  });
+  long const expected = long(values.size()) * long(values.size() - 1) / 2;
+  check(std::accumulate(values.begin(), values.end(), 0L) == expected, "parallel_for");
+
+  // tasks running loops of their own
+  std::atomic<std::size_t> items{0};
+  std::vector<job_system::handle> tasks{};
+  for (std::size_t task = 0; task < 8; ++task) {
+    tasks.push_back(jobs.run([&]() {
+      jobs.parallel_for(1000, 10, [&](std::size_t first, std::size_t last) { items += last - first; });
+    }));
+  }
+  jobs.wait(tasks);
+  check(items == 8000, "nested parallel_for");
+
+  // thread which is neither a worker nor the main thread
+  std::atomic<std::size_t> others{0};
+  std::thread other{[&]() {
+    jobs.parallel_for(500, 1, [&](std::size_t first, std::size_t last) { others += last - first; });
+  }};
+  other.join();
+  check(others == 500, "parallel_for on other thread");
+}
+
+// tasks start after their dependencies, main thread tasks on this thread
+static void test_dependencies(job_system& jobs) {
+  int value = 0;
+  int seen_by_main = -1;
+  bool on_main = false;
+  std::atomic<int> last_runs{0};
+  auto const first = jobs.run([&]() { value = 1; });
+  auto const second = jobs.then(first, [&]() { value += 1; });
+  auto const main_task = jobs.run([&]() {
+    seen_by_main = value;
+    on_main = jobs.is_main_thread();
+  }, {second}, job_system::affinity::main_thread);
+  auto const last = jobs.run([&]() { ++last_runs; }, {first, second, main_task});
+  jobs.wait(last);
+  check(seen_by_main == 2, "dependencies");
+  check(on_main, "main thread task");
+  check(last_runs == 1 && jobs.finished(main_task), "fan in");
+}
+
+// an exception skips the continuations and reaches the waiting thread
+static void test_exceptions(job_system& jobs) {
+  auto const failing = jobs.run([]() { throw std::runtime_error("expected"); });
+  bool continued = false;
+  auto const continuation = jobs.then(failing, [&]() { continued = true; });
+  bool rethrown = false;
+  try {
+    jobs.wait(continuation);
+  }
+  catch (std::runtime_error const&) {
+    rethrown = true;
+  }
+  check(rethrown, "exception");
+  check(!continued, "continuation of failed task");
+}
+
+// one task spawns more tasks than the deques hold initially
+static void test_deque_growth(job_system& jobs) {
+  std::size_t const num_tasks = 2000;
+  std::atomic<std::size_t> done{0};
+  jobs.wait(jobs.run([&]() {
+    std::vector<job_system::handle> tasks{};
+    for (std::size_t task = 0; task < num_tasks; ++task) {
+      tasks.push_back(jobs.run([&done]() { ++done; }));
+    }
+    jobs.wait(tasks);
+  }));
+  check(done == num_tasks, "deque growth");
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const rounds = argc > 1 ? std::stoul(argv[1]) : 50;
+    job_system jobs{4};
+    for (std::size_t round = 0; round < rounds && failures == 0; ++round) {
+      test_parallel_for(jobs);
+      test_dependencies(jobs);
+      test_exceptions(jobs);
+      test_deque_growth(jobs);
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "job_system_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "orbit_set.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// compare the batched kepler solver with solving every orbit in double
+// precision one by one, over random asteroid belts from a thousand up to
+// max_orbits, errors are relative to the semi-major axis
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const max_orbits = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::size_t const num_frames = argc > 2 ? std::stoul(argv[2]) : 20;
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> axis{2.1f, 3.3f};
+    std::uniform_real_distribution<float> angle{0.0f, 6.2831853f};
+    std::uniform_real_distribution<float> inclination{0.0f, 0.5f};
+    // mostly low eccentricities with a tail up to 0.9
+    std::exponential_distribution<float> eccentricity{8.0f};
+
+#if defined(__AVX__)
+    std::cout << "solver lanes: avx, 8 orbits" << std::endl;
+#elif defined(__SSE__)
+    std::cout << "solver lanes: sse, 4 orbits" << std::endl;
+#else
+    std::cout << "solver lanes: scalar" << std::endl;
+#endif
+    std::cout << "  orbits    batched      double   speedup   max error" << std::endl;
+
+    for (std::size_t orbits = 1000; orbits <= max_orbits; orbits *= 10) {
+      orbit_set set{};
+      for (std::size_t i = 0; i < orbits; ++i) {
+        orbital_elements elements{};
+        elements.semi_major_axis = axis(random);
+        elements.eccentricity = std::min(eccentricity(random), 0.9f);
+        elements.inclination = inclination(random);
+        elements.ascending_node = angle(random);
+        elements.argument_of_periapsis = angle(random);
+        elements.mean_anomaly = angle(random);
+        // third law with a year for an axis of 1
+        elements.period = 60.0f * std::pow(elements.semi_major_axis, 1.5f);
+        set.add(elements);
+      }
+
+      // frames a minute apart, late enough that float time would be off
+      std::vector<glm::fvec3> positions{};
+      auto const start = std::chrono::steady_clock::now();
+      for (std::size_t frame = 0; frame < num_frames; ++frame) {
+        set.evaluate(3600.0 + 60.0 * double(frame), positions);
+      }
+      std::chrono::duration<double, std::milli> const batched = std::chrono::steady_clock::now() - start;
+
+      std::vector<glm::dvec3> references(orbits);
+      auto const reference_start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < orbits; ++i) {
+        references[i] = set.reference(i, 3600.0 + 60.0 * double(num_frames - 1));
+      }
+      std::chrono::duration<double, std::milli> const reference = std::chrono::steady_clock::now() - reference_start;
+
+      double max_error = 0.0;
+      for (std::size_t i = 0; i < orbits; ++i) {
+        double const error = glm::length(glm::dvec3{positions[i]} - references[i]) / glm::length(references[i]);
+        max_error = std::max(max_error, error);
+      }
+
+      double const batched_frame = batched.count() / double(num_frames);
+      std::cout << std::setw(8) << orbits << std::fixed << std::setprecision(3) << std::setw(10) << batched_frame
+                << " ms" << std::setw(9) << reference.count() << " ms" << std::setw(9) << std::setprecision(1)
+                << reference.count() / batched_frame << "x" << std::scientific << std::setprecision(1)
+                << std::setw(12) << max_error << std::defaultfloat << std::endl;
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "texture_loader.hpp"
+#include "window_handler.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// seconds of the fastest of some runs
+template <typename F>
+static double best_of(std::size_t runs, F const& function) {
+  double best = 1e30;
+  for (std::size_t run = 0; run < runs; ++run) {
+    auto const start = std::chrono::steady_clock::now();
+    function();
+    std::chrono::duration<double> const duration = std::chrono::steady_clock::now() - start;
+    best = std::min(best, duration.count());
+  }
+  return best;
+}
+
+// seconds glGenerateMipmap takes at best for the srgb image, including the
+// wait for the driver to finish, not the upload
+static double driver_mipmaps(pixel_data const& image, std::size_t runs) {
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GLint(GL_SRGB8_ALPHA8), GLsizei(image.width), GLsizei(image.height), 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, image.ptr());
+  glFinish();
+  double const seconds = best_of(runs, []() {
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glFinish();
+  });
+  glDeleteTextures(1, &texture);
+  return seconds;
+}
+
+static void print_row(std::size_t size, std::string const& lanes, double box, double kaiser) {
+  double const megapixels = double(size * size) / 1e6;
+  std::cout << std::setw(8) << size << std::setw(8) << lanes << std::fixed << std::setprecision(2)
+            << std::setw(9) << 1000.0 * box << " ms" << std::setw(12) << megapixels / box;
+  if (kaiser > 0.0) {
+    std::cout << std::setw(9) << 1000.0 * kaiser << " ms" << std::setw(12) << megapixels / kaiser;
+  }
+  std::cout << std::defaultfloat << std::endl;
+}
+
+// builds the mip chains of random rgba images of growing size with the box
+// and the kaiser filter, once for each simd path of the build, and with the
+// box filter of glGenerateMipmap in a hidden window if a context can be made
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const max_size = argc > 1 ? std::stoul(argv[1]) : 4096;
+    std::size_t const runs = argc > 2 ? std::stoul(argv[2]) : 5;
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> channel{0, 255};
+
+    std::vector<std::pair<simd_lanes, std::string>> paths{{simd_lanes::scalar, "scalar"}};
+    if (widest_simd_lanes() != simd_lanes::scalar) {
+      paths.emplace_back(simd_lanes::sse, "sse");
+    }
+    if (widest_simd_lanes() == simd_lanes::avx) {
+      paths.emplace_back(simd_lanes::avx, "avx");
+    }
+    GLFWwindow* const window = window_handler::hidden_context(3, 2);
+    if (!window) {
+      std::cout << "no gl context, glGenerateMipmap skipped" << std::endl;
+    }
+    std::cout << "    size   lanes         box    Mpixel/s      kaiser    Mpixel/s" << std::endl;
+
+    for (std::size_t size = 256; size <= max_size; size *= 2) {
+      std::vector<std::uint8_t> pixels(size * size * 4);
+      for (auto& value : pixels) {
+        value = std::uint8_t(channel(random));
+      }
+      pixel_data const image{pixels, GL_RGBA, GL_UNSIGNED_BYTE, size, size};
+
+      for (auto const& path : paths) {
+        double const box = best_of(runs, [&]() {
+          texture_loader::mipmaps(image, texture_loader::mip_filter::box, true, path.first);
+        });
+        double const kaiser = best_of(runs, [&]() {
+          texture_loader::mipmaps(image, texture_loader::mip_filter::kaiser, true, path.first);
+        });
+        print_row(size, path.second, box, kaiser);
+      }
+      if (window) {
+        print_row(size, "driver", driver_mipmaps(image, runs), 0.0);
+      }
+    }
+
+    if (window) {
+      glfwDestroyWindow(window);
+      glfwTerminate();
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#include "model_loader.hpp"
+#include "utils.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// levels of detail built by the quadric simplifier from the sphere model and
+// the texcoords at the poles of the uv sphere, no gl context needed
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "model_loader_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// positions of the vertices of a model with positions only
+static std::set<std::array<GLfloat, 3>> positions(model const& mesh) {
+  std::set<std::array<GLfloat, 3>> result{};
+  for (std::size_t i = 0; i + 2 < mesh.data.size(); i += 3) {
+    result.insert(std::array<GLfloat, 3>{{mesh.data[i], mesh.data[i + 1], mesh.data[i + 2]}});
+  }
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    model const sphere = model_loader::obj(utils::read_resource_path(argc, argv) + "models/sphere.obj");
+    std::vector<float> errors{};
+    std::vector<model> const levels = model_loader::lod_chain(sphere, 7, errors);
+
+    check(levels.size() == 7 && errors.size() == levels.size(), "number of levels");
+    check(errors.front() == 0.0f, "error of the source");
+    std::set<std::array<GLfloat, 3>> const source_positions = positions(sphere);
+    for (std::size_t level = 1; level < levels.size(); ++level) {
+      std::size_t const triangles = levels[level].indices.size() / 3;
+      std::size_t const previous = levels[level - 1].indices.size() / 3;
+      std::cout << "level " << level << ": " << triangles << " triangles, error " << errors[level] << std::endl;
+      check(triangles < previous, "fewer triangles in level " + std::to_string(level));
+      check(errors[level] > errors[level - 1], "growing error in level " + std::to_string(level));
+
+      // collapses keep vertices in place, so the levels stay inside convex
+      // surfaces, which the occluders rely on
+      bool kept = true;
+      for (auto const& position : positions(levels[level])) {
+        kept = kept && source_positions.count(position) > 0;
+      }
+      check(kept, "vertices of level " + std::to_string(level) + " from the source");
+    }
+
+    // a pole vertex sits in the middle of the slice of its triangle, so the
+    // texture does not shear towards the poles
+    model const& uv = model_loader::uv_sphere(16, 8, model::TEXCOORD);
+    std::size_t const stride = std::size_t(uv.vertex_bytes) / sizeof(GLfloat);
+    std::size_t const texcoord = reinterpret_cast<std::size_t>(uv.offsets.at(model::TEXCOORD)) / sizeof(GLfloat);
+    bool centered = true;
+    for (std::size_t i = 0; i + 2 < uv.indices.size(); i += 3) {
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        GLfloat const* pole = &uv.data[uv.indices[i + corner] * stride];
+        if (std::abs(pole[1]) < 1.0f) {
+          continue;
+        }
+        GLfloat const u0 = uv.data[uv.indices[i + (corner + 1) % 3] * stride + texcoord];
+        GLfloat const u1 = uv.data[uv.indices[i + (corner + 2) % 3] * stride + texcoord];
+        centered = centered && std::abs(pole[texcoord] - (u0 + u1) * 0.5f) < 1e-6f;
+      }
+    }
+    check(centered, "pole texcoords of the uv sphere");
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "model_loader_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+#include "nbody_system.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// step clusters from ten thousand up to max_particles with the barnes-hut
+// forces and report the interactions per second, errors are relative to the
+// direct sum of some sample particles
+int main(int argc, char* argv[]) {
+  try {
+    std::size_t const max_particles = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    float const opening_angle = argc > 2 ? std::stof(argv[2]) : 0.5f;
+    std::size_t const num_steps = 3;
+    std::size_t const num_samples = 100;
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+
+#if defined(__AVX__)
+    std::cout << "leaf lanes: avx, 8 interactions" << std::endl;
+#elif defined(__SSE__)
+    std::cout << "leaf lanes: sse, 4 interactions" << std::endl;
+#else
+    std::cout << "leaf lanes: scalar" << std::endl;
+#endif
+    std::cout << "opening angle: " << opening_angle << std::endl;
+    std::cout << "particles    nodes     step   interactions/s   max error" << std::endl;
+
+    for (std::size_t particles = 10000; particles <= max_particles; particles *= 10) {
+      // plummer sphere of total mass 1, at rest, dense in the middle
+      nbody_system system{opening_angle, 0.01f};
+      for (std::size_t i = 0; i < particles; ++i) {
+        float const radius = 1.0f / std::sqrt(std::pow(std::max(uniform(random), 1e-6f), -2.0f / 3.0f) - 1.0f);
+        float const height = 2.0f * uniform(random) - 1.0f;
+        float const angle = 6.2831853f * uniform(random);
+        float const ring = std::sqrt(1.0f - height * height);
+        glm::fvec3 const direction{ring * std::cos(angle), height, ring * std::sin(angle)};
+        system.add(direction * std::min(radius, 20.0f), glm::fvec3{0.0f}, 1.0f / float(particles));
+      }
+
+      // the first step builds the forces of the start as well
+      system.step(0.001f);
+      std::uint64_t interactions = 0;
+      auto const start = std::chrono::steady_clock::now();
+      for (std::size_t step = 0; step < num_steps; ++step) {
+        system.step(0.001f);
+        interactions += system.interactions();
+      }
+      std::chrono::duration<double> const duration = std::chrono::steady_clock::now() - start;
+
+      double max_error = 0.0;
+      for (std::size_t sample = 0; sample < num_samples; ++sample) {
+        std::size_t const id = sample * particles / num_samples;
+        glm::fvec3 const direct = system.direct_acceleration(id);
+        double const error = glm::length(glm::dvec3{system.acceleration(id) - direct}) /
+                             glm::length(glm::dvec3{direct});
+        max_error = std::max(max_error, error);
+      }
+
+      std::cout << std::setw(9) << particles << std::setw(9) << system.num_nodes() << std::fixed
+                << std::setprecision(1) << std::setw(9) << 1000.0 * duration.count() / double(num_steps)
+                << " ms" << std::scientific << std::setprecision(2) << std::setw(14)
+                << double(interactions) / duration.count() << std::setprecision(1) << std::setw(12)
+                << max_error << std::defaultfloat << std::endl;
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
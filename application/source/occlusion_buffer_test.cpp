@@ -0,0 +1,108 @@
+#include "model_loader.hpp"
+#include "occlusion_buffer.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// rasterizes sphere occluders with every simd path of the build and tests
+// bodies behind, in front of, next to and around them, no gl context needed
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "occlusion_buffer_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// camera at the origin looking down -z
+static glm::fmat4 const view_projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+
+// occluder mesh for a sphere, the chords of the unit sphere lie inside it
+static void add_sphere(occlusion_buffer& buffer, glm::fvec3 const& center, float radius) {
+  glm::fmat4 const model_matrix = glm::scale(glm::translate(glm::fmat4{}, center), glm::fvec3{radius});
+  buffer.add_occluder(model_loader::icosphere(3), view_projection * model_matrix);
+}
+
+static std::vector<float> depths(occlusion_buffer const& buffer) {
+  std::vector<float> result{};
+  for (std::size_t y = 0; y < buffer.height(); ++y) {
+    for (std::size_t x = 0; x < buffer.width(); ++x) {
+      result.push_back(buffer.depth(x, y));
+    }
+  }
+  return result;
+}
+
+static bool visible(occlusion_buffer const& buffer, glm::fvec3 const& center, float radius) {
+  return buffer.visible(glm::fvec4{center, radius}, view_projection);
+}
+
+int main() {
+  try {
+    std::vector<std::pair<simd_lanes, std::string>> paths{{simd_lanes::scalar, "scalar"}};
+    if (widest_simd_lanes() != simd_lanes::scalar) {
+      paths.emplace_back(simd_lanes::sse, "sse");
+    }
+    if (widest_simd_lanes() == simd_lanes::avx) {
+      paths.emplace_back(simd_lanes::avx, "avx");
+    }
+
+    std::vector<float> scalar_depths{};
+    for (auto const& path : paths) {
+      // odd size and small tiles, so triangles cross tiles and the border
+      occlusion_buffer buffer{250, 125, 16};
+      add_sphere(buffer, glm::fvec3{0.0f, 0.0f, -10.0f}, 2.0f);
+      add_sphere(buffer, glm::fvec3{-9.0f, 3.0f, -12.0f}, 3.0f);
+      add_sphere(buffer, glm::fvec3{17.0f, -4.0f, -15.0f}, 4.0f);
+      // crosses the near plane, its front triangles there are skipped
+      add_sphere(buffer, glm::fvec3{0.3f, -0.2f, -0.3f}, 0.3f);
+      buffer.rasterize(path.first);
+      std::string const name = " with " + path.second;
+
+      std::vector<float> const result = depths(buffer);
+      if (path.first == simd_lanes::scalar) {
+        scalar_depths = result;
+      }
+      else {
+        check(result == scalar_depths, "same depths as scalar" + name);
+      }
+      float nearest = 1.0f;
+      for (float depth : result) {
+        nearest = std::min(nearest, depth);
+      }
+      check(nearest >= 0.0f, "no depth before the near plane" + name);
+
+      check(!visible(buffer, glm::fvec3{0.0f, 0.0f, -20.0f}, 1.0f), "body behind the occluder" + name);
+      check(visible(buffer, glm::fvec3{0.0f, 0.0f, -6.0f}, 1.0f), "body in front of the occluder" + name);
+      // the silhouette of the occluder is 11.5 degrees off the axis
+      check(visible(buffer, glm::fvec3{4.0f, 0.0f, -20.0f}, 1.0f), "body peeking out" + name);
+      check(visible(buffer, glm::fvec3{0.0f, 15.0f, -40.0f}, 1.0f), "body next to the occluders" + name);
+      check(!visible(buffer, glm::fvec3{100.0f, 0.0f, -20.0f}, 1.0f), "body right of the view" + name);
+      check(!visible(buffer, glm::fvec3{0.0f, -60.0f, -20.0f}, 1.0f), "body below the view" + name);
+      check(!visible(buffer, glm::fvec3{0.0f, 0.0f, -150.0f}, 1.0f), "body beyond the far plane" + name);
+      // the box reaches behind the camera, so it is kept
+      check(visible(buffer, glm::fvec3{0.0f, 0.0f, -0.05f}, 0.2f), "box crossing the near plane" + name);
+      check(visible(buffer, glm::fvec3{0.0f, 0.0f, -20.0f}, 25.0f), "box around the camera" + name);
+    }
+    std::cout << "compared " << paths.size() << " simd paths" << std::endl;
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "occlusion_buffer_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
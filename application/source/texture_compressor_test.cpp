@@ -0,0 +1,220 @@
+#include "texture_compressor.hpp"
+#include "texture_loader.hpp"
+#include "utils.hpp"
+#include "window_handler.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// decodes etc blocks with known texels, encodes the bundled textures as
+// etc2 and decodes them again, the color of every mip level has to stay
+// close to the original
+// with a gl 4.3 context the driver decodes the same blocks and textures,
+// its texels have to match the decoder exactly, without one this is skipped
+
+// the noisiest texture, mercury, reaches about 30 dB, wrong blocks end far below
+static double const min_psnr = 28.0;
+
+// block in the byte order of the file and its texels decoded by hand
+// following the etc1 specification, rgb rows from the first one on
+struct known_block {
+  char const* name;
+  std::uint8_t bytes[8];
+  std::uint8_t texels[16 * 3];
+};
+
+// the base colors and tables are shared by the flipped and unflipped blocks,
+// only the subblocks the pixels belong to differ
+static known_block const known_blocks[] = {
+  // 4 bit colors 1,8,f and a,3,6, tables 0 and 7, clamped at 0 and 255
+  {"individual block", {0x1A, 0x83, 0xF6, 0x1C, 0x3C, 0x5A, 0x96, 0x69},
+   {25, 144, 255,  15, 134, 253,  217, 98, 149,  0, 0, 0,
+    15, 134, 253,  25, 144, 255,  255, 234, 255,  123, 4, 55,
+    19, 138, 255,  9, 128, 247,  0, 0, 0,  217, 98, 149,
+    9, 128, 247,  19, 138, 255,  123, 4, 55,  255, 234, 255}},
+  {"flipped individual block", {0x1A, 0x83, 0xF6, 0x1D, 0x3C, 0x5A, 0x96, 0x69},
+   {25, 144, 255,  15, 134, 253,  19, 138, 255,  9, 128, 247,
+    15, 134, 253,  25, 144, 255,  25, 144, 255,  15, 134, 253,
+    217, 98, 149,  0, 0, 0,  0, 0, 0,  217, 98, 149,
+    0, 0, 0,  217, 98, 149,  123, 4, 55,  255, 234, 255}},
+  // 5 bit color 20,5,31 with differences +3,-4,-1, tables 3 and 5
+  {"differential block", {0xA3, 0x2C, 0xFF, 0x76, 0xA5, 0xC3, 0x0F, 0xF0},
+   {152, 28, 242,  207, 83, 255,  109, 0, 167,  213, 32, 255,
+    152, 28, 242,  207, 83, 255,  255, 88, 255,  165, 0, 223,
+    178, 54, 255,  123, 0, 213,  109, 0, 167,  213, 32, 255,
+    178, 54, 255,  123, 0, 213,  255, 88, 255,  165, 0, 223}},
+  {"flipped differential block", {0xA3, 0x2C, 0xFF, 0x77, 0xA5, 0xC3, 0x0F, 0xF0},
+   {152, 28, 242,  207, 83, 255,  123, 0, 213,  178, 54, 255,
+    152, 28, 242,  207, 83, 255,  207, 83, 255,  152, 28, 242,
+    213, 32, 255,  109, 0, 167,  109, 0, 167,  213, 32, 255,
+    213, 32, 255,  109, 0, 167,  255, 88, 255,  165, 0, 223}},
+};
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "texture_compressor_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// single 4x4 block as a compressed texture
+static pixel_data block_texture(known_block const& block) {
+  return pixel_data{std::vector<std::uint8_t>(block.bytes, block.bytes + 8), GL_COMPRESSED_RGB8_ETC2, GL_NONE, 4, 4};
+}
+
+// whether the rgba pixels have the rgb texels
+static bool same_texels(std::uint8_t const* pixels, std::uint8_t const* texels) {
+  for (std::size_t pixel = 0; pixel < 16; ++pixel) {
+    if (std::memcmp(pixels + pixel * 4, texels + pixel * 3, 3) != 0 || pixels[pixel * 4 + 3] != 255) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// peak signal to noise ratio of the rgb channels over all mip levels
+static double psnr(pixel_data const& original, pixel_data const& decoded) {
+  if (original.num_levels() != decoded.num_levels() || original.width != decoded.width ||
+      original.height != decoded.height) {
+    throw std::logic_error("texture_compressor_test: decoded texture has other dimensions");
+  }
+  double squared_error = 0.0;
+  std::size_t samples = 0;
+  for (std::size_t level = 0; level < original.num_levels(); ++level) {
+    std::uint8_t const* expected = static_cast<std::uint8_t const*>(original.ptr(level));
+    std::uint8_t const* actual = static_cast<std::uint8_t const*>(decoded.ptr(level));
+    std::size_t const pixels = original.level_width(level) * original.level_height(level);
+    for (std::size_t pixel = 0; pixel < pixels; ++pixel) {
+      for (std::size_t channel = 0; channel < 3; ++channel) {
+        double const difference = double(expected[pixel * 4 + channel]) - double(actual[pixel * 4 + channel]);
+        squared_error += difference * difference;
+      }
+    }
+    samples += pixels * 3;
+  }
+  if (squared_error == 0.0) {
+    return 1e30;
+  }
+  return 10.0 * std::log10(255.0 * 255.0 * double(samples) / squared_error);
+}
+
+// upload all levels with glCompressedTexImage2D and read them back decoded
+// by the driver
+static pixel_data driver_decode(pixel_data const& compressed) {
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(compressed.num_levels() - 1));
+  for (std::size_t level = 0; level < compressed.num_levels(); ++level) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), compressed.channels, GLsizei(compressed.level_width(level)),
+                           GLsizei(compressed.level_height(level)), 0, GLsizei(compressed.mip_levels[level].size),
+                           compressed.ptr(level));
+  }
+
+  std::vector<pixel_data::mip_level> levels{};
+  std::size_t total_bytes = 0;
+  for (std::size_t level = 0; level < compressed.num_levels(); ++level) {
+    std::size_t const level_bytes = compressed.level_width(level) * compressed.level_height(level) * 4;
+    levels.push_back(pixel_data::mip_level{total_bytes, level_bytes});
+    total_bytes += level_bytes;
+  }
+  pixel_data image{std::vector<std::uint8_t>(total_bytes), GL_RGBA, GL_UNSIGNED_BYTE,
+                   compressed.width, compressed.height};
+  image.mip_levels = levels;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  for (std::size_t level = 0; level < compressed.num_levels(); ++level) {
+    glGetTexImage(GL_TEXTURE_2D, GLint(level), GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get() + levels[level].offset);
+  }
+
+  glDeleteTextures(1, &texture);
+  if (glGetError() != GL_NO_ERROR) {
+    throw std::runtime_error("texture_compressor_test: driver rejected the etc2 texture");
+  }
+  return image;
+}
+
+// copy the file, so its cache is not written into the resources
+static void copy_file(std::string const& source, std::string const& target) {
+  std::ifstream input{source, std::ios::binary};
+  std::ofstream output{target, std::ios::binary};
+  output << input.rdbuf();
+  if (!input || !output) {
+    throw std::runtime_error("texture_compressor_test: cannot copy " + source + " to " + target);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::string const resource_path = utils::read_resource_path(argc, argv);
+  std::vector<std::string> const names{
+    "sunmap.png", "mercurymap.png", "venusmap.png", "earthmap1k.png", "moonmap1k.png",
+    "mars_1k_color.png", "mars_1k_normal.png", "jupitermap.png", "saturnmap.png",
+    "uranusmap.png", "neptunemap.png", "skybox_back.png", "skybox_down.png",
+    "skybox_front.png", "skybox_left.png", "skybox_right.png", "skybox_up.png"};
+  // in the working directory, the build directory under ctest
+  std::string const copy_name = "texture_compressor_test.png";
+
+  GLFWwindow* const window = window_handler::hidden_context(4, 3);
+  try {
+    for (auto const& block : known_blocks) {
+      pixel_data const decoded = texture_compressor::decode_etc2(block_texture(block));
+      check(same_texels(static_cast<std::uint8_t const*>(decoded.ptr()), block.texels), block.name);
+      if (window) {
+        pixel_data const driver = driver_decode(block_texture(block));
+        check(same_texels(static_cast<std::uint8_t const*>(driver.ptr()), block.texels),
+              std::string{block.name} + " in the driver");
+      }
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (auto const& name : names) {
+      copy_file(resource_path + "textures/" + name, copy_name);
+      pixel_data const original = texture_loader::file(copy_name);
+      std::remove(copy_name.c_str());
+      std::remove((copy_name + ".ktx").c_str());
+
+      pixel_data const compressed = texture_compressor::etc2(original);
+      pixel_data const decoded = texture_compressor::decode_etc2(compressed);
+      double const quality = psnr(original, decoded);
+      std::cout << std::setw(20) << name << std::setw(10) << quality << " dB" << std::endl;
+      check(quality >= min_psnr, name + " above " + std::to_string(min_psnr) + " dB");
+      if (window) {
+        pixel_data const driver = driver_decode(compressed);
+        check(std::memcmp(driver.ptr(), decoded.ptr(), decoded.num_bytes) == 0, name + " decoded like the driver");
+      }
+    }
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    std::remove(copy_name.c_str());
+    std::remove((copy_name + ".ktx").c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+  else {
+    std::cout << "no gl 4.3 context, driver upload skipped" << std::endl;
+  }
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "texture_compressor_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
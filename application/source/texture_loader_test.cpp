@@ -0,0 +1,148 @@
+#include "texture_loader.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// counts the heap allocations of loading a texture
+// decoding it the first time, the chain is filtered inside the buffer
+// stb_image decoded level 0 into, which comes from malloc and is not seen
+// here, only the float images of the filter are allocated through new and
+// they are freed before the texture is returned
+// loading it from the cache, the pixels stay in the one buffer the cache
+// entry is read into and are never copied on the way to the caller
+
+static_assert(!std::is_copy_constructible<pixel_data>::value, "pixel_data must not be copyable");
+
+// allocations since the last reset and those at least as large as a threshold
+static std::atomic<std::size_t> allocations{0};
+static std::atomic<std::size_t> large_allocations{0};
+static std::atomic<std::size_t> large_threshold{~std::size_t(0)};
+// bytes of large allocations which are not freed yet
+static std::atomic<std::size_t> large_bytes{0};
+
+// each allocation is preceded by its size, padded to keep the alignment
+static std::size_t const header_bytes = 16;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (size >= large_threshold) {
+    ++large_allocations;
+  }
+  void* memory = std::malloc(size + header_bytes);
+  if (!memory) {
+    throw std::bad_alloc{};
+  }
+  *static_cast<std::size_t*>(memory) = size;
+  if (size >= large_threshold) {
+    large_bytes += size;
+  }
+  return static_cast<char*>(memory) + header_bytes;
+}
+
+void operator delete(void* memory) noexcept {
+  if (!memory) {
+    return;
+  }
+  void* const start = static_cast<char*>(memory) - header_bytes;
+  std::size_t const size = *static_cast<std::size_t*>(start);
+  if (size >= large_threshold) {
+    large_bytes -= size;
+  }
+  std::free(start);
+}
+
+static void reset_counters(std::size_t threshold) {
+  large_threshold = threshold;
+  allocations = 0;
+  large_allocations = 0;
+  large_bytes = 0;
+}
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "texture_loader_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// copy the file, so its cache is not written into the resources
+static void copy_file(std::string const& source, std::string const& target) {
+  std::ifstream input{source, std::ios::binary};
+  std::ofstream output{target, std::ios::binary};
+  output << input.rdbuf();
+  if (!input || !output) {
+    throw std::runtime_error("texture_loader_test: cannot copy " + source + " to " + target);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  // in the working directory, the build directory under ctest
+  std::string const file_name = "texture_loader_test.png";
+  std::string const cache_name = file_name + ".ktx";
+  try {
+    copy_file(utils::read_resource_path(argc, argv) + "textures/moonmap1k.png", file_name);
+    std::remove(cache_name.c_str());
+    std::size_t const row_bytes = texture_loader::file(file_name).level_width(0) * 4;
+
+    // a buffer of a row of pixels or more is a copy of the pixels or a
+    // float image of the filter
+    std::remove(cache_name.c_str());
+    reset_counters(row_bytes);
+    pixel_data decoded = texture_loader::file(file_name);
+    std::size_t const decoding = allocations;
+    std::size_t const decoding_large = large_allocations;
+    std::size_t const decoding_kept = large_bytes;
+    // the linear copy of level 0 and a row and column pass for each level
+    std::size_t const filter_images = 1 + 2 * (decoded.num_levels() - 1);
+    check(decoded.num_levels() > 1, "decoded mip chain");
+    check(decoding_kept == 0, "decoded chain in the buffer of stb_image");
+    check(decoding_large <= filter_images, "only filter images besides the chain");
+
+    // mapping the cache entry allocates none, reading it into memory one
+    reset_counters(row_bytes);
+    pixel_data texture = texture_loader::file(file_name);
+    std::size_t const loading = allocations;
+    std::size_t const loading_large = large_allocations;
+    check(loading_large <= 1, "single pixel buffer");
+    check(texture.num_levels() > 1, "cached mip chain");
+
+    // moving hands the buffer over
+    void const* const pixels = texture.ptr();
+    reset_counters(row_bytes);
+    pixel_data moved{std::move(texture)};
+    texture = std::move(moved);
+    std::size_t const moving = allocations;
+    check(moving == 0, "move without allocation");
+    check(texture.ptr() == pixels, "move keeps the buffer");
+
+    std::cout << "decoding: " << decoding << " allocations, " << decoding_large
+              << " of pixel size, at most " << filter_images << " expected" << std::endl;
+    std::cout << "cached load: " << loading << " allocations, " << loading_large
+              << " of pixel size" << std::endl;
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    std::remove(file_name.c_str());
+    std::remove(cache_name.c_str());
+    return EXIT_FAILURE;
+  }
+  std::remove(file_name.c_str());
+  std::remove(cache_name.c_str());
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "texture_loader_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
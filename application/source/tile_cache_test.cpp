@@ -0,0 +1,127 @@
+#include "tile_cache.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// bookkeeping of the virtual texture tile cache, no gl context needed
+
+static std::size_t failures = 0;
+
+static void check(bool condition, std::string const& what) {
+  if (!condition) {
+    std::cerr << "tile_cache_test: " << what << " failed" << std::endl;
+    ++failures;
+  }
+}
+
+// keys round trip and out of range coordinates are rejected
+static void test_keys() {
+  tile_cache::tile_key const key = tile_cache::key(7, 4095, 12);
+  check(tile_cache::level(key) == 7 && tile_cache::x(key) == 4095 && tile_cache::y(key) == 12, "key");
+
+  bool thrown = false;
+  try {
+    tile_cache::key(0, 4096, 0);
+  }
+  catch (std::out_of_range const&) {
+    thrown = true;
+  }
+  check(thrown, "key out of range");
+}
+
+// free slots are handed out first, in order
+static void test_insert() {
+  tile_cache cache{3};
+  tile_cache::insertion result{};
+  for (std::size_t tile = 0; tile < 3; ++tile) {
+    check(cache.insert(tile_cache::key(0, tile, 0), 0, result), "insert into free slot");
+    check(result.slot == tile && !result.evicted, "slot of free insert");
+  }
+  check(cache.size() == 3 && cache.capacity() == 3, "size");
+  check(cache.contains(tile_cache::key(0, 1, 0)) && cache.slot(tile_cache::key(0, 1, 0)) == 1, "lookup");
+  check(!cache.contains(tile_cache::key(0, 3, 0)), "missing tile");
+
+  bool thrown = false;
+  try {
+    cache.insert(tile_cache::key(0, 1, 0), 1, result);
+  }
+  catch (std::logic_error const&) {
+    thrown = true;
+  }
+  check(thrown, "insert resident tile");
+}
+
+// the least recently touched tile goes first, tiles of this frame never
+static void test_eviction_order() {
+  tile_cache cache{3};
+  tile_cache::insertion result{};
+  tile_cache::tile_key const a = tile_cache::key(0, 0, 0);
+  tile_cache::tile_key const b = tile_cache::key(0, 1, 0);
+  tile_cache::tile_key const c = tile_cache::key(0, 2, 0);
+  cache.insert(a, 0, result);
+  cache.insert(b, 0, result);
+  cache.insert(c, 0, result);
+
+  // a becomes the most recent, b the least recent
+  check(cache.touch(a, 1), "touch resident tile");
+  check(cache.touch(c, 1), "touch resident tile");
+  check(!cache.touch(tile_cache::key(1, 0, 0), 1), "touch missing tile");
+
+  tile_cache::tile_key const d = tile_cache::key(1, 0, 0);
+  check(cache.insert(d, 2, result), "insert into full cache");
+  check(result.evicted && result.evicted_key == b && result.slot == 1, "least recently used evicted");
+  check(!cache.contains(b) && cache.slot(d) == 1, "evicted tile replaced");
+
+  // a and c were touched in frame 1, d in frame 2, so a goes next
+  tile_cache::tile_key const e = tile_cache::key(1, 1, 0);
+  check(cache.insert(e, 2, result), "second eviction");
+  check(result.evicted_key == a && result.slot == 0, "second least recently used evicted");
+
+  // every tile is used in frame 3
+  cache.touch(c, 3);
+  cache.touch(d, 3);
+  cache.touch(e, 3);
+  check(!cache.insert(tile_cache::key(1, 2, 0), 3, result), "tiles of the frame kept");
+  check(cache.size() == 3, "failed insert changes nothing");
+}
+
+// a pinned tile stays although it is the least recently used
+static void test_pinned() {
+  tile_cache cache{2};
+  tile_cache::insertion result{};
+  tile_cache::tile_key const pinned = tile_cache::key(4, 0, 0);
+  cache.insert(pinned, 0, result, true);
+  std::size_t const pinned_slot = result.slot;
+
+  for (std::size_t frame = 1; frame < 50; ++frame) {
+    check(cache.insert(tile_cache::key(0, frame, 0), frame, result), "insert next to pinned tile");
+    check(result.slot != pinned_slot && (!result.evicted || result.evicted_key != pinned), "pinned tile evicted");
+  }
+  check(cache.contains(pinned) && cache.slot(pinned) == pinned_slot, "pinned tile resident");
+
+  // only the pinned tile left to evict
+  tile_cache single{1};
+  single.insert(pinned, 0, result, true);
+  check(!single.insert(tile_cache::key(0, 0, 0), 1, result), "pinned tile is the only victim");
+}
+
+int main() {
+  try {
+    test_keys();
+    test_insert();
+    test_eviction_order();
+    test_pinned();
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "tile_cache_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}
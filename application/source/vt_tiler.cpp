@@ -0,0 +1,147 @@
+#include "tile_pyramid.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// rows of a binary ppm, read from the file strip by strip
+class ppm_rows {
+ public:
+  explicit ppm_rows(std::string const& file_name)
+   :file_{file_name, std::ios::binary}
+   ,file_name_{file_name}
+   ,width_{0}
+   ,height_{0}
+   ,data_offset_{0}
+   ,row_{}
+  {
+    if (!file_) {
+      throw std::runtime_error("vt_tiler: cannot read " + file_name);
+    }
+    std::string magic{};
+    file_ >> magic;
+    std::size_t const width = field();
+    std::size_t const height = field();
+    std::size_t const max_value = field();
+    if (magic != "P6" || width == 0 || height == 0 || max_value != 255) {
+      throw std::runtime_error("vt_tiler: " + file_name + " is no binary ppm with 8 bit channels");
+    }
+    // a single whitespace ends the header
+    file_.get();
+    width_ = width;
+    height_ = height;
+    data_offset_ = file_.tellg();
+    row_.resize(width_ * 3);
+  }
+
+  std::size_t width() const {
+    return width_;
+  }
+
+  std::size_t height() const {
+    return height_;
+  }
+
+  // rows go downwards in the file
+  void read(std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels) {
+    for (std::size_t row = first_row; row < first_row + num_rows; ++row) {
+      file_.seekg(data_offset_ + std::streamoff((height_ - 1 - row) * row_.size()));
+      file_.read(reinterpret_cast<char*>(row_.data()), std::streamsize(row_.size()));
+      if (!file_) {
+        throw std::runtime_error("vt_tiler: " + file_name_ + " is truncated");
+      }
+      std::uint8_t* target = pixels + (row - first_row) * width_ * 4;
+      for (std::size_t x = 0; x < width_; ++x) {
+        target[x * 4] = row_[x * 3];
+        target[x * 4 + 1] = row_[x * 3 + 1];
+        target[x * 4 + 2] = row_[x * 3 + 2];
+        target[x * 4 + 3] = 255;
+      }
+    }
+  }
+
+ private:
+  // number in the header, comments start with #
+  std::size_t field() {
+    file_ >> std::ws;
+    while (file_.peek() == '#') {
+      std::string comment{};
+      std::getline(file_, comment);
+      file_ >> std::ws;
+    }
+    std::size_t value = 0;
+    file_ >> value;
+    return value;
+  }
+
+  std::ifstream file_;
+  std::string file_name_;
+  std::size_t width_;
+  std::size_t height_;
+  std::streamoff data_offset_;
+  std::vector<std::uint8_t> row_;
+};
+
+static bool ends_with(std::string const& text, std::string const& end) {
+  return text.size() >= end.size() && text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+// cut a large texture into the tile pyramid of a virtual texture
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <image> <tile pyramid> [tile size]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    std::string const image_name = argv[1];
+    std::size_t const tile_size = argc > 3 ? std::stoul(argv[3]) : 128;
+    if (ends_with(image_name, ".ppm")) {
+      // only a strip of rows is in memory at any time
+      ppm_rows image{image_name};
+      tile_pyramid::write(argv[2], image.width(), image.height(),
+                          [&image](std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels) {
+                            image.read(first_row, num_rows, pixels);
+                          },
+                          tile_size);
+    }
+    else {
+      // stb_image decodes the whole image, but without the mip chain and
+      // the cache file of the texture loader
+      stbi_set_flip_vertically_on_load(true);
+      int width = 0;
+      int height = 0;
+      int components = 0;
+      std::unique_ptr<stbi_uc, void (*)(void*)> pixels{
+          stbi_load(image_name.c_str(), &width, &height, &components, STBI_rgb_alpha), stbi_image_free};
+      if (!pixels) {
+        throw std::runtime_error(std::string{"stb_image: "} + stbi_failure_reason());
+      }
+      std::size_t const row_bytes = std::size_t(width) * 4;
+      stbi_uc const* rows = pixels.get();
+      tile_pyramid::write(argv[2], std::size_t(width), std::size_t(height),
+                          [rows, row_bytes](std::size_t first_row, std::size_t num_rows, std::uint8_t* strip) {
+                            std::copy(rows + first_row * row_bytes, rows + (first_row + num_rows) * row_bytes, strip);
+                          },
+                          tile_size);
+    }
+
+    tile_pyramid pyramid{argv[2]};
+    std::cout << "wrote " << argv[2] << ": " << pyramid.width() << "x" << pyramid.height()
+              << " in " << pyramid.num_levels() << " levels of " << pyramid.tile_size() << " pixel tiles" << std::endl;
+  }
+  catch (std::exception const& error) {
+    std::cerr << error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
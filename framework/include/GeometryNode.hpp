@@ -11,16 +11,21 @@
 class GeometryNode : public Node {
  private:
   model geometry_;
+  // sphere enclosing the vertices of the geometry in object space
+  glm::fvec4 bounding_sphere_;
   glm::fvec3 color_;
   pixel_data texture_;
   texture_object planet_texture_obj_;
+  // object space error of each level of detail, finest first
+  std::vector<float> lod_errors_;
+  std::size_t lod_;
 
  public:
   // User Defined Constructor of the GeometryNode
   GeometryNode(std::string const& name,
                model const& geometry_model,
                glm::fvec3 const& color,
-               pixel_data const& texture);
+               pixel_data&& texture);
 
   // Destructor of the GeometryNode
   ~GeometryNode();
@@ -28,16 +33,27 @@ class GeometryNode : public Node {
   // Getter and Setter Functions for the GeometryNode
   model getGeometry() const;
   void setGeometry(model const& geometry_model);
+  // center and radius of the sphere around the geometry in object space
+  glm::fvec4 getBoundingSphere() const;
 
   glm::fvec3 getColor() const;
   void setColor(glm::fvec3 const& inputColor);
 
-  pixel_data getTexture() const;
-  void setTexture(pixel_data const& input_texture);
+  pixel_data const& getTexture() const;
+  void setTexture(pixel_data&& input_texture);
 
   texture_object getTextureObj() const;
   void setTextureObj(texture_object const input_texture_obj);
   void setTextureObjAttribute(gl::GLuint const& handle, gl::GLenum const& target);
+
+  // errors of the levels of detail the geometry is drawn with, finest first
+  void setLodErrors(std::vector<float> const& errors);
+  // level of detail chosen by the last selection
+  std::size_t getLod() const;
+  // choose the coarsest level whose error, scaled to pixels by pixels_per_unit,
+  // is at most max_pixels, a coarser level than the current one is only taken
+  // once its error drops below hysteresis * max_pixels to avoid popping
+  std::size_t selectLod(float pixels_per_unit, float max_pixels = 1.0f, float hysteresis = 0.5f);
   
 };
 
@@ -9,6 +9,9 @@
 #include <list>
 #include <memory>
 
+// defined in orbit_set.hpp, nodes only hold a pointer to their orbit
+struct orbital_elements;
+
 /*
 The Node Class is responsible for creating the different Nodes in the Sceen Graph.
 Some A Root Node is the Ancestor node for the rest of all the nodes that that are in the tree
@@ -27,6 +30,12 @@ class Node {
   int depth_;
   glm::mat4 localTransform_;
   glm::mat4 worldTransform_;
+  // sphere enclosing the geometry of the subtree in world space
+  glm::vec4 worldBounds_;
+  // outside of the view frustum in the last frame
+  bool culled_;
+  // orbit around the parent, null for nodes placed otherwise
+  std::shared_ptr<orbital_elements> orbit_;
   
 
  public:
@@ -60,6 +69,18 @@ class Node {
   glm::mat4 getWorldTransform() const;
   void setWorldTransform(glm::mat4 const& inputMatrix);
 
+  //Used to store the Bounding Sphere of the Subtree, center and radius in World Space
+  glm::vec4 getWorldBounds() const;
+  void setWorldBounds(glm::vec4 const& sphere);
+
+  //Used to mark Nodes outside of the View Frustum, the mark is passed on to all Descendants
+  bool isCulled() const;
+  void setCulled(bool culled);
+
+  //Used to let a Node move on an Orbit around its Parent, null if it has none
+  orbital_elements const* getOrbit() const;
+  void setOrbit(orbital_elements const& orbit);
+
   //Used to add or Creat a new Node/ Child/ Parent
   void addChild(Node* node);
 
@@ -1,11 +1,15 @@
 #ifndef APPLICATION_HPP
 #define APPLICATION_HPP
 
+#include "frame_clock.hpp"
 #include "structs.hpp"
 
 #include <glm/gtc/type_precision.hpp>
 
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <thread>
 
 struct GLFWwindow;
 // gpu representation of model
@@ -27,6 +31,15 @@ class Application {
   void mouse_callback(GLFWwindow* window, double pos_x, double pos_y);
   // recompile shaders form source files
   void reloadShaders(bool throwing);
+  // start a frame at wall_time and run the simulation steps due until then,
+  // unless the simulation thread runs them
+  void advanceClock(double wall_time);
+  // run the simulation steps on a worker thread from now on, they only
+  // reach update() and render() through what publish() hands over
+  void startSimulationThread();
+  // join the simulation thread, derived classes have to call this before
+  // the state their steps use is destroyed
+  void stopSimulationThread();
 
 // functiosn which are implemented in derived classes
   // update uniform locations and values
@@ -37,6 +50,13 @@ class Application {
   inline virtual void mouseCallback(double pos_x, double pos_y) {};
   // update framebuffer textures
   inline virtual void resizeCallback(unsigned width, unsigned height) {};
+  // advance the simulation by one fixed step of dt simulated seconds
+  inline virtual void simulate(double dt) {};
+  // hand the state of the steps to the render thread, called after steps
+  // were taken at wall_time with m_clock_mutex held
+  inline virtual void publish(double wall_time) {};
+  // advance state which changes between frames
+  inline virtual void update() {};
   // draw all objects
   virtual void render() const = 0;
 
@@ -48,18 +68,34 @@ class Application {
   // container for the shader programs
   std::map<std::string, shader_program> m_shaders{};
 
+  // simulation time, frames render between its last two steps
+  frame_clock m_clock;
+  // held while simulating, other threads lock it to change the clock or
+  // the simulation between steps
+  mutable std::mutex m_clock_mutex;
+
   // resolution when 
   static const glm::uvec2 initial_resolution; 
   static const float initial_aspect_ratio; 
+
+ private:
+  // run the simulation steps due at wall_time and publish them
+  void runSteps(double wall_time);
+
+  std::thread m_simulation_thread;
+  std::atomic<bool> m_simulating;
 };
 
 
+#include "job_system.hpp"
 #include "utils.hpp"
 #include "window_handler.hpp"
 
 template<typename T>
 void Application::run(int argc, char* argv[], unsigned ver_major, unsigned ver_minor) {  
 
+    // the job system takes the thread creating it as main thread for gl tasks
+    job_system::shared();
     GLFWwindow* window = window_handler::initialize(initial_resolution, ver_major, ver_minor);
     
     std::string resource_path = utils::read_resource_path(argc, argv);
@@ -78,6 +114,12 @@ void Application::run(int argc, char* argv[], unsigned ver_major, unsigned ver_m
     while (!glfwWindowShouldClose(window)) {
       // query input
       glfwPollEvents();
+      // fixed simulation steps for the time since the last frame
+      application->advanceClock(glfwGetTime());
+      // gl work handed to this thread by tasks of the job system
+      job_system::shared().run_main_tasks();
+      // update scene and streamed resources
+      application->update();
       // clear buffer
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       // draw geometry
@@ -0,0 +1,79 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// bounding volume hierarchy of boxes over spheres packed as center and radius,
+// e.g. the world bounds of the bodies, ids are the indices of the spheres
+// built top-down with the binned surface area heuristic, moving spheres refit
+// the boxes and the tree is rebuilt once refitting made it too loose
+class bvh {
+ public:
+  // trees are rebuilt once their cost grew by rebuild_ratio since the build
+  bvh(std::size_t max_leaf_size = 4, float rebuild_ratio = 1.5f);
+
+  // build the tree from scratch
+  void build(std::vector<glm::fvec4> const& spheres);
+  // follow the spheres of the same ids, rebuild if the number changed or the
+  // tree degraded
+  void update(std::vector<glm::fvec4> const& spheres);
+
+  // closest sphere hit by the ray from origin along direction, returns false
+  // if none is hit
+  bool raycast(glm::fvec3 const& origin, glm::fvec3 const& direction,
+               std::size_t& id, float& distance) const;
+  // spheres intersecting the sphere
+  void overlap(glm::fvec4 const& sphere, std::vector<std::size_t>& ids) const;
+  // spheres intersecting the frustum of utils::frustum_planes
+  void frustum(std::array<glm::fvec4, 6> const& planes, std::vector<std::size_t>& ids) const;
+  // k spheres closest to the point by the distance to their surface,
+  // closest first
+  void nearest(glm::fvec3 const& point, std::size_t k, std::vector<std::size_t>& ids) const;
+
+  std::size_t size() const;
+  // expected cost of a query by the surface area heuristic
+  float cost() const;
+  // number of builds so far, refits excluded
+  std::size_t builds() const;
+
+ private:
+  struct box {
+    glm::fvec3 low;
+    glm::fvec3 high;
+  };
+
+  // leaves hold count items from first, inner nodes their two children
+  // from first, children follow their parent in the array
+  struct node {
+    box bounds;
+    std::uint32_t first;
+    std::uint32_t count;
+  };
+
+  static box sphere_box(glm::fvec4 const& sphere);
+  static box merge(box const& a, box const& b);
+  static float area(box const& bounds);
+  // squared distance from the point to the box, 0 inside
+  static float distance2(box const& bounds, glm::fvec3 const& point);
+
+  // split the items from first recursively into the node
+  void split(std::size_t node_index, std::size_t first, std::size_t count);
+  // recompute the boxes from the leaves up
+  void refit();
+
+  std::size_t max_leaf_size_;
+  float rebuild_ratio_;
+
+  std::vector<glm::fvec4> spheres_;
+  // ids in the order of the leaves
+  std::vector<std::uint32_t> items_;
+  std::vector<node> nodes_;
+  float build_cost_;
+  std::size_t builds_;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef DEPTH_PYRAMID_HPP
+#define DEPTH_PYRAMID_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
+// hierarchical z pyramid reduced from a depth texture, for occlusion tests of
+// bounding spheres against the depth of the last frame
+// level 0 has half the size of the depth texture and every texel holds the
+// nearest and farthest depth of all texels below it, so tests stay
+// conservative at any level
+// a small level is read back asynchronously through pixel pack buffers for
+// tests on the cpu
+class depth_pyramid {
+ public:
+  // depth texture of width and height, levels up to readback_width wide are
+  // read back, requires a current context
+  depth_pyramid(unsigned width, unsigned height, unsigned readback_width = 64);
+  // free textures and buffers
+  ~depth_pyramid();
+
+  depth_pyramid(depth_pyramid const&) = delete;
+  depth_pyramid& operator=(depth_pyramid const&) = delete;
+
+  // adapt to a new depth texture size, drops pyramid and read backs
+  void resize(unsigned width, unsigned height);
+
+  // reduce the depth texture rendered with view_projection with the program
+  // of shaders/hiz_reduce.vert and .frag, and start reading back the small
+  // level, restores the framebuffer and viewport
+  void build(GLuint depth_texture, GLuint program, glm::fmat4 const& view_projection);
+  // take the oldest finished read back, does not wait for the gpu
+  void resolve();
+
+  // texture with all levels, red holds the nearest and green the farthest depth
+  GLuint texture() const;
+  std::size_t num_levels() const;
+  // false before the first build
+  bool built() const;
+  // matrix of the depth of the last build
+  glm::fmat4 const& view_projection() const;
+
+  // builds since the read back depth, 0 without read back
+  std::size_t readback_age() const;
+  // false if the sphere lies behind the read back depth everywhere it covers,
+  // as seen by the matrix that depth was rendered with, true outside of that
+  // view and without read back
+  bool visible(glm::fvec4 const& sphere) const;
+
+ private:
+  void create_pyramid();
+  void delete_pyramid();
+
+  unsigned width_;
+  unsigned height_;
+  unsigned readback_width_;
+  // size of each level
+  std::vector<glm::uvec2> levels_;
+  std::size_t readback_level_;
+  GLuint texture_;
+  GLuint framebuffer_;
+  // draws the screen filling triangle without attributes
+  GLuint vertex_array_;
+  std::size_t num_builds_;
+  glm::fmat4 view_projection_;
+
+  // read backs of two frames are in flight
+  GLuint pack_buffers_[2];
+  GLsync fences_[2];
+  std::size_t pack_builds_[2];
+  glm::fmat4 pack_matrices_[2];
+  std::size_t next_buffer_;
+
+  // resolved level, nearest and farthest depth per texel
+  std::vector<glm::fvec2> readback_;
+  std::size_t readback_build_;
+  glm::fmat4 readback_matrix_;
+};
+
+#endif
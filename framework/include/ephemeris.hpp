@@ -0,0 +1,55 @@
+#ifndef EPHEMERIS_HPP
+#define EPHEMERIS_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// positions of bodies over a range of time as chebyshev series, one per body
+// and segment of time, so any time in the range is evaluated without
+// stepping or solving anything
+// the series can be written to a file which is memory mapped for reading
+class ephemeris {
+ public:
+  // positions of all bodies at a time
+  typedef std::function<void(double, std::vector<glm::fvec3>&)> sampler;
+
+  // fit series of degree to the positions from sampler over segments of
+  // segment_length from start until end, key identifies what was sampled
+  ephemeris(std::size_t num_bodies, double start, double end, double segment_length,
+            std::size_t degree, sampler const& positions, std::uint64_t key = 0);
+  // map a file written by write
+  explicit ephemeris(std::string const& file_name);
+
+  // write the series next to the file and move it there when complete
+  void write(std::string const& file_name) const;
+
+  std::size_t num_bodies() const;
+  std::size_t degree() const;
+  double start() const;
+  double end() const;
+  double segment_length() const;
+  std::uint64_t key() const;
+
+  // positions of all bodies, times outside of the range are clamped into it
+  void evaluate(double time, std::vector<glm::fvec3>& positions) const;
+
+ private:
+  std::size_t num_bodies_;
+  std::size_t degree_;
+  std::size_t num_segments_;
+  double start_;
+  double segment_length_;
+  std::uint64_t key_;
+  // coefficients by segment, body, axis and degree, in fitted_ or the
+  // mapping of the file
+  std::vector<float> fitted_;
+  std::unique_ptr<std::uint8_t, std::function<void(std::uint8_t*)>> mapping_;
+  float const* coefficients_;
+};
+
+#endif
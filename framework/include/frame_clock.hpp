@@ -0,0 +1,65 @@
+#ifndef FRAME_CLOCK_HPP
+#define FRAME_CLOCK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// simulation time advanced in fixed ticks, decoupled from the frame rate
+// every frame adds the scaled wall time since the last one to an accumulator
+// and takes as many whole ticks out as fit, the remainder interpolates
+// between the last two ticks for rendering
+// when more ticks are due than a frame may run, e.g. under time warp, the
+// due time is split into that many equally long steps instead
+class frame_clock {
+ public:
+  // tick in simulated seconds at scale 1, at most max_ticks per frame
+  explicit frame_clock(double tick = 1.0 / 120.0, std::size_t max_ticks = 8);
+
+  // start a frame at wall_time in seconds, returns the steps to simulate
+  // before rendering it, each step() long
+  std::size_t advance(double wall_time);
+
+  // simulated seconds of each step of the current frame
+  double step() const;
+  // simulated seconds of one tick at scale 1
+  double tick() const;
+  // simulated time after all steps of the current frame
+  double time() const;
+  // simulated time before the last step
+  double previous_time() const;
+  // fraction of a step the rendered frame lies beyond previous_time()
+  double interpolation() const;
+  // simulated time to render the current frame at, between the last two steps
+  double render_time() const;
+  // steps taken since the start
+  std::uint64_t steps() const;
+
+  // simulated seconds per wall second, 0 stops the simulation
+  void set_scale(double scale);
+  double scale() const;
+  void set_paused(bool paused);
+  bool paused() const;
+  // frames advance by frame_time regardless of the wall clock, so runs
+  // with the same input repeat exactly
+  void set_deterministic(bool deterministic, double frame_time = 1.0 / 60.0);
+  bool deterministic() const;
+  // jump to a simulated time, the next frame does not interpolate
+  void seek(double time);
+
+ private:
+  double tick_;
+  std::size_t max_ticks_;
+  double scale_;
+  bool paused_;
+  bool deterministic_;
+  double frame_time_;
+  // wall time of the last frame, negative before the first one
+  double last_wall_time_;
+  // simulated time not yet covered by steps
+  double accumulator_;
+  double step_;
+  double time_;
+  std::uint64_t steps_;
+};
+
+#endif
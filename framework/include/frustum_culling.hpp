@@ -0,0 +1,41 @@
+#ifndef FRUSTUM_CULLING_HPP
+#define FRUSTUM_CULLING_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// bounding sphere tests against the planes of utils::frustum_planes
+// spheres are packed as center and radius
+namespace frustum_culling {
+
+// spheres stored component by component, so several are tested at once
+struct sphere_list {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+
+  void clear();
+  void push_back(glm::fvec4 const& sphere);
+  std::size_t size() const;
+};
+
+// set visible to 1 for the spheres intersecting the frustum and 0 for the
+// others, tests 8 spheres at a time with avx and 4 with sse
+// returns the number of visible spheres
+std::size_t test(std::array<glm::fvec4, 6> const& planes,
+                 sphere_list const& spheres,
+                 std::vector<std::uint8_t>& visible);
+
+// sphere enclosing the transformed sphere, scaled by the longest axis
+glm::fvec4 transform(glm::fmat4 const& matrix, glm::fvec4 const& sphere);
+
+// smallest sphere enclosing both spheres
+glm::fvec4 merge(glm::fvec4 const& a, glm::fvec4 const& b);
+
+}
+
+#endif
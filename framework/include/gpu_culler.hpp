@@ -0,0 +1,96 @@
+#ifndef GPU_CULLER_HPP
+#define GPU_CULLER_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <array>
+#include <vector>
+
+// culls bodies with a compute shader and writes their indirect draw commands,
+// so the cpu only uploads the bodies which changed
+// commands have the layout of glDrawElementsIndirect, each body has its own
+// command which draws no instance when culled
+// bodies sharing geometry form a group, drawn by one multi draw over a
+// command of every body, those of other groups or culled draw no instance
+// the base instance of a command is the body id, which the vertex shader
+// reads through an instanced attribute to fetch the body from the buffer
+class gpu_culler {
+ public:
+  // size of one command in the buffers
+  static std::size_t const command_bytes = 5 * sizeof(GLuint);
+  // group of bodies only drawn through their own command
+  static GLuint const no_group = ~GLuint(0);
+
+  // compute shaders and storage buffers in vertex shaders need gl 4.3
+  static bool supported();
+
+  // space for max_bodies in num_groups, requires a current context which is
+  // supported
+  gpu_culler(std::size_t max_bodies, std::size_t num_groups);
+  ~gpu_culler();
+
+  gpu_culler(gpu_culler const&) = delete;
+  gpu_culler& operator=(gpu_culler const&) = delete;
+
+  // transform, bounding sphere in object space, group, texture layer and
+  // index range of a body, ids below max_bodies, bodies which did not change
+  // are not uploaded again
+  void set_body(std::size_t id, glm::fmat4 const& model_matrix, glm::fvec4 const& sphere,
+                GLuint group, GLuint layer, GLuint num_indices, GLuint first_index = 0,
+                GLint base_vertex = 0);
+  // bodies up to the highest id set
+  std::size_t num_bodies() const;
+
+  // upload the changed bodies and cull them with the program of
+  // shaders/gpu_cull.comp against the frustum planes in world space, its
+  // occlusion uniforms are set by the caller
+  void cull(GLuint program, std::array<glm::fvec4, 6> const& frustum);
+
+  // let the attribute at location of the bound vertex array hold the body
+  // id per instance
+  void bind_body_ids(GLuint location) const;
+  // draw the bodies of group with the bound program and vertex array, the
+  // bodies are bound to storage buffer binding 0
+  void draw_group(GLuint group, GLenum mode, GLenum index_type) const;
+
+  // command of body id at id * command_bytes
+  GLuint command_buffer() const;
+  // number of visible bodies of the last cull, waits for the gpu
+  std::size_t visible_bodies() const;
+  // bodies of the last cull in the frustum but occluded, waits for the gpu
+  std::size_t occluded_bodies() const;
+  // bytes of body data uploaded by the last cull
+  std::size_t uploaded_bytes() const;
+
+ private:
+  // std430 layout of a body in the shaders
+  struct body {
+    glm::fmat4 model;
+    glm::fvec4 sphere;
+    // index count, first index, base vertex and group
+    GLuint draw[4];
+    // texture layer, padded to the alignment of the struct
+    GLuint layer[4];
+  };
+
+  std::size_t max_bodies_;
+  std::size_t num_groups_;
+  std::vector<body> bodies_;
+  std::vector<bool> changed_;
+  std::size_t num_bodies_;
+  std::size_t uploaded_bytes_;
+
+  GLuint body_buffer_;
+  GLuint command_buffer_;
+  // commands of group g from g * max_bodies_ on
+  GLuint group_buffer_;
+  GLuint count_buffer_;
+  // ids of the bodies for the instanced attribute
+  GLuint id_buffer_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// pool of worker threads running tasks, shared by everything that would
+// otherwise start threads of its own
+// every worker keeps the tasks it spawns in a chase-lev deque, runs the
+// newest of them itself and steals the oldest from the others when it runs
+// dry, tasks from other threads go through a shared queue
+// tasks start once all their dependencies finished, tasks bound to the main
+// thread run only there, when it waits or calls run_main_tasks
+class job_system {
+  struct task;
+
+ public:
+  // submitted task, keeps it alive for waiting and as a dependency
+  typedef std::shared_ptr<task> handle;
+
+  enum class affinity {
+    any,
+    // e.g. gl calls, which only the thread owning the context may make
+    main_thread
+  };
+
+  // 0 workers takes one less than there are cores, since the calling thread
+  // helps while waiting, the creating thread becomes the main thread
+  explicit job_system(std::size_t num_workers = 0);
+  // finishes all queued tasks, main thread tasks not run by then are dropped
+  ~job_system();
+
+  job_system(job_system const&) = delete;
+  job_system& operator=(job_system const&) = delete;
+
+  // pool of the framework, created by the first thread using it
+  static job_system& shared();
+
+  // run function once all dependencies finished
+  // a dependency which threw skips function and passes its exception on
+  handle run(std::function<void()> const& function, std::vector<handle> const& dependencies = {},
+             affinity where = affinity::any);
+  // run function after first, as continuation of it
+  handle then(handle const& first, std::function<void()> const& function, affinity where = affinity::any);
+
+  bool finished(handle const& awaited) const;
+  // run other tasks until awaited finished, rethrows the exception of it
+  void wait(handle const& awaited);
+  void wait(std::vector<handle> const& tasks);
+  // run the ready main thread tasks, on the main thread only, returns how many
+  std::size_t run_main_tasks();
+
+  // call function with ranges of at most grain of count items, the calling
+  // thread takes part and returns once all ranges are done
+  void parallel_for(std::size_t count, std::size_t grain,
+                    std::function<void(std::size_t, std::size_t)> const& function);
+
+  std::size_t num_workers() const;
+  // threads working on a parallel_for, the workers and the caller
+  std::size_t concurrency() const;
+  bool is_main_thread() const;
+
+ private:
+  class task_deque;
+  struct worker;
+
+  void work(worker* own);
+  // worker of this pool running on the calling thread, if any
+  worker* current_worker() const;
+  // take a ready task from own deque, another worker or the shared queue
+  task* find_task(worker* own);
+  void schedule(handle const& ready);
+  // count down a dependency of task, schedule it when it was the last
+  void release(handle const& waiting);
+  void execute(task* current);
+  void wake_workers();
+  void wake_waiting();
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::thread::id main_thread_;
+
+  // guards the queues and sleeping
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // ready tasks of threads which are not workers
+  std::deque<task*> injected_;
+  std::deque<task*> main_tasks_;
+  // ready tasks in the deques and injected_, not yet taken
+  std::atomic<std::size_t> queued_;
+  std::atomic<std::size_t> num_injected_;
+  // workers sleeping and threads sleeping in wait
+  std::atomic<std::size_t> sleeping_;
+  std::atomic<std::size_t> waiting_;
+  std::atomic<bool> stop_;
+
+  static thread_local worker* current_;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef KTX_FILE_HPP
+#define KTX_FILE_HPP
+
+#include "pixel_data.hpp"
+
+#include <map>
+#include <string>
+
+// reading and writing of textures with mip chains in the KTX 1.1 container
+namespace ktx_file {
+  typedef std::map<std::string, std::string> key_values;
+
+  // map file into memory, the pixel_data points directly into the mapping
+  // optionally return the key/value metadata of the file
+  pixel_data read(std::string const& file_name, key_values* metadata = nullptr);
+  // write all mip levels of the texture and the metadata
+  void write(std::string const& file_name, pixel_data const& texture, key_values const& metadata = key_values{});
+}
+
+#endif
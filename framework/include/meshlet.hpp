@@ -0,0 +1,41 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <array>
+#include <vector>
+
+// cluster of neighbouring triangles with similar normals, culled as a whole
+struct meshlet {
+  // range in the index buffer of the model
+  GLuint first_index;
+  GLsizei num_indices;
+  // bounding sphere in object space
+  glm::fvec3 center;
+  float radius;
+  // normals of all triangles lie in the cone around the axis, a cutoff of 1
+  // means the cone is too wide to ever face away completely
+  glm::fvec3 cone_axis;
+  float cone_cutoff;
+};
+
+// ranges of the index buffer to draw with glMultiDrawElements
+struct meshlet_draws {
+  std::vector<GLsizei> counts;
+  std::vector<GLvoid const*> offsets;
+  std::size_t num_triangles;
+};
+
+// collect the meshlets which face the camera and intersect the frustum, both
+// given in object space, neighbouring ranges are merged into one draw
+void cull_meshlets(std::vector<meshlet> const& meshlets,
+                   glm::fvec3 const& camera,
+                   std::array<glm::fvec4, 6> const& frustum,
+                   meshlet_draws& draws);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MODEL_LOADER_HPP
 #define MODEL_LOADER_HPP
 
+#include "meshlet.hpp"
 #include "model.hpp"
 
 #include "tiny_obj_loader.h"
@@ -9,6 +10,35 @@ namespace model_loader {
 
 model obj(std::string const& path, model::attrib_flag_t import_attribs = model::POSITION);
 
+// unit sphere from an icosahedron whose faces are split into four
+// subdivisions times, attributes are computed analytically and vertices are
+// duplicated along the texcoord seam and at the poles
+// built once per subdivision level and attributes, shared afterwards
+model const& icosphere(std::size_t subdivisions, model::attrib_flag_t import_attribs = model::POSITION);
+
+// unit sphere of slices around the y axis and stacks from pole to pole,
+// built and shared like the icosphere
+model const& uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t import_attribs = model::POSITION);
+
+// largest distance between the unit sphere and the triangles of a sphere mesh
+float sphere_error(model const& sphere);
+
+// collapse edges in order of their quadric error until at most
+// target_triangles remain, each vertex keeps its attributes
+// copies of a vertex are welded, vertices on borders and attribute seams are
+// not moved
+// error receives the largest distance of a removed vertex to the surface
+model simplify(model const& source, std::size_t target_triangles, float* error = nullptr);
+
+// levels of detail with factor times the triangles of the previous one,
+// the source is the first level and errors receive the deviation of each
+std::vector<model> lod_chain(model const& source, std::size_t num_levels, std::vector<float>& errors, float factor = 0.5f);
+
+// group the triangles into clusters of neighbours with at most max_triangles
+// triangles and max_vertices distinct vertices, the indices of the model are
+// reordered so every cluster is a contiguous range
+std::vector<meshlet> meshlets(model& source, std::size_t max_triangles = 124, std::size_t max_vertices = 64);
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef NBODY_SYSTEM_HPP
+#define NBODY_SYSTEM_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// particles under their mutual gravity, integrated with kick-drift-kick
+// leapfrog so orbits keep their energy over long runs
+// every force pass sorts the particles along a morton curve and builds an
+// octree over them, far nodes act through their center of mass (barnes-hut)
+// and near leaves particle by particle with sse/avx
+class nbody_system {
+ public:
+  // nodes are opened when their size is above opening_angle times their
+  // distance, softening keeps close encounters finite and must be positive
+  explicit nbody_system(float opening_angle = 0.5f, float softening = 0.01f,
+                        float gravity = 1.0f, std::size_t max_leaf_size = 16);
+
+  // id of the new particle, ids count up from 0
+  std::size_t add(glm::fvec3 const& position, glm::fvec3 const& velocity, float mass);
+  void clear();
+  std::size_t size() const;
+
+  void set_opening_angle(float opening_angle);
+  float opening_angle() const;
+
+  // advance all particles by dt
+  void step(float dt);
+
+  glm::fvec3 position(std::size_t id) const;
+  glm::fvec3 velocity(std::size_t id) const;
+  // acceleration of the last force pass
+  glm::fvec3 acceleration(std::size_t id) const;
+  // acceleration summed over all particles one by one, for comparison
+  glm::fvec3 direct_acceleration(std::size_t id) const;
+
+  // particle pairs and particle node pairs of the last force pass
+  std::uint64_t interactions() const;
+  // nodes of the last octree
+  std::size_t num_nodes() const;
+
+ private:
+  // inner nodes have num_children consecutive children from first_child,
+  // leaves hold count particles of the sorted order from first
+  struct node {
+    glm::fvec3 center_of_mass;
+    float mass;
+    // edge length of the cube
+    float size;
+    std::uint32_t first_child;
+    std::uint32_t num_children;
+    std::uint32_t first;
+    std::uint32_t count;
+  };
+
+  // morton code of a particle and its id
+  struct key {
+    std::uint64_t code;
+    std::uint32_t id;
+  };
+
+  struct interaction_list;
+
+  // sort the particles and link the nodes
+  void build_tree();
+  // nodes below the range of sorted particles, whose codes agree above level
+  void build_node(std::vector<node>& nodes, std::size_t index, std::uint32_t first,
+                  std::uint32_t count, unsigned level) const;
+  // accelerations of all particles from the tree
+  void compute_forces();
+  // accelerations of the particles of one leaf, returns the interactions
+  std::uint64_t leaf_forces(node const& leaf, interaction_list& list);
+
+  float opening_angle_;
+  float softening2_;
+  float gravity_;
+  std::size_t max_leaf_size_;
+
+  // particles by id, stored per component for the vector units
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> vx_;
+  std::vector<float> vy_;
+  std::vector<float> vz_;
+  std::vector<float> ax_;
+  std::vector<float> ay_;
+  std::vector<float> az_;
+  std::vector<float> masses_;
+  // accelerations match the positions, the first kick of a step can reuse them
+  bool forces_valid_;
+
+  // ids along the morton curve and their positions and masses in that order
+  glm::fvec3 low_;
+  float cube_size_;
+  std::vector<key> keys_;
+  std::vector<glm::fvec4> sorted_;
+  std::vector<node> nodes_;
+  // indices of the leaf nodes in morton order
+  std::vector<std::uint32_t> leaves_;
+  std::uint64_t interactions_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef OCCLUSION_BUFFER_HPP
+#define OCCLUSION_BUFFER_HPP
+
+#include "model.hpp"
+#include "simd_lanes.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
+// low resolution depth buffer rasterized on the cpu from occluder meshes,
+// bodies whose screen bounds lie behind the occluders everywhere need not
+// be drawn
+// the buffer is split into tiles which are rasterized in parallel, rows of
+// 8 pixels at a time with avx and 4 with sse
+// occluders must lie inside the surface they stand for, like the chords of a
+// sphere mesh, so that nothing visible is rejected
+class occlusion_buffer {
+ public:
+  // width and height are rounded up to multiples of the tile size, which is
+  // rounded up to a multiple of 8
+  occlusion_buffer(std::size_t width = 256, std::size_t height = 128, std::size_t tile_size = 32);
+
+  // reset to the far plane and drop the occluders
+  void clear();
+  // queue the front facing triangles of the mesh, transformed by matrix into
+  // clip space, triangles crossing the near plane are skipped
+  void add_occluder(model const& mesh, glm::fmat4 const& matrix);
+  // rasterize the queued occluders, all lanes give the same depths
+  void rasterize(simd_lanes lanes = widest_simd_lanes());
+
+  // false if the sphere is outside of the view or behind the occluders in all
+  // pixels it covers, view_projection transforms it into clip space
+  bool visible(glm::fvec4 const& sphere, glm::fmat4 const& view_projection) const;
+
+  std::size_t width() const;
+  std::size_t height() const;
+  // depth of the pixel between 0 at the near and 1 at the far plane, rows
+  // start at the bottom
+  float depth(std::size_t x, std::size_t y) const;
+  // triangles rasterized by the last call
+  std::size_t triangles() const;
+
+ private:
+  // edge functions and depth plane over pixel coordinates
+  struct triangle {
+    glm::fvec3 edge_x;
+    glm::fvec3 edge_y;
+    glm::fvec3 edge_c;
+    glm::fvec3 depth;
+    int low_x;
+    int low_y;
+    int high_x;
+    int high_y;
+  };
+
+  // rasterize the binned triangles into one tile
+  void rasterize_tile(std::size_t tile, simd_lanes lanes);
+
+  std::size_t tile_size_;
+  std::size_t tiles_x_;
+  std::size_t tiles_y_;
+  std::size_t width_;
+  std::size_t height_;
+  std::vector<float> depths_;
+  std::vector<triangle> triangles_;
+  // indices of the triangles overlapping each tile
+  std::vector<std::vector<std::size_t>> bins_;
+};
+
+#endif
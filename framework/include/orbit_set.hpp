@@ -0,0 +1,67 @@
+#ifndef ORBIT_SET_HPP
+#define ORBIT_SET_HPP
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
+// classical elements of an elliptic orbit around the parent, angles in
+// radians, the reference plane is xz and y points north
+struct orbital_elements {
+  float semi_major_axis;
+  // 0 for circles, below 1
+  float eccentricity;
+  float inclination;
+  float ascending_node;
+  float argument_of_periapsis;
+  // mean anomaly at time 0
+  float mean_anomaly;
+  // seconds for one revolution
+  float period;
+  // seconds for one turn of the body around its own y axis, 0 for none
+  float rotation_period;
+};
+
+// positions on many orbits at once, the elements are stored per component so
+// the kepler equation is solved with newton iterations for 8 orbits at a time
+// with avx and 4 with sse
+class orbit_set {
+ public:
+  // newton iterations at most, enough for eccentricities up to 0.9, solves
+  // stop early once all orbits of a register converged
+  explicit orbit_set(std::size_t iterations = 8);
+
+  // id of the new orbit, ids count up from 0
+  std::size_t add(orbital_elements const& elements);
+  void clear();
+  std::size_t size() const;
+
+  // position relative to the focus of every orbit at time, by id
+  void evaluate(double time, std::vector<glm::fvec3>& positions) const;
+  // position of one orbit solved in double precision until converged, for
+  // comparison
+  glm::dvec3 reference(std::size_t id, double time) const;
+
+ private:
+  std::size_t iterations_;
+  // phase is kept in double, float time would drift within minutes
+  std::vector<double> mean_anomalies_;
+  std::vector<double> mean_motions_;
+  std::vector<float> eccentricities_;
+  std::vector<float> semi_major_axes_;
+  std::vector<float> semi_minor_axes_;
+  // directions of the major axis towards periapsis and of the minor axis
+  // along the motion
+  std::vector<float> major_x_;
+  std::vector<float> major_y_;
+  std::vector<float> major_z_;
+  std::vector<float> minor_x_;
+  std::vector<float> minor_y_;
+  std::vector<float> minor_z_;
+
+  // solve the orbits from first on, as many as lanes holds
+  template <typename lanes>
+  void solve(std::size_t first, double time, glm::fvec3* positions) const;
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <cstdint>
+#include <functional>
+#include <memory>
 
 // #include <glbinding/gl/types.h>
 #include <glbinding/gl/enum.h>
@@ -10,9 +12,22 @@
 using namespace gl;
 
 // holds texture data and format information
+// owns its pixel buffer exclusively, so it can only be moved
 struct pixel_data {
+  // releases a buffer which was adopted by the pixel_data
+  typedef std::function<void(std::uint8_t*)> deleter_type;
+  typedef std::unique_ptr<std::uint8_t, deleter_type> buffer_type;
+
+  // location of a mip level, offset is relative to the start of the buffer
+  struct mip_level {
+    std::size_t offset;
+    std::size_t size;
+  };
+
   pixel_data()
-   :pixels()
+   :pixels(nullptr, deleter_type{})
+   ,num_bytes{0}
+   ,mip_levels(1, mip_level{0, 0})
    ,width{0}
    ,height{0}
    ,depth{0}
@@ -20,8 +35,29 @@ struct pixel_data {
    ,channel_type{GL_NONE}
   {}
 
+  // take over the storage of the vector
   pixel_data(std::vector<std::uint8_t> dat, GLenum c, GLenum ty, std::size_t w, std::size_t h = 1, std::size_t d = 1)
-   :pixels(dat)
+   :pixel_data()
+  {
+    if (!dat.empty()) {
+      // vector is moved to the heap so its buffer stays in place
+      std::vector<std::uint8_t>* storage = new std::vector<std::uint8_t>(std::move(dat));
+      pixels = buffer_type(storage->data(), [storage](std::uint8_t*) { delete storage; });
+      num_bytes = storage->size();
+      mip_levels[0].size = num_bytes;
+    }
+    width = w;
+    height = h;
+    depth = d;
+    channels = c;
+    channel_type = ty;
+  }
+
+  // adopt a foreign buffer of the given size, it is released with the deleter
+  pixel_data(std::uint8_t* dat, deleter_type deleter, std::size_t bytes, GLenum c, GLenum ty, std::size_t w, std::size_t h = 1, std::size_t d = 1)
+   :pixels(dat, std::move(deleter))
+   ,num_bytes{bytes}
+   ,mip_levels(1, mip_level{0, bytes})
    ,width{w}
    ,height{h}
    ,depth{d}
@@ -29,11 +65,34 @@ struct pixel_data {
    ,channel_type{ty}
   {}
 
-  void const* ptr() const {
-    return pixels.data();
+  pixel_data(pixel_data&&) = default;
+  pixel_data& operator=(pixel_data&&) = default;
+
+  void const* ptr(std::size_t level = 0) const {
+    return pixels.get() + mip_levels[level].offset;
+  }
+
+  // number of mip levels in the buffer, level 0 is the full image
+  std::size_t num_levels() const {
+    return mip_levels.size();
+  }
+
+  // dimensions of a mip level
+  std::size_t level_width(std::size_t level) const {
+    return width >> level > 0 ? width >> level : 1;
+  }
+  std::size_t level_height(std::size_t level) const {
+    return height >> level > 0 ? height >> level : 1;
+  }
+
+  // number of bytes in the buffer
+  std::size_t size() const {
+    return num_bytes;
   }
 
-  std::vector<std::uint8_t> pixels;
+  buffer_type pixels;
+  std::size_t num_bytes;
+  std::vector<mip_level> mip_levels;
   std::size_t width;
   std::size_t height;
   std::size_t depth;
@@ -44,4 +103,4 @@ struct pixel_data {
   GLenum channel_type; 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,24 @@
+#ifndef SIMD_LANES_HPP
+#define SIMD_LANES_HPP
+
+// vector instructions a loop may use, chosen at run time so tests and
+// benchmarks can compare the paths in one build
+// lanes the build was not compiled for fall back to the widest it was
+enum class simd_lanes {
+  scalar,
+  sse,
+  avx
+};
+
+// widest lanes of the build
+inline simd_lanes widest_simd_lanes() {
+#if defined(__AVX__)
+  return simd_lanes::avx;
+#elif defined(__SSE__)
+  return simd_lanes::sse;
+#else
+  return simd_lanes::scalar;
+#endif
+}
+
+#endif
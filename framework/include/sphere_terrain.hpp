@@ -0,0 +1,154 @@
+#ifndef SPHERE_TERRAIN_HPP
+#define SPHERE_TERRAIN_HPP
+
+#include "pixel_data.hpp"
+#include "structs.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// unit sphere displaced by a heightmap, drawn as chunks of a quadtree on each
+// face of a cube projected onto the sphere (cdlod)
+// chunks closer than their lod range are replaced by their four children,
+// vertices morph into the grid of the parent towards the end of the range so
+// neighbouring levels meet without cracks or popping
+// chunks are generated on worker threads and kept in a bounded lru cache
+class sphere_terrain {
+ public:
+  // chunk selected for drawing, the vertex array uses the shared index buffer
+  struct chunk_draw {
+    GLuint vertex_AO;
+    // distances from the camera in object space between which the vertices
+    // move to their morph target
+    float morph_start;
+    float morph_end;
+  };
+
+  // heights are taken from the first channel of the 8 bit heightmap in
+  // equirectangular projection, scaled by height_scale
+  // chunks have grid_size quads per side and are subdivided once the camera is
+  // closer than lod_ratio times their size, requires a current context
+  sphere_terrain(pixel_data const& heightmap,
+                 float height_scale,
+                 std::size_t grid_size = 16,
+                 float lod_ratio = 6.0f,
+                 std::size_t max_level = 12,
+                 std::size_t max_chunks = 1024,
+                 std::size_t num_workers = 2);
+  // stop workers and free buffers
+  ~sphere_terrain();
+
+  sphere_terrain(sphere_terrain const&) = delete;
+  sphere_terrain& operator=(sphere_terrain const&) = delete;
+
+  // upload up to max_uploads generated chunks, select the chunks to draw for
+  // the camera and request missing ones, camera and frustum planes are in
+  // object space of the unit sphere
+  void update(glm::fvec3 const& camera, std::array<glm::fvec4, 6> const& frustum, std::size_t max_uploads);
+
+  // chunks selected by the last update
+  std::vector<chunk_draw> const& selection() const;
+  // unsigned int indices to draw for each chunk, with GL_TRIANGLES
+  GLsizei num_elements() const;
+  // triangles of the selected chunks
+  std::size_t triangles() const;
+
+  // largest distance of the surface from the center
+  float radius() const;
+
+  std::size_t resident_chunks() const;
+  // chunks queued or being generated
+  std::size_t pending_chunks() const;
+
+ private:
+  typedef std::uint64_t chunk_key;
+
+  struct bounding_sphere {
+    glm::fvec3 center;
+    float radius;
+  };
+
+  struct chunk {
+    model_object object;
+    // encloses the vertices, tighter than the bounds before generation
+    bounding_sphere bounds;
+    std::size_t last_used;
+  };
+
+  // vertices of a chunk generated by a worker
+  struct generated_chunk {
+    chunk_key key;
+    std::vector<GLfloat> vertices;
+    bounding_sphere bounds;
+  };
+
+  static chunk_key key(std::size_t face, std::size_t level, std::size_t x, std::size_t y);
+  static std::size_t face(chunk_key key);
+  static std::size_t level(chunk_key key);
+  static std::size_t x(chunk_key key);
+  static std::size_t y(chunk_key key);
+
+  // point of the unit sphere at face coordinates in [0, 1]
+  static glm::dvec3 direction(std::size_t face, double s, double t);
+  // sphere enclosing the chunk at any height, for chunks not generated yet
+  bounding_sphere bounds(chunk_key key) const;
+  // chunk intersects the frustum and is not hidden behind the horizon
+  bool visible(bounding_sphere const& sphere) const;
+  // distance from the camera below which a chunk of the level is subdivided
+  float range(std::size_t level) const;
+
+  // bilinear height at texcoords, wrapping around in u
+  double height(double u, double v) const;
+  // interleaved position, normal, texcoord and morph target of the chunk
+  // and the sphere enclosing them
+  generated_chunk generate(chunk_key key) const;
+  void upload(generated_chunk const& generated);
+  // choose chunks recursively, starting with a root
+  void select(chunk_key key);
+  // drop the least recently used chunks above the budget
+  void evict();
+
+  // take keys from the queue until stopped
+  void work();
+
+  std::vector<float> heights_;
+  std::size_t height_width_;
+  std::size_t height_height_;
+  float height_scale_;
+  std::size_t grid_size_;
+  float lod_ratio_;
+  std::size_t max_level_;
+  std::size_t max_chunks_;
+
+  GLuint element_BO_;
+  std::unordered_map<chunk_key, chunk> chunks_;
+  std::size_t frame_;
+
+  // state of the current selection
+  glm::fvec3 camera_;
+  std::array<glm::fvec4, 6> frustum_;
+  std::vector<chunk_draw> selection_;
+  // chunks requested in this frame which are not resident or queued yet
+  std::vector<chunk_key> requests_;
+  // chunks queued or being generated, accessed by the gl thread only
+  std::unordered_set<chunk_key> pending_;
+
+  // state shared with the workers
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<chunk_key> queue_;
+  std::vector<generated_chunk> generated_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include "job_system.hpp"
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// named stages of work with the stages they take their inputs from, run on
+// a job system as soon as the inputs are ready
+// stages bound to the main thread, e.g. gl calls, run on the thread calling
+// run, the others on the workers
+// the time of every stage is recorded, so the chain of stages which held
+// up the last one can be printed
+class task_graph {
+ public:
+  explicit task_graph(job_system& jobs = job_system::shared());
+
+  // inputs are names of stages added before, so the graph has no cycles
+  void add(std::string const& name, std::vector<std::string> const& inputs,
+           std::function<void()> const& function,
+           job_system::affinity where = job_system::affinity::any);
+
+  // run all stages and return once they are done, on the main thread of the
+  // job system when any stage is bound to it
+  // stages after a stage which threw are skipped, the first exception is
+  // rethrown once all others ended
+  void run();
+
+  // seconds from the start of run until the stage started and finished
+  double started(std::string const& name) const;
+  double finished(std::string const& name) const;
+  // seconds of all stages added up, divided by the duration of run, the
+  // threads busy on average
+  double parallelism() const;
+  // names of the stages from a first one to the one finishing last, each
+  // stage is the input of the next which finished last
+  std::vector<std::string> critical_path() const;
+  // print the critical path with the time of every stage on it
+  void print_critical_path(std::ostream& stream) const;
+
+ private:
+  struct stage {
+    std::string name;
+    std::vector<std::size_t> inputs;
+    std::function<void()> function;
+    job_system::affinity where;
+    double started;
+    double finished;
+  };
+
+  std::size_t index(std::string const& name) const;
+
+  job_system& jobs_;
+  std::vector<stage> stages_;
+  std::map<std::string, std::size_t> indices_;
+  double duration_;
+};
+
+#endif
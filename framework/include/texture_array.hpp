@@ -0,0 +1,56 @@
+#ifndef TEXTURE_ARRAY_HPP
+#define TEXTURE_ARRAY_HPP
+
+#include "structs.hpp"
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <vector>
+
+// 2D array texture with a mip chain whose layers are drawn from 2D textures
+// of any size and format, so one draw of bodies with different textures
+// samples the one array bound for all of them
+// a layer is only drawn again when its texture or the version given with
+// it changes, like the resident levels of a streamed texture
+class texture_array {
+ public:
+  // layers of width and height in rgba8, requires a current context with
+  // immutable texture storage
+  texture_array(std::size_t width, std::size_t height, std::size_t num_layers);
+  // free texture, framebuffer and vertex array
+  ~texture_array();
+
+  texture_array(texture_array const&) = delete;
+  texture_array& operator=(texture_array const&) = delete;
+
+  // draw the source into the layer with the program of
+  // shaders/texture_layer.vert and .frag, unless the layer holds this version
+  // of it already, restores the framebuffer and viewport
+  // returns whether the layer was drawn
+  bool set_layer(GLuint program, std::size_t layer, texture_object const& source, std::size_t version);
+  // rebuild the mip chain if layers were drawn since the last call
+  void update_mipmaps();
+
+  texture_object const& texture() const;
+  std::size_t num_layers() const;
+
+ private:
+  // texture a layer was drawn from
+  struct layer_source {
+    GLuint handle;
+    std::size_t version;
+  };
+
+  std::size_t width_;
+  std::size_t height_;
+  std::vector<layer_source> sources_;
+  bool changed_;
+  texture_object texture_;
+  GLuint framebuffer_;
+  // draws the screen filling triangle without attributes
+  GLuint vertex_array_;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef TEXTURE_COMPRESSOR_HPP
+#define TEXTURE_COMPRESSOR_HPP
+
+#include "pixel_data.hpp"
+
+// block compression of textures for upload with glCompressedTexImage2D
+namespace texture_compressor {
+  // encode every mip level of an 8 bit rgba texture as GL_COMPRESSED_RGB8_ETC2,
+  // alpha is dropped, only ETC1 compatible blocks are written
+  pixel_data etc2(pixel_data const& image);
+  // decode a GL_COMPRESSED_RGB8_ETC2 texture with ETC1 compatible blocks to 8 bit rgba
+  pixel_data decode_etc2(pixel_data const& compressed);
+}
+
+#endif
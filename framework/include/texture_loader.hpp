@@ -2,11 +2,34 @@
 #define TEXTURE_LOADER_HPP
 
 #include "pixel_data.hpp"
+#include "simd_lanes.hpp"
 
+#include <future>
 #include <string>
+#include <vector>
 
 namespace texture_loader {
+  // decoded pixels and mip chain are cached next to the file as "<file_name>.ktx",
+  // the cache is used as long as size and modification time of the file match
   pixel_data file(std::string const& file_name);
+  // GL_COMPRESSED_RGB8_ETC2 texture with mip chain, encoded on first use and
+  // cached as "<file_name>.etc2.ktx" like uncompressed textures
+  pixel_data compressed_file(std::string const& file_name);
+  // decode files on the job system, futures are in order of the names
+  // and become ready as soon as the respective file is decoded
+  std::vector<std::future<pixel_data>> files(std::vector<std::string> const& file_names, bool compressed = false);
+  // filters for halving the size of a mip level
+  enum class mip_filter {
+    // average of 2x2 pixels
+    box,
+    // kaiser windowed sinc, keeps more detail in the smaller levels
+    kaiser
+  };
+  // copy 8 bit image into a buffer followed by its complete mip chain,
+  // with srgb the color channels are filtered in linear space
+  // rows are split across threads, pixels are filtered with the given lanes
+  pixel_data mipmaps(pixel_data const& image, mip_filter filter = mip_filter::kaiser, bool srgb = true,
+                     simd_lanes lanes = widest_simd_lanes());
 }
 
-#endif
\ No newline at end of file
+#endif
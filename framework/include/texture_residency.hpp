@@ -0,0 +1,96 @@
+#ifndef TEXTURE_RESIDENCY_HPP
+#define TEXTURE_RESIDENCY_HPP
+
+#include "pixel_data.hpp"
+#include "structs.hpp"
+#include "texture_streamer.hpp"
+
+#include <future>
+#include <memory>
+#include <vector>
+
+// keeps the mip levels of textures resident which their size on screen
+// requires, finer levels are streamed in on demand and the least needed
+// ones are evicted when the memory budget is exceeded
+// textures are clamped to their resident levels with GL_TEXTURE_BASE_LEVEL
+class texture_residency {
+ public:
+  typedef std::size_t texture_id;
+  // called with the texture once its coarse levels are resident
+  typedef texture_streamer::completion_callback ready_callback;
+
+  // levels are uploaded through the streamer, which must outlive this object
+  texture_residency(texture_streamer& streamer, std::size_t budget_bytes);
+
+  texture_residency(texture_residency const&) = delete;
+  texture_residency& operator=(texture_residency const&) = delete;
+
+  // manage 2D texture whose pixels with complete mip chain are still decoding,
+  // levels of at most coarse_size pixels are always resident
+  texture_id add(texture_object const& texture,
+                 std::future<pixel_data>&& pixels,
+                 ready_callback const& on_ready);
+
+  // set the number of screen pixels the width of the texture spans,
+  // 0 if it is not visible
+  void request(texture_id id, float screen_size);
+
+  // evict levels and request uploads for the current screen sizes,
+  // call once per frame before updating the streamer
+  void update();
+
+  std::size_t budget() const;
+  void set_budget(std::size_t budget_bytes);
+  // bytes of the resident levels
+  std::size_t resident_bytes() const;
+  // bytes of the levels which are being uploaded
+  std::size_t pending_bytes() const;
+  // number of textures waiting for pixels or levels
+  std::size_t pending() const;
+  // finest resident level of texture, number of its levels if none is resident
+  std::size_t base_level(texture_id id) const;
+
+  // edge length up to which levels stay resident regardless of the budget
+  static std::size_t const coarse_size = 128;
+
+ private:
+  struct entry {
+    texture_object texture;
+    std::future<pixel_data> future;
+    // pixels of all levels, kept to upload evicted levels again
+    std::shared_ptr<pixel_data const> pixels;
+    ready_callback on_ready;
+    float screen_size;
+    // finest resident level, number of levels while none is resident
+    std::size_t base_level;
+    // finest level the screen size requires
+    std::size_t wanted_level;
+    // finest of the coarse levels
+    std::size_t coarse_level;
+    // an upload of finer levels is in flight
+    bool loading;
+  };
+
+  // screen pixels per texel of the level, above 1 the level is magnified
+  static float need(entry const& texture, std::size_t level);
+  // bytes of levels [first_level, end_level)
+  static std::size_t level_bytes(entry const& texture, std::size_t first_level, std::size_t end_level);
+
+  // queue upload of levels [first_level, base_level) of entry
+  void load(texture_id id, std::size_t first_level);
+  // make levels from first_level on sampled once they are uploaded
+  void loaded(texture_id id, std::size_t first_level);
+  // free finest resident level of entry
+  void evict(texture_id id);
+  // entry whose finest resident level is needed least, number of entries if
+  // no entry has evictable levels
+  texture_id eviction_candidate() const;
+
+  texture_streamer& streamer_;
+  std::size_t budget_;
+  std::size_t resident_bytes_;
+  std::size_t pending_bytes_;
+  std::vector<entry> entries_;
+};
+
+#endif
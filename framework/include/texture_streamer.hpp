@@ -0,0 +1,100 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include "pixel_data.hpp"
+#include "structs.hpp"
+
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <vector>
+
+// uploads textures over several frames through a pool of pixel unpack buffers,
+// a placeholder can be bound until a texture is complete
+class texture_streamer {
+ public:
+  // called with the texture once all of its pixels are uploaded
+  typedef std::function<void(texture_object const&)> completion_callback;
+
+  // create pool of pixel unpack buffers, requires a current context
+  texture_streamer(std::size_t num_buffers = 4, std::size_t buffer_bytes = 1 << 20);
+  // free buffers, fences and the placeholder
+  ~texture_streamer();
+
+  texture_streamer(texture_streamer const&) = delete;
+  texture_streamer& operator=(texture_streamer const&) = delete;
+
+  // 1x1 texture to bind while the actual one is still streaming
+  texture_object placeholder() const;
+
+  // queue pixels for upload into the 2D texture, storage is allocated once
+  // the pixels are available
+  // with mipmaps, the mip chain of the pixels is uploaded or generated if
+  // they have none, otherwise only the first level is used
+  // compressed pixels are uploaded as they are, they must bring their own mip chain
+  // if the future holds an exception, it is logged and the texture is
+  // dropped without calling on_complete, so the placeholder stays bound
+  void upload(texture_object const& texture,
+              std::future<pixel_data>&& pixels,
+              completion_callback const& on_complete,
+              bool mipmaps = true);
+
+  // queue levels [first_level, end_level) of pixels for upload into the 2D
+  // texture, only their storage is allocated and the level range of the
+  // texture is left to the caller
+  void upload_levels(texture_object const& texture,
+                     std::shared_ptr<pixel_data const> const& pixels,
+                     std::size_t first_level,
+                     std::size_t end_level,
+                     completion_callback const& on_complete);
+
+  // copy up to max_bytes of queued pixels into free buffers and upload them,
+  // call once per frame
+  void update(std::size_t max_bytes);
+
+  // number of textures which are not completely uploaded yet
+  std::size_t pending() const;
+
+ private:
+  // pixel unpack buffer and the fence of its last upload
+  struct unpack_buffer {
+    GLuint handle;
+    GLsync fence;
+    std::size_t size;
+  };
+
+  // texture waiting for its pixels or in the middle of an upload
+  struct upload_job {
+    texture_object texture;
+    // invalid if the pixels were given directly
+    std::future<pixel_data> future;
+    std::shared_ptr<pixel_data const> pixels;
+    completion_callback on_complete;
+    bool mipmaps;
+    // whether the job defines the level range of the texture
+    bool whole_texture;
+    // started once pixels are decoded and storage is allocated
+    bool started;
+    // level and its first row which are not yet uploaded, rows of blocks
+    // for compressed pixels
+    std::size_t level;
+    std::size_t next_row;
+    // level after the last one to upload
+    std::size_t end_level;
+  };
+
+  // allocate storage for the levels of the job
+  void start(upload_job& job);
+  // return buffer which the gpu no longer reads from, nullptr if all are busy
+  unpack_buffer* acquire_buffer();
+  // upload next rows of job, returns number of bytes uploaded
+  std::size_t upload_rows(upload_job& job, std::size_t max_bytes);
+
+  std::vector<unpack_buffer> buffers_;
+  std::size_t next_buffer_;
+  std::list<upload_job> jobs_;
+  texture_object placeholder_;
+};
+
+#endif
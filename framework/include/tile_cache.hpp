@@ -0,0 +1,64 @@
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// least recently used assignment of virtual texture tiles to the slots of a
+// physical tile texture, only bookkeeping without any gl calls
+class tile_cache {
+ public:
+  // level, column and row of a tile packed into one value
+  typedef std::uint32_t tile_key;
+
+  // result of inserting a tile
+  struct insertion {
+    std::size_t slot;
+    // tile which occupied the slot before
+    bool evicted;
+    tile_key evicted_key;
+  };
+
+  // levels up to 255, columns and rows up to 4095
+  static tile_key key(std::size_t level, std::size_t x, std::size_t y);
+  static std::size_t level(tile_key key);
+  static std::size_t x(tile_key key);
+  static std::size_t y(tile_key key);
+
+  explicit tile_cache(std::size_t num_slots);
+
+  std::size_t capacity() const;
+  // number of resident tiles
+  std::size_t size() const;
+
+  bool contains(tile_key key) const;
+  // slot of resident tile, throws if the tile is not resident
+  std::size_t slot(tile_key key) const;
+
+  // mark resident tile as used in the frame, returns whether it is resident
+  bool touch(tile_key key, std::size_t frame);
+
+  // assign a slot to the tile, evicting the least recently used tile if all
+  // slots are taken
+  // fails if every evictable tile was used in this frame, pinned tiles are
+  // never evicted
+  bool insert(tile_key key, std::size_t frame, insertion& result, bool pinned = false);
+
+ private:
+  struct entry {
+    tile_key key;
+    std::size_t slot;
+    std::size_t last_frame;
+    bool pinned;
+  };
+
+  // most recently used tiles first
+  std::list<entry> entries_;
+  std::unordered_map<tile_key, std::list<entry>::iterator> lookup_;
+  std::vector<std::size_t> free_slots_;
+  std::size_t capacity_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef TILE_PYRAMID_HPP
+#define TILE_PYRAMID_HPP
+
+#include "pixel_data.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// rgba8 image and its mip chain cut into square tiles for virtual texturing,
+// stored in one file which is memory mapped for reading
+// each tile repeats a border of its neighbours' pixels for filtering and
+// the coarsest level fits into a single tile
+class tile_pyramid {
+ public:
+  // copy num_rows rows of level 0 from first_row on into pixels, rgba8
+  // without padding, rows go upwards like in gl
+  typedef std::function<void(std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels)> row_reader;
+
+  // cut an image of width and height into tiles and write them to the file,
+  // one strip of rows is read for each row of tiles from the bottom up,
+  // strips overlap by the borders
+  // coarser levels are filtered from the tiles of the finer level in the
+  // file, so only a few strips are held in memory
+  static void write(std::string const& file_name,
+                    std::size_t width,
+                    std::size_t height,
+                    row_reader const& read_rows,
+                    std::size_t tile_size = 128,
+                    std::size_t border = 1);
+  // cut level 0 of the image like above
+  static void write(std::string const& file_name,
+                    pixel_data const& image,
+                    std::size_t tile_size = 128,
+                    std::size_t border = 1);
+
+  // map the file, tiles can be read from any thread afterwards
+  tile_pyramid(std::string const& file_name);
+
+  // size of level 0 in pixels
+  std::size_t width() const;
+  std::size_t height() const;
+  // pixels of tile content along each side
+  std::size_t tile_size() const;
+  // pixels repeated from the neighbouring tiles on each side
+  std::size_t border() const;
+  std::size_t num_levels() const;
+
+  std::size_t level_width(std::size_t level) const;
+  std::size_t level_height(std::size_t level) const;
+  // number of tiles along each axis of the level
+  std::size_t tiles_x(std::size_t level) const;
+  std::size_t tiles_y(std::size_t level) const;
+
+  // rgba8 pixels of tile including its border, rows go upwards like in gl
+  std::uint8_t const* tile(std::size_t level, std::size_t x, std::size_t y) const;
+  // bytes of one tile including its border
+  std::size_t tile_bytes() const;
+
+ private:
+  pixel_data::buffer_type mapping_;
+  std::size_t width_;
+  std::size_t height_;
+  std::size_t tile_size_;
+  std::size_t border_;
+  // index of the first tile of each level
+  std::vector<std::size_t> first_tiles_;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// hands values from one writing thread to one reading thread without locks
+// the writer fills the back slot and publishes it, the reader takes the
+// newest published slot, neither waits for the other
+// slots are reused, so the writer has to fill every field of the back slot
+template <typename T>
+class triple_buffer {
+ public:
+  triple_buffer()
+   :slots_{}
+   ,back_{0}
+   ,middle_{1}
+   ,front_{2}
+  {}
+
+  triple_buffer(triple_buffer const&) = delete;
+  triple_buffer& operator=(triple_buffer const&) = delete;
+
+  // slot the writer fills, the reader does not see it until it is published
+  T& back() {
+    return slots_[back_];
+  }
+  // hand the back slot to the reader, the writer continues with another one
+  void publish() {
+    back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) & index_mask;
+  }
+
+  // newest published slot, stays unchanged until the next call
+  T const& front() {
+    if (middle_.load(std::memory_order_relaxed) & fresh) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    }
+    return slots_[front_];
+  }
+
+ private:
+  // marks the middle slot as published and not yet taken by the reader
+  static unsigned const fresh = 4;
+  static unsigned const index_mask = 3;
+
+  std::array<T, 3> slots_;
+  // owned by the writer
+  unsigned back_;
+  // swapped by both
+  std::atomic<unsigned> middle_;
+  // owned by the reader
+  unsigned front_;
+};
+
+#endif
@@ -7,7 +7,12 @@ using namespace gl;
 
 #include <glm/gtc/type_precision.hpp>
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
 struct pixel_data;
@@ -28,14 +33,26 @@ namespace utils {
   // return handle of bound vertex array object
   GLint get_bound_VAO();
 
+  // check whether the context can sample textures in the compressed format
+  bool supports_compressed_format(GLenum format);
+  // check whether the context has at least the gl version
+  bool supports_version(GLint major, GLint minor);
+
   // read file and write content to string
   std::string read_file(std::string const& name);
+  // map whole file read-only into memory, the deleter unmaps it again
+  std::unique_ptr<std::uint8_t, std::function<void(std::uint8_t*)>> map_file(std::string const& name, std::size_t& size);
 
   // return path to resources depending on cmdline args
   std::string read_resource_path(int argc, char* argv[]);
 
   // calculate Vert+ FOV projection matrix
   glm::fmat4 calculate_projection_matrix(float aspect);
+
+  // normalized planes bounding the view volume of the matrix, in the space
+  // the matrix transforms from, points p inside satisfy dot(plane.xyz, p) + plane.w >= 0
+  // order is left, right, bottom, top, near, far
+  std::array<glm::fvec4, 6> frustum_planes(glm::fmat4 const& matrix);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef VIRTUAL_TEXTURE_HPP
+#define VIRTUAL_TEXTURE_HPP
+
+#include "structs.hpp"
+#include "tile_cache.hpp"
+#include "tile_pyramid.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// texture far larger than gpu memory, drawn from a cache texture holding the
+// visible tiles of a tile pyramid
+// tiles reported by the feedback pass are read from the mapped file on worker
+// threads, an indirection texture with one texel per tile and level points to
+// the finest resident tile covering it
+class virtual_texture {
+ public:
+  // open tile pyramid and create cache of slots_per_side^2 tiles and the
+  // indirection texture, requires a current context
+  virtual_texture(std::string const& file_name,
+                  std::size_t slots_per_side = 16,
+                  std::size_t num_workers = 2);
+  // stop workers and free textures
+  ~virtual_texture();
+
+  virtual_texture(virtual_texture const&) = delete;
+  virtual_texture& operator=(virtual_texture const&) = delete;
+
+  tile_pyramid const& pyramid() const;
+  // rgba8 texture of the resident tiles
+  texture_object cache_texture() const;
+  // rgba8ui texture holding slot column, slot row and level of the tile to sample
+  texture_object indirection_texture() const;
+  // edge length of the cache texture in pixels
+  std::size_t cache_size() const;
+
+  // tile is visible in the current frame, load it if it is not resident
+  void request(std::size_t level, std::size_t x, std::size_t y);
+
+  // upload up to max_tiles loaded tiles, queue requested ones for loading and
+  // update the indirection texture, call once per frame after the requests
+  void update(std::size_t max_tiles);
+
+  std::size_t resident_tiles() const;
+  // tiles queued or being read by the workers
+  std::size_t pending_tiles() const;
+
+ private:
+  // pixels of a tile read by a worker
+  struct loaded_tile {
+    tile_cache::tile_key key;
+    std::vector<std::uint8_t> pixels;
+  };
+
+  // take tiles from the queue until stopped
+  void work();
+  // write tile pixels into its slot of the cache texture
+  void upload(tile_cache::tile_key key, std::uint8_t const* pixels, bool pinned);
+  // point every texel to the finest resident tile covering it and upload the levels
+  void update_indirection();
+
+  tile_pyramid pyramid_;
+  tile_cache cache_;
+  std::size_t slots_per_side_;
+  std::size_t frame_;
+  texture_object cache_texture_;
+  texture_object indirection_texture_;
+  bool indirection_dirty_;
+
+  // tiles requested this frame which are not resident or queued yet
+  std::vector<tile_cache::tile_key> requests_;
+  // tiles queued or being read, accessed by the gl thread only
+  std::unordered_set<tile_cache::tile_key> pending_;
+
+  // state shared with the workers
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<tile_cache::tile_key> queue_;
+  std::vector<loaded_tile> loaded_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+};
+
+#endif
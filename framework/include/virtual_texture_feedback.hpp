@@ -0,0 +1,58 @@
+#ifndef VIRTUAL_TEXTURE_FEEDBACK_HPP
+#define VIRTUAL_TEXTURE_FEEDBACK_HPP
+
+#include "structs.hpp"
+
+#include <functional>
+
+// small integer framebuffer into which the virtually textured objects write
+// the tiles they sample, read back asynchronously through pixel pack buffers
+// each pixel holds tile column, tile row, level and virtual texture id + 1
+class virtual_texture_feedback {
+ public:
+  // called once per distinct tile in a resolved frame
+  typedef std::function<void(std::size_t texture_id, std::size_t level, std::size_t x, std::size_t y)> tile_callback;
+
+  // framebuffer is the window size reduced by scale, requires a current context
+  virtual_texture_feedback(unsigned width, unsigned height, unsigned scale = 8);
+  // free framebuffer and buffers
+  ~virtual_texture_feedback();
+
+  virtual_texture_feedback(virtual_texture_feedback const&) = delete;
+  virtual_texture_feedback& operator=(virtual_texture_feedback const&) = delete;
+
+  // adapt framebuffer to new window size
+  void resize(unsigned width, unsigned height);
+
+  // bias for the level computed in the feedback shader, so it matches the
+  // level at full resolution
+  float lod_bias() const;
+
+  // bind and clear the framebuffer, draw the objects afterwards
+  void begin();
+  // start the read back and restore the previous framebuffer and viewport
+  void end();
+
+  // report the tiles of the oldest frame whose read back is complete
+  void resolve(tile_callback const& on_tile);
+
+ private:
+  void create_framebuffer();
+  void delete_framebuffer();
+
+  unsigned width_;
+  unsigned height_;
+  unsigned scale_;
+  GLuint framebuffer_;
+  GLuint color_buffer_;
+  GLuint depth_buffer_;
+  // read backs of two frames are in flight
+  GLuint pack_buffers_[2];
+  GLsync fences_[2];
+  std::size_t next_buffer_;
+  // state restored by end
+  GLint previous_framebuffer_;
+  GLint previous_viewport_[4];
+};
+
+#endif
@@ -14,6 +14,10 @@ struct GLFWwindow;
 namespace window_handler { 
   // create window and set callbacks
   GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigned ver_minor);
+  // make the core context of an invisible window current, for tests and
+  // benchmarks, nullptr if there is no display or the version is missing
+  // free it with glfwDestroyWindow and glfwTerminate
+  GLFWwindow* hidden_context(unsigned ver_major, unsigned ver_minor);
   // load shader programs and update uniform locations
   void set_callback_object(GLFWwindow* window, Application* app);
   // free resources
@@ -1,5 +1,29 @@
 #include <GeometryNode.hpp>
 
+#include <algorithm>
+
+// sphere around the box of the vertex positions
+static glm::fvec4 bounding_sphere(model const& geometry) {
+  std::size_t const stride = std::size_t(geometry.vertex_bytes) / sizeof(GLfloat);
+  if (stride == 0 || geometry.data.size() < stride) {
+    return glm::fvec4{0.0f};
+  }
+  glm::fvec3 low{geometry.data[0], geometry.data[1], geometry.data[2]};
+  glm::fvec3 high = low;
+  for (std::size_t i = 0; i + 2 < geometry.data.size(); i += stride) {
+    glm::fvec3 const position{geometry.data[i], geometry.data[i + 1], geometry.data[i + 2]};
+    low = glm::min(low, position);
+    high = glm::max(high, position);
+  }
+  glm::fvec3 const center = (low + high) * 0.5f;
+  float radius = 0.0f;
+  for (std::size_t i = 0; i + 2 < geometry.data.size(); i += stride) {
+    glm::fvec3 const position{geometry.data[i], geometry.data[i + 1], geometry.data[i + 2]};
+    radius = std::max(radius, glm::length(position - center));
+  }
+  return glm::fvec4{center, radius};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // The Geometry Node is ude to initialize the Planets with a Name and a Model -
 // The model generates the Mesh
@@ -8,12 +32,15 @@
 GeometryNode::GeometryNode(std::string const& name,
                            model const& geometry_model,
                            glm::fvec3 const& color,
-                           pixel_data const& texture)
+                           pixel_data&& texture)
     : Node{name},
       geometry_{geometry_model},
+      bounding_sphere_{bounding_sphere(geometry_model)},
       color_{color},
-      texture_{texture},
-      planet_texture_obj_{} {}
+      texture_{std::move(texture)},
+      planet_texture_obj_{},
+      lod_errors_{0.0f},
+      lod_{0} {}
 
 // Destructor
 GeometryNode::~GeometryNode() {}
@@ -26,6 +53,11 @@ model GeometryNode::getGeometry() const {
 // Function Call that sets the Model to the Geometry
 void GeometryNode::setGeometry(model const& geometry_model) {
   geometry_ = geometry_model;
+  bounding_sphere_ = bounding_sphere(geometry_model);
+}
+
+glm::fvec4 GeometryNode::getBoundingSphere() const {
+  return bounding_sphere_;
 }
 
 glm::fvec3 GeometryNode::getColor() const {
@@ -36,12 +68,12 @@ void GeometryNode::setColor(glm::fvec3 const& inputColor) {
   color_ = inputColor;
 }
 
-pixel_data GeometryNode::getTexture() const {
+pixel_data const& GeometryNode::getTexture() const {
   return texture_;
 }
 
-void GeometryNode::setTexture(pixel_data const& input_texture) {
-  texture_ = input_texture;
+void GeometryNode::setTexture(pixel_data&& input_texture) {
+  texture_ = std::move(input_texture);
 }
 
 texture_object GeometryNode::getTextureObj() const {
@@ -55,3 +87,34 @@ void GeometryNode::setTextureObjAttribute(gl::GLuint const& handle, gl::GLenum c
   planet_texture_obj_.handle = handle;
   planet_texture_obj_.target = target;
 }
+
+void GeometryNode::setLodErrors(std::vector<float> const& errors) {
+  lod_errors_ = errors.empty() ? std::vector<float>{0.0f} : errors;
+  lod_ = 0;
+}
+
+std::size_t GeometryNode::getLod() const {
+  return lod_;
+}
+
+std::size_t GeometryNode::selectLod(float pixels_per_unit, float max_pixels, float hysteresis) {
+  // errors grow with the level, search from the coarsest
+  std::size_t fitting = 0;
+  for (std::size_t level = lod_errors_.size(); level > 0; --level) {
+    if (lod_errors_[level - 1] * pixels_per_unit <= max_pixels) {
+      fitting = level - 1;
+      break;
+    }
+  }
+  // finer levels are taken at once, coarser ones with a margin
+  if (fitting < lod_) {
+    lod_ = fitting;
+  }
+  else {
+    while (lod_ < fitting && lod_errors_[fitting] * pixels_per_unit > max_pixels * hysteresis) {
+      --fitting;
+    }
+    lod_ = fitting;
+  }
+  return lod_;
+}
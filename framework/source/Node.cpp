@@ -1,4 +1,5 @@
 #include "Node.hpp"
+#include "orbit_set.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -7,6 +8,9 @@ Node::Node(std::string const& name)
     : name_{name}, path_{"\\" + name_}, depth_{0} {
   localTransform_ = glm::fmat4{1.0f};
   worldTransform_ = glm::fmat4{1.0f};
+  worldBounds_ = glm::fvec4{0.0f};
+  culled_ = false;
+  orbit_ = nullptr;
   parent_ = nullptr;
 }
 
@@ -16,6 +20,9 @@ Node::Node(std::string const& name)
 Node::Node() : name_{"name"}, path_{"\\" + name_}, depth_{0} {
   localTransform_ = glm::fmat4{};
   worldTransform_ = glm::fmat4{};
+  worldBounds_ = glm::fvec4{0.0f};
+  culled_ = false;
+  orbit_ = nullptr;
   parent_ = nullptr;
 }
 
@@ -125,6 +132,45 @@ void Node::setWorldTransform(glm::mat4 const& inputMatrix) {
   worldTransform_ = localTransform_ * inputMatrix;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// For getting the Bounding Sphere of the Subtree in World Space
+
+glm::vec4 Node::getWorldBounds() const {
+  return worldBounds_;
+}
+
+void Node::setWorldBounds(glm::vec4 const& sphere) {
+  worldBounds_ = sphere;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// For checking if the Node was outside of the View Frustum
+
+bool Node::isCulled() const {
+  return culled_;
+}
+
+void Node::setCulled(bool culled) {
+  culled_ = culled;
+  // a culled subtree is culled as a whole
+  if (culled) {
+    for (auto child : children_) {
+      child->setCulled(true);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// For the Orbit Elements of the Node
+
+orbital_elements const* Node::getOrbit() const {
+  return orbit_.get();
+}
+
+void Node::setOrbit(orbital_elements const& orbit) {
+  orbit_ = std::make_shared<orbital_elements>(orbit);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Node::addChild(Node* node) {
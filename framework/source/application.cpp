@@ -12,6 +12,8 @@ using namespace gl;
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+
 //Used for updating the Shaders of the program
 static void update_shader_programs(std::map<std::string, shader_program>& shaders, bool throwing);
 
@@ -23,10 +25,15 @@ const float Application::initial_aspect_ratio = float(initial_resolution.x) / fl
 Application::Application(std::string const& resource_path)
  :m_resource_path{resource_path}
  ,m_shaders{}
+ ,m_clock{}
+ ,m_clock_mutex{}
+ ,m_simulation_thread{}
+ ,m_simulating{false}
 {}
 
 //The Destructor that is used to free the Resourses used when the Application is running e.g Shaders
 Application::~Application() {
+  stopSimulationThread();
   // free all shader program objects
   for (auto const& pair : m_shaders) {
     glDeleteProgram(pair.second.handle);
@@ -42,6 +49,45 @@ void Application::reloadShaders(bool throwing) {
   uploadUniforms();
 }
 
+void Application::advanceClock(double wall_time) {
+  if (!m_simulating) {
+    runSteps(wall_time);
+  }
+}
+
+void Application::startSimulationThread() {
+  if (m_simulating) {
+    return;
+  }
+  m_simulating = true;
+  m_simulation_thread = std::thread{[this]() {
+    while (m_simulating) {
+      // glfw allows reading the time from any thread
+      runSteps(glfwGetTime());
+      // once per tick, a deterministic clock then takes one step each time
+      std::this_thread::sleep_for(std::chrono::duration<double>{m_clock.tick()});
+    }
+  }};
+}
+
+void Application::stopSimulationThread() {
+  if (m_simulating) {
+    m_simulating = false;
+    m_simulation_thread.join();
+  }
+}
+
+void Application::runSteps(double wall_time) {
+  std::lock_guard<std::mutex> lock{m_clock_mutex};
+  std::size_t const num_steps = m_clock.advance(wall_time);
+  for (std::size_t i = 0; i < num_steps; ++i) {
+    simulate(m_clock.step());
+  }
+  if (num_steps > 0) {
+    publish(wall_time);
+  }
+}
+
 // update shader uniform locations
 void Application::updateUniformLocations() {
   for (auto& pair : m_shaders) {
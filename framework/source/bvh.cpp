@@ -0,0 +1,411 @@
+#include "bvh.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+// bins along each axis when searching for the cheapest split
+static std::size_t const num_bins = 16;
+
+bvh::bvh(std::size_t max_leaf_size, float rebuild_ratio)
+ :max_leaf_size_{max_leaf_size}
+ ,rebuild_ratio_{rebuild_ratio}
+ ,spheres_{}
+ ,items_{}
+ ,nodes_{}
+ ,build_cost_{0.0f}
+ ,builds_{0}
+{
+  if (max_leaf_size_ == 0) {
+    throw std::logic_error("bvh: leaves must hold at least one sphere");
+  }
+  if (rebuild_ratio_ < 1.0f) {
+    throw std::logic_error("bvh: rebuild ratio must be at least 1");
+  }
+}
+
+void bvh::build(std::vector<glm::fvec4> const& spheres) {
+  if (spheres.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::logic_error("bvh: too many spheres");
+  }
+  spheres_ = spheres;
+  items_.resize(spheres_.size());
+  for (std::size_t i = 0; i < items_.size(); ++i) {
+    items_[i] = std::uint32_t(i);
+  }
+  nodes_.clear();
+  ++builds_;
+  if (spheres_.empty()) {
+    build_cost_ = 0.0f;
+    return;
+  }
+  // a binary tree with one item per leaf has fewer than two nodes per item
+  nodes_.reserve(2 * (spheres_.size() / max_leaf_size_ + 1));
+  nodes_.push_back(node{});
+  split(0, 0, items_.size());
+  build_cost_ = cost();
+}
+
+void bvh::update(std::vector<glm::fvec4> const& spheres) {
+  if (spheres.size() != spheres_.size()) {
+    build(spheres);
+    return;
+  }
+  spheres_ = spheres;
+  refit();
+  if (cost() > build_cost_ * rebuild_ratio_) {
+    build(spheres);
+  }
+}
+
+void bvh::split(std::size_t node_index, std::size_t first, std::size_t count) {
+  // recursion goes as deep as the tree, which the heuristic keeps shallow
+  box bounds = sphere_box(spheres_[items_[first]]);
+  box centroids{glm::fvec3{spheres_[items_[first]]}, glm::fvec3{spheres_[items_[first]]}};
+  for (std::size_t i = first + 1; i < first + count; ++i) {
+    glm::fvec4 const& sphere = spheres_[items_[i]];
+    bounds = merge(bounds, sphere_box(sphere));
+    centroids = merge(centroids, box{glm::fvec3{sphere}, glm::fvec3{sphere}});
+  }
+  nodes_[node_index].bounds = bounds;
+  nodes_[node_index].first = std::uint32_t(first);
+  nodes_[node_index].count = std::uint32_t(count);
+  if (count == 1) {
+    return;
+  }
+
+  // cheapest split between bins of the centroids, traversing a node costs
+  // as much as testing one sphere
+  float best_cost = std::numeric_limits<float>::max();
+  int best_axis = 0;
+  std::size_t best_bin = 0;
+  glm::fvec3 const extent = centroids.high - centroids.low;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (extent[axis] <= 0.0f) {
+      continue;
+    }
+    float const scale = float(num_bins) / extent[axis];
+    std::array<box, num_bins> bin_bounds{};
+    std::array<std::size_t, num_bins> bin_counts{};
+    for (std::size_t i = first; i < first + count; ++i) {
+      glm::fvec4 const& sphere = spheres_[items_[i]];
+      std::size_t const bin = std::min(num_bins - 1, std::size_t((sphere[axis] - centroids.low[axis]) * scale));
+      bin_bounds[bin] = bin_counts[bin] == 0 ? sphere_box(sphere) : merge(bin_bounds[bin], sphere_box(sphere));
+      ++bin_counts[bin];
+    }
+    // areas of all bins left of each split, then right of it
+    std::array<float, num_bins> left_costs{};
+    box left_bounds{};
+    std::size_t left_count = 0;
+    for (std::size_t bin = 0; bin + 1 < num_bins; ++bin) {
+      if (bin_counts[bin] > 0) {
+        left_bounds = left_count == 0 ? bin_bounds[bin] : merge(left_bounds, bin_bounds[bin]);
+        left_count += bin_counts[bin];
+      }
+      left_costs[bin] = left_count == 0 ? 0.0f : area(left_bounds) * float(left_count);
+    }
+    box right_bounds{};
+    std::size_t right_count = 0;
+    for (std::size_t bin = num_bins - 1; bin > 0; --bin) {
+      if (bin_counts[bin] > 0) {
+        right_bounds = right_count == 0 ? bin_bounds[bin] : merge(right_bounds, bin_bounds[bin]);
+        right_count += bin_counts[bin];
+      }
+      if (right_count == 0 || right_count == count) {
+        continue;
+      }
+      float const split_cost = left_costs[bin - 1] + area(right_bounds) * float(right_count);
+      if (split_cost < best_cost) {
+        best_cost = split_cost;
+        best_axis = axis;
+        best_bin = bin;
+      }
+    }
+  }
+
+  std::size_t left_count = 0;
+  float const leaf_cost = area(bounds) * float(count);
+  float const parent_area = area(bounds);
+  if (best_cost < std::numeric_limits<float>::max()) {
+    // small nodes stay leaves if splitting does not pay off
+    if (count <= max_leaf_size_ && parent_area + best_cost >= leaf_cost) {
+      return;
+    }
+    float const scale = float(num_bins) / extent[best_axis];
+    auto const middle = std::partition(items_.begin() + long(first), items_.begin() + long(first + count),
+                                       [&](std::uint32_t id) {
+      std::size_t const bin = std::min(num_bins - 1, std::size_t((spheres_[id][best_axis] - centroids.low[best_axis]) * scale));
+      return bin < best_bin;
+    });
+    left_count = std::size_t(middle - (items_.begin() + long(first)));
+  }
+  else {
+    // all centroids coincide, halve the items
+    if (count <= max_leaf_size_) {
+      return;
+    }
+    left_count = count / 2;
+  }
+
+  std::size_t const left = nodes_.size();
+  nodes_[node_index].first = std::uint32_t(left);
+  nodes_[node_index].count = 0;
+  nodes_.push_back(node{});
+  nodes_.push_back(node{});
+  split(left, first, left_count);
+  split(left + 1, first + left_count, count - left_count);
+}
+
+void bvh::refit() {
+  // children are stored behind their parents
+  for (std::size_t i = nodes_.size(); i > 0; --i) {
+    node& current = nodes_[i - 1];
+    if (current.count > 0) {
+      current.bounds = sphere_box(spheres_[items_[current.first]]);
+      for (std::size_t item = current.first + 1; item < current.first + current.count; ++item) {
+        current.bounds = merge(current.bounds, sphere_box(spheres_[items_[item]]));
+      }
+    }
+    else {
+      current.bounds = merge(nodes_[current.first].bounds, nodes_[current.first + 1].bounds);
+    }
+  }
+}
+
+bool bvh::raycast(glm::fvec3 const& origin, glm::fvec3 const& direction,
+                  std::size_t& id, float& distance) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+  glm::fvec3 const unit = glm::normalize(direction);
+  glm::fvec3 const inverse = 1.0f / unit;
+  float closest = std::numeric_limits<float>::max();
+  bool hit = false;
+
+  // distance at which the ray enters the box, or infinity if it misses
+  auto const entry = [&](box const& bounds) {
+    glm::fvec3 const t0 = (bounds.low - origin) * inverse;
+    glm::fvec3 const t1 = (bounds.high - origin) * inverse;
+    glm::fvec3 const near = glm::min(t0, t1);
+    glm::fvec3 const far = glm::max(t0, t1);
+    float const enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float const leave = std::min(std::min(far.x, far.y), far.z);
+    return enter <= leave ? enter : std::numeric_limits<float>::infinity();
+  };
+
+  std::vector<std::pair<float, std::uint32_t>> stack{{entry(nodes_[0].bounds), 0}};
+  while (!stack.empty()) {
+    std::pair<float, std::uint32_t> const top = stack.back();
+    stack.pop_back();
+    if (top.first >= closest) {
+      continue;
+    }
+    node const& current = nodes_[top.second];
+    if (current.count > 0) {
+      for (std::size_t item = current.first; item < current.first + current.count; ++item) {
+        glm::fvec4 const& sphere = spheres_[items_[item]];
+        glm::fvec3 const offset = origin - glm::fvec3{sphere};
+        float const b = glm::dot(offset, unit);
+        float const discriminant = b * b - glm::dot(offset, offset) + sphere.w * sphere.w;
+        if (discriminant < 0.0f) {
+          continue;
+        }
+        // the far intersection counts if the origin lies inside
+        float t = -b - std::sqrt(discriminant);
+        if (t < 0.0f) {
+          t = -b + std::sqrt(discriminant);
+        }
+        if (t >= 0.0f && t < closest) {
+          closest = t;
+          id = items_[item];
+          hit = true;
+        }
+      }
+      continue;
+    }
+    // visit the closer child first by pushing it last
+    float const left = entry(nodes_[current.first].bounds);
+    float const right = entry(nodes_[current.first + 1].bounds);
+    if (left <= right) {
+      stack.emplace_back(right, current.first + 1);
+      stack.emplace_back(left, current.first);
+    }
+    else {
+      stack.emplace_back(left, current.first);
+      stack.emplace_back(right, current.first + 1);
+    }
+  }
+  distance = closest;
+  return hit;
+}
+
+void bvh::overlap(glm::fvec4 const& sphere, std::vector<std::size_t>& ids) const {
+  ids.clear();
+  if (nodes_.empty()) {
+    return;
+  }
+  glm::fvec3 const center{sphere};
+  std::vector<std::uint32_t> stack{0};
+  while (!stack.empty()) {
+    node const& current = nodes_[stack.back()];
+    stack.pop_back();
+    if (distance2(current.bounds, center) > sphere.w * sphere.w) {
+      continue;
+    }
+    if (current.count > 0) {
+      for (std::size_t item = current.first; item < current.first + current.count; ++item) {
+        glm::fvec4 const& other = spheres_[items_[item]];
+        float const reach = sphere.w + other.w;
+        glm::fvec3 const offset = glm::fvec3{other} - center;
+        if (glm::dot(offset, offset) <= reach * reach) {
+          ids.push_back(items_[item]);
+        }
+      }
+    }
+    else {
+      stack.push_back(current.first);
+      stack.push_back(current.first + 1);
+    }
+  }
+}
+
+void bvh::frustum(std::array<glm::fvec4, 6> const& planes, std::vector<std::size_t>& ids) const {
+  ids.clear();
+  if (nodes_.empty()) {
+    return;
+  }
+  // nodes inside all planes need no further tests below them
+  std::vector<std::pair<std::uint32_t, bool>> stack{{0, false}};
+  while (!stack.empty()) {
+    std::pair<std::uint32_t, bool> const top = stack.back();
+    stack.pop_back();
+    node const& current = nodes_[top.first];
+    bool inside = top.second;
+    if (!inside) {
+      bool outside = false;
+      inside = true;
+      for (glm::fvec4 const& plane : planes) {
+        glm::fvec3 const normal{plane};
+        // corners furthest along and against the normal
+        glm::fvec3 const positive{normal.x > 0.0f ? current.bounds.high.x : current.bounds.low.x,
+                                  normal.y > 0.0f ? current.bounds.high.y : current.bounds.low.y,
+                                  normal.z > 0.0f ? current.bounds.high.z : current.bounds.low.z};
+        glm::fvec3 const negative{normal.x > 0.0f ? current.bounds.low.x : current.bounds.high.x,
+                                  normal.y > 0.0f ? current.bounds.low.y : current.bounds.high.y,
+                                  normal.z > 0.0f ? current.bounds.low.z : current.bounds.high.z};
+        if (glm::dot(normal, positive) + plane.w < 0.0f) {
+          outside = true;
+          break;
+        }
+        inside = inside && glm::dot(normal, negative) + plane.w >= 0.0f;
+      }
+      if (outside) {
+        continue;
+      }
+    }
+    if (current.count > 0) {
+      for (std::size_t item = current.first; item < current.first + current.count; ++item) {
+        glm::fvec4 const& sphere = spheres_[items_[item]];
+        bool visible = true;
+        for (std::size_t i = 0; i < planes.size() && visible && !inside; ++i) {
+          visible = glm::dot(glm::fvec3{planes[i]}, glm::fvec3{sphere}) + planes[i].w >= -sphere.w;
+        }
+        if (visible) {
+          ids.push_back(items_[item]);
+        }
+      }
+    }
+    else {
+      stack.emplace_back(current.first, inside);
+      stack.emplace_back(current.first + 1, inside);
+    }
+  }
+}
+
+void bvh::nearest(glm::fvec3 const& point, std::size_t k, std::vector<std::size_t>& ids) const {
+  ids.clear();
+  if (nodes_.empty() || k == 0) {
+    return;
+  }
+  typedef std::pair<float, std::uint32_t> entry;
+  // nodes by the distance to their box, closest on top
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> nodes{};
+  // best spheres so far, furthest on top
+  std::priority_queue<entry> found{};
+  nodes.emplace(std::sqrt(distance2(nodes_[0].bounds, point)), 0);
+  while (!nodes.empty()) {
+    entry const top = nodes.top();
+    nodes.pop();
+    // boxes contain their spheres, so no closer sphere remains
+    if (found.size() == k && top.first >= found.top().first) {
+      break;
+    }
+    node const& current = nodes_[top.second];
+    if (current.count > 0) {
+      for (std::size_t item = current.first; item < current.first + current.count; ++item) {
+        glm::fvec4 const& sphere = spheres_[items_[item]];
+        float const distance = std::max(0.0f, glm::length(point - glm::fvec3{sphere}) - sphere.w);
+        if (found.size() < k) {
+          found.emplace(distance, items_[item]);
+        }
+        else if (distance < found.top().first) {
+          found.pop();
+          found.emplace(distance, items_[item]);
+        }
+      }
+    }
+    else {
+      nodes.emplace(std::sqrt(distance2(nodes_[current.first].bounds, point)), current.first);
+      nodes.emplace(std::sqrt(distance2(nodes_[current.first + 1].bounds, point)), current.first + 1);
+    }
+  }
+  ids.resize(found.size());
+  for (std::size_t i = ids.size(); i > 0; --i) {
+    ids[i - 1] = found.top().second;
+    found.pop();
+  }
+}
+
+std::size_t bvh::size() const {
+  return spheres_.size();
+}
+
+float bvh::cost() const {
+  if (nodes_.empty()) {
+    return 0.0f;
+  }
+  float sum = 0.0f;
+  for (node const& current : nodes_) {
+    sum += area(current.bounds) * (current.count > 0 ? float(current.count) : 1.0f);
+  }
+  float const root_area = area(nodes_[0].bounds);
+  return root_area > 0.0f ? sum / root_area : float(spheres_.size());
+}
+
+std::size_t bvh::builds() const {
+  return builds_;
+}
+
+bvh::box bvh::sphere_box(glm::fvec4 const& sphere) {
+  glm::fvec3 const center{sphere};
+  return box{center - sphere.w, center + sphere.w};
+}
+
+bvh::box bvh::merge(box const& a, box const& b) {
+  return box{glm::min(a.low, b.low), glm::max(a.high, b.high)};
+}
+
+float bvh::area(box const& bounds) {
+  glm::fvec3 const size = bounds.high - bounds.low;
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+float bvh::distance2(box const& bounds, glm::fvec3 const& point) {
+  glm::fvec3 const offset = glm::max(bounds.low - point, glm::max(point - bounds.high, glm::fvec3{0.0f}));
+  return glm::dot(offset, offset);
+}
@@ -0,0 +1,280 @@
+#include "depth_pyramid.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// clip space w below which a point counts as behind the camera
+static float const min_w = 1e-5f;
+
+depth_pyramid::depth_pyramid(unsigned width, unsigned height, unsigned readback_width)
+ :width_{0}
+ ,height_{0}
+ ,readback_width_{std::max(readback_width, 1u)}
+ ,levels_{}
+ ,readback_level_{0}
+ ,texture_{0}
+ ,framebuffer_{0}
+ ,vertex_array_{0}
+ ,num_builds_{0}
+ ,view_projection_{}
+ ,pack_buffers_{0, 0}
+ ,fences_{nullptr, nullptr}
+ ,pack_builds_{0, 0}
+ ,pack_matrices_{}
+ ,next_buffer_{0}
+ ,readback_{}
+ ,readback_build_{0}
+ ,readback_matrix_{}
+{
+  glGenVertexArrays(1, &vertex_array_);
+  resize(width, height);
+}
+
+depth_pyramid::~depth_pyramid() {
+  delete_pyramid();
+  glDeleteVertexArrays(1, &vertex_array_);
+}
+
+void depth_pyramid::resize(unsigned width, unsigned height) {
+  delete_pyramid();
+  width_ = std::max(width, 1u);
+  height_ = std::max(height, 1u);
+  create_pyramid();
+}
+
+void depth_pyramid::build(GLuint depth_texture, GLuint program, glm::fmat4 const& view_projection) {
+  GLint previous_framebuffer = 0;
+  GLint previous_viewport[4] = {0, 0, 0, 0};
+  GLint previous_unit = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGetIntegerv(GL_VIEWPORT, previous_viewport);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &previous_unit);
+  GLboolean const depth_test = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_DEPTH_TEST);
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "source_Texture"), 0);
+  GLint const depth_location = glGetUniformLocation(program, "source_Depth");
+  GLint const size_location = glGetUniformLocation(program, "target_Size");
+  glActiveTexture(GL_TEXTURE0);
+  GLint previous_texture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glBindVertexArray(vertex_array_);
+
+  // each level reduces the one above, which alone may be sampled meanwhile
+  for (std::size_t level = 0; level < levels_.size(); ++level) {
+    if (level == 0) {
+      glBindTexture(GL_TEXTURE_2D, depth_texture);
+      glUniform1i(depth_location, 1);
+    }
+    else {
+      glBindTexture(GL_TEXTURE_2D, texture_);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(level - 1));
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(level - 1));
+      glUniform1i(depth_location, 0);
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, GLint(level));
+    glViewport(0, 0, GLsizei(levels_[level].x), GLsizei(levels_[level].y));
+    glUniform2i(size_location, GLint(levels_[level].x), GLint(levels_[level].y));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(levels_.size() - 1));
+  ++num_builds_;
+  view_projection_ = view_projection;
+
+  // unresolved frame in this buffer is dropped
+  if (fences_[next_buffer_]) {
+    glDeleteSync(fences_[next_buffer_]);
+  }
+  glm::uvec2 const size = levels_[readback_level_];
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, GLint(readback_level_));
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffers_[next_buffer_]);
+  glReadPixels(0, 0, GLsizei(size.x), GLsizei(size.y), GL_RG, GL_FLOAT, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  fences_[next_buffer_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+  pack_builds_[next_buffer_] = num_builds_;
+  pack_matrices_[next_buffer_] = view_projection;
+  next_buffer_ = (next_buffer_ + 1) % 2;
+
+  glBindTexture(GL_TEXTURE_2D, GLuint(previous_texture));
+  glActiveTexture(GLenum(previous_unit));
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer));
+  glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+  if (depth_test == GL_TRUE) {
+    glEnable(GL_DEPTH_TEST);
+  }
+}
+
+void depth_pyramid::resolve() {
+  // the buffer written next holds the oldest frame
+  GLsync& fence = fences_[next_buffer_];
+  if (!fence) {
+    return;
+  }
+  // dont stall, try again next frame
+  GLenum status = glClientWaitSync(fence, GL_NONE_BIT, 0);
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+
+  glm::uvec2 const size = levels_[readback_level_];
+  std::size_t const num_texels = std::size_t(size.x) * std::size_t(size.y);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffers_[next_buffer_]);
+  void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(num_texels * sizeof(glm::fvec2)),
+                                  GL_MAP_READ_BIT);
+  if (!mapped) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    throw std::runtime_error("depth_pyramid: mapping of pack buffer failed");
+  }
+  glm::fvec2 const* texels = static_cast<glm::fvec2 const*>(mapped);
+  readback_.assign(texels, texels + num_texels);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  readback_build_ = pack_builds_[next_buffer_];
+  readback_matrix_ = pack_matrices_[next_buffer_];
+}
+
+GLuint depth_pyramid::texture() const {
+  return texture_;
+}
+
+std::size_t depth_pyramid::num_levels() const {
+  return levels_.size();
+}
+
+bool depth_pyramid::built() const {
+  return num_builds_ > 0;
+}
+
+glm::fmat4 const& depth_pyramid::view_projection() const {
+  return view_projection_;
+}
+
+std::size_t depth_pyramid::readback_age() const {
+  return readback_.empty() ? 0 : num_builds_ - readback_build_;
+}
+
+bool depth_pyramid::visible(glm::fvec4 const& sphere) const {
+  if (readback_.empty()) {
+    return true;
+  }
+  // screen bounds of the corners of the box around the sphere
+  glm::fvec3 low{std::numeric_limits<float>::max()};
+  glm::fvec3 high{-std::numeric_limits<float>::max()};
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::fvec3 const offset{corner & 1 ? sphere.w : -sphere.w, corner & 2 ? sphere.w : -sphere.w, corner & 4 ? sphere.w : -sphere.w};
+    glm::fvec4 const clip = readback_matrix_ * glm::fvec4{glm::fvec3{sphere} + offset, 1.0f};
+    // reaching behind the camera, assume it covers the view
+    if (clip.w <= min_w) {
+      return true;
+    }
+    glm::fvec3 const ndc = glm::fvec3{clip} / clip.w;
+    low = glm::min(low, ndc);
+    high = glm::max(high, ndc);
+  }
+  // nothing is known about the depth outside of the read back view
+  if (low.x < -1.0f || high.x > 1.0f || low.y < -1.0f || high.y > 1.0f || low.z > 1.0f) {
+    return true;
+  }
+
+  // one texel of level 0 around, depth was only sampled at pixel centers
+  glm::uvec2 const size = levels_[readback_level_];
+  float const margin_x = 1.0f / float(levels_.front().x);
+  float const margin_y = 1.0f / float(levels_.front().y);
+  int const low_x = std::max(0, int(std::floor((low.x * 0.5f + 0.5f - margin_x) * float(size.x))));
+  int const low_y = std::max(0, int(std::floor((low.y * 0.5f + 0.5f - margin_y) * float(size.y))));
+  int const high_x = std::min(int(size.x) - 1, int(std::ceil((high.x * 0.5f + 0.5f + margin_x) * float(size.x))) - 1);
+  int const high_y = std::min(int(size.y) - 1, int(std::ceil((high.y * 0.5f + 0.5f + margin_y) * float(size.y))) - 1);
+  float const nearest = low.z * 0.5f + 0.5f;
+  for (int y = low_y; y <= high_y; ++y) {
+    glm::fvec2 const* row = readback_.data() + std::size_t(y) * size.x;
+    for (int x = low_x; x <= high_x; ++x) {
+      if (row[x].y >= nearest) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void depth_pyramid::create_pyramid() {
+  // halve until a single texel, odd sizes round up
+  glm::uvec2 size{(width_ + 1) / 2, (height_ + 1) / 2};
+  levels_.push_back(size);
+  while (size.x > 1 || size.y > 1) {
+    size = glm::uvec2{(size.x + 1) / 2, (size.y + 1) / 2};
+    levels_.push_back(size);
+  }
+  readback_level_ = 0;
+  while (levels_[readback_level_].x > readback_width_ && readback_level_ + 1 < levels_.size()) {
+    ++readback_level_;
+  }
+
+  GLint previous_texture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture);
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GLint(GL_NEAREST));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GLint(GL_NEAREST));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GLint(GL_CLAMP_TO_EDGE));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GLint(GL_CLAMP_TO_EDGE));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(levels_.size() - 1));
+  for (std::size_t level = 0; level < levels_.size(); ++level) {
+    glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RG32F, GLsizei(levels_[level].x), GLsizei(levels_[level].y), 0,
+                 GL_RG, GL_FLOAT, NULL);
+  }
+  glBindTexture(GL_TEXTURE_2D, GLuint(previous_texture));
+
+  GLint previous_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+  GLenum const status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("depth_pyramid: framebuffer is incomplete");
+  }
+
+  glm::uvec2 const readback_size = levels_[readback_level_];
+  glGenBuffers(2, pack_buffers_);
+  for (GLuint buffer : pack_buffers_) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(std::size_t(readback_size.x) * readback_size.y * sizeof(glm::fvec2)),
+                 NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void depth_pyramid::delete_pyramid() {
+  if (framebuffer_ == 0) {
+    return;
+  }
+  for (GLsync& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  glDeleteBuffers(2, pack_buffers_);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteTextures(1, &texture_);
+  framebuffer_ = 0;
+  levels_.clear();
+  readback_.clear();
+  num_builds_ = 0;
+}
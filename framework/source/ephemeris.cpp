@@ -0,0 +1,194 @@
+#include "ephemeris.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static char const MAGIC[4] = {'E', 'P', 'H', 'M'};
+static std::uint32_t const VERSION = 1;
+static double const pi = 3.141592653589793;
+
+// fields at the start of the file, the coefficients follow segment by segment
+struct ephemeris_header {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t num_bodies;
+  std::uint32_t degree;
+  std::uint64_t num_segments;
+  double start;
+  double segment_length;
+  std::uint64_t key;
+};
+
+ephemeris::ephemeris(std::size_t num_bodies, double start, double end, double segment_length,
+                     std::size_t degree, sampler const& positions, std::uint64_t key)
+ :num_bodies_{num_bodies}
+ ,degree_{degree}
+ ,num_segments_{0}
+ ,start_{start}
+ ,segment_length_{segment_length}
+ ,key_{key}
+ ,fitted_{}
+ ,mapping_{}
+ ,coefficients_{nullptr}
+{
+  if (!(segment_length > 0.0) || !(end > start)) {
+    throw std::logic_error("ephemeris: the range and the segments must not be empty");
+  }
+  num_segments_ = std::size_t(std::ceil((end - start) / segment_length));
+
+  // samples at the chebyshev nodes of each segment, the coefficients are
+  // their discrete cosine transform
+  std::size_t const num_nodes = degree + 1;
+  std::size_t const series = 3 * num_nodes;
+  fitted_.resize(num_segments_ * num_bodies * series);
+  std::vector<std::vector<glm::fvec3>> samples(num_nodes);
+  for (std::size_t segment = 0; segment < num_segments_; ++segment) {
+    double const segment_start = start + double(segment) * segment_length;
+    for (std::size_t node = 0; node < num_nodes; ++node) {
+      double const u = std::cos(pi * (double(node) + 0.5) / double(num_nodes));
+      positions(segment_start + 0.5 * (u + 1.0) * segment_length, samples[node]);
+      if (samples[node].size() != num_bodies) {
+        throw std::logic_error("ephemeris: sampler returned a wrong number of bodies");
+      }
+    }
+
+    for (std::size_t body = 0; body < num_bodies; ++body) {
+      float* coefficients = &fitted_[(segment * num_bodies + body) * series];
+      for (int axis = 0; axis < 3; ++axis) {
+        for (std::size_t j = 0; j < num_nodes; ++j) {
+          double sum = 0.0;
+          for (std::size_t node = 0; node < num_nodes; ++node) {
+            sum += double(samples[node][body][axis]) *
+                   std::cos(pi * double(j) * (double(node) + 0.5) / double(num_nodes));
+          }
+          // the constant term counts half
+          coefficients[std::size_t(axis) * num_nodes + j] = float(sum * (j == 0 ? 1.0 : 2.0) / double(num_nodes));
+        }
+      }
+    }
+  }
+  coefficients_ = fitted_.data();
+}
+
+ephemeris::ephemeris(std::string const& file_name)
+ :num_bodies_{0}
+ ,degree_{0}
+ ,num_segments_{0}
+ ,start_{0.0}
+ ,segment_length_{1.0}
+ ,key_{0}
+ ,fitted_{}
+ ,mapping_{}
+ ,coefficients_{nullptr}
+{
+  std::size_t file_size = 0;
+  mapping_ = utils::map_file(file_name, file_size);
+
+  ephemeris_header header{};
+  if (file_size < sizeof(header)) {
+    throw std::runtime_error("ephemeris: " + file_name + " is truncated");
+  }
+  std::memcpy(&header, mapping_.get(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+    throw std::runtime_error("ephemeris: " + file_name + " is no ephemeris");
+  }
+  num_bodies_ = header.num_bodies;
+  degree_ = header.degree;
+  num_segments_ = std::size_t(header.num_segments);
+  start_ = header.start;
+  segment_length_ = header.segment_length;
+  key_ = header.key;
+  if (num_segments_ == 0 || !(segment_length_ > 0.0)) {
+    throw std::runtime_error("ephemeris: " + file_name + " has an invalid layout");
+  }
+  if (file_size < sizeof(header) + num_segments_ * num_bodies_ * 3 * (degree_ + 1) * sizeof(float)) {
+    throw std::runtime_error("ephemeris: " + file_name + " is truncated");
+  }
+  // the header keeps the coefficients aligned
+  coefficients_ = reinterpret_cast<float const*>(mapping_.get() + sizeof(header));
+}
+
+void ephemeris::write(std::string const& file_name) const {
+  ephemeris_header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.num_bodies = std::uint32_t(num_bodies_);
+  header.degree = std::uint32_t(degree_);
+  header.num_segments = num_segments_;
+  header.start = start_;
+  header.segment_length = segment_length_;
+  header.key = key_;
+
+  std::string const temp_name = file_name + ".tmp";
+  {
+    std::ofstream file{temp_name, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error("ephemeris: cannot write " + temp_name);
+    }
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(coefficients_),
+               std::streamsize(num_segments_ * num_bodies_ * 3 * (degree_ + 1) * sizeof(float)));
+    if (!file) {
+      throw std::runtime_error("ephemeris: writing " + temp_name + " failed");
+    }
+  }
+  std::remove(file_name.c_str());
+  if (std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+    throw std::runtime_error("ephemeris: cannot replace " + file_name);
+  }
+}
+
+std::size_t ephemeris::num_bodies() const {
+  return num_bodies_;
+}
+
+std::size_t ephemeris::degree() const {
+  return degree_;
+}
+
+double ephemeris::start() const {
+  return start_;
+}
+
+double ephemeris::end() const {
+  return start_ + double(num_segments_) * segment_length_;
+}
+
+double ephemeris::segment_length() const {
+  return segment_length_;
+}
+
+std::uint64_t ephemeris::key() const {
+  return key_;
+}
+
+void ephemeris::evaluate(double time, std::vector<glm::fvec3>& positions) const {
+  positions.resize(num_bodies_);
+  double const offset = (time - start_) / segment_length_;
+  std::size_t const segment = std::size_t(std::min(std::max(std::floor(offset), 0.0), double(num_segments_ - 1)));
+  // position within the segment from -1 to 1
+  float const u = float(std::min(std::max(2.0 * (offset - double(segment)) - 1.0, -1.0), 1.0));
+
+  // clenshaw recurrence, two multiply-adds per coefficient and axis
+  std::size_t const num_nodes = degree_ + 1;
+  float const* coefficients = coefficients_ + segment * num_bodies_ * 3 * num_nodes;
+  for (std::size_t body = 0; body < num_bodies_; ++body) {
+    for (int axis = 0; axis < 3; ++axis) {
+      float const* c = coefficients + (body * 3 + std::size_t(axis)) * num_nodes;
+      float b1 = 0.0f;
+      float b2 = 0.0f;
+      for (std::size_t j = degree_; j > 0; --j) {
+        float const b0 = 2.0f * u * b1 - b2 + c[j];
+        b2 = b1;
+        b1 = b0;
+      }
+      positions[body][axis] = u * b1 - b2 + c[0];
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#include "frame_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// wall time a frame counts at most, longer stalls do not catch up
+static double const max_frame_time = 0.25;
+
+frame_clock::frame_clock(double tick, std::size_t max_ticks)
+ :tick_{tick}
+ ,max_ticks_{max_ticks}
+ ,scale_{1.0}
+ ,paused_{false}
+ ,deterministic_{false}
+ ,frame_time_{1.0 / 60.0}
+ ,last_wall_time_{-1.0}
+ ,accumulator_{0.0}
+ ,step_{tick}
+ // one step ahead, so the first frame renders time 0
+ ,time_{tick}
+ ,steps_{0}
+{
+  if (!(tick > 0.0) || max_ticks == 0) {
+    throw std::logic_error("frame_clock: ticks must be positive and at least one per frame");
+  }
+}
+
+std::size_t frame_clock::advance(double wall_time) {
+  double frame_time = 0.0;
+  if (last_wall_time_ >= 0.0) {
+    frame_time = deterministic_ ? frame_time_ : std::min(std::max(wall_time - last_wall_time_, 0.0), max_frame_time);
+  }
+  last_wall_time_ = wall_time;
+  if (paused_) {
+    return 0;
+  }
+
+  accumulator_ += frame_time * scale_;
+  std::size_t num_steps = std::size_t(std::floor(accumulator_ / tick_));
+  if (num_steps == 0) {
+    return 0;
+  }
+  if (num_steps <= max_ticks_) {
+    step_ = tick_;
+    accumulator_ -= double(num_steps) * tick_;
+  }
+  else {
+    // sub-steps of the whole due time instead of falling behind
+    num_steps = max_ticks_;
+    step_ = accumulator_ / double(num_steps);
+    accumulator_ = 0.0;
+  }
+  time_ += double(num_steps) * step_;
+  steps_ += num_steps;
+  return num_steps;
+}
+
+double frame_clock::step() const {
+  return step_;
+}
+
+double frame_clock::tick() const {
+  return tick_;
+}
+
+double frame_clock::time() const {
+  return time_;
+}
+
+double frame_clock::previous_time() const {
+  return time_ - step_;
+}
+
+double frame_clock::interpolation() const {
+  return std::min(accumulator_ / step_, 1.0);
+}
+
+double frame_clock::render_time() const {
+  return previous_time() + interpolation() * step_;
+}
+
+std::uint64_t frame_clock::steps() const {
+  return steps_;
+}
+
+void frame_clock::set_scale(double scale) {
+  if (!(scale >= 0.0)) {
+    throw std::logic_error("frame_clock: the time scale must not be negative");
+  }
+  scale_ = scale;
+}
+
+double frame_clock::scale() const {
+  return scale_;
+}
+
+void frame_clock::set_paused(bool paused) {
+  paused_ = paused;
+}
+
+bool frame_clock::paused() const {
+  return paused_;
+}
+
+void frame_clock::set_deterministic(bool deterministic, double frame_time) {
+  deterministic_ = deterministic;
+  frame_time_ = frame_time;
+}
+
+bool frame_clock::deterministic() const {
+  return deterministic_;
+}
+
+void frame_clock::seek(double time) {
+  accumulator_ = 0.0;
+  time_ = time + step_;
+}
@@ -0,0 +1,117 @@
+#include "frustum_culling.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace frustum_culling {
+
+void sphere_list::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  radius.clear();
+}
+
+void sphere_list::push_back(glm::fvec4 const& sphere) {
+  x.push_back(sphere.x);
+  y.push_back(sphere.y);
+  z.push_back(sphere.z);
+  radius.push_back(sphere.w);
+}
+
+std::size_t sphere_list::size() const {
+  return radius.size();
+}
+
+std::size_t test(std::array<glm::fvec4, 6> const& planes,
+                 sphere_list const& spheres,
+                 std::vector<std::uint8_t>& visible) {
+  std::size_t const count = spheres.size();
+  visible.resize(count);
+  std::size_t num_visible = 0;
+
+  // a sphere is outside once its center lies further than its radius behind
+  // any of the planes
+  std::size_t i = 0;
+#if defined(__AVX__)
+  for (; i + 8 <= count; i += 8) {
+    __m256 const x = _mm256_loadu_ps(spheres.x.data() + i);
+    __m256 const y = _mm256_loadu_ps(spheres.y.data() + i);
+    __m256 const z = _mm256_loadu_ps(spheres.z.data() + i);
+    __m256 const negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius.data() + i));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (glm::fvec4 const& plane : planes) {
+      __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x), _mm256_set1_ps(plane.w));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), y));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), z));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+    }
+    int const mask = _mm256_movemask_ps(inside);
+    for (std::size_t lane = 0; lane < 8; ++lane) {
+      visible[i + lane] = std::uint8_t((mask >> lane) & 1);
+      num_visible += visible[i + lane];
+    }
+  }
+#endif
+#if defined(__SSE__)
+  for (; i + 4 <= count; i += 4) {
+    __m128 const x = _mm_loadu_ps(spheres.x.data() + i);
+    __m128 const y = _mm_loadu_ps(spheres.y.data() + i);
+    __m128 const z = _mm_loadu_ps(spheres.z.data() + i);
+    __m128 const negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius.data() + i));
+    __m128 inside = _mm_cmpeq_ps(x, x);
+    for (glm::fvec4 const& plane : planes) {
+      __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_set1_ps(plane.w));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), y));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+    }
+    int const mask = _mm_movemask_ps(inside);
+    for (std::size_t lane = 0; lane < 4; ++lane) {
+      visible[i + lane] = std::uint8_t((mask >> lane) & 1);
+      num_visible += visible[i + lane];
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    bool inside = true;
+    for (glm::fvec4 const& plane : planes) {
+      float const distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+      inside = inside && distance >= -spheres.radius[i];
+    }
+    visible[i] = inside ? 1 : 0;
+    num_visible += visible[i];
+  }
+  return num_visible;
+}
+
+glm::fvec4 transform(glm::fmat4 const& matrix, glm::fvec4 const& sphere) {
+  glm::fvec4 const center = matrix * glm::fvec4{glm::fvec3{sphere}, 1.0f};
+  float const scale = std::max(glm::length(glm::fvec3{matrix[0]}),
+                               std::max(glm::length(glm::fvec3{matrix[1]}), glm::length(glm::fvec3{matrix[2]})));
+  return glm::fvec4{glm::fvec3{center}, sphere.w * scale};
+}
+
+glm::fvec4 merge(glm::fvec4 const& a, glm::fvec4 const& b) {
+  glm::fvec3 const offset = glm::fvec3{b} - glm::fvec3{a};
+  float const distance = glm::length(offset);
+  // one sphere contains the other
+  if (distance + b.w <= a.w) {
+    return a;
+  }
+  if (distance + a.w <= b.w) {
+    return b;
+  }
+  float const radius = (distance + a.w + b.w) * 0.5f;
+  glm::fvec3 const center = glm::fvec3{a} + offset * ((radius - a.w) / distance);
+  return glm::fvec4{center, radius};
+}
+
+}
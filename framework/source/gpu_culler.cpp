@@ -0,0 +1,203 @@
+#include "gpu_culler.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/functions.h>
+#include <glbinding/gl/bitfield.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// invocations per work group in shaders/gpu_cull.comp
+static GLuint const group_size = 64;
+
+GLuint const gpu_culler::no_group;
+
+bool gpu_culler::supported() {
+  if (!utils::supports_version(4, 3)) {
+    return false;
+  }
+  // the draws read the bodies in the vertex shader, which gl 4.3 allows
+  // to have no storage buffers at all
+  GLint vertex_blocks = 0;
+  glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertex_blocks);
+  return vertex_blocks > 0;
+}
+
+gpu_culler::gpu_culler(std::size_t max_bodies, std::size_t num_groups)
+ :max_bodies_{max_bodies}
+ ,num_groups_{num_groups}
+ ,bodies_{}
+ ,changed_{}
+ ,num_bodies_{0}
+ ,uploaded_bytes_{0}
+ ,body_buffer_{0}
+ ,command_buffer_{0}
+ ,group_buffer_{0}
+ ,count_buffer_{0}
+ ,id_buffer_{0}
+{
+  if (max_bodies_ == 0) {
+    throw std::logic_error("gpu culler needs space for at least one body");
+  }
+  bodies_.reserve(max_bodies_);
+  changed_.reserve(max_bodies_);
+
+  glGenBuffers(1, &body_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, body_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(max_bodies_ * sizeof(body)), NULL, GL_DYNAMIC_DRAW);
+
+  // commands are written by the gpu and only read for drawing
+  glGenBuffers(1, &command_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, command_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(max_bodies_ * command_bytes), NULL, GL_DYNAMIC_COPY);
+
+  // no group leaves an empty buffer, which cannot be bound
+  glGenBuffers(1, &group_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, group_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(std::max(num_groups_, std::size_t(1)) * max_bodies_ * command_bytes),
+               NULL, GL_DYNAMIC_COPY);
+
+  // visible and occluded bodies
+  GLuint const zeros[2] = {0, 0};
+  glGenBuffers(1, &count_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeros), zeros, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  std::vector<GLuint> ids(max_bodies_);
+  for (std::size_t id = 0; id < max_bodies_; ++id) {
+    ids[id] = GLuint(id);
+  }
+  glGenBuffers(1, &id_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, id_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(ids.size() * sizeof(GLuint)), ids.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+gpu_culler::~gpu_culler() {
+  glDeleteBuffers(1, &body_buffer_);
+  glDeleteBuffers(1, &command_buffer_);
+  glDeleteBuffers(1, &group_buffer_);
+  glDeleteBuffers(1, &count_buffer_);
+  glDeleteBuffers(1, &id_buffer_);
+}
+
+void gpu_culler::set_body(std::size_t id, glm::fmat4 const& model_matrix, glm::fvec4 const& sphere,
+                          GLuint group, GLuint layer, GLuint num_indices, GLuint first_index,
+                          GLint base_vertex) {
+  if (id >= max_bodies_) {
+    throw std::out_of_range("body " + std::to_string(id) + " exceeds the gpu culler");
+  }
+  if (group != no_group && group >= num_groups_) {
+    throw std::out_of_range("group " + std::to_string(group) + " exceeds the gpu culler");
+  }
+  if (id >= bodies_.size()) {
+    // new bodies draw nothing until they are set
+    bodies_.resize(id + 1, body{glm::fmat4{}, glm::fvec4{0.0f}, {0, 0, 0, no_group}, {0, 0, 0, 0}});
+    changed_.resize(id + 1, true);
+    num_bodies_ = id + 1;
+  }
+
+  body const record{model_matrix, sphere, {num_indices, first_index, GLuint(base_vertex), group},
+                    {layer, 0, 0, 0}};
+  if (std::memcmp(&record, &bodies_[id], sizeof(body)) != 0) {
+    bodies_[id] = record;
+    changed_[id] = true;
+  }
+}
+
+std::size_t gpu_culler::num_bodies() const {
+  return num_bodies_;
+}
+
+void gpu_culler::cull(GLuint program, std::array<glm::fvec4, 6> const& frustum) {
+  // upload runs of changed bodies
+  uploaded_bytes_ = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, body_buffer_);
+  for (std::size_t first = 0; first < num_bodies_;) {
+    if (!changed_[first]) {
+      ++first;
+      continue;
+    }
+    std::size_t last = first;
+    while (last < num_bodies_ && changed_[last]) {
+      changed_[last] = false;
+      ++last;
+    }
+    GLsizeiptr const bytes = GLsizeiptr((last - first) * sizeof(body));
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(first * sizeof(body)), bytes, &bodies_[first]);
+    uploaded_bytes_ += std::size_t(bytes);
+    first = last;
+  }
+
+  GLuint const zeros[2] = {0, 0};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeros), zeros);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, body_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, group_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, count_buffer_);
+
+  glUseProgram(program);
+  glUniform4fv(glGetUniformLocation(program, "frustum_Planes"), 6, glm::value_ptr(frustum[0]));
+  glUniform1ui(glGetUniformLocation(program, "body_Count"), GLuint(num_bodies_));
+  glUniform1ui(glGetUniformLocation(program, "group_Count"), GLuint(num_groups_));
+  glUniform1ui(glGetUniformLocation(program, "group_Stride"), GLuint(max_bodies_));
+  glDispatchCompute((GLuint(num_bodies_) + group_size - 1) / group_size, 1, 1);
+
+  // commands are read by draws, the count by buffer reads
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void gpu_culler::bind_body_ids(GLuint location) const {
+  glBindBuffer(GL_ARRAY_BUFFER, id_buffer_);
+  glEnableVertexAttribArray(location);
+  glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, 0, NULL);
+  // fetched at the base instance of each command
+  glVertexAttribDivisor(location, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void gpu_culler::draw_group(GLuint group, GLenum mode, GLenum index_type) const {
+  if (group >= num_groups_) {
+    throw std::out_of_range("group " + std::to_string(group) + " exceeds the gpu culler");
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, body_buffer_);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, group_buffer_);
+  glMultiDrawElementsIndirect(mode, index_type,
+                              reinterpret_cast<GLvoid const*>(group * max_bodies_ * command_bytes),
+                              GLsizei(num_bodies_), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+GLuint gpu_culler::command_buffer() const {
+  return command_buffer_;
+}
+
+std::size_t gpu_culler::visible_bodies() const {
+  GLuint count = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return std::size_t(count);
+}
+
+std::size_t gpu_culler::occluded_bodies() const {
+  GLuint count = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), sizeof(GLuint), &count);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return std::size_t(count);
+}
+
+std::size_t gpu_culler::uploaded_bytes() const {
+  return uploaded_bytes_;
+}
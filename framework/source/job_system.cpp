@@ -0,0 +1,469 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+
+// slots of a new deque, it grows when a worker spawns more at once
+static std::size_t const initial_capacity = 256;
+
+struct job_system::task {
+  std::function<void()> function;
+  affinity where;
+  // dependencies not finished yet, plus one while being submitted
+  std::atomic<std::size_t> remaining;
+  // guards done, continuations and error
+  std::mutex mutex;
+  std::atomic<bool> done;
+  std::vector<handle> continuations;
+  std::exception_ptr error;
+  // keeps the task alive while it is queued
+  handle self;
+};
+
+// chase-lev work-stealing deque, only the owning worker pushes and pops at
+// the bottom, any thread steals from the top
+// orderings follow le et al., "correct and efficient work-stealing for weak
+// memory models", with seq_cst accesses instead of fences
+class job_system::task_deque {
+ public:
+  task_deque()
+   :top_{0}
+   ,padding_{}
+   ,bottom_{0}
+   ,ring_{nullptr}
+   ,rings_{}
+  {
+    rings_.emplace_back(new ring{initial_capacity});
+    ring_ = rings_.back().get();
+  }
+
+  void push(task* pushed) {
+    std::int64_t const bottom = bottom_.load(std::memory_order_relaxed);
+    std::int64_t const top = top_.load(std::memory_order_acquire);
+    ring* current = ring_.load(std::memory_order_relaxed);
+    if (bottom - top > std::int64_t(current->mask)) {
+      // full, thieves may still read the old ring, so it is kept
+      rings_.emplace_back(new ring{2 * (current->mask + 1)});
+      ring* grown = rings_.back().get();
+      for (std::int64_t i = top; i < bottom; ++i) {
+        grown->at(i).store(current->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      ring_.store(grown, std::memory_order_release);
+      current = grown;
+    }
+    current->at(bottom).store(pushed, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_release);
+  }
+
+  task* pop() {
+    std::int64_t const bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    ring* current = ring_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    std::int64_t top = top_.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    task* popped = current->at(bottom).load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // last task, a thief may take it at the same time
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        popped = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return popped;
+  }
+
+  // nullptr when empty or another thread took the task first
+  task* steal() {
+    std::int64_t top = top_.load(std::memory_order_seq_cst);
+    std::int64_t const bottom = bottom_.load(std::memory_order_seq_cst);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    task* stolen = ring_.load(std::memory_order_acquire)->at(top).load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return stolen;
+  }
+
+ private:
+  struct ring {
+    explicit ring(std::size_t capacity)
+     :mask{capacity - 1}
+     ,slots{new std::atomic<task*>[capacity]}
+    {}
+
+    std::atomic<task*>& at(std::int64_t index) {
+      return slots[std::size_t(index) & mask];
+    }
+
+    std::size_t mask;
+    std::unique_ptr<std::atomic<task*>[]> slots;
+  };
+
+  std::atomic<std::int64_t> top_;
+  // apart, so thieves and the owner do not share a cache line
+  char padding_[64 - sizeof(std::atomic<std::int64_t>)];
+  std::atomic<std::int64_t> bottom_;
+  std::atomic<ring*> ring_;
+  // every ring used so far, written by the owner only
+  std::vector<std::unique_ptr<ring>> rings_;
+};
+
+struct job_system::worker {
+  job_system* owner;
+  std::size_t index;
+  task_deque tasks;
+};
+
+thread_local job_system::worker* job_system::current_ = nullptr;
+
+job_system::job_system(std::size_t num_workers)
+ :workers_{}
+ ,threads_{}
+ ,main_thread_{std::this_thread::get_id()}
+ ,mutex_{}
+ ,condition_{}
+ ,injected_{}
+ ,main_tasks_{}
+ ,queued_{0}
+ ,num_injected_{0}
+ ,sleeping_{0}
+ ,waiting_{0}
+ ,stop_{false}
+{
+  if (num_workers == 0) {
+    num_workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+  // all deques exist before any worker steals from them
+  for (std::size_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(new worker{this, i, {}});
+  }
+  for (auto& own : workers_) {
+    threads_.emplace_back(&job_system::work, this, own.get());
+  }
+}
+
+job_system::~job_system() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  for (task* dropped : main_tasks_) {
+    dropped->self.reset();
+  }
+}
+
+job_system& job_system::shared() {
+  static job_system pool{};
+  return pool;
+}
+
+job_system::handle job_system::run(std::function<void()> const& function, std::vector<handle> const& dependencies,
+                                   affinity where) {
+  handle const created = std::make_shared<task>();
+  created->function = function;
+  created->where = where;
+  created->remaining = 1;
+  created->done = false;
+
+  std::exception_ptr inherited{};
+  for (auto const& dependency : dependencies) {
+    std::lock_guard<std::mutex> lock{dependency->mutex};
+    if (!dependency->done) {
+      ++created->remaining;
+      dependency->continuations.push_back(created);
+    }
+    else if (dependency->error && !inherited) {
+      inherited = dependency->error;
+    }
+  }
+  if (inherited) {
+    std::lock_guard<std::mutex> lock{created->mutex};
+    if (!created->error) {
+      created->error = inherited;
+    }
+  }
+  release(created);
+  return created;
+}
+
+job_system::handle job_system::then(handle const& first, std::function<void()> const& function, affinity where) {
+  return run(function, {first}, where);
+}
+
+bool job_system::finished(handle const& awaited) const {
+  return awaited->done;
+}
+
+void job_system::wait(handle const& awaited) {
+  worker* const own = current_worker();
+  bool const main = is_main_thread();
+  while (!awaited->done) {
+    if (main && run_main_tasks() > 0) {
+      continue;
+    }
+    if (task* found = find_task(own)) {
+      execute(found);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{mutex_};
+    ++waiting_;
+    condition_.wait(lock, [this, &awaited, main]() {
+      return awaited->done || queued_ > 0 || (main && !main_tasks_.empty());
+    });
+    --waiting_;
+  }
+
+  std::exception_ptr error{};
+  {
+    std::lock_guard<std::mutex> lock{awaited->mutex};
+    error = awaited->error;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void job_system::wait(std::vector<handle> const& tasks) {
+  // all are waited for before the first exception is passed on
+  std::exception_ptr error{};
+  for (auto const& awaited : tasks) {
+    try {
+      wait(awaited);
+    }
+    catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::size_t job_system::run_main_tasks() {
+  if (!is_main_thread()) {
+    return 0;
+  }
+  std::size_t num_run = 0;
+  for (;;) {
+    task* next = nullptr;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (main_tasks_.empty()) {
+        return num_run;
+      }
+      next = main_tasks_.front();
+      main_tasks_.pop_front();
+    }
+    execute(next);
+    ++num_run;
+  }
+}
+
+void job_system::parallel_for(std::size_t count, std::size_t grain,
+                              std::function<void(std::size_t, std::size_t)> const& function) {
+  grain = std::max(grain, std::size_t{1});
+  std::size_t const num_chunks = (count + grain - 1) / grain;
+  if (num_chunks <= 1) {
+    if (count > 0) {
+      function(0, count);
+    }
+    return;
+  }
+
+  // helpers take chunks while any are left, helpers starting late find none
+  std::atomic<std::size_t> next_chunk{0};
+  auto const chunks = [&]() {
+    for (std::size_t chunk = next_chunk++; chunk < num_chunks; chunk = next_chunk++) {
+      function(chunk * grain, std::min(count, (chunk + 1) * grain));
+    }
+  };
+  std::vector<handle> helpers{};
+  for (std::size_t i = 1; i < std::min(num_chunks, concurrency()); ++i) {
+    helpers.push_back(run(chunks));
+  }
+
+  std::exception_ptr error{};
+  try {
+    chunks();
+  }
+  catch (...) {
+    error = std::current_exception();
+    next_chunk = num_chunks;
+  }
+  // helpers use this frame, so they are waited for before throwing
+  try {
+    wait(helpers);
+  }
+  catch (...) {
+    if (!error) {
+      error = std::current_exception();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::size_t job_system::num_workers() const {
+  return workers_.size();
+}
+
+std::size_t job_system::concurrency() const {
+  return workers_.size() + 1;
+}
+
+bool job_system::is_main_thread() const {
+  return std::this_thread::get_id() == main_thread_;
+}
+
+void job_system::work(worker* own) {
+  current_ = own;
+  for (;;) {
+    if (task* found = find_task(own)) {
+      execute(found);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{mutex_};
+    ++sleeping_;
+    condition_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    --sleeping_;
+    if (stop_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+job_system::worker* job_system::current_worker() const {
+  return current_ && current_->owner == this ? current_ : nullptr;
+}
+
+job_system::task* job_system::find_task(worker* own) {
+  if (own) {
+    if (task* popped = own->tasks.pop()) {
+      --queued_;
+      return popped;
+    }
+  }
+  // victims after the own index, so thieves do not all start at the first
+  std::size_t const first = own ? own->index + 1 : 0;
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    worker& victim = *workers_[(first + i) % workers_.size()];
+    if (&victim == own) {
+      continue;
+    }
+    if (task* stolen = victim.tasks.steal()) {
+      --queued_;
+      return stolen;
+    }
+  }
+  if (num_injected_ > 0) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!injected_.empty()) {
+      task* taken = injected_.front();
+      injected_.pop_front();
+      --num_injected_;
+      --queued_;
+      return taken;
+    }
+  }
+  return nullptr;
+}
+
+void job_system::schedule(handle const& ready) {
+  ready->self = ready;
+  if (ready->where == affinity::main_thread) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      main_tasks_.push_back(ready.get());
+    }
+    wake_waiting();
+    return;
+  }
+
+  // counted before it can be taken, so the count does not drop below zero
+  ++queued_;
+  if (worker* own = current_worker()) {
+    own->tasks.push(ready.get());
+  }
+  else {
+    std::lock_guard<std::mutex> lock{mutex_};
+    injected_.push_back(ready.get());
+    ++num_injected_;
+  }
+  wake_workers();
+}
+
+void job_system::release(handle const& waiting) {
+  if (--waiting->remaining == 0) {
+    schedule(waiting);
+  }
+}
+
+void job_system::execute(task* current) {
+  handle const keep = std::move(current->self);
+  // written before the last dependency released it, so no lock is needed
+  if (!current->error) {
+    try {
+      current->function();
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock{current->mutex};
+      current->error = std::current_exception();
+    }
+  }
+  current->function = nullptr;
+
+  std::vector<handle> continuations{};
+  std::exception_ptr error{};
+  {
+    std::lock_guard<std::mutex> lock{current->mutex};
+    current->done = true;
+    continuations.swap(current->continuations);
+    error = current->error;
+  }
+  wake_waiting();
+
+  for (auto const& next : continuations) {
+    if (error) {
+      std::lock_guard<std::mutex> lock{next->mutex};
+      if (!next->error) {
+        next->error = error;
+      }
+    }
+    release(next);
+  }
+}
+
+void job_system::wake_workers() {
+  // a sleeper counts itself under the mutex before checking the queues, so
+  // locking it here makes sure the sleeper either sees the task or is woken
+  if (sleeping_ > 0 || waiting_ > 0) {
+    { std::lock_guard<std::mutex> lock{mutex_}; }
+    // waiters done with their own task leave without taking it, so all
+    if (waiting_ > 0) {
+      condition_.notify_all();
+    }
+    else {
+      condition_.notify_one();
+    }
+  }
+}
+
+void job_system::wake_waiting() {
+  if (waiting_ > 0) {
+    { std::lock_guard<std::mutex> lock{mutex_}; }
+    condition_.notify_all();
+  }
+}
@@ -0,0 +1,227 @@
+#include "ktx_file.hpp"
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+static std::uint8_t const IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+static std::uint32_t const ENDIANNESS = 0x04030201;
+
+// fields following the identifier, all little endian
+struct ktx_header {
+  std::uint32_t endianness;
+  std::uint32_t gl_type;
+  std::uint32_t gl_type_size;
+  std::uint32_t gl_format;
+  std::uint32_t gl_internal_format;
+  std::uint32_t gl_base_internal_format;
+  std::uint32_t pixel_width;
+  std::uint32_t pixel_height;
+  std::uint32_t pixel_depth;
+  std::uint32_t number_of_array_elements;
+  std::uint32_t number_of_faces;
+  std::uint32_t number_of_mipmap_levels;
+  std::uint32_t bytes_of_key_value_data;
+};
+
+// sized internal format matching the pixel format
+static GLenum sized_format(GLenum channels, GLenum channel_type);
+// round up to multiple of 4
+static std::size_t padded(std::size_t size);
+// name next to file_name which no other writer uses, from any process or thread
+static std::string unique_temp_name(std::string const& file_name);
+// move source over target, returns false and leaves target untouched on failure
+static bool replace_file(std::string const& source, std::string const& target);
+
+namespace ktx_file {
+
+pixel_data read(std::string const& file_name, key_values* metadata) {
+  std::size_t file_size = 0;
+  pixel_data::buffer_type mapping = utils::map_file(file_name, file_size);
+  std::uint8_t const* data = mapping.get();
+
+  ktx_header header{};
+  if (file_size < sizeof(IDENTIFIER) + sizeof(header) || std::memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0) {
+    throw std::runtime_error("ktx_file: " + file_name + " is no KTX 1.1 file");
+  }
+  std::memcpy(&header, data + sizeof(IDENTIFIER), sizeof(header));
+  if (header.endianness != ENDIANNESS) {
+    throw std::runtime_error("ktx_file: " + file_name + " has unsupported byte order");
+  }
+  if (header.number_of_faces != 1 || header.number_of_array_elements != 0 || header.pixel_depth > 1) {
+    throw std::runtime_error("ktx_file: " + file_name + " is no 2D texture");
+  }
+
+  std::size_t offset = sizeof(IDENTIFIER) + sizeof(header);
+  std::size_t const key_value_end = offset + header.bytes_of_key_value_data;
+  if (key_value_end > file_size) {
+    throw std::runtime_error("ktx_file: " + file_name + " is truncated");
+  }
+  // parse "key\0value" pairs, each prefixed with its size
+  while (offset + 4 <= key_value_end) {
+    std::uint32_t pair_size = 0;
+    std::memcpy(&pair_size, data + offset, 4);
+    offset += 4;
+    if (offset + pair_size > key_value_end) {
+      throw std::runtime_error("ktx_file: " + file_name + " has corrupt metadata");
+    }
+    if (metadata) {
+      char const* pair = reinterpret_cast<char const*>(data + offset);
+      std::size_t key_size = strnlen(pair, pair_size);
+      std::size_t value_size = key_size < pair_size ? pair_size - key_size - 1 : 0;
+      // values may be null terminated
+      std::string value{pair + key_size + 1, value_size};
+      (*metadata)[std::string{pair, key_size}] = value.c_str();
+    }
+    offset += padded(pair_size);
+  }
+  offset = key_value_end;
+
+  // collect the location of each mip level
+  std::size_t const num_levels = header.number_of_mipmap_levels > 0 ? header.number_of_mipmap_levels : 1;
+  std::size_t const first_level = offset + 4;
+  std::vector<pixel_data::mip_level> levels{};
+  for (std::size_t level = 0; level < num_levels; ++level) {
+    std::uint32_t image_size = 0;
+    if (offset + 4 > file_size) {
+      throw std::runtime_error("ktx_file: " + file_name + " is truncated");
+    }
+    std::memcpy(&image_size, data + offset, 4);
+    offset += 4;
+    if (offset + image_size > file_size) {
+      throw std::runtime_error("ktx_file: " + file_name + " is truncated");
+    }
+    levels.push_back(pixel_data::mip_level{offset - first_level, image_size});
+    offset += padded(image_size);
+  }
+
+  // compressed textures have no pixel format, only an internal one
+  GLenum const channels = header.gl_type == 0 ? GLenum(header.gl_internal_format) : GLenum(header.gl_format);
+  GLenum const channel_type = header.gl_type == 0 ? GL_NONE : GLenum(header.gl_type);
+
+  // hand the mapping over, the deleter still releases the whole file
+  pixel_data texture{const_cast<std::uint8_t*>(data) + first_level, mapping.get_deleter(), file_size - first_level,
+                     channels, channel_type, header.pixel_width, header.pixel_height > 0 ? header.pixel_height : 1};
+  mapping.release();
+  texture.mip_levels = levels;
+
+  return texture;
+}
+
+void write(std::string const& file_name, pixel_data const& texture, key_values const& metadata) {
+  bool const compressed = texture.channel_type == GL_NONE;
+
+  ktx_header header{};
+  header.endianness = ENDIANNESS;
+  header.gl_type = compressed ? 0 : std::uint32_t(texture.channel_type);
+  header.gl_type_size = compressed ? 1 : (texture.channel_type == GL_UNSIGNED_BYTE ? 1 : 4);
+  header.gl_format = compressed ? 0 : std::uint32_t(texture.channels);
+  header.gl_internal_format = compressed ? std::uint32_t(texture.channels) : std::uint32_t(sized_format(texture.channels, texture.channel_type));
+  header.gl_base_internal_format = compressed ? std::uint32_t(GL_RGB) : std::uint32_t(texture.channels);
+  header.pixel_width = std::uint32_t(texture.width);
+  header.pixel_height = std::uint32_t(texture.height);
+  header.pixel_depth = 0;
+  header.number_of_array_elements = 0;
+  header.number_of_faces = 1;
+  header.number_of_mipmap_levels = std::uint32_t(texture.num_levels());
+
+  std::vector<char> key_value_data{};
+  for (auto const& pair : metadata) {
+    std::uint32_t pair_size = std::uint32_t(pair.first.size() + 1 + pair.second.size() + 1);
+    char const* size_bytes = reinterpret_cast<char const*>(&pair_size);
+    key_value_data.insert(key_value_data.end(), size_bytes, size_bytes + 4);
+    key_value_data.insert(key_value_data.end(), pair.first.c_str(), pair.first.c_str() + pair.first.size() + 1);
+    key_value_data.insert(key_value_data.end(), pair.second.c_str(), pair.second.c_str() + pair.second.size() + 1);
+    key_value_data.resize(padded(key_value_data.size()), 0);
+  }
+  header.bytes_of_key_value_data = std::uint32_t(key_value_data.size());
+
+  // write to temporary file so readers never see a partial file, each
+  // writer has its own so concurrent writers of one file do not mix
+  std::string const temp_name = unique_temp_name(file_name);
+  {
+    std::ofstream file{temp_name, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error("ktx_file: cannot write " + temp_name);
+    }
+    file.write(reinterpret_cast<char const*>(IDENTIFIER), sizeof(IDENTIFIER));
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(key_value_data.data(), std::streamsize(key_value_data.size()));
+
+    char const padding[4] = {0, 0, 0, 0};
+    for (auto const& level : texture.mip_levels) {
+      std::uint32_t image_size = std::uint32_t(level.size);
+      file.write(reinterpret_cast<char const*>(&image_size), 4);
+      file.write(reinterpret_cast<char const*>(texture.pixels.get() + level.offset), std::streamsize(level.size));
+      file.write(padding, std::streamsize(padded(level.size) - level.size));
+    }
+    if (!file) {
+      throw std::runtime_error("ktx_file: cannot write " + temp_name);
+    }
+  }
+  // the old file stays in place unless it is replaced in one step
+  if (!replace_file(temp_name, file_name)) {
+    std::remove(temp_name.c_str());
+    throw std::runtime_error("ktx_file: cannot write " + file_name);
+  }
+}
+
+}
+
+///////////////////////////// local helper functions //////////////////////////
+static GLenum sized_format(GLenum channels, GLenum channel_type) {
+  bool const is_float = channel_type == GL_FLOAT;
+  if (channels == GL_RED) {
+    return is_float ? GL_R32F : GL_R8;
+  }
+  else if (channels == GL_RG) {
+    return is_float ? GL_RG32F : GL_RG8;
+  }
+  else if (channels == GL_RGB) {
+    return is_float ? GL_RGB32F : GL_RGB8;
+  }
+  return is_float ? GL_RGBA32F : GL_RGBA8;
+}
+
+static std::size_t padded(std::size_t size) {
+  return (size + 3) & ~std::size_t(3);
+}
+
+static std::string unique_temp_name(std::string const& file_name) {
+  static std::atomic<unsigned> counter{0};
+#ifdef _WIN32
+  int const process = _getpid();
+#else
+  int const process = int(getpid());
+#endif
+  std::ostringstream name{};
+  name << file_name << '.' << process << '.' << std::hash<std::thread::id>{}(std::this_thread::get_id())
+       << '.' << counter++ << ".tmp";
+  return name.str();
+}
+
+static bool replace_file(std::string const& source, std::string const& target) {
+#ifdef _WIN32
+  // rename fails there when the target exists
+  return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  // rename replaces the target atomically
+  return std::rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
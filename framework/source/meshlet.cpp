@@ -0,0 +1,49 @@
+#include "meshlet.hpp"
+
+#include "model.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <cstdint>
+
+void cull_meshlets(std::vector<meshlet> const& meshlets,
+                   glm::fvec3 const& camera,
+                   std::array<glm::fvec4, 6> const& frustum,
+                   meshlet_draws& draws) {
+  draws.counts.clear();
+  draws.offsets.clear();
+  draws.num_triangles = 0;
+
+  GLuint range_end = 0;
+  for (meshlet const& cluster : meshlets) {
+    // every triangle faces away if the direction to the camera lies outside
+    // of the cone widened by the bounding sphere
+    glm::fvec3 const to_cluster = cluster.center - camera;
+    if (glm::dot(to_cluster, cluster.cone_axis) >=
+        cluster.cone_cutoff * glm::length(to_cluster) + cluster.radius) {
+      continue;
+    }
+    bool inside = true;
+    for (glm::fvec4 const& plane : frustum) {
+      if (glm::dot(glm::fvec3{plane}, cluster.center) + plane.w < -cluster.radius) {
+        inside = false;
+        break;
+      }
+    }
+    if (!inside) {
+      continue;
+    }
+
+    // continue the previous range if the meshlets are adjacent in the buffer
+    if (!draws.counts.empty() && range_end == cluster.first_index) {
+      draws.counts.back() += cluster.num_indices;
+    }
+    else {
+      draws.counts.push_back(cluster.num_indices);
+      draws.offsets.push_back(reinterpret_cast<GLvoid const*>(
+          std::uintptr_t(cluster.first_index) * std::uintptr_t(model::INDEX.size)));
+    }
+    range_end = cluster.first_index + GLuint(cluster.num_indices);
+    draws.num_triangles += std::size_t(cluster.num_indices) / 3;
+  }
+}
@@ -3,11 +3,79 @@
 // use floats and med precision operations
 #include <glm/gtc/type_precision.hpp>
 #include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+// symmetric 4x4 matrix summing the squared distances to a set of planes
+struct quadric {
+  quadric()
+   :a2{0.0}, ab{0.0}, ac{0.0}, ad{0.0}, b2{0.0}, bc{0.0}, bd{0.0}, c2{0.0}, cd{0.0}, d2{0.0}
+  {}
+  // plane through point with unit normal
+  quadric(glm::dvec3 const& n, glm::dvec3 const& point) {
+    double const d = -glm::dot(n, point);
+    a2 = n.x * n.x; ab = n.x * n.y; ac = n.x * n.z; ad = n.x * d;
+    b2 = n.y * n.y; bc = n.y * n.z; bd = n.y * d;
+    c2 = n.z * n.z; cd = n.z * d;
+    d2 = d * d;
+  }
+
+  quadric& operator+=(quadric const& q) {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+    b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd;
+    d2 += q.d2;
+    return *this;
+  }
+
+  double evaluate(glm::dvec3 const& p) const {
+    return a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+         + b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+         + c2 * p.z * p.z + 2.0 * cd * p.z
+         + d2;
+  }
+
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+// moving vertex from onto vertex to, queued by the error it introduces
+struct collapse {
+  double cost;
+  GLuint from;
+  GLuint to;
+  unsigned version_from;
+  unsigned version_to;
+
+  bool operator>(collapse const& other) const {
+    return cost > other.cost;
+  }
+};
 
 namespace model_loader {
 
+// procedural meshes built so far, keyed by shape, resolution and attributes
+typedef std::tuple<int, std::size_t, std::size_t, model::attrib_flag_t> sphere_key;
+static std::map<sphere_key, model> sphere_cache{};
+static std::mutex sphere_mutex{};
+
+model build_icosphere(std::size_t subdivisions, model::attrib_flag_t attributes);
+
+model build_uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t attributes);
+
+void push_sphere_vertex(std::vector<GLfloat>& data, model::attrib_flag_t attributes,
+                        glm::dvec3 const& position, double u, double v);
+
 void generate_normals(tinyobj::mesh_t& model);
 
 std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model);
@@ -168,4 +236,628 @@ std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model) {
   return tangents;
 }
 
-}
\ No newline at end of file
+model simplify(model const& source, std::size_t target_triangles, float* error) {
+  if (source.indices.empty() || source.vertex_bytes == 0) {
+    throw std::logic_error("simplify: model has no indexed triangles");
+  }
+  std::size_t const stride = std::size_t(source.vertex_bytes) / sizeof(GLfloat);
+  std::size_t const num_vertices = source.data.size() / stride;
+  std::size_t const num_triangles = source.indices.size() / 3;
+
+  // position is the first attribute of every vertex
+  std::vector<glm::dvec3> positions(num_vertices);
+  for (std::size_t i = 0; i < num_vertices; ++i) {
+    positions[i] = glm::dvec3{source.data[i * stride], source.data[i * stride + 1], source.data[i * stride + 2]};
+  }
+
+  // copies of a vertex with equal attributes are one vertex of the surface,
+  // vertices sharing only the position lie on a seam between texcoords or
+  // normals
+  std::vector<GLuint> welded(num_vertices);
+  std::vector<bool> locked(num_vertices, false);
+  std::map<std::vector<GLfloat>, GLuint> first_copy{};
+  std::map<std::array<GLfloat, 3>, GLuint> first_at_position{};
+  for (std::size_t i = 0; i < num_vertices; ++i) {
+    std::vector<GLfloat> const vertex{source.data.begin() + long(i * stride),
+                                      source.data.begin() + long((i + 1) * stride)};
+    auto const copy = first_copy.emplace(vertex, GLuint(i));
+    welded[i] = copy.first->second;
+    if (!copy.second) {
+      continue;
+    }
+    std::array<GLfloat, 3> const key{{source.data[i * stride], source.data[i * stride + 1], source.data[i * stride + 2]}};
+    auto const inserted = first_at_position.emplace(key, GLuint(i));
+    if (!inserted.second) {
+      locked[i] = true;
+      locked[inserted.first->second] = true;
+    }
+  }
+
+  std::vector<std::array<GLuint, 3>> triangles(num_triangles);
+  std::vector<bool> triangle_alive(num_triangles, true);
+  std::vector<std::vector<std::size_t>> vertex_triangles(num_vertices);
+  std::vector<quadric> quadrics(num_vertices);
+  std::map<std::pair<GLuint, GLuint>, unsigned> edge_uses{};
+  std::size_t live_triangles = num_triangles;
+  for (std::size_t t = 0; t < num_triangles; ++t) {
+    std::array<GLuint, 3>& triangle = triangles[t];
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      triangle[corner] = welded[source.indices[t * 3 + corner]];
+    }
+    // welding may leave triangles without area
+    if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+      triangle_alive[t] = false;
+      --live_triangles;
+      continue;
+    }
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      vertex_triangles[triangle[corner]].push_back(t);
+    }
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      GLuint const a = triangle[corner];
+      GLuint const b = triangle[(corner + 1) % 3];
+      ++edge_uses[std::make_pair(std::min(a, b), std::max(a, b))];
+    }
+
+    glm::dvec3 const normal = glm::cross(positions[triangle[1]] - positions[triangle[0]],
+                                         positions[triangle[2]] - positions[triangle[0]]);
+    double const length = glm::length(normal);
+    if (length > 0.0) {
+      quadric const plane{normal / length, positions[triangle[0]]};
+      for (GLuint vertex : triangle) {
+        quadrics[vertex] += plane;
+      }
+    }
+  }
+  // open borders must not shrink
+  for (auto const& edge : edge_uses) {
+    if (edge.second == 1) {
+      locked[edge.first.first] = true;
+      locked[edge.first.second] = true;
+    }
+  }
+
+  std::vector<unsigned> versions(num_vertices, 0);
+  std::vector<bool> removed(num_vertices, false);
+  std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>> queue{};
+  auto push = [&](GLuint from, GLuint to) {
+    if (!locked[from]) {
+      quadric sum = quadrics[from];
+      sum += quadrics[to];
+      queue.push(collapse{std::max(sum.evaluate(positions[to]), 0.0), from, to, versions[from], versions[to]});
+    }
+  };
+  for (auto const& edge : edge_uses) {
+    push(edge.first.first, edge.first.second);
+    push(edge.first.second, edge.first.first);
+  }
+
+  auto neighbours = [&](GLuint vertex) {
+    std::vector<GLuint> result{};
+    for (std::size_t t : vertex_triangles[vertex]) {
+      if (triangle_alive[t]) {
+        for (GLuint other : triangles[t]) {
+          if (other != vertex) {
+            result.push_back(other);
+          }
+        }
+      }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  };
+
+  // vertex each removed vertex was moved onto
+  std::vector<GLuint> moved_to(num_vertices);
+  for (std::size_t i = 0; i < num_vertices; ++i) {
+    moved_to[i] = GLuint(i);
+  }
+  while (live_triangles > target_triangles && !queue.empty()) {
+    collapse const candidate = queue.top();
+    queue.pop();
+    GLuint const from = candidate.from;
+    GLuint const to = candidate.to;
+    // an endpoint changed since the candidate was queued
+    if (removed[from] || removed[to] ||
+        candidate.version_from != versions[from] || candidate.version_to != versions[to]) {
+      continue;
+    }
+
+    // triangles on the edge vanish, the others of from are moved to to
+    std::vector<std::size_t> shared{};
+    std::vector<std::size_t> moved{};
+    for (std::size_t t : vertex_triangles[from]) {
+      if (!triangle_alive[t]) {
+        continue;
+      }
+      std::array<GLuint, 3> const& triangle = triangles[t];
+      if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+        shared.push_back(t);
+      }
+      else {
+        moved.push_back(t);
+      }
+    }
+    if (shared.empty()) {
+      continue;
+    }
+
+    // the endpoints may only share the vertices opposite the edge,
+    // otherwise the surface would fold onto itself
+    std::vector<GLuint> const from_neighbours = neighbours(from);
+    std::vector<GLuint> const to_neighbours = neighbours(to);
+    std::vector<GLuint> common{};
+    std::set_intersection(from_neighbours.begin(), from_neighbours.end(),
+                          to_neighbours.begin(), to_neighbours.end(), std::back_inserter(common));
+    if (common.size() != shared.size()) {
+      continue;
+    }
+
+    // moved triangles must not flip or degenerate
+    bool flips = false;
+    for (std::size_t t : moved) {
+      std::array<GLuint, 3> const& triangle = triangles[t];
+      glm::dvec3 corners[3];
+      glm::dvec3 moved_corners[3];
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        corners[corner] = positions[triangle[corner]];
+        moved_corners[corner] = triangle[corner] == from ? positions[to] : corners[corner];
+      }
+      glm::dvec3 const before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      glm::dvec3 const after = glm::cross(moved_corners[1] - moved_corners[0], moved_corners[2] - moved_corners[0]);
+      if (glm::dot(before, after) <= 0.05 * glm::length(before) * glm::length(after)) {
+        flips = true;
+        break;
+      }
+    }
+    if (flips) {
+      continue;
+    }
+
+    for (std::size_t t : shared) {
+      triangle_alive[t] = false;
+    }
+    live_triangles -= shared.size();
+    for (std::size_t t : moved) {
+      std::replace(triangles[t].begin(), triangles[t].end(), from, to);
+      vertex_triangles[to].push_back(t);
+    }
+    vertex_triangles[from].clear();
+    removed[from] = true;
+    moved_to[from] = to;
+    quadrics[to] += quadrics[from];
+
+    // costs of all edges at to changed
+    ++versions[to];
+    for (GLuint other : neighbours(to)) {
+      push(to, other);
+      push(other, to);
+    }
+  }
+
+  // keep the referenced vertices in their original order
+  std::vector<GLuint> remap(num_vertices, GLuint(-1));
+  std::vector<GLfloat> data{};
+  std::vector<GLuint> indices{};
+  indices.reserve(live_triangles * 3);
+  for (std::size_t t = 0; t < num_triangles; ++t) {
+    if (!triangle_alive[t]) {
+      continue;
+    }
+    for (GLuint vertex : triangles[t]) {
+      if (remap[vertex] == GLuint(-1)) {
+        remap[vertex] = GLuint(data.size() / stride);
+        data.insert(data.end(), source.data.begin() + long(vertex * stride),
+                    source.data.begin() + long((vertex + 1) * stride));
+      }
+      indices.push_back(remap[vertex]);
+    }
+  }
+
+  if (error) {
+    // distance of every removed vertex to the closest plane of the
+    // triangles around the vertex it ended up in
+    double max_distance = 0.0;
+    for (std::size_t i = 0; i < num_vertices; ++i) {
+      if (!removed[i]) {
+        continue;
+      }
+      GLuint end = moved_to[i];
+      while (moved_to[end] != end) {
+        end = moved_to[end];
+      }
+      double distance = std::numeric_limits<double>::max();
+      for (std::size_t t : vertex_triangles[end]) {
+        if (!triangle_alive[t]) {
+          continue;
+        }
+        std::array<GLuint, 3> const& triangle = triangles[t];
+        glm::dvec3 const normal = glm::cross(positions[triangle[1]] - positions[triangle[0]],
+                                             positions[triangle[2]] - positions[triangle[0]]);
+        double const length = glm::length(normal);
+        if (length > 0.0) {
+          distance = std::min(distance, std::abs(glm::dot(normal / length, positions[i] - positions[triangle[0]])));
+        }
+      }
+      if (distance < std::numeric_limits<double>::max()) {
+        max_distance = std::max(max_distance, distance);
+      }
+    }
+    *error = float(max_distance);
+  }
+  model::attrib_flag_t attributes = 0;
+  for (auto const& offset : source.offsets) {
+    attributes |= offset.first;
+  }
+  return model{data, attributes, indices};
+}
+
+std::vector<model> lod_chain(model const& source, std::size_t num_levels, std::vector<float>& errors, float factor) {
+  if (factor <= 0.0f || factor >= 1.0f) {
+    throw std::logic_error("lod_chain: factor must be between 0 and 1");
+  }
+  std::vector<model> levels{source};
+  errors.assign(1, 0.0f);
+
+  std::size_t const num_triangles = source.indices.size() / 3;
+  double target = double(num_triangles);
+  for (std::size_t level = 1; level < num_levels; ++level) {
+    target *= double(factor);
+    // every level starts from the source, so the error is measured against it
+    float level_error = 0.0f;
+    model simplified = simplify(source, std::size_t(target), &level_error);
+    // seams and borders may stop the reduction
+    if (simplified.indices.size() >= levels.back().indices.size()) {
+      break;
+    }
+    levels.push_back(std::move(simplified));
+    errors.push_back(std::max(level_error, errors.back()));
+  }
+  return levels;
+}
+
+std::vector<meshlet> meshlets(model& source, std::size_t max_triangles, std::size_t max_vertices) {
+  if (source.indices.empty() || source.vertex_bytes == 0) {
+    throw std::logic_error("meshlets: model has no indexed triangles");
+  }
+  if (max_triangles == 0 || max_vertices < 3) {
+    throw std::logic_error("meshlets: clusters must hold at least one triangle");
+  }
+  std::size_t const stride = std::size_t(source.vertex_bytes) / sizeof(GLfloat);
+  std::size_t const num_vertices = source.data.size() / stride;
+  std::size_t const num_triangles = source.indices.size() / 3;
+
+  auto const position = [&](GLuint vertex) {
+    return glm::fvec3{source.data[vertex * stride], source.data[vertex * stride + 1], source.data[vertex * stride + 2]};
+  };
+
+  // unit normals and centroids of the triangles
+  std::vector<glm::fvec3> normals(num_triangles);
+  std::vector<glm::fvec3> centroids(num_triangles);
+  std::vector<std::vector<std::size_t>> vertex_triangles(num_vertices);
+  for (std::size_t t = 0; t < num_triangles; ++t) {
+    glm::fvec3 const a = position(source.indices[t * 3]);
+    glm::fvec3 const b = position(source.indices[t * 3 + 1]);
+    glm::fvec3 const c = position(source.indices[t * 3 + 2]);
+    glm::fvec3 const normal = glm::cross(b - a, c - a);
+    float const length = glm::length(normal);
+    normals[t] = length > 0.0f ? normal / length : glm::fvec3{0.0f};
+    centroids[t] = (a + b + c) / 3.0f;
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      vertex_triangles[source.indices[t * 3 + corner]].push_back(t);
+    }
+  }
+
+  std::vector<GLuint> indices{};
+  indices.reserve(source.indices.size());
+  std::vector<meshlet> clusters{};
+  std::vector<bool> assigned(num_triangles, false);
+  // cluster which last used the vertex, to count distinct vertices
+  std::vector<std::size_t> vertex_cluster(num_vertices, std::size_t(-1));
+  std::size_t seed = 0;
+  while (true) {
+    while (seed < num_triangles && assigned[seed]) {
+      ++seed;
+    }
+    if (seed == num_triangles) {
+      break;
+    }
+    std::size_t const id = clusters.size();
+    std::size_t const first_index = indices.size();
+    std::vector<std::size_t> members{};
+    std::vector<std::size_t> frontier{seed};
+    std::size_t cluster_vertices = 0;
+    glm::fvec3 normal_sum{0.0f};
+    glm::fvec3 centroid_sum{0.0f};
+
+    // grow from the seed, preferring triangles which add few vertices, then
+    // ones with a similar normal and finally ones close to the cluster
+    while (members.size() < max_triangles) {
+      glm::fvec3 const direction = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::fvec3{0.0f};
+      glm::fvec3 const center = members.empty() ? glm::fvec3{0.0f} : centroid_sum / float(members.size());
+      std::size_t best = num_triangles;
+      std::tuple<std::size_t, float, float> best_score{};
+      for (std::size_t candidate : frontier) {
+        if (assigned[candidate]) {
+          continue;
+        }
+        std::size_t added = 0;
+        for (std::size_t corner = 0; corner < 3; ++corner) {
+          added += vertex_cluster[source.indices[candidate * 3 + corner]] != id ? 1 : 0;
+        }
+        if (cluster_vertices + added > max_vertices) {
+          continue;
+        }
+        std::tuple<std::size_t, float, float> const score{
+            added, -glm::dot(normals[candidate], direction), glm::length(centroids[candidate] - center)};
+        if (best == num_triangles || score < best_score) {
+          best = candidate;
+          best_score = score;
+        }
+      }
+      if (best == num_triangles) {
+        break;
+      }
+
+      assigned[best] = true;
+      members.push_back(best);
+      normal_sum += normals[best];
+      centroid_sum += centroids[best];
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        GLuint const vertex = source.indices[best * 3 + corner];
+        indices.push_back(vertex);
+        if (vertex_cluster[vertex] != id) {
+          vertex_cluster[vertex] = id;
+          ++cluster_vertices;
+        }
+        for (std::size_t neighbour : vertex_triangles[vertex]) {
+          if (!assigned[neighbour]) {
+            frontier.push_back(neighbour);
+          }
+        }
+      }
+      // drop candidates taken in the meantime so the frontier stays short
+      frontier.erase(std::remove_if(frontier.begin(), frontier.end(), [&](std::size_t t) { return assigned[t]; }),
+                     frontier.end());
+    }
+
+    meshlet cluster{};
+    cluster.first_index = GLuint(first_index);
+    cluster.num_indices = GLsizei(indices.size() - first_index);
+
+    // sphere around the box of the vertices
+    glm::fvec3 low{std::numeric_limits<float>::max()};
+    glm::fvec3 high{-std::numeric_limits<float>::max()};
+    for (std::size_t i = first_index; i < indices.size(); ++i) {
+      low = glm::min(low, position(indices[i]));
+      high = glm::max(high, position(indices[i]));
+    }
+    cluster.center = (low + high) * 0.5f;
+    for (std::size_t i = first_index; i < indices.size(); ++i) {
+      cluster.radius = std::max(cluster.radius, glm::length(position(indices[i]) - cluster.center));
+    }
+
+    // cone around the mean normal, degenerate triangles face nowhere
+    cluster.cone_axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::fvec3{0.0f, 0.0f, 1.0f};
+    float min_dot = 1.0f;
+    for (std::size_t t : members) {
+      if (normals[t] != glm::fvec3{0.0f}) {
+        min_dot = std::min(min_dot, glm::dot(normals[t], cluster.cone_axis));
+      }
+    }
+    // cones as wide as a hemisphere never face away completely
+    cluster.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+    clusters.push_back(cluster);
+  }
+
+  source.indices = std::move(indices);
+  return clusters;
+}
+
+model const& icosphere(std::size_t subdivisions, model::attrib_flag_t import_attribs) {
+  model::attrib_flag_t const attributes = model::POSITION | import_attribs;
+  std::lock_guard<std::mutex> lock{sphere_mutex};
+  sphere_key const key{0, subdivisions, 0, attributes};
+  auto cached = sphere_cache.find(key);
+  if (cached == sphere_cache.end()) {
+    cached = sphere_cache.emplace(key, build_icosphere(subdivisions, attributes)).first;
+  }
+  return cached->second;
+}
+
+model const& uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t import_attribs) {
+  if (slices < 3 || stacks < 2) {
+    throw std::logic_error("uv_sphere: at least 3 slices and 2 stacks are required");
+  }
+  model::attrib_flag_t const attributes = model::POSITION | import_attribs;
+  std::lock_guard<std::mutex> lock{sphere_mutex};
+  sphere_key const key{1, slices, stacks, attributes};
+  auto cached = sphere_cache.find(key);
+  if (cached == sphere_cache.end()) {
+    cached = sphere_cache.emplace(key, build_uv_sphere(slices, stacks, attributes)).first;
+  }
+  return cached->second;
+}
+
+float sphere_error(model const& sphere) {
+  std::size_t const stride = std::size_t(sphere.vertex_bytes) / sizeof(GLfloat);
+  double min_distance = 1.0;
+  for (std::size_t i = 0; i + 2 < sphere.indices.size(); i += 3) {
+    glm::dvec3 corners[3];
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      GLfloat const* position = &sphere.data[sphere.indices[i + corner] * stride];
+      corners[corner] = glm::dvec3{position[0], position[1], position[2]};
+    }
+    glm::dvec3 const normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    double const length = glm::length(normal);
+    if (length > 0.0) {
+      // the plane of the triangle comes closest to the center
+      min_distance = std::min(min_distance, std::abs(glm::dot(normal / length, corners[0])));
+    }
+  }
+  return float(1.0 - min_distance);
+}
+
+model build_icosphere(std::size_t subdivisions, model::attrib_flag_t attributes) {
+  // vertices at the poles and two rings of five in between, so that
+  // only the pole vertices have no defined longitude
+  std::vector<glm::dvec3> positions{glm::dvec3{0.0, 1.0, 0.0}, glm::dvec3{0.0, -1.0, 0.0}};
+  double const ring_height = 1.0 / std::sqrt(5.0);
+  double const ring_radius = 2.0 / std::sqrt(5.0);
+  for (std::size_t i = 0; i < 10; ++i) {
+    // upper ring first, the lower one is rotated by half a step
+    double const angle = glm::pi<double>() * (0.4 * double(i % 5) + (i < 5 ? 0.0 : 0.2));
+    positions.push_back(glm::dvec3{ring_radius * std::cos(angle), i < 5 ? ring_height : -ring_height,
+                                   ring_radius * std::sin(angle)});
+  }
+  std::vector<std::array<GLuint, 3>> triangles{};
+  for (GLuint i = 0; i < 5; ++i) {
+    GLuint const upper = 2 + i;
+    GLuint const upper_next = 2 + (i + 1) % 5;
+    GLuint const lower = 7 + i;
+    GLuint const lower_next = 7 + (i + 1) % 5;
+    triangles.push_back({{0, upper, upper_next}});
+    triangles.push_back({{upper, lower, upper_next}});
+    triangles.push_back({{upper_next, lower, lower_next}});
+    triangles.push_back({{1, lower_next, lower}});
+  }
+  // counter clockwise seen from outside
+  for (auto& triangle : triangles) {
+    glm::dvec3 const normal = glm::cross(positions[triangle[1]] - positions[triangle[0]],
+                                         positions[triangle[2]] - positions[triangle[0]]);
+    if (glm::dot(normal, positions[triangle[0]]) < 0.0) {
+      std::swap(triangle[1], triangle[2]);
+    }
+  }
+
+  // split every triangle into four, neighbours share the edge midpoints
+  for (std::size_t level = 0; level < subdivisions; ++level) {
+    std::map<std::pair<GLuint, GLuint>, GLuint> midpoints{};
+    auto midpoint = [&](GLuint a, GLuint b) {
+      auto const inserted = midpoints.emplace(std::make_pair(std::min(a, b), std::max(a, b)), GLuint(positions.size()));
+      if (inserted.second) {
+        positions.push_back(glm::normalize(positions[a] + positions[b]));
+      }
+      return inserted.first->second;
+    };
+    std::vector<std::array<GLuint, 3>> split{};
+    split.reserve(triangles.size() * 4);
+    for (auto const& triangle : triangles) {
+      GLuint const ab = midpoint(triangle[0], triangle[1]);
+      GLuint const bc = midpoint(triangle[1], triangle[2]);
+      GLuint const ca = midpoint(triangle[2], triangle[0]);
+      split.push_back({{triangle[0], ab, ca}});
+      split.push_back({{ab, triangle[1], bc}});
+      split.push_back({{ca, bc, triangle[2]}});
+      split.push_back({{ab, bc, ca}});
+    }
+    triangles = std::move(split);
+  }
+
+  // texcoords per corner, vertices with equal position and texcoord are shared
+  std::vector<GLfloat> data{};
+  std::vector<GLuint> indices{};
+  std::map<std::pair<GLuint, double>, GLuint> vertices{};
+  for (auto const& triangle : triangles) {
+    double u[3];
+    bool pole[3];
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      glm::dvec3 const& position = positions[triangle[corner]];
+      pole[corner] = std::abs(position.y) > 1.0 - 1e-9;
+      u[corner] = 0.5 - std::atan2(position.z, position.x) / (2.0 * glm::pi<double>());
+      if (u[corner] >= 1.0) {
+        u[corner] = 0.0;
+      }
+    }
+    // corners on the far side of the seam continue beyond 1
+    double max_u = 0.0;
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      max_u = pole[corner] ? max_u : std::max(max_u, u[corner]);
+    }
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      if (!pole[corner] && max_u - u[corner] > 0.5) {
+        u[corner] += 1.0;
+      }
+    }
+    // a pole takes the longitude of the edge opposite to it
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      if (pole[corner]) {
+        u[corner] = 0.5 * (u[(corner + 1) % 3] + u[(corner + 2) % 3]);
+      }
+    }
+
+    for (std::size_t corner = 0; corner < 3; ++corner) {
+      auto const inserted = vertices.emplace(std::make_pair(triangle[corner], u[corner]),
+                                             GLuint(vertices.size()));
+      if (inserted.second) {
+        glm::dvec3 const& position = positions[triangle[corner]];
+        double const v = 0.5 - std::asin(glm::clamp(position.y, -1.0, 1.0)) / glm::pi<double>();
+        push_sphere_vertex(data, attributes, position, u[corner], v);
+      }
+      indices.push_back(inserted.first->second);
+    }
+  }
+  return model{data, attributes, indices};
+}
+
+model build_uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t attributes) {
+  std::vector<GLfloat> data{};
+  std::vector<GLuint> indices{};
+  // one more column than slices, the last one closes the seam
+  for (std::size_t stack = 0; stack <= stacks; ++stack) {
+    double const v = double(stack) / double(stacks);
+    double const theta = glm::pi<double>() * v;
+    for (std::size_t slice = 0; slice <= slices; ++slice) {
+      // pole vertices sit in the middle of their triangle
+      bool const pole = stack == 0 || stack == stacks;
+      double const u = (double(slice) + (pole ? 0.5 : 0.0)) / double(slices);
+      double const phi = (0.5 - u) * 2.0 * glm::pi<double>();
+      glm::dvec3 const position{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+      push_sphere_vertex(data, attributes, position, u, v);
+    }
+  }
+
+  GLuint const row = GLuint(slices + 1);
+  for (GLuint stack = 0; stack < GLuint(stacks); ++stack) {
+    for (GLuint slice = 0; slice < GLuint(slices); ++slice) {
+      GLuint const top_left = stack * row + slice;
+      GLuint const bottom_left = top_left + row;
+      // the triangles touching a pole would be degenerate
+      if (stack != 0) {
+        indices.insert(indices.end(), {top_left, bottom_left, top_left + 1});
+      }
+      if (stack + 1 != GLuint(stacks)) {
+        // the north pole vertex of this slice sits above its middle
+        GLuint const top = stack == 0 ? top_left : top_left + 1;
+        indices.insert(indices.end(), {top, bottom_left, bottom_left + 1});
+      }
+    }
+  }
+  return model{data, attributes, indices};
+}
+
+void push_sphere_vertex(std::vector<GLfloat>& data, model::attrib_flag_t attributes,
+                        glm::dvec3 const& position, double u, double v) {
+  // texcoords grow eastwards and southwards
+  double const phi = (0.5 - u) * 2.0 * glm::pi<double>();
+  glm::dvec3 const tangent{std::sin(phi), 0.0, -std::cos(phi)};
+  glm::dvec3 const bitangent = glm::cross(tangent, position);
+
+  // same order as the attributes in the vertex
+  data.insert(data.end(), {GLfloat(position.x), GLfloat(position.y), GLfloat(position.z)});
+  if (attributes & model::NORMAL) {
+    data.insert(data.end(), {GLfloat(position.x), GLfloat(position.y), GLfloat(position.z)});
+  }
+  if (attributes & model::TEXCOORD) {
+    data.insert(data.end(), {GLfloat(u), GLfloat(v)});
+  }
+  if (attributes & model::TANGENT) {
+    data.insert(data.end(), {GLfloat(tangent.x), GLfloat(tangent.y), GLfloat(tangent.z)});
+  }
+  if (attributes & model::BITANGENT) {
+    data.insert(data.end(), {GLfloat(bitangent.x), GLfloat(bitangent.y), GLfloat(bitangent.z)});
+  }
+}
+
+}
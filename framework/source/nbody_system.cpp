@@ -0,0 +1,515 @@
+#include "nbody_system.hpp"
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// levels of the octree, a morton code holds 3 bits per level
+static unsigned const max_level = 21;
+// particles a force task takes at least, smaller tasks cost more to hand out
+static std::size_t const min_chunk = 256;
+
+// put two zero bits in front of each of the lower 21 bits
+static std::uint64_t spread_bits(std::uint64_t value) {
+  value &= 0x1FFFFF;
+  value = (value | value << 32) & 0x1F00000000FFFF;
+  value = (value | value << 16) & 0x1F0000FF0000FF;
+  value = (value | value << 8) & 0x100F00F00F00F00F;
+  value = (value | value << 4) & 0x10C30C30C30C30C3;
+  value = (value | value << 2) & 0x1249249249249249;
+  return value;
+}
+
+// points acting on the particles of a leaf, per component for the vector units
+struct nbody_system::interaction_list {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> mass;
+
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    mass.clear();
+  }
+  void push(glm::fvec4 const& point) {
+    x.push_back(point.x);
+    y.push_back(point.y);
+    z.push_back(point.z);
+    mass.push_back(point.w);
+  }
+  std::size_t size() const {
+    return x.size();
+  }
+};
+
+// acceleration at the point from all items of the list, vector lanes refine
+// the estimated inverse square root with one newton step instead of dividing
+static glm::fvec3 accumulate(std::vector<float> const& x, std::vector<float> const& y,
+                             std::vector<float> const& z, std::vector<float> const& mass,
+                             glm::fvec3 const& point, float softening2) {
+  std::size_t i = 0;
+  glm::fvec3 acceleration{0.0f};
+#if defined(__AVX__)
+  __m256 const px = _mm256_set1_ps(point.x);
+  __m256 const py = _mm256_set1_ps(point.y);
+  __m256 const pz = _mm256_set1_ps(point.z);
+  __m256 const epsilon2 = _mm256_set1_ps(softening2);
+  __m256 const half = _mm256_set1_ps(0.5f);
+  __m256 const three = _mm256_set1_ps(3.0f);
+  __m256 ax = _mm256_setzero_ps();
+  __m256 ay = _mm256_setzero_ps();
+  __m256 az = _mm256_setzero_ps();
+  for (; i + 8 <= x.size(); i += 8) {
+    __m256 const dx = _mm256_sub_ps(_mm256_loadu_ps(&x[i]), px);
+    __m256 const dy = _mm256_sub_ps(_mm256_loadu_ps(&y[i]), py);
+    __m256 const dz = _mm256_sub_ps(_mm256_loadu_ps(&z[i]), pz);
+    __m256 const r2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                    _mm256_add_ps(_mm256_mul_ps(dz, dz), epsilon2));
+    __m256 const estimate = _mm256_rsqrt_ps(r2);
+    __m256 const inverse = _mm256_mul_ps(_mm256_mul_ps(half, estimate),
+                                         _mm256_sub_ps(three, _mm256_mul_ps(r2, _mm256_mul_ps(estimate, estimate))));
+    __m256 const strength = _mm256_mul_ps(_mm256_loadu_ps(&mass[i]),
+                                          _mm256_mul_ps(inverse, _mm256_mul_ps(inverse, inverse)));
+    ax = _mm256_add_ps(ax, _mm256_mul_ps(dx, strength));
+    ay = _mm256_add_ps(ay, _mm256_mul_ps(dy, strength));
+    az = _mm256_add_ps(az, _mm256_mul_ps(dz, strength));
+  }
+  float lanes[8];
+  for (auto sum : {std::make_pair(ax, 0), std::make_pair(ay, 1), std::make_pair(az, 2)}) {
+    _mm256_storeu_ps(lanes, sum.first);
+    acceleration[sum.second] = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+                               ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+  }
+#elif defined(__SSE__)
+  __m128 const px = _mm_set1_ps(point.x);
+  __m128 const py = _mm_set1_ps(point.y);
+  __m128 const pz = _mm_set1_ps(point.z);
+  __m128 const epsilon2 = _mm_set1_ps(softening2);
+  __m128 const half = _mm_set1_ps(0.5f);
+  __m128 const three = _mm_set1_ps(3.0f);
+  __m128 ax = _mm_setzero_ps();
+  __m128 ay = _mm_setzero_ps();
+  __m128 az = _mm_setzero_ps();
+  for (; i + 4 <= x.size(); i += 4) {
+    __m128 const dx = _mm_sub_ps(_mm_loadu_ps(&x[i]), px);
+    __m128 const dy = _mm_sub_ps(_mm_loadu_ps(&y[i]), py);
+    __m128 const dz = _mm_sub_ps(_mm_loadu_ps(&z[i]), pz);
+    __m128 const r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                 _mm_add_ps(_mm_mul_ps(dz, dz), epsilon2));
+    __m128 const estimate = _mm_rsqrt_ps(r2);
+    __m128 const inverse = _mm_mul_ps(_mm_mul_ps(half, estimate),
+                                      _mm_sub_ps(three, _mm_mul_ps(r2, _mm_mul_ps(estimate, estimate))));
+    __m128 const strength = _mm_mul_ps(_mm_loadu_ps(&mass[i]),
+                                       _mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse)));
+    ax = _mm_add_ps(ax, _mm_mul_ps(dx, strength));
+    ay = _mm_add_ps(ay, _mm_mul_ps(dy, strength));
+    az = _mm_add_ps(az, _mm_mul_ps(dz, strength));
+  }
+  float lanes[4];
+  for (auto sum : {std::make_pair(ax, 0), std::make_pair(ay, 1), std::make_pair(az, 2)}) {
+    _mm_storeu_ps(lanes, sum.first);
+    acceleration[sum.second] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  }
+#endif
+  for (; i < x.size(); ++i) {
+    glm::fvec3 const delta{x[i] - point.x, y[i] - point.y, z[i] - point.z};
+    float const inverse = 1.0f / std::sqrt(glm::dot(delta, delta) + softening2);
+    acceleration += delta * (mass[i] * inverse * inverse * inverse);
+  }
+  return acceleration;
+}
+
+nbody_system::nbody_system(float opening_angle, float softening, float gravity,
+                           std::size_t max_leaf_size)
+ :opening_angle_{opening_angle}
+ ,softening2_{softening * softening}
+ ,gravity_{gravity}
+ ,max_leaf_size_{max_leaf_size}
+ ,x_{}
+ ,y_{}
+ ,z_{}
+ ,vx_{}
+ ,vy_{}
+ ,vz_{}
+ ,ax_{}
+ ,ay_{}
+ ,az_{}
+ ,masses_{}
+ ,forces_valid_{false}
+ ,low_{0.0f}
+ ,cube_size_{1.0f}
+ ,keys_{}
+ ,sorted_{}
+ ,nodes_{}
+ ,leaves_{}
+ ,interactions_{0}
+{
+  if (!(softening > 0.0f)) {
+    throw std::logic_error("nbody_system: softening must be positive");
+  }
+  if (max_leaf_size == 0) {
+    throw std::logic_error("nbody_system: leaves must hold at least one particle");
+  }
+}
+
+std::size_t nbody_system::add(glm::fvec3 const& position, glm::fvec3 const& velocity, float mass) {
+  if (size() >= std::numeric_limits<std::uint32_t>::max()) {
+    throw std::logic_error("nbody_system: too many particles");
+  }
+  x_.push_back(position.x);
+  y_.push_back(position.y);
+  z_.push_back(position.z);
+  vx_.push_back(velocity.x);
+  vy_.push_back(velocity.y);
+  vz_.push_back(velocity.z);
+  ax_.push_back(0.0f);
+  ay_.push_back(0.0f);
+  az_.push_back(0.0f);
+  masses_.push_back(mass);
+  forces_valid_ = false;
+  return x_.size() - 1;
+}
+
+void nbody_system::clear() {
+  for (auto values : {&x_, &y_, &z_, &vx_, &vy_, &vz_, &ax_, &ay_, &az_, &masses_}) {
+    values->clear();
+  }
+  keys_.clear();
+  sorted_.clear();
+  nodes_.clear();
+  leaves_.clear();
+  forces_valid_ = false;
+  interactions_ = 0;
+}
+
+std::size_t nbody_system::size() const {
+  return x_.size();
+}
+
+void nbody_system::set_opening_angle(float opening_angle) {
+  opening_angle_ = opening_angle;
+  forces_valid_ = false;
+}
+
+float nbody_system::opening_angle() const {
+  return opening_angle_;
+}
+
+void nbody_system::step(float dt) {
+  if (size() == 0) {
+    return;
+  }
+  if (!forces_valid_) {
+    compute_forces();
+  }
+
+  // kick half a step, drift a full one and kick again with the new forces
+  float const half_dt = 0.5f * dt;
+  auto const kick = [this, half_dt](std::size_t first, std::size_t last) {
+    for (std::size_t id = first; id < last; ++id) {
+      vx_[id] += ax_[id] * half_dt;
+      vy_[id] += ay_[id] * half_dt;
+      vz_[id] += az_[id] * half_dt;
+    }
+  };
+  job_system::shared().parallel_for(size(), 1 << 16, [this, kick, dt](std::size_t first, std::size_t last) {
+    kick(first, last);
+    for (std::size_t id = first; id < last; ++id) {
+      x_[id] += vx_[id] * dt;
+      y_[id] += vy_[id] * dt;
+      z_[id] += vz_[id] * dt;
+    }
+  });
+  compute_forces();
+  job_system::shared().parallel_for(size(), 1 << 16, kick);
+}
+
+glm::fvec3 nbody_system::position(std::size_t id) const {
+  return glm::fvec3{x_[id], y_[id], z_[id]};
+}
+
+glm::fvec3 nbody_system::velocity(std::size_t id) const {
+  return glm::fvec3{vx_[id], vy_[id], vz_[id]};
+}
+
+glm::fvec3 nbody_system::acceleration(std::size_t id) const {
+  return glm::fvec3{ax_[id], ay_[id], az_[id]};
+}
+
+glm::fvec3 nbody_system::direct_acceleration(std::size_t id) const {
+  glm::dvec3 acceleration{0.0};
+  glm::dvec3 const point{position(id)};
+  for (std::size_t other = 0; other < size(); ++other) {
+    glm::dvec3 const delta = glm::dvec3{position(other)} - point;
+    double const r2 = glm::dot(delta, delta) + double(softening2_);
+    acceleration += delta * (double(masses_[other]) / (r2 * std::sqrt(r2)));
+  }
+  return glm::fvec3{acceleration * double(gravity_)};
+}
+
+std::uint64_t nbody_system::interactions() const {
+  return interactions_;
+}
+
+std::size_t nbody_system::num_nodes() const {
+  return nodes_.size();
+}
+
+void nbody_system::build_tree() {
+  std::size_t const count = size();
+
+  // bounding cube of all particles, reduced per chunk
+  std::size_t const grain = 1 << 16;
+  std::vector<glm::fvec3> lows((count + grain - 1) / grain);
+  std::vector<glm::fvec3> highs(lows.size());
+  job_system::shared().parallel_for(count, grain, [this, grain, &lows, &highs](std::size_t first, std::size_t last) {
+    glm::fvec3 low{std::numeric_limits<float>::max()};
+    glm::fvec3 high{-std::numeric_limits<float>::max()};
+    for (std::size_t id = first; id < last; ++id) {
+      low = glm::min(low, position(id));
+      high = glm::max(high, position(id));
+    }
+    lows[first / grain] = low;
+    highs[first / grain] = high;
+  });
+  glm::fvec3 low = lows[0];
+  glm::fvec3 high = highs[0];
+  for (std::size_t chunk = 1; chunk < lows.size(); ++chunk) {
+    low = glm::min(low, lows[chunk]);
+    high = glm::max(high, highs[chunk]);
+  }
+  glm::fvec3 const extent = high - low;
+  low_ = low;
+  // slightly larger, so the highest particles still get codes inside
+  cube_size_ = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) * 1.0001f;
+
+  // morton codes of the cells on the finest level
+  keys_.resize(count);
+  float const cells = float(1u << max_level);
+  job_system::shared().parallel_for(count, grain, [this, cells](std::size_t first, std::size_t last) {
+    for (std::size_t id = first; id < last; ++id) {
+      glm::fvec3 const cell = glm::clamp((position(id) - low_) * (cells / cube_size_),
+                                         glm::fvec3{0.0f}, glm::fvec3{cells - 1.0f});
+      std::uint64_t const code = spread_bits(std::uint64_t(cell.x)) << 2 |
+                                 spread_bits(std::uint64_t(cell.y)) << 1 |
+                                 spread_bits(std::uint64_t(cell.z));
+      keys_[id] = key{code, std::uint32_t(id)};
+    }
+  });
+
+  // sorted in chunks on all cores and merged pairwise
+  auto const before = [](key const& a, key const& b) {
+    return a.code < b.code || (a.code == b.code && a.id < b.id);
+  };
+  std::size_t const sort_grain = std::max(grain, count / job_system::shared().concurrency() + 1);
+  job_system::shared().parallel_for(count, sort_grain, [this, before](std::size_t first, std::size_t last) {
+    std::sort(keys_.begin() + std::ptrdiff_t(first), keys_.begin() + std::ptrdiff_t(last), before);
+  });
+  for (std::size_t width = sort_grain; width < count; width *= 2) {
+    job_system::shared().parallel_for((count + 2 * width - 1) / (2 * width), 1,
+                                      [this, before, width, count](std::size_t first, std::size_t last) {
+      for (std::size_t pair = first; pair < last; ++pair) {
+        std::size_t const middle = std::min(count, pair * 2 * width + width);
+        std::size_t const end = std::min(count, middle + width);
+        std::inplace_merge(keys_.begin() + std::ptrdiff_t(pair * 2 * width),
+                           keys_.begin() + std::ptrdiff_t(middle),
+                           keys_.begin() + std::ptrdiff_t(end), before);
+      }
+    });
+  }
+
+  sorted_.resize(count);
+  job_system::shared().parallel_for(count, grain, [this](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      std::uint32_t const id = keys_[i].id;
+      sorted_[i] = glm::fvec4{x_[id], y_[id], z_[id], masses_[id]};
+    }
+  });
+
+  // the subtrees of the octants of the root are built in parallel and
+  // appended behind the root and its children
+  nodes_.assign(1, node{});
+  nodes_[0].size = cube_size_;
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> octants{};
+  if (count > max_leaf_size_) {
+    std::uint32_t first = 0;
+    while (first < count) {
+      std::uint64_t const octant = keys_[first].code >> (3 * (max_level - 1));
+      std::uint32_t const last = std::uint32_t(std::partition_point(
+          keys_.begin() + first, keys_.end(),
+          [octant](key const& k) { return k.code >> (3 * (max_level - 1)) == octant; }) - keys_.begin());
+      octants.emplace_back(first, last - first);
+      first = last;
+    }
+  }
+  if (octants.empty()) {
+    build_node(nodes_, 0, 0, std::uint32_t(count), 0);
+  }
+  else {
+    std::vector<std::vector<node>> subtrees(octants.size());
+    job_system::shared().parallel_for(octants.size(), 1,
+                                      [this, &octants, &subtrees](std::size_t first, std::size_t last) {
+      for (std::size_t octant = first; octant < last; ++octant) {
+        subtrees[octant].assign(1, node{});
+        subtrees[octant][0].size = cube_size_ * 0.5f;
+        build_node(subtrees[octant], 0, octants[octant].first, octants[octant].second, 1);
+      }
+    });
+
+    node root = nodes_[0];
+    root.first_child = 1;
+    root.num_children = std::uint32_t(octants.size());
+    root.first = 0;
+    root.count = std::uint32_t(count);
+    glm::fvec3 weighted{0.0f};
+    for (auto const& subtree : subtrees) {
+      nodes_.push_back(subtree[0]);
+      weighted += subtree[0].center_of_mass * subtree[0].mass;
+      root.mass += subtree[0].mass;
+    }
+    root.center_of_mass = root.mass > 0.0f ? weighted / root.mass : glm::fvec3{0.0f};
+    nodes_[0] = root;
+    for (std::size_t octant = 0; octant < subtrees.size(); ++octant) {
+      // local index 1 and above move to the end of the tree
+      std::uint32_t const offset = std::uint32_t(nodes_.size()) - 1;
+      for (std::size_t local = 0; local < subtrees[octant].size(); ++local) {
+        node& moved = local == 0 ? nodes_[1 + octant] : subtrees[octant][local];
+        if (moved.num_children > 0) {
+          moved.first_child += offset;
+        }
+      }
+      nodes_.insert(nodes_.end(), subtrees[octant].begin() + 1, subtrees[octant].end());
+    }
+  }
+
+  leaves_.clear();
+  for (std::size_t index = 0; index < nodes_.size(); ++index) {
+    if (nodes_[index].num_children == 0) {
+      leaves_.push_back(std::uint32_t(index));
+    }
+  }
+}
+
+void nbody_system::build_node(std::vector<node>& nodes, std::size_t index, std::uint32_t first,
+                              std::uint32_t count, unsigned level) const {
+  nodes[index].first = first;
+  nodes[index].count = count;
+  if (count <= max_leaf_size_ || level == max_level) {
+    glm::fvec3 weighted{0.0f};
+    float mass = 0.0f;
+    for (std::uint32_t i = first; i < first + count; ++i) {
+      weighted += glm::fvec3{sorted_[i]} * sorted_[i].w;
+      mass += sorted_[i].w;
+    }
+    nodes[index].mass = mass;
+    nodes[index].center_of_mass = mass > 0.0f ? weighted / mass : glm::fvec3{sorted_[first]};
+    nodes[index].num_children = 0;
+    return;
+  }
+
+  // codes agree above level, so the digit of level splits the range in order
+  unsigned const shift = 3 * (max_level - 1 - level);
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> children{};
+  std::uint32_t child_first = first;
+  while (child_first < first + count) {
+    std::uint64_t const digit = keys_[child_first].code >> shift & 7;
+    std::uint32_t const child_last = std::uint32_t(std::partition_point(
+        keys_.begin() + child_first, keys_.begin() + first + count,
+        [shift, digit](key const& k) { return (k.code >> shift & 7) == digit; }) - keys_.begin());
+    children.emplace_back(child_first, child_last - child_first);
+    child_first = child_last;
+  }
+
+  std::uint32_t const first_child = std::uint32_t(nodes.size());
+  nodes[index].first_child = first_child;
+  nodes[index].num_children = std::uint32_t(children.size());
+  nodes.resize(nodes.size() + children.size());
+  glm::fvec3 weighted{0.0f};
+  float mass = 0.0f;
+  for (std::size_t child = 0; child < children.size(); ++child) {
+    nodes[first_child + child].size = nodes[index].size * 0.5f;
+    build_node(nodes, first_child + child, children[child].first, children[child].second, level + 1);
+    weighted += nodes[first_child + child].center_of_mass * nodes[first_child + child].mass;
+    mass += nodes[first_child + child].mass;
+  }
+  nodes[index].mass = mass;
+  nodes[index].center_of_mass = mass > 0.0f ? weighted / mass : glm::fvec3{sorted_[first]};
+}
+
+void nbody_system::compute_forces() {
+  build_tree();
+
+  // leaves are handed out in morton order, neighbours share most of the walk
+  std::atomic<std::uint64_t> interactions{0};
+  std::size_t const leaves_per_chunk = std::max(std::size_t{1}, min_chunk / max_leaf_size_);
+  job_system::shared().parallel_for(leaves_.size(), leaves_per_chunk,
+                                    [this, &interactions](std::size_t first, std::size_t last) {
+    interaction_list list{};
+    std::uint64_t chunk_interactions = 0;
+    for (std::size_t leaf = first; leaf < last; ++leaf) {
+      chunk_interactions += leaf_forces(nodes_[leaves_[leaf]], list);
+    }
+    interactions += chunk_interactions;
+  });
+  interactions_ = interactions;
+  forces_valid_ = true;
+}
+
+std::uint64_t nbody_system::leaf_forces(node const& leaf, interaction_list& list) {
+  // box around the particles of the leaf, nodes far from all of them act as
+  // one point on all of them
+  glm::fvec3 low{sorted_[leaf.first]};
+  glm::fvec3 high{low};
+  for (std::uint32_t i = leaf.first + 1; i < leaf.first + leaf.count; ++i) {
+    low = glm::min(low, glm::fvec3{sorted_[i]});
+    high = glm::max(high, glm::fvec3{sorted_[i]});
+  }
+
+  list.clear();
+  float const opening2 = opening_angle_ * opening_angle_;
+  std::uint32_t stack[8 * max_level + 1];
+  std::size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    node const& current = nodes_[stack[--stack_size]];
+    glm::fvec3 const gap = glm::max(glm::max(low - current.center_of_mass, current.center_of_mass - high),
+                                    glm::fvec3{0.0f});
+    if (current.size * current.size < opening2 * glm::dot(gap, gap)) {
+      list.push(glm::fvec4{current.center_of_mass, current.mass});
+    }
+    else if (current.num_children == 0) {
+      // includes the leaf itself, a particle exerts no force on itself
+      for (std::uint32_t i = current.first; i < current.first + current.count; ++i) {
+        list.push(sorted_[i]);
+      }
+    }
+    else {
+      for (std::uint32_t child = 0; child < current.num_children; ++child) {
+        stack[stack_size++] = current.first_child + child;
+      }
+    }
+  }
+
+  // scattered back to the ids, each particle is in exactly one leaf
+  for (std::uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i) {
+    glm::fvec3 const acceleration =
+        accumulate(list.x, list.y, list.z, list.mass, glm::fvec3{sorted_[i]}, softening2_) * gravity_;
+    std::uint32_t const id = keys_[i].id;
+    ax_[id] = acceleration.x;
+    ay_[id] = acceleration.y;
+    az_[id] = acceleration.z;
+  }
+  return std::uint64_t(leaf.count) * list.size();
+}
@@ -0,0 +1,263 @@
+#include "occlusion_buffer.hpp"
+
+#include "job_system.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// clip space w below which triangles and bounds count as crossing the near plane
+static float const min_w = 1e-5f;
+// triangles a task should have at least to pay for handing it out
+static std::size_t const min_triangles_per_task = 512;
+
+static std::size_t round_up(std::size_t value, std::size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+occlusion_buffer::occlusion_buffer(std::size_t width, std::size_t height, std::size_t tile_size)
+ :tile_size_{round_up(std::max(tile_size, std::size_t{1}), 8)}
+ ,tiles_x_{round_up(std::max(width, std::size_t{1}), tile_size_) / tile_size_}
+ ,tiles_y_{round_up(std::max(height, std::size_t{1}), tile_size_) / tile_size_}
+ ,width_{tiles_x_ * tile_size_}
+ ,height_{tiles_y_ * tile_size_}
+ ,depths_(width_ * height_, 1.0f)
+ ,triangles_{}
+ ,bins_(tiles_x_ * tiles_y_)
+{}
+
+void occlusion_buffer::clear() {
+  std::fill(depths_.begin(), depths_.end(), 1.0f);
+  triangles_.clear();
+}
+
+void occlusion_buffer::add_occluder(model const& mesh, glm::fmat4 const& matrix) {
+  std::size_t const stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+  std::size_t const num_vertices = stride > 0 ? mesh.data.size() / stride : 0;
+
+  // vertices in pixel coordinates with depth between 0 and 1
+  std::vector<glm::fvec3> screen(num_vertices);
+  std::vector<bool> in_front(num_vertices);
+  for (std::size_t i = 0; i < num_vertices; ++i) {
+    glm::fvec4 const clip = matrix * glm::fvec4{mesh.data[i * stride], mesh.data[i * stride + 1], mesh.data[i * stride + 2], 1.0f};
+    in_front[i] = clip.w > min_w;
+    glm::fvec3 const ndc = glm::fvec3{clip} / clip.w;
+    screen[i] = glm::fvec3{(ndc.x * 0.5f + 0.5f) * float(width_), (ndc.y * 0.5f + 0.5f) * float(height_), ndc.z * 0.5f + 0.5f};
+  }
+
+  for (std::size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+    GLuint const indices[3] = {mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2]};
+    if (!in_front[indices[0]] || !in_front[indices[1]] || !in_front[indices[2]]) {
+      continue;
+    }
+    glm::fvec3 const& v0 = screen[indices[0]];
+    glm::fvec3 const& v1 = screen[indices[1]];
+    glm::fvec3 const& v2 = screen[indices[2]];
+    // pixels whose centers lie in the bounds
+    float const low_x = std::min(v0.x, std::min(v1.x, v2.x));
+    float const low_y = std::min(v0.y, std::min(v1.y, v2.y));
+    float const high_x = std::max(v0.x, std::max(v1.x, v2.x));
+    float const high_y = std::max(v0.y, std::max(v1.y, v2.y));
+    triangle setup{};
+    setup.low_x = std::max(0, int(std::ceil(low_x - 0.5f)));
+    setup.low_y = std::max(0, int(std::ceil(low_y - 0.5f)));
+    setup.high_x = std::min(int(width_) - 1, int(std::floor(high_x - 0.5f)));
+    setup.high_y = std::min(int(height_) - 1, int(std::floor(high_y - 0.5f)));
+    if (setup.low_x > setup.high_x || setup.low_y > setup.high_y) {
+      continue;
+    }
+
+    // edges from each vertex to the next, positive inside counter-clockwise
+    // triangles
+    glm::fvec3 const* vertices[3] = {&v0, &v1, &v2};
+    for (int edge = 0; edge < 3; ++edge) {
+      glm::fvec3 const& from = *vertices[edge];
+      glm::fvec3 const& to = *vertices[(edge + 1) % 3];
+      setup.edge_x[edge] = from.y - to.y;
+      setup.edge_y[edge] = to.x - from.x;
+      setup.edge_c[edge] = from.x * to.y - from.y * to.x;
+    }
+    float const area = setup.edge_x[0] * v2.x + setup.edge_y[0] * v2.y + setup.edge_c[0];
+    // back facing or degenerate
+    if (area <= 0.0f) {
+      continue;
+    }
+    // the edge opposite a vertex weights its depth
+    glm::fvec3 const weights = glm::fvec3{v0.z, v1.z, v2.z} / area;
+    setup.depth = glm::fvec3{
+        setup.edge_x[1] * weights.x + setup.edge_x[2] * weights.y + setup.edge_x[0] * weights.z,
+        setup.edge_y[1] * weights.x + setup.edge_y[2] * weights.y + setup.edge_y[0] * weights.z,
+        setup.edge_c[1] * weights.x + setup.edge_c[2] * weights.y + setup.edge_c[0] * weights.z};
+    triangles_.push_back(setup);
+  }
+}
+
+void occlusion_buffer::rasterize(simd_lanes lanes) {
+  lanes = std::min(lanes, widest_simd_lanes());
+  for (auto& bin : bins_) {
+    bin.clear();
+  }
+  for (std::size_t i = 0; i < triangles_.size(); ++i) {
+    triangle const& current = triangles_[i];
+    for (std::size_t y = std::size_t(current.low_y) / tile_size_; y <= std::size_t(current.high_y) / tile_size_; ++y) {
+      for (std::size_t x = std::size_t(current.low_x) / tile_size_; x <= std::size_t(current.high_x) / tile_size_; ++x) {
+        bins_[y * tiles_x_ + x].push_back(i);
+      }
+    }
+  }
+
+  // tiles do not share pixels, so tasks need no synchronization
+  // few triangles are rasterized in fewer, larger ranges of tiles
+  std::size_t const num_tasks = std::max(std::size_t{1},
+                                         std::min(bins_.size(), triangles_.size() / min_triangles_per_task + 1));
+  job_system::shared().parallel_for(bins_.size(), (bins_.size() + num_tasks - 1) / num_tasks,
+                                    [this, lanes](std::size_t first, std::size_t last) {
+    for (std::size_t tile = first; tile < last; ++tile) {
+      rasterize_tile(tile, lanes);
+    }
+  });
+}
+
+void occlusion_buffer::rasterize_tile(std::size_t tile, simd_lanes lanes) {
+  int const tile_x = int((tile % tiles_x_) * tile_size_);
+  int const tile_y = int((tile / tiles_x_) * tile_size_);
+  int const tile_end_x = tile_x + int(tile_size_);
+  int const tile_end_y = tile_y + int(tile_size_);
+  // pixels of a row handled at once
+  int const block = lanes == simd_lanes::avx ? 8 : lanes == simd_lanes::sse ? 4 : 1;
+
+  for (std::size_t index : bins_[tile]) {
+    triangle const& current = triangles_[index];
+    // blocks of lanes start aligned and never cross the tile
+    int const low_x = std::max(current.low_x, tile_x) / block * block;
+    int const high_x = std::min(current.high_x, tile_end_x - 1);
+    int const low_y = std::max(current.low_y, tile_y);
+    int const high_y = std::min(current.high_y, tile_end_y - 1);
+#if defined(__AVX__)
+    __m256 const offsets8 = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    __m256 const zero8 = _mm256_setzero_ps();
+    __m256 const edge_x0_8 = _mm256_set1_ps(current.edge_x[0]);
+    __m256 const edge_x1_8 = _mm256_set1_ps(current.edge_x[1]);
+    __m256 const edge_x2_8 = _mm256_set1_ps(current.edge_x[2]);
+    __m256 const depth_x8 = _mm256_set1_ps(current.depth.x);
+#endif
+#if defined(__SSE__)
+    __m128 const offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 const zero = _mm_setzero_ps();
+    __m128 const edge_x0 = _mm_set1_ps(current.edge_x[0]);
+    __m128 const edge_x1 = _mm_set1_ps(current.edge_x[1]);
+    __m128 const edge_x2 = _mm_set1_ps(current.edge_x[2]);
+    __m128 const depth_x = _mm_set1_ps(current.depth.x);
+#endif
+    for (int y = low_y; y <= high_y; ++y) {
+      float const center_y = float(y) + 0.5f;
+      glm::fvec3 const row_edges = current.edge_y * center_y + current.edge_c;
+      float const row_depth = current.depth.y * center_y + current.depth.z;
+      float* row = depths_.data() + std::size_t(y) * width_;
+#if defined(__AVX__)
+      if (lanes == simd_lanes::avx) {
+        __m256 const row_edge0 = _mm256_set1_ps(row_edges[0]);
+        __m256 const row_edge1 = _mm256_set1_ps(row_edges[1]);
+        __m256 const row_edge2 = _mm256_set1_ps(row_edges[2]);
+        __m256 const row_depths = _mm256_set1_ps(row_depth);
+        for (int x = low_x; x <= high_x; x += block) {
+          __m256 const centers = _mm256_add_ps(_mm256_set1_ps(float(x)), offsets8);
+          __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_x0_8, centers), row_edge0), zero8, _CMP_GE_OQ);
+          inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_x1_8, centers), row_edge1), zero8, _CMP_GE_OQ));
+          inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edge_x2_8, centers), row_edge2), zero8, _CMP_GE_OQ));
+          __m256 const depth = _mm256_add_ps(_mm256_mul_ps(depth_x8, centers), row_depths);
+          __m256 const old = _mm256_loadu_ps(row + x);
+          _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, depth), inside));
+        }
+        continue;
+      }
+#endif
+#if defined(__SSE__)
+      if (lanes == simd_lanes::sse) {
+        __m128 const row_edge0 = _mm_set1_ps(row_edges[0]);
+        __m128 const row_edge1 = _mm_set1_ps(row_edges[1]);
+        __m128 const row_edge2 = _mm_set1_ps(row_edges[2]);
+        __m128 const row_depths = _mm_set1_ps(row_depth);
+        for (int x = low_x; x <= high_x; x += block) {
+          __m128 const centers = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+          __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_x0, centers), row_edge0), zero);
+          inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_x1, centers), row_edge1), zero));
+          inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edge_x2, centers), row_edge2), zero));
+          __m128 const depth = _mm_add_ps(_mm_mul_ps(depth_x, centers), row_depths);
+          __m128 const old = _mm_loadu_ps(row + x);
+          // keep the old depth outside of the triangle
+          _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, depth)), _mm_andnot_ps(inside, old)));
+        }
+        continue;
+      }
+#endif
+      for (int x = low_x; x <= high_x; ++x) {
+        float const center_x = float(x) + 0.5f;
+        glm::fvec3 const edges = current.edge_x * center_x + row_edges;
+        if (edges[0] >= 0.0f && edges[1] >= 0.0f && edges[2] >= 0.0f) {
+          row[x] = std::min(row[x], current.depth.x * center_x + row_depth);
+        }
+      }
+    }
+  }
+}
+
+bool occlusion_buffer::visible(glm::fvec4 const& sphere, glm::fmat4 const& view_projection) const {
+  // screen bounds of the corners of the box around the sphere
+  glm::fvec3 low{std::numeric_limits<float>::max()};
+  glm::fvec3 high{-std::numeric_limits<float>::max()};
+  for (int corner = 0; corner < 8; ++corner) {
+    glm::fvec3 const offset{corner & 1 ? sphere.w : -sphere.w, corner & 2 ? sphere.w : -sphere.w, corner & 4 ? sphere.w : -sphere.w};
+    glm::fvec4 const clip = view_projection * glm::fvec4{glm::fvec3{sphere} + offset, 1.0f};
+    // reaching behind the camera, assume it covers the view
+    if (clip.w <= min_w) {
+      return true;
+    }
+    glm::fvec3 const ndc = glm::fvec3{clip} / clip.w;
+    low = glm::min(low, ndc);
+    high = glm::max(high, ndc);
+  }
+  if (high.x < -1.0f || low.x > 1.0f || high.y < -1.0f || low.y > 1.0f || low.z > 1.0f) {
+    return false;
+  }
+
+  // one more pixel around, occluders were only sampled at pixel centers
+  float const nearest = low.z * 0.5f + 0.5f;
+  int const low_x = std::max(0, int(std::floor((low.x * 0.5f + 0.5f) * float(width_))) - 1);
+  int const low_y = std::max(0, int(std::floor((low.y * 0.5f + 0.5f) * float(height_))) - 1);
+  int const high_x = std::min(int(width_) - 1, int(std::ceil((high.x * 0.5f + 0.5f) * float(width_))) + 1);
+  int const high_y = std::min(int(height_) - 1, int(std::ceil((high.y * 0.5f + 0.5f) * float(height_))) + 1);
+  for (int y = low_y; y <= high_y; ++y) {
+    float const* row = depths_.data() + std::size_t(y) * width_;
+    for (int x = low_x; x <= high_x; ++x) {
+      if (row[x] >= nearest) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::size_t occlusion_buffer::width() const {
+  return width_;
+}
+
+std::size_t occlusion_buffer::height() const {
+  return height_;
+}
+
+float occlusion_buffer::depth(std::size_t x, std::size_t y) const {
+  return depths_[y * width_ + x];
+}
+
+std::size_t occlusion_buffer::triangles() const {
+  return triangles_.size();
+}
@@ -0,0 +1,228 @@
+#include "orbit_set.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+static double const two_pi = 6.283185307179586;
+
+// one orbit at a time, for the ones left over by the vector paths
+struct lanes1 {
+  static std::size_t const count = 1;
+  float v;
+  explicit lanes1(float value) :v{value} {}
+  static lanes1 load(float const* data) { return lanes1{*data}; }
+  void store(float* data) const { *data = v; }
+};
+static lanes1 operator+(lanes1 a, lanes1 b) { return lanes1{a.v + b.v}; }
+static lanes1 operator-(lanes1 a, lanes1 b) { return lanes1{a.v - b.v}; }
+static lanes1 operator*(lanes1 a, lanes1 b) { return lanes1{a.v * b.v}; }
+static lanes1 operator/(lanes1 a, lanes1 b) { return lanes1{a.v / b.v}; }
+static lanes1 nearest(lanes1 a) { return lanes1{std::nearbyint(a.v)}; }
+static bool all_below(lanes1 a, float limit) { return std::abs(a.v) < limit; }
+
+#if defined(__AVX__)
+struct lanes8 {
+  static std::size_t const count = 8;
+  __m256 v;
+  lanes8(__m256 value) :v(value) {}
+  explicit lanes8(float value) :v(_mm256_set1_ps(value)) {}
+  static lanes8 load(float const* data) { return _mm256_loadu_ps(data); }
+  void store(float* data) const { _mm256_storeu_ps(data, v); }
+};
+static lanes8 operator+(lanes8 a, lanes8 b) { return _mm256_add_ps(a.v, b.v); }
+static lanes8 operator-(lanes8 a, lanes8 b) { return _mm256_sub_ps(a.v, b.v); }
+static lanes8 operator*(lanes8 a, lanes8 b) { return _mm256_mul_ps(a.v, b.v); }
+static lanes8 operator/(lanes8 a, lanes8 b) { return _mm256_div_ps(a.v, b.v); }
+static lanes8 nearest(lanes8 a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static bool all_below(lanes8 a, float limit) {
+  __m256 const magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v);
+  return _mm256_movemask_ps(_mm256_cmp_ps(magnitude, _mm256_set1_ps(limit), _CMP_LT_OQ)) == 0xFF;
+}
+#elif defined(__SSE__)
+struct lanes4 {
+  static std::size_t const count = 4;
+  __m128 v;
+  lanes4(__m128 value) :v(value) {}
+  explicit lanes4(float value) :v(_mm_set1_ps(value)) {}
+  static lanes4 load(float const* data) { return _mm_loadu_ps(data); }
+  void store(float* data) const { _mm_storeu_ps(data, v); }
+};
+static lanes4 operator+(lanes4 a, lanes4 b) { return _mm_add_ps(a.v, b.v); }
+static lanes4 operator-(lanes4 a, lanes4 b) { return _mm_sub_ps(a.v, b.v); }
+static lanes4 operator*(lanes4 a, lanes4 b) { return _mm_mul_ps(a.v, b.v); }
+static lanes4 operator/(lanes4 a, lanes4 b) { return _mm_div_ps(a.v, b.v); }
+// adding and removing 1.5 * 2^23 drops the fraction with round to nearest,
+// sse has no rounding instruction before 4.1
+static lanes4 nearest(lanes4 a) {
+  __m128 const magic = _mm_set1_ps(12582912.0f);
+  return _mm_sub_ps(_mm_add_ps(a.v, magic), magic);
+}
+static bool all_below(lanes4 a, float limit) {
+  __m128 const magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v);
+  return _mm_movemask_ps(_mm_cmplt_ps(magnitude, _mm_set1_ps(limit))) == 0xF;
+}
+#endif
+
+// reduced to -pi..pi, where the taylor series are accurate to about 1e-6
+template <typename lanes>
+static void sin_cos(lanes x, lanes& sine, lanes& cosine) {
+  x = x - lanes{float(two_pi)} * nearest(x * lanes{float(1.0 / two_pi)});
+  lanes const x2 = x * x;
+  sine = x * (lanes{1.0f} + x2 * (lanes{-1.0f / 6.0f} + x2 * (lanes{1.0f / 120.0f} + x2 * (lanes{-1.0f / 5040.0f} +
+         x2 * (lanes{1.0f / 362880.0f} + x2 * (lanes{-1.0f / 39916800.0f} + x2 * (lanes{1.0f / 6227020800.0f} +
+         x2 * lanes{-1.0f / 1307674368000.0f})))))));
+  cosine = lanes{1.0f} + x2 * (lanes{-1.0f / 2.0f} + x2 * (lanes{1.0f / 24.0f} + x2 * (lanes{-1.0f / 720.0f} +
+           x2 * (lanes{1.0f / 40320.0f} + x2 * (lanes{-1.0f / 3628800.0f} + x2 * (lanes{1.0f / 479001600.0f} +
+           x2 * (lanes{-1.0f / 87178291200.0f} + x2 * lanes{1.0f / 20922789888000.0f})))))));
+}
+
+orbit_set::orbit_set(std::size_t iterations)
+ :iterations_{iterations}
+ ,mean_anomalies_{}
+ ,mean_motions_{}
+ ,eccentricities_{}
+ ,semi_major_axes_{}
+ ,semi_minor_axes_{}
+ ,major_x_{}
+ ,major_y_{}
+ ,major_z_{}
+ ,minor_x_{}
+ ,minor_y_{}
+ ,minor_z_{}
+{}
+
+std::size_t orbit_set::add(orbital_elements const& elements) {
+  if (!(elements.eccentricity >= 0.0f && elements.eccentricity < 1.0f)) {
+    throw std::logic_error("orbit_set: only elliptic orbits with eccentricity in [0, 1) are supported");
+  }
+  if (!(elements.semi_major_axis > 0.0f && elements.period > 0.0f)) {
+    throw std::logic_error("orbit_set: semi-major axis and period must be positive");
+  }
+
+  mean_anomalies_.push_back(double(elements.mean_anomaly));
+  mean_motions_.push_back(two_pi / double(elements.period));
+  eccentricities_.push_back(elements.eccentricity);
+  semi_major_axes_.push_back(elements.semi_major_axis);
+  semi_minor_axes_.push_back(elements.semi_major_axis *
+                             std::sqrt(1.0f - elements.eccentricity * elements.eccentricity));
+
+  // perifocal axes with z north, then swapped into the xz plane with y north
+  // so that orbits run the way positive rotations around y turn
+  float const cos_node = std::cos(elements.ascending_node);
+  float const sin_node = std::sin(elements.ascending_node);
+  float const cos_periapsis = std::cos(elements.argument_of_periapsis);
+  float const sin_periapsis = std::sin(elements.argument_of_periapsis);
+  float const cos_inclination = std::cos(elements.inclination);
+  float const sin_inclination = std::sin(elements.inclination);
+  glm::fvec3 const major{cos_node * cos_periapsis - sin_node * sin_periapsis * cos_inclination,
+                         sin_node * cos_periapsis + cos_node * sin_periapsis * cos_inclination,
+                         sin_periapsis * sin_inclination};
+  glm::fvec3 const minor{-cos_node * sin_periapsis - sin_node * cos_periapsis * cos_inclination,
+                         -sin_node * sin_periapsis + cos_node * cos_periapsis * cos_inclination,
+                         cos_periapsis * sin_inclination};
+  major_x_.push_back(major.x);
+  major_y_.push_back(major.z);
+  major_z_.push_back(-major.y);
+  minor_x_.push_back(minor.x);
+  minor_y_.push_back(minor.z);
+  minor_z_.push_back(-minor.y);
+
+  return mean_anomalies_.size() - 1;
+}
+
+void orbit_set::clear() {
+  for (auto values : {&mean_anomalies_, &mean_motions_}) {
+    values->clear();
+  }
+  for (auto values : {&eccentricities_, &semi_major_axes_, &semi_minor_axes_, &major_x_, &major_y_, &major_z_,
+                      &minor_x_, &minor_y_, &minor_z_}) {
+    values->clear();
+  }
+}
+
+std::size_t orbit_set::size() const {
+  return mean_anomalies_.size();
+}
+
+void orbit_set::evaluate(double time, std::vector<glm::fvec3>& positions) const {
+  positions.resize(size());
+  std::size_t id = 0;
+#if defined(__AVX__)
+  for (; id + lanes8::count <= size(); id += lanes8::count) {
+    solve<lanes8>(id, time, positions.data());
+  }
+#elif defined(__SSE__)
+  for (; id + lanes4::count <= size(); id += lanes4::count) {
+    solve<lanes4>(id, time, positions.data());
+  }
+#endif
+  for (; id < size(); ++id) {
+    solve<lanes1>(id, time, positions.data());
+  }
+}
+
+template <typename lanes>
+void orbit_set::solve(std::size_t first, double time, glm::fvec3* positions) const {
+  float mean[lanes::count];
+  for (std::size_t lane = 0; lane < lanes::count; ++lane) {
+    double phase = mean_anomalies_[first + lane] + mean_motions_[first + lane] * time;
+    phase -= two_pi * std::floor(phase / two_pi + 0.5);
+    mean[lane] = float(phase);
+  }
+  lanes const mean_anomaly = lanes::load(mean);
+  lanes const eccentricity = lanes::load(&eccentricities_[first]);
+
+  // newton iterations on E - e sin(E) = M, starting from M + e sin(M), until
+  // all lanes are within float precision
+  lanes sine{0.0f};
+  lanes cosine{0.0f};
+  sin_cos(mean_anomaly, sine, cosine);
+  lanes anomaly = mean_anomaly + eccentricity * sine;
+  for (std::size_t i = 0; i < iterations_; ++i) {
+    sin_cos(anomaly, sine, cosine);
+    lanes const step = (anomaly - eccentricity * sine - mean_anomaly) / (lanes{1.0f} - eccentricity * cosine);
+    anomaly = anomaly - step;
+    if (all_below(step, 1e-6f)) {
+      break;
+    }
+  }
+  sin_cos(anomaly, sine, cosine);
+
+  // along the major axis from the focus and along the minor axis
+  lanes const major = lanes::load(&semi_major_axes_[first]) * (cosine - eccentricity);
+  lanes const minor = lanes::load(&semi_minor_axes_[first]) * sine;
+  float x[lanes::count];
+  float y[lanes::count];
+  float z[lanes::count];
+  (lanes::load(&major_x_[first]) * major + lanes::load(&minor_x_[first]) * minor).store(x);
+  (lanes::load(&major_y_[first]) * major + lanes::load(&minor_y_[first]) * minor).store(y);
+  (lanes::load(&major_z_[first]) * major + lanes::load(&minor_z_[first]) * minor).store(z);
+  for (std::size_t lane = 0; lane < lanes::count; ++lane) {
+    positions[first + lane] = glm::fvec3{x[lane], y[lane], z[lane]};
+  }
+}
+
+glm::dvec3 orbit_set::reference(std::size_t id, double time) const {
+  double const mean_anomaly = mean_anomalies_[id] + mean_motions_[id] * time;
+  double const eccentricity = double(eccentricities_[id]);
+  double anomaly = mean_anomaly + eccentricity * std::sin(mean_anomaly);
+  for (int i = 0; i < 64; ++i) {
+    double const step = (anomaly - eccentricity * std::sin(anomaly) - mean_anomaly) /
+                        (1.0 - eccentricity * std::cos(anomaly));
+    anomaly -= step;
+    if (std::abs(step) < 1e-14) {
+      break;
+    }
+  }
+
+  double const major = double(semi_major_axes_[id]) * (std::cos(anomaly) - eccentricity);
+  double const minor = double(semi_minor_axes_[id]) * std::sin(anomaly);
+  return glm::dvec3{major_x_[id], major_y_[id], major_z_[id]} * major +
+         glm::dvec3{minor_x_[id], minor_y_[id], minor_z_[id]} * minor;
+}
@@ -0,0 +1,505 @@
+#include "sphere_terrain.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+// chunks which may wait for the workers at once, more are requested again by
+// the next update
+static std::size_t const max_queued_chunks = 64;
+// floats per vertex: position, normal, texcoord and morph target
+static std::size_t const vertex_floats = 11;
+// fraction of the lod range after which the vertices start to morph
+static float const morph_start_fraction = 0.8f;
+
+sphere_terrain::sphere_terrain(pixel_data const& heightmap,
+                               float height_scale,
+                               std::size_t grid_size,
+                               float lod_ratio,
+                               std::size_t max_level,
+                               std::size_t max_chunks,
+                               std::size_t num_workers)
+ :heights_{}
+ ,height_width_{heightmap.width}
+ ,height_height_{heightmap.height}
+ ,height_scale_{height_scale}
+ ,grid_size_{grid_size}
+ ,lod_ratio_{lod_ratio}
+ ,max_level_{max_level}
+ ,max_chunks_{std::max(max_chunks, std::size_t{6})}
+ ,element_BO_{0}
+ ,chunks_{}
+ ,frame_{0}
+ ,camera_{0.0f}
+ ,frustum_{}
+ ,selection_{}
+ ,requests_{}
+ ,pending_{}
+ ,mutex_{}
+ ,condition_{}
+ ,queue_{}
+ ,generated_{}
+ ,stop_{false}
+ ,workers_{}
+{
+  std::size_t components = 0;
+  if (heightmap.channels == GL_RED) components = 1;
+  else if (heightmap.channels == GL_RG) components = 2;
+  else if (heightmap.channels == GL_RGB) components = 3;
+  else if (heightmap.channels == GL_RGBA) components = 4;
+  if (components == 0 || heightmap.channel_type != GL_UNSIGNED_BYTE || !heightmap.pixels ||
+      heightmap.width == 0 || heightmap.height == 0) {
+    throw std::logic_error("sphere_terrain: heightmap must be an 8 bit image");
+  }
+  // odd vertices morph onto their even neighbours
+  if (grid_size < 2 || grid_size % 2 != 0) {
+    throw std::logic_error("sphere_terrain: grid size must be even");
+  }
+  // the key holds 24 bits per coordinate
+  if (max_level > 24) {
+    throw std::logic_error("sphere_terrain: at most 24 levels are supported");
+  }
+
+  // workers sample the heights while generating chunks
+  std::uint8_t const* pixels = static_cast<std::uint8_t const*>(heightmap.ptr());
+  heights_.resize(height_width_ * height_height_);
+  for (std::size_t i = 0; i < heights_.size(); ++i) {
+    heights_[i] = float(pixels[i * components]) / 255.0f;
+  }
+
+  // all chunks share the triangulation of their grid
+  std::vector<GLuint> indices{};
+  GLuint const row = GLuint(grid_size_ + 1);
+  for (GLuint j = 0; j < GLuint(grid_size_); ++j) {
+    for (GLuint i = 0; i < GLuint(grid_size_); ++i) {
+      GLuint const corner = j * row + i;
+      // diagonals run the same way in every quad, so the odd vertices can
+      // morph onto the triangles of the coarser grid
+      indices.insert(indices.end(), {corner, corner + 1, corner + row + 1});
+      indices.insert(indices.end(), {corner, corner + row + 1, corner + row});
+    }
+  }
+  // the element binding belongs to the bound vertex array, so none may be
+  // bound, whichever was set up last would draw with these indices
+  glBindVertexArray(0);
+  glGenBuffers(1, &element_BO_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_BO_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(GLuint)), indices.data(),
+               GL_STATIC_DRAW);
+
+  // roots are always resident, the coarsest fallback
+  for (std::size_t root_face = 0; root_face < 6; ++root_face) {
+    chunk_key const root = key(root_face, 0, 0, 0);
+    upload(generate(root));
+  }
+
+  for (std::size_t i = 0; i < std::max(num_workers, std::size_t{1}); ++i) {
+    workers_.emplace_back(&sphere_terrain::work, this);
+  }
+}
+
+sphere_terrain::~sphere_terrain() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+
+  for (auto& resident : chunks_) {
+    glDeleteBuffers(1, &resident.second.object.vertex_BO);
+    glDeleteVertexArrays(1, &resident.second.object.vertex_AO);
+  }
+  glDeleteBuffers(1, &element_BO_);
+}
+
+void sphere_terrain::update(glm::fvec3 const& camera, std::array<glm::fvec4, 6> const& frustum,
+                            std::size_t max_uploads) {
+  std::vector<generated_chunk> generated{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::size_t const num_chunks = std::min(max_uploads, generated_.size());
+    std::move(generated_.begin(), generated_.begin() + long(num_chunks), std::back_inserter(generated));
+    generated_.erase(generated_.begin(), generated_.begin() + long(num_chunks));
+  }
+  for (auto const& finished : generated) {
+    pending_.erase(finished.key);
+    upload(finished);
+  }
+
+  camera_ = camera;
+  frustum_ = frustum;
+  selection_.clear();
+  for (std::size_t root_face = 0; root_face < 6; ++root_face) {
+    select(key(root_face, 0, 0, 0));
+  }
+
+  // coarse chunks first, they replace more triangles
+  std::sort(requests_.begin(), requests_.end(), [](chunk_key a, chunk_key b) {
+    return level(a) < level(b);
+  });
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (chunk_key requested : requests_) {
+      if (queue_.size() < max_queued_chunks) {
+        queue_.push_back(requested);
+      }
+      else {
+        pending_.erase(requested);
+      }
+    }
+  }
+  condition_.notify_all();
+  requests_.clear();
+
+  evict();
+  ++frame_;
+}
+
+std::vector<sphere_terrain::chunk_draw> const& sphere_terrain::selection() const {
+  return selection_;
+}
+
+GLsizei sphere_terrain::num_elements() const {
+  return GLsizei(grid_size_ * grid_size_ * 6);
+}
+
+std::size_t sphere_terrain::triangles() const {
+  return selection_.size() * grid_size_ * grid_size_ * 2;
+}
+
+float sphere_terrain::radius() const {
+  // heights are scaled from [0, 1]
+  return 1.0f + height_scale_;
+}
+
+std::size_t sphere_terrain::resident_chunks() const {
+  return chunks_.size();
+}
+
+std::size_t sphere_terrain::pending_chunks() const {
+  return pending_.size();
+}
+
+sphere_terrain::chunk_key sphere_terrain::key(std::size_t face, std::size_t level, std::size_t x, std::size_t y) {
+  return chunk_key(face) << 61 | chunk_key(level) << 48 | chunk_key(x) << 24 | chunk_key(y);
+}
+
+std::size_t sphere_terrain::face(chunk_key key) {
+  return std::size_t(key >> 61);
+}
+
+std::size_t sphere_terrain::level(chunk_key key) {
+  return std::size_t(key >> 48 & 0x1F);
+}
+
+std::size_t sphere_terrain::x(chunk_key key) {
+  return std::size_t(key >> 24 & 0xFFFFFF);
+}
+
+std::size_t sphere_terrain::y(chunk_key key) {
+  return std::size_t(key & 0xFFFFFF);
+}
+
+glm::dvec3 sphere_terrain::direction(std::size_t face, double s, double t) {
+  // normal and first axis of the cube faces, the second axis completes them
+  // so that the grid winds counter clockwise seen from outside
+  static glm::dvec3 const normals[6] = {{1.0, 0.0, 0.0}, {-1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
+                                        {0.0, -1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, -1.0}};
+  static glm::dvec3 const axes[6] = {{0.0, 0.0, -1.0}, {0.0, 0.0, 1.0}, {1.0, 0.0, 0.0},
+                                     {1.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {-1.0, 0.0, 0.0}};
+  glm::dvec3 const& normal = normals[face];
+  glm::dvec3 const& axis = axes[face];
+  return glm::normalize(normal + (2.0 * s - 1.0) * axis + (2.0 * t - 1.0) * glm::cross(normal, axis));
+}
+
+sphere_terrain::bounding_sphere sphere_terrain::bounds(chunk_key key) const {
+  double const size = 1.0 / double(1u << level(key));
+  double const s0 = double(x(key)) * size;
+  double const t0 = double(y(key)) * size;
+
+  // samples on the ground and at the highest possible height
+  std::size_t const samples = 5;
+  glm::dvec3 points[samples * samples * 2];
+  glm::dvec3 center{0.0};
+  for (std::size_t j = 0; j < samples; ++j) {
+    for (std::size_t i = 0; i < samples; ++i) {
+      glm::dvec3 const point = direction(face(key), s0 + size * double(i) / double(samples - 1),
+                                         t0 + size * double(j) / double(samples - 1));
+      points[(j * samples + i) * 2] = point;
+      points[(j * samples + i) * 2 + 1] = point * (1.0 + double(height_scale_));
+      center += point * (2.0 + double(height_scale_));
+    }
+  }
+  center /= double(samples * samples * 2);
+  double radius = 0.0;
+  for (glm::dvec3 const& point : points) {
+    radius = std::max(radius, glm::length(point - center));
+  }
+  // the surface bulges between the samples
+  radius += 0.25 * size * size;
+  return bounding_sphere{glm::fvec3{center}, float(radius)};
+}
+
+bool sphere_terrain::visible(bounding_sphere const& sphere) const {
+  for (glm::fvec4 const& plane : frustum_) {
+    if (glm::dot(glm::fvec3{plane}, sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+
+  // a point at the highest height is hidden once its angle to the camera
+  // exceeds those of the tangents from the camera and from the point
+  float const camera_distance = glm::length(camera_);
+  float const center_distance = glm::length(sphere.center);
+  if (camera_distance <= 1.0f || center_distance <= sphere.radius) {
+    return true;
+  }
+  float const angle = std::acos(glm::clamp(glm::dot(camera_, sphere.center) / (camera_distance * center_distance),
+                                           -1.0f, 1.0f));
+  float const extent = std::asin(sphere.radius / center_distance);
+  float const horizon = std::acos(1.0f / camera_distance) + std::acos(1.0f / (1.0f + height_scale_));
+  return angle - extent <= horizon;
+}
+
+float sphere_terrain::range(std::size_t level) const {
+  // edge length of a chunk on the unit sphere
+  return lod_ratio_ * glm::half_pi<float>() / float(1u << level);
+}
+
+double sphere_terrain::height(double u, double v) const {
+  double const x = u * double(height_width_) - 0.5;
+  double const y = glm::clamp(v * double(height_height_) - 0.5, 0.0, double(height_height_ - 1));
+  double const x_floor = std::floor(x);
+  double const y_floor = std::floor(y);
+  double const fx = x - x_floor;
+  double const fy = y - y_floor;
+
+  long const width = long(height_width_);
+  std::size_t const x0 = std::size_t(((long(x_floor) % width) + width) % width);
+  std::size_t const x1 = (x0 + 1) % height_width_;
+  std::size_t const y0 = std::size_t(y_floor);
+  std::size_t const y1 = std::min(y0 + 1, height_height_ - 1);
+
+  double const top = double(heights_[y0 * height_width_ + x0]) * (1.0 - fx) + double(heights_[y0 * height_width_ + x1]) * fx;
+  double const bottom = double(heights_[y1 * height_width_ + x0]) * (1.0 - fx) + double(heights_[y1 * height_width_ + x1]) * fx;
+  return top * (1.0 - fy) + bottom * fy;
+}
+
+sphere_terrain::generated_chunk sphere_terrain::generate(chunk_key key) const {
+  std::size_t const side = grid_size_ + 1;
+  double const size = 1.0 / double(1u << level(key));
+  double const s0 = double(x(key)) * size;
+  double const t0 = double(y(key)) * size;
+
+  // positions with a ring around the chunk for the normals at its edge
+  std::size_t const ring_side = side + 2;
+  std::vector<glm::dvec3> positions(ring_side * ring_side);
+  std::vector<double> us(side * side);
+  std::vector<double> vs(side * side);
+  for (std::size_t j = 0; j < ring_side; ++j) {
+    for (std::size_t i = 0; i < ring_side; ++i) {
+      glm::dvec3 const dir = direction(face(key), s0 + size * (double(i) - 1.0) / double(grid_size_),
+                                       t0 + size * (double(j) - 1.0) / double(grid_size_));
+      // texcoords grow eastwards and southwards like those of the spheres
+      double u = 0.5 - std::atan2(dir.z, dir.x) / (2.0 * glm::pi<double>());
+      u = u >= 1.0 ? 0.0 : u;
+      double const v = 0.5 - std::asin(glm::clamp(dir.y, -1.0, 1.0)) / glm::pi<double>();
+      positions[j * ring_side + i] = dir * (1.0 + double(height_scale_) * height(u, v));
+      if (i > 0 && j > 0 && i <= side && j <= side) {
+        us[(j - 1) * side + (i - 1)] = u;
+        vs[(j - 1) * side + (i - 1)] = v;
+      }
+    }
+  }
+
+  // chunks on the seam continue beyond 1, poles take the mean longitude
+  double min_u = 1.0;
+  double max_u = 0.0;
+  double sum_u = 0.0;
+  std::size_t num_u = 0;
+  std::vector<bool> pole(side * side, false);
+  for (std::size_t j = 0; j < side; ++j) {
+    for (std::size_t i = 0; i < side; ++i) {
+      glm::dvec3 const& position = positions[(j + 1) * ring_side + i + 1];
+      pole[j * side + i] = std::abs(position.x) < 1e-9 && std::abs(position.z) < 1e-9;
+      if (!pole[j * side + i]) {
+        min_u = std::min(min_u, us[j * side + i]);
+        max_u = std::max(max_u, us[j * side + i]);
+      }
+    }
+  }
+  bool const on_seam = max_u - min_u > 0.5;
+  for (std::size_t i = 0; i < us.size(); ++i) {
+    if (!pole[i]) {
+      us[i] += on_seam && us[i] < 0.5 ? 1.0 : 0.0;
+      sum_u += us[i];
+      ++num_u;
+    }
+  }
+  for (std::size_t i = 0; i < us.size(); ++i) {
+    us[i] = pole[i] && num_u > 0 ? sum_u / double(num_u) : us[i];
+  }
+
+  auto position = [&](std::size_t i, std::size_t j) -> glm::dvec3 const& {
+    return positions[(j + 1) * ring_side + i + 1];
+  };
+  std::vector<GLfloat> vertices{};
+  vertices.reserve(side * side * vertex_floats);
+  glm::dvec3 lower{position(0, 0)};
+  glm::dvec3 upper{position(0, 0)};
+  for (std::size_t j = 0; j < side; ++j) {
+    for (std::size_t i = 0; i < side; ++i) {
+      glm::dvec3 const& center = position(i, j);
+      glm::dvec3 const normal = glm::normalize(glm::cross(positions[(j + 1) * ring_side + i + 2] - positions[(j + 1) * ring_side + i],
+                                                          positions[(j + 2) * ring_side + i + 1] - positions[j * ring_side + i + 1]));
+      // odd vertices lie on the edges and diagonals of the coarser grid
+      glm::dvec3 target = center;
+      if (i % 2 == 1 && j % 2 == 1) {
+        target = 0.5 * (position(i - 1, j - 1) + position(i + 1, j + 1));
+      }
+      else if (i % 2 == 1) {
+        target = 0.5 * (position(i - 1, j) + position(i + 1, j));
+      }
+      else if (j % 2 == 1) {
+        target = 0.5 * (position(i, j - 1) + position(i, j + 1));
+      }
+
+      lower = glm::min(lower, center);
+      upper = glm::max(upper, center);
+      vertices.insert(vertices.end(), {GLfloat(center.x), GLfloat(center.y), GLfloat(center.z),
+                                       GLfloat(normal.x), GLfloat(normal.y), GLfloat(normal.z),
+                                       GLfloat(us[j * side + i]), GLfloat(vs[j * side + i]),
+                                       GLfloat(target.x), GLfloat(target.y), GLfloat(target.z)});
+    }
+  }
+
+  // morph targets lie between the vertices, so the sphere encloses them too
+  glm::dvec3 const middle = 0.5 * (lower + upper);
+  double radius = 0.0;
+  for (std::size_t j = 0; j < side; ++j) {
+    for (std::size_t i = 0; i < side; ++i) {
+      radius = std::max(radius, glm::length(position(i, j) - middle));
+    }
+  }
+  return generated_chunk{key, std::move(vertices), bounding_sphere{glm::fvec3{middle}, float(radius)}};
+}
+
+void sphere_terrain::upload(generated_chunk const& generated) {
+  chunk resident{model_object{}, generated.bounds, frame_};
+  resident.object.draw_mode = GL_TRIANGLES;
+  resident.object.num_elements = num_elements();
+  resident.object.element_BO = element_BO_;
+
+  glGenVertexArrays(1, &resident.object.vertex_AO);
+  glBindVertexArray(resident.object.vertex_AO);
+  glGenBuffers(1, &resident.object.vertex_BO);
+  glBindBuffer(GL_ARRAY_BUFFER, resident.object.vertex_BO);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(generated.vertices.size() * sizeof(GLfloat)),
+               generated.vertices.data(), GL_STATIC_DRAW);
+
+  // same locations as the attributes of the models
+  GLsizei const stride = GLsizei(vertex_floats * sizeof(GLfloat));
+  GLuint const components[4] = {3, 3, 2, 3};
+  std::size_t offset = 0;
+  for (GLuint location = 0; location < 4; ++location) {
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, GLint(components[location]), GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<GLvoid*>(offset * sizeof(GLfloat)));
+    offset += components[location];
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_BO_);
+  glBindVertexArray(0);
+
+  chunks_[generated.key] = resident;
+}
+
+void sphere_terrain::select(chunk_key key) {
+  chunk& current = chunks_.at(key);
+  bounding_sphere const& sphere = current.bounds;
+  if (!visible(sphere)) {
+    return;
+  }
+  current.last_used = frame_;
+
+  std::size_t const current_level = level(key);
+  float const distance = std::max(glm::length(camera_ - sphere.center) - sphere.radius, 0.0f);
+  if (current_level < max_level_ && distance < range(current_level + 1)) {
+    chunk_key children[4];
+    bool ready = true;
+    for (std::size_t child = 0; child < 4; ++child) {
+      children[child] = sphere_terrain::key(face(key), current_level + 1,
+                                            x(key) * 2 + child % 2, y(key) * 2 + child / 2);
+      // hidden children are not drawn, so they need not be resident
+      if (chunks_.count(children[child]) == 0 && visible(bounds(children[child]))) {
+        ready = false;
+        if (pending_.insert(children[child]).second) {
+          requests_.push_back(children[child]);
+        }
+      }
+    }
+    if (ready) {
+      for (chunk_key child : children) {
+        if (chunks_.count(child) > 0) {
+          select(child);
+        }
+      }
+      return;
+    }
+  }
+
+  float const morph_end = range(current_level);
+  selection_.push_back(chunk_draw{current.object.vertex_AO, morph_start_fraction * morph_end, morph_end});
+}
+
+void sphere_terrain::evict() {
+  if (chunks_.size() <= max_chunks_) {
+    return;
+  }
+  // roots and chunks of this frame stay
+  std::vector<std::pair<std::size_t, chunk_key>> candidates{};
+  for (auto const& resident : chunks_) {
+    if (level(resident.first) > 0 && resident.second.last_used < frame_) {
+      candidates.emplace_back(resident.second.last_used, resident.first);
+    }
+  }
+  std::size_t const num_evicted = std::min(candidates.size(), chunks_.size() - max_chunks_);
+  std::partial_sort(candidates.begin(), candidates.begin() + long(num_evicted), candidates.end());
+  for (std::size_t i = 0; i < num_evicted; ++i) {
+    chunk& evicted = chunks_.at(candidates[i].second);
+    glDeleteBuffers(1, &evicted.object.vertex_BO);
+    glDeleteVertexArrays(1, &evicted.object.vertex_AO);
+    chunks_.erase(candidates[i].second);
+  }
+}
+
+void sphere_terrain::work() {
+  while (true) {
+    chunk_key requested = 0;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      condition_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      requested = queue_.front();
+      queue_.pop_front();
+    }
+
+    generated_chunk finished = generate(requested);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    generated_.push_back(std::move(finished));
+  }
+}
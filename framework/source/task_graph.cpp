@@ -0,0 +1,116 @@
+#include "task_graph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+task_graph::task_graph(job_system& jobs)
+ :jobs_{jobs}
+ ,stages_{}
+ ,indices_{}
+ ,duration_{0.0}
+{}
+
+void task_graph::add(std::string const& name, std::vector<std::string> const& inputs,
+                     std::function<void()> const& function, job_system::affinity where) {
+  if (indices_.count(name) > 0) {
+    throw std::logic_error("task_graph: stage " + name + " was added before");
+  }
+  stage added{name, {}, function, where, 0.0, 0.0};
+  for (auto const& input : inputs) {
+    added.inputs.push_back(index(input));
+  }
+  indices_[name] = stages_.size();
+  stages_.push_back(added);
+}
+
+void task_graph::run() {
+  auto const start = std::chrono::steady_clock::now();
+  auto const seconds = [start]() {
+    return std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count();
+  };
+
+  // inputs come before the stages using them, so their handles exist
+  std::vector<job_system::handle> handles{};
+  for (auto& current : stages_) {
+    std::vector<job_system::handle> inputs{};
+    for (std::size_t input : current.inputs) {
+      inputs.push_back(handles[input]);
+    }
+    // every task writes the times of its own stage only
+    stage* const timed = &current;
+    handles.push_back(jobs_.run([timed, seconds]() {
+      timed->started = seconds();
+      timed->function();
+      timed->finished = seconds();
+    }, inputs, current.where));
+  }
+  jobs_.wait(handles);
+  duration_ = seconds();
+}
+
+double task_graph::started(std::string const& name) const {
+  return stages_[index(name)].started;
+}
+
+double task_graph::finished(std::string const& name) const {
+  return stages_[index(name)].finished;
+}
+
+double task_graph::parallelism() const {
+  double busy = 0.0;
+  for (auto const& current : stages_) {
+    busy += current.finished - current.started;
+  }
+  return duration_ > 0.0 ? busy / duration_ : 0.0;
+}
+
+std::vector<std::string> task_graph::critical_path() const {
+  std::vector<std::string> path{};
+  if (stages_.empty()) {
+    return path;
+  }
+  auto const later = [this](std::size_t a, std::size_t b) {
+    return stages_[a].finished < stages_[b].finished;
+  };
+  std::vector<std::size_t> all(stages_.size());
+  for (std::size_t i = 0; i < all.size(); ++i) {
+    all[i] = i;
+  }
+
+  // walk back from the last stage along the input which finished last
+  std::size_t current = *std::max_element(all.begin(), all.end(), later);
+  path.push_back(stages_[current].name);
+  while (!stages_[current].inputs.empty()) {
+    auto const& inputs = stages_[current].inputs;
+    current = *std::max_element(inputs.begin(), inputs.end(), later);
+    path.push_back(stages_[current].name);
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+void task_graph::print_critical_path(std::ostream& stream) const {
+  std::vector<std::string> const path = critical_path();
+  // formatted apart, so the stream keeps its own precision
+  std::ostringstream text{};
+  text << std::fixed << std::setprecision(1) << "critical path of " << 1000.0 * duration_ << " ms, "
+       << std::setprecision(2) << parallelism() << " stages at once on average\n";
+  for (auto const& name : path) {
+    stage const& current = stages_[index(name)];
+    text << std::setprecision(1) << std::setw(9) << 1000.0 * current.started << " -"
+         << std::setw(8) << 1000.0 * current.finished << " ms  " << current.name
+         << (current.where == job_system::affinity::main_thread ? " (main thread)" : "") << '\n';
+  }
+  stream << text.str() << std::flush;
+}
+
+std::size_t task_graph::index(std::string const& name) const {
+  auto const found = indices_.find(name);
+  if (found == indices_.end()) {
+    throw std::logic_error("task_graph: there is no stage " + name);
+  }
+  return found->second;
+}
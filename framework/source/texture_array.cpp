@@ -0,0 +1,107 @@
+#include "texture_array.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+texture_array::texture_array(std::size_t width, std::size_t height, std::size_t num_layers)
+ :width_{width}
+ ,height_{height}
+ ,sources_(num_layers, layer_source{0, 0})
+ ,changed_{false}
+ ,texture_{0, GL_TEXTURE_2D_ARRAY}
+ ,framebuffer_{0}
+ ,vertex_array_{0}
+{
+  if (width_ == 0 || height_ == 0 || num_layers == 0) {
+    throw std::logic_error("texture array needs at least one texel and layer");
+  }
+  std::size_t num_levels = 1;
+  while ((std::max(width_, height_) >> num_levels) > 0) {
+    ++num_levels;
+  }
+
+  glGenTextures(1, &texture_.handle);
+  glBindTexture(texture_.target, texture_.handle);
+  glTexStorage3D(texture_.target, GLsizei(num_levels), GL_RGBA8, GLsizei(width_), GLsizei(height_),
+                 GLsizei(num_layers));
+  // texcoords of the spheres continue beyond 1 across the seam
+  glTexParameteri(texture_.target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(texture_.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(texture_.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(texture_.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(texture_.target, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glGenVertexArrays(1, &vertex_array_);
+}
+
+texture_array::~texture_array() {
+  glDeleteTextures(1, &texture_.handle);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteVertexArrays(1, &vertex_array_);
+}
+
+bool texture_array::set_layer(GLuint program, std::size_t layer, texture_object const& source,
+                              std::size_t version) {
+  if (layer >= sources_.size()) {
+    throw std::out_of_range("layer " + std::to_string(layer) + " exceeds the texture array");
+  }
+  if (sources_[layer].handle == source.handle && sources_[layer].version == version) {
+    return false;
+  }
+
+  GLint previous_framebuffer = 0;
+  GLint previous_viewport[4] = {0, 0, 0, 0};
+  GLint previous_unit = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGetIntegerv(GL_VIEWPORT, previous_viewport);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &previous_unit);
+  GLboolean const depth_test = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_DEPTH_TEST);
+
+  // the sampler takes the level matching the layer size from the
+  // derivatives, larger sources are filtered through their own mip chain
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "source_Texture"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(source.target, source.handle);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_.handle, 0, GLint(layer));
+  glViewport(0, 0, GLsizei(width_), GLsizei(height_));
+  glBindVertexArray(vertex_array_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  glActiveTexture(GLenum(previous_unit));
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer));
+  glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+  if (depth_test == GL_TRUE) {
+    glEnable(GL_DEPTH_TEST);
+  }
+
+  sources_[layer] = layer_source{source.handle, version};
+  changed_ = true;
+  return true;
+}
+
+void texture_array::update_mipmaps() {
+  if (!changed_) {
+    return;
+  }
+  glBindTexture(texture_.target, texture_.handle);
+  glGenerateMipmap(texture_.target);
+  glBindTexture(texture_.target, 0);
+  changed_ = false;
+}
+
+texture_object const& texture_array::texture() const {
+  return texture_;
+}
+
+std::size_t texture_array::num_layers() const {
+  return sources_.size();
+}
@@ -0,0 +1,288 @@
+#include "texture_compressor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// intensity modifiers of the ETC1 codeword tables
+static int const MODIFIERS[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+// bytes of one 4x4 block
+static std::size_t const BLOCK_BYTES = 8;
+
+// best encoding of a subblock for a given base color
+struct subblock_fit {
+  unsigned table;
+  // 2 bit modifier index per pixel, in subblock order
+  unsigned indices[8];
+  unsigned error;
+};
+
+// encode 4x4 rgba pixels, rows are stored consecutively
+static std::uint64_t encode_block(std::uint8_t const* pixels);
+// decode 4x4 block to rgba pixels
+static void decode_block(std::uint64_t block, std::uint8_t* pixels);
+// pixel index in the block of the i-th pixel of a subblock
+static unsigned subblock_pixel(unsigned subblock, unsigned flip, unsigned i);
+
+namespace texture_compressor {
+
+pixel_data etc2(pixel_data const& image) {
+  if (image.channels != GL_RGBA || image.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::logic_error("texture_compressor: etc2 requires 8 bit rgba pixels");
+  }
+
+  std::vector<pixel_data::mip_level> levels{};
+  std::size_t total_bytes = 0;
+  for (std::size_t level = 0; level < image.num_levels(); ++level) {
+    std::size_t const blocks = ((image.level_width(level) + 3) / 4) * ((image.level_height(level) + 3) / 4);
+    levels.push_back(pixel_data::mip_level{total_bytes, blocks * BLOCK_BYTES});
+    total_bytes += blocks * BLOCK_BYTES;
+  }
+
+  pixel_data compressed{new std::uint8_t[total_bytes], [](std::uint8_t* ptr) { delete[] ptr; }, total_bytes,
+                        GL_COMPRESSED_RGB8_ETC2, GL_NONE, image.width, image.height};
+  compressed.mip_levels = levels;
+
+  for (std::size_t level = 0; level < image.num_levels(); ++level) {
+    std::size_t const width = image.level_width(level);
+    std::size_t const height = image.level_height(level);
+    std::uint8_t const* source = static_cast<std::uint8_t const*>(image.ptr(level));
+    std::uint8_t* target = compressed.pixels.get() + levels[level].offset;
+
+    for (std::size_t block_y = 0; block_y < height; block_y += 4) {
+      for (std::size_t block_x = 0; block_x < width; block_x += 4) {
+        // gather block, repeating the edge pixels of partial blocks
+        std::uint8_t block[16 * 4];
+        for (std::size_t y = 0; y < 4; ++y) {
+          for (std::size_t x = 0; x < 4; ++x) {
+            std::size_t const source_x = std::min(block_x + x, width - 1);
+            std::size_t const source_y = std::min(block_y + y, height - 1);
+            std::memcpy(block + (y * 4 + x) * 4, source + (source_y * width + source_x) * 4, 4);
+          }
+        }
+        std::uint64_t const bits = encode_block(block);
+        // blocks are stored big endian
+        for (unsigned byte = 0; byte < BLOCK_BYTES; ++byte) {
+          target[byte] = std::uint8_t(bits >> (56 - byte * 8));
+        }
+        target += BLOCK_BYTES;
+      }
+    }
+  }
+
+  return compressed;
+}
+
+pixel_data decode_etc2(pixel_data const& compressed) {
+  if (compressed.channels != GL_COMPRESSED_RGB8_ETC2) {
+    throw std::logic_error("texture_compressor: texture is not etc2 compressed");
+  }
+
+  std::vector<pixel_data::mip_level> levels{};
+  std::size_t total_bytes = 0;
+  for (std::size_t level = 0; level < compressed.num_levels(); ++level) {
+    std::size_t const level_bytes = compressed.level_width(level) * compressed.level_height(level) * 4;
+    levels.push_back(pixel_data::mip_level{total_bytes, level_bytes});
+    total_bytes += level_bytes;
+  }
+
+  pixel_data image{new std::uint8_t[total_bytes], [](std::uint8_t* ptr) { delete[] ptr; }, total_bytes,
+                   GL_RGBA, GL_UNSIGNED_BYTE, compressed.width, compressed.height};
+  image.mip_levels = levels;
+
+  for (std::size_t level = 0; level < compressed.num_levels(); ++level) {
+    std::size_t const width = compressed.level_width(level);
+    std::size_t const height = compressed.level_height(level);
+    std::uint8_t const* source = static_cast<std::uint8_t const*>(compressed.ptr(level));
+    std::uint8_t* target = image.pixels.get() + levels[level].offset;
+
+    for (std::size_t block_y = 0; block_y < height; block_y += 4) {
+      for (std::size_t block_x = 0; block_x < width; block_x += 4) {
+        std::uint64_t bits = 0;
+        for (unsigned byte = 0; byte < BLOCK_BYTES; ++byte) {
+          bits = (bits << 8) | source[byte];
+        }
+        source += BLOCK_BYTES;
+
+        std::uint8_t block[16 * 4];
+        decode_block(bits, block);
+        // skip pixels of partial blocks outside the image
+        for (std::size_t y = 0; y < 4 && block_y + y < height; ++y) {
+          for (std::size_t x = 0; x < 4 && block_x + x < width; ++x) {
+            std::memcpy(target + ((block_y + y) * width + block_x + x) * 4, block + (y * 4 + x) * 4, 4);
+          }
+        }
+      }
+    }
+  }
+
+  return image;
+}
+
+}
+
+///////////////////////////// local helper functions //////////////////////////
+static unsigned subblock_pixel(unsigned subblock, unsigned flip, unsigned i) {
+  // without flip the subblocks are 2x4 side by side, with flip 4x2 on top of each other
+  unsigned const x = flip ? i % 4 : subblock * 2 + i / 4;
+  unsigned const y = flip ? subblock * 2 + i / 4 : i % 4;
+  return y * 4 + x;
+}
+
+static std::uint8_t clamp_channel(int value) {
+  return std::uint8_t(std::min(255, std::max(0, value)));
+}
+
+// choose table and modifiers with the least squared error for the base color
+static subblock_fit fit_subblock(std::uint8_t const* pixels, unsigned subblock, unsigned flip, int const base[3]) {
+  subblock_fit best{};
+  best.error = std::numeric_limits<unsigned>::max();
+
+  for (unsigned table = 0; table < 8; ++table) {
+    // index order is +small, +large, -small, -large
+    int const modifiers[4] = {MODIFIERS[table][0], MODIFIERS[table][1], -MODIFIERS[table][0], -MODIFIERS[table][1]};
+    subblock_fit fit{};
+    fit.table = table;
+    for (unsigned i = 0; i < 8 && fit.error < best.error; ++i) {
+      std::uint8_t const* pixel = pixels + subblock_pixel(subblock, flip, i) * 4;
+      unsigned best_pixel_error = std::numeric_limits<unsigned>::max();
+      for (unsigned index = 0; index < 4; ++index) {
+        unsigned pixel_error = 0;
+        for (unsigned c = 0; c < 3; ++c) {
+          int const difference = int(clamp_channel(base[c] + modifiers[index])) - int(pixel[c]);
+          pixel_error += unsigned(difference * difference);
+        }
+        if (pixel_error < best_pixel_error) {
+          best_pixel_error = pixel_error;
+          fit.indices[i] = index;
+        }
+      }
+      fit.error += best_pixel_error;
+    }
+    if (fit.error < best.error) {
+      best = fit;
+    }
+  }
+
+  return best;
+}
+
+static std::uint64_t encode_block(std::uint8_t const* pixels) {
+  std::uint64_t best_bits = 0;
+  unsigned best_error = std::numeric_limits<unsigned>::max();
+
+  for (unsigned flip = 0; flip < 2; ++flip) {
+    // average color of both subblocks
+    float average[2][3] = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+    for (unsigned subblock = 0; subblock < 2; ++subblock) {
+      for (unsigned i = 0; i < 8; ++i) {
+        for (unsigned c = 0; c < 3; ++c) {
+          average[subblock][c] += pixels[subblock_pixel(subblock, flip, i) * 4 + c] / 8.0f;
+        }
+      }
+    }
+
+    // differential mode stores 5 bit colors, valid if their difference fits 3 bit
+    int quantized[2][3];
+    bool differential = true;
+    for (unsigned c = 0; c < 3; ++c) {
+      quantized[0][c] = int(average[0][c] * 31.0f / 255.0f + 0.5f);
+      quantized[1][c] = int(average[1][c] * 31.0f / 255.0f + 0.5f);
+      int const difference = quantized[1][c] - quantized[0][c];
+      differential = differential && difference >= -4 && difference <= 3;
+    }
+    if (!differential) {
+      // individual mode stores two 4 bit colors
+      for (unsigned c = 0; c < 3; ++c) {
+        quantized[0][c] = int(average[0][c] * 15.0f / 255.0f + 0.5f);
+        quantized[1][c] = int(average[1][c] * 15.0f / 255.0f + 0.5f);
+      }
+    }
+
+    int base[2][3];
+    for (unsigned subblock = 0; subblock < 2; ++subblock) {
+      for (unsigned c = 0; c < 3; ++c) {
+        int const q = quantized[subblock][c];
+        base[subblock][c] = differential ? (q << 3) | (q >> 2) : (q << 4) | q;
+      }
+    }
+
+    subblock_fit const fits[2] = {fit_subblock(pixels, 0, flip, base[0]), fit_subblock(pixels, 1, flip, base[1])};
+    unsigned const error = fits[0].error + fits[1].error;
+    if (error >= best_error) {
+      continue;
+    }
+    best_error = error;
+
+    std::uint64_t bits = 0;
+    for (unsigned c = 0; c < 3; ++c) {
+      std::uint64_t channel = 0;
+      if (differential) {
+        channel = std::uint64_t(quantized[0][c]) << 3 | std::uint64_t((quantized[1][c] - quantized[0][c]) & 0x7);
+      }
+      else {
+        channel = std::uint64_t(quantized[0][c]) << 4 | std::uint64_t(quantized[1][c]);
+      }
+      bits |= channel << (56 - c * 8);
+    }
+    bits |= std::uint64_t(fits[0].table) << 37;
+    bits |= std::uint64_t(fits[1].table) << 34;
+    bits |= std::uint64_t(differential ? 1 : 0) << 33;
+    bits |= std::uint64_t(flip) << 32;
+    // pixel indices are stored column major, msb and lsb in separate halves
+    for (unsigned subblock = 0; subblock < 2; ++subblock) {
+      for (unsigned i = 0; i < 8; ++i) {
+        unsigned const pixel = subblock_pixel(subblock, flip, i);
+        unsigned const column_major = (pixel % 4) * 4 + pixel / 4;
+        unsigned const index = fits[subblock].indices[i];
+        bits |= std::uint64_t(index >> 1) << (16 + column_major);
+        bits |= std::uint64_t(index & 1) << column_major;
+      }
+    }
+    best_bits = bits;
+  }
+
+  return best_bits;
+}
+
+static void decode_block(std::uint64_t block, std::uint8_t* pixels) {
+  bool const differential = (block >> 33) & 1;
+  unsigned const flip = unsigned(block >> 32) & 1;
+
+  int base[2][3];
+  for (unsigned c = 0; c < 3; ++c) {
+    unsigned const channel = unsigned(block >> (56 - c * 8)) & 0xFF;
+    if (differential) {
+      int const first = int(channel >> 3);
+      // sign extend 3 bit difference
+      int const second = first + (int(channel & 0x7) ^ 0x4) - 0x4;
+      if (second < 0 || second > 31) {
+        throw std::runtime_error("texture_compressor: etc2 T, H and planar blocks are not supported");
+      }
+      base[0][c] = (first << 3) | (first >> 2);
+      base[1][c] = (second << 3) | (second >> 2);
+    }
+    else {
+      base[0][c] = int(channel >> 4) * 17;
+      base[1][c] = int(channel & 0xF) * 17;
+    }
+  }
+
+  unsigned const tables[2] = {unsigned(block >> 37) & 0x7, unsigned(block >> 34) & 0x7};
+  for (unsigned subblock = 0; subblock < 2; ++subblock) {
+    int const modifiers[4] = {MODIFIERS[tables[subblock]][0], MODIFIERS[tables[subblock]][1],
+                              -MODIFIERS[tables[subblock]][0], -MODIFIERS[tables[subblock]][1]};
+    for (unsigned i = 0; i < 8; ++i) {
+      unsigned const pixel = subblock_pixel(subblock, flip, i);
+      unsigned const column_major = (pixel % 4) * 4 + pixel / 4;
+      unsigned const index = unsigned((block >> (16 + column_major)) & 1) << 1 | unsigned((block >> column_major) & 1);
+      for (unsigned c = 0; c < 3; ++c) {
+        pixels[pixel * 4 + c] = clamp_channel(base[subblock][c] + modifiers[index]);
+      }
+      pixels[pixel * 4 + 3] = 255;
+    }
+  }
+}
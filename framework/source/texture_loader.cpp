@@ -1,5 +1,9 @@
 #include "texture_loader.hpp"
 
+#include "job_system.hpp"
+#include "ktx_file.hpp"
+#include "texture_compressor.hpp"
+
 // request supported types
 #define STBI_ONLY_JPEG
 #define STBI_ONLY_PNG
@@ -11,14 +15,379 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
  
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
 #include <cstdint> 
 #include <cstring> 
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <stdexcept> 
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include <sys/stat.h>
+
+// load file from cache or decode it
+static pixel_data load(std::string const& file_name);
+// load compressed file from cache or encode it
+static pixel_data load_compressed(std::string const& file_name);
+// return cache entry if it belongs to the version of the file identified by key
+static bool read_cache(std::string const& cache_name, ktx_file::key_values const& key, pixel_data& cached);
+// store cache entry, failing is not fatal
+static void write_cache(std::string const& cache_name, ktx_file::key_values const& key, pixel_data const& texture);
+// decode file flipped vertically, to match the opengl representation, into
+// a buffer with room for the mip chain after level 0
+static pixel_data decode(std::string const& file_name);
+// identify the version of a file for the cache
+static ktx_file::key_values cache_key(std::string const& file_name);
+
+// weights of the source pixels 2 * x + first_offset + i for target pixel x
+struct filter_taps {
+  int first_offset;
+  std::vector<float> weights;
+};
+// levels of the complete mip chain of an 8 bit image, ending with 1x1
+static std::vector<pixel_data::mip_level> chain_levels(std::size_t width, std::size_t height,
+                                                       std::size_t num_components);
+// filter the levels after level 0 inside the buffer of the chain
+static void filter_chain(pixel_data& chain, texture_loader::mip_filter filter, bool srgb, simd_lanes lanes);
+// taps for halving the size along one axis
+static filter_taps downsample_taps(texture_loader::mip_filter filter);
+// convert 8 bit pixels to float rgba, srgb channels are linearized
+static std::vector<float> to_linear(std::uint8_t const* pixels, std::size_t width, std::size_t height,
+                                    std::size_t num_components, std::size_t srgb_components);
+// convert float rgba to 8 bit pixels, srgb channels are encoded again
+static void from_linear(std::vector<float> const& source, std::size_t width, std::size_t height,
+                        std::uint8_t* pixels, std::size_t num_components, std::size_t srgb_components);
+// filter float rgba image to the target size, first along rows then along columns
+static std::vector<float> downsample(std::vector<float> const& source, filter_taps const& taps,
+                                     std::size_t source_width, std::size_t source_height,
+                                     std::size_t target_width, std::size_t target_height, simd_lanes lanes);
+// call function with ranges of rows, large images are split across the job system
+static void parallel_rows(std::size_t num_rows, std::size_t row_pixels,
+                          std::function<void(std::size_t, std::size_t)> const& function);
+
 namespace texture_loader {
 pixel_data file(std::string const& file_name) {
-  // match to opengl representation
-  stbi_set_flip_vertically_on_load(true);
+  return load(file_name);
+}
+
+pixel_data compressed_file(std::string const& file_name) {
+  return load_compressed(file_name);
+}
+
+std::vector<std::future<pixel_data>> files(std::vector<std::string> const& file_names, bool compressed) {
+  std::vector<std::future<pixel_data>> futures{};
+  for (auto const& name : file_names) {
+    // tasks are copied, so they share the promise
+    std::shared_ptr<std::promise<pixel_data>> result = std::make_shared<std::promise<pixel_data>>();
+    futures.push_back(result->get_future());
+    job_system::shared().run([result, name, compressed]() {
+      try {
+        result->set_value(compressed ? load_compressed(name) : load(name));
+      }
+      catch (...) {
+        // rethrown on the thread calling get()
+        result->set_exception(std::current_exception());
+      }
+    });
+  }
+
+  return futures;
+}
+
+pixel_data mipmaps(pixel_data const& image, mip_filter filter, bool srgb, simd_lanes lanes) {
+  if (image.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::logic_error("texture_loader: mipmaps only support 8 bit channels");
+  }
+  std::size_t const num_components = image.size() / (image.width * image.height);
+  if (num_components > 4) {
+    throw std::logic_error("texture_loader: mipmaps support at most 4 channels");
+  }
+
+  std::vector<pixel_data::mip_level> const levels = chain_levels(image.width, image.height, num_components);
+  std::size_t const total_bytes = levels.back().offset + levels.back().size;
+  pixel_data chain{new std::uint8_t[total_bytes], [](std::uint8_t* ptr) { delete[] ptr; }, total_bytes,
+                   image.channels, image.channel_type, image.width, image.height};
+  chain.mip_levels = levels;
+  std::memcpy(chain.pixels.get(), image.ptr(), levels[0].size);
+  filter_chain(chain, filter, srgb, lanes);
+
+  return chain;
+}
+
+}
+
+///////////////////////////// local helper functions //////////////////////////
+static pixel_data load(std::string const& file_name) {
+  std::string const cache_name = file_name + ".ktx";
+  ktx_file::key_values const key = cache_key(file_name);
+
+  pixel_data texture{};
+  if (!read_cache(cache_name, key, texture)) {
+    // level 0 stays where stb_image decoded it
+    texture = decode(file_name);
+    filter_chain(texture, texture_loader::mip_filter::kaiser, true, widest_simd_lanes());
+    write_cache(cache_name, key, texture);
+  }
+
+  return texture;
+}
+
+static pixel_data load_compressed(std::string const& file_name) {
+  std::string const cache_name = file_name + ".etc2.ktx";
+  ktx_file::key_values const key = cache_key(file_name);
+
+  pixel_data texture{};
+  if (!read_cache(cache_name, key, texture)) {
+    // encode from the uncompressed mip chain, which may be cached as well
+    texture = texture_compressor::etc2(load(file_name));
+    write_cache(cache_name, key, texture);
+  }
+
+  return texture;
+}
+
+static bool read_cache(std::string const& cache_name, ktx_file::key_values const& key, pixel_data& cached) {
+  try {
+    ktx_file::key_values metadata{};
+    pixel_data entry = ktx_file::read(cache_name, &metadata);
+    for (auto const& pair : key) {
+      if (metadata[pair.first] != pair.second) {
+        return false;
+      }
+    }
+    cached = std::move(entry);
+    return true;
+  }
+  catch (std::exception const&) {
+    // no usable cache entry
+    return false;
+  }
+}
+
+static void write_cache(std::string const& cache_name, ktx_file::key_values const& key, pixel_data const& texture) {
+  try {
+    ktx_file::write(cache_name, texture, key);
+  }
+  catch (std::exception const& error) {
+    // resource directory may be read only, loading still succeeded
+    std::cerr << error.what() << std::endl;
+  }
+}
+
+static ktx_file::key_values cache_key(std::string const& file_name) {
+  ktx_file::key_values key{};
+  key["source"] = file_name;
+  // chains built with other filters are outdated
+  key["mipmaps"] = "kaiser_srgb";
+
+  struct stat status;
+  if (stat(file_name.c_str(), &status) == 0) {
+    key["source_size"] = std::to_string(status.st_size);
+    key["source_mtime"] = std::to_string(status.st_mtime);
+  }
+
+  return key;
+}
+
+static filter_taps downsample_taps(texture_loader::mip_filter filter) {
+  if (filter == texture_loader::mip_filter::box) {
+    return filter_taps{0, {0.5f, 0.5f}};
+  }
+
+  // sinc lowpass at half the sample rate, windowed to 6 taps
+  double const alpha = 4.0;
+  double const radius = 3.0;
+  // zeroth order modified bessel function of the first kind
+  auto bessel_i0 = [](double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  };
+
+  filter_taps taps{-2, std::vector<float>(6)};
+  double total = 0.0;
+  std::vector<double> weights(taps.weights.size());
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    // distance from the target pixel center in source pixels
+    double const distance = double(taps.first_offset) + double(i) - 0.5;
+    double const x = distance * 0.5 * M_PI;
+    double const sinc = std::abs(x) < 1e-8 ? 1.0 : std::sin(x) / x;
+    double const t = distance / radius;
+    double const window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / bessel_i0(alpha);
+    weights[i] = sinc * window;
+    total += weights[i];
+  }
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    taps.weights[i] = float(weights[i] / total);
+  }
+
+  return taps;
+}
+
+static std::vector<float> to_linear(std::uint8_t const* pixels, std::size_t width, std::size_t height,
+                                    std::size_t num_components, std::size_t srgb_components) {
+  // C++11 guarantees thread-safe initialization
+  static std::array<float, 256> const srgb_table = []() {
+    std::array<float, 256> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      double const value = double(i) / 255.0;
+      table[i] = float(value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4));
+    }
+    return table;
+  }();
+
+  std::vector<float> linear(width * height * 4, 0.0f);
+  parallel_rows(height, width, [&](std::size_t first_row, std::size_t end_row) {
+    for (std::size_t i = first_row * width; i < end_row * width; ++i) {
+      for (std::size_t c = 0; c < num_components; ++c) {
+        std::uint8_t const value = pixels[i * num_components + c];
+        linear[i * 4 + c] = c < srgb_components ? srgb_table[value] : float(value) / 255.0f;
+      }
+    }
+  });
+
+  return linear;
+}
+
+static void from_linear(std::vector<float> const& source, std::size_t width, std::size_t height,
+                        std::uint8_t* pixels, std::size_t num_components, std::size_t srgb_components) {
+  // fine enough that the error stays below one 8 bit step
+  static std::size_t const table_size = 4096;
+  static std::array<std::uint8_t, table_size> const srgb_table = []() {
+    std::array<std::uint8_t, table_size> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      double const value = double(i) / double(table_size - 1);
+      double const encoded = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+      table[i] = std::uint8_t(encoded * 255.0 + 0.5);
+    }
+    return table;
+  }();
+
+  parallel_rows(height, width, [&](std::size_t first_row, std::size_t end_row) {
+    for (std::size_t i = first_row * width; i < end_row * width; ++i) {
+      for (std::size_t c = 0; c < num_components; ++c) {
+        // sinc filters overshoot at sharp edges
+        float const value = std::min(std::max(source[i * 4 + c], 0.0f), 1.0f);
+        pixels[i * num_components + c] = c < srgb_components
+                                       ? srgb_table[std::size_t(value * float(table_size - 1) + 0.5f)]
+                                       : std::uint8_t(value * 255.0f + 0.5f);
+      }
+    }
+  });
+}
+
+static std::vector<float> downsample(std::vector<float> const& source, filter_taps const& taps,
+                                     std::size_t source_width, std::size_t source_height,
+                                     std::size_t target_width, std::size_t target_height, simd_lanes lanes) {
+  std::size_t const num_taps = taps.weights.size();
+  // unused in builds without simd
+  static_cast<void>(lanes);
+  // source pixel of tap, clamped at the edges
+  auto tap_index = [&taps](std::size_t target, std::size_t tap, std::size_t source_size) {
+    long const index = long(target * 2) + long(taps.first_offset) + long(tap);
+    return std::size_t(std::min(std::max(index, 0l), long(source_size) - 1));
+  };
+
+  // along rows, each rgba pixel is one vector
+  std::vector<float> rows(target_width * source_height * 4);
+  parallel_rows(source_height, source_width, [&](std::size_t first_row, std::size_t end_row) {
+    for (std::size_t y = first_row; y < end_row; ++y) {
+      float const* source_row = source.data() + y * source_width * 4;
+      float* target_row = rows.data() + y * target_width * 4;
+      for (std::size_t x = 0; x < target_width; ++x) {
+#if defined(__SSE__)
+        if (lanes != simd_lanes::scalar) {
+          __m128 sum = _mm_setzero_ps();
+          for (std::size_t tap = 0; tap < num_taps; ++tap) {
+            __m128 const pixel = _mm_loadu_ps(source_row + tap_index(x, tap, source_width) * 4);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[tap]), pixel));
+          }
+          _mm_storeu_ps(target_row + x * 4, sum);
+          continue;
+        }
+#endif
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (std::size_t tap = 0; tap < num_taps; ++tap) {
+          float const* pixel = source_row + tap_index(x, tap, source_width) * 4;
+          for (std::size_t c = 0; c < 4; ++c) {
+            sum[c] += taps.weights[tap] * pixel[c];
+          }
+        }
+        std::copy(sum, sum + 4, target_row + x * 4);
+      }
+    }
+  });
+
+  // along columns, whole rows are weighted so the floats are contiguous
+  std::vector<float> target(target_width * target_height * 4);
+  std::size_t const row_floats = target_width * 4;
+  parallel_rows(target_height, target_width, [&](std::size_t first_row, std::size_t end_row) {
+    std::vector<float const*> source_rows(num_taps);
+    for (std::size_t y = first_row; y < end_row; ++y) {
+      for (std::size_t tap = 0; tap < num_taps; ++tap) {
+        source_rows[tap] = rows.data() + tap_index(y, tap, source_height) * row_floats;
+      }
+      float* target_row = target.data() + y * row_floats;
+
+      std::size_t i = 0;
+#if defined(__AVX__)
+      for (; lanes == simd_lanes::avx && i + 8 <= row_floats; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (std::size_t tap = 0; tap < num_taps; ++tap) {
+          sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(taps.weights[tap]),
+                                                 _mm256_loadu_ps(source_rows[tap] + i)));
+        }
+        _mm256_storeu_ps(target_row + i, sum);
+      }
+#endif
+#if defined(__SSE__)
+      for (; lanes != simd_lanes::scalar && i + 4 <= row_floats; i += 4) {
+        __m128 sum = _mm_setzero_ps();
+        for (std::size_t tap = 0; tap < num_taps; ++tap) {
+          sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[tap]), _mm_loadu_ps(source_rows[tap] + i)));
+        }
+        _mm_storeu_ps(target_row + i, sum);
+      }
+#endif
+      for (; i < row_floats; ++i) {
+        float sum = 0.0f;
+        for (std::size_t tap = 0; tap < num_taps; ++tap) {
+          sum += taps.weights[tap] * source_rows[tap][i];
+        }
+        target_row[i] = sum;
+      }
+    }
+  });
+
+  return target;
+}
+
+static void parallel_rows(std::size_t num_rows, std::size_t row_pixels,
+                          std::function<void(std::size_t, std::size_t)> const& function) {
+  // tasks only pay off with enough pixels each
+  std::size_t const min_pixels = 1 << 16;
+  std::size_t const rows_per_task = std::max(std::size_t{1}, min_pixels / std::max(row_pixels, std::size_t{1}));
+  job_system::shared().parallel_for(num_rows, rows_per_task, function);
+}
+
+static pixel_data decode(std::string const& file_name) {
+  // the flag is global stb state, set once before the first decode reads
+  // it, so threads decoding at the same time do not write it
+  static bool const flipped = (stbi_set_flip_vertically_on_load(true), true);
+  static_cast<void>(flipped);
 
   uint8_t* data_ptr;
   int width = 0;
@@ -30,35 +399,56 @@ pixel_data file(std::string const& file_name) {
     throw std::logic_error(std::string{"stb_image: "} + stbi_failure_reason());
   }
 
-  // determine format of image data, internal format should be sized
-  GLenum pixel_format = GL_NONE;
-  std::size_t num_components = 0;
-  if (format == STBI_grey) {
-    pixel_format = GL_RED;
-    num_components = 1;
-  }
-  else if (format == STBI_grey_alpha) {
-    pixel_format = GL_RG;
-    num_components = 2;
-  }
-  else if (format == STBI_rgb) {
-    pixel_format = GL_RGB;
-    num_components = 3;
-  }
-  else if (format == STBI_rgb_alpha) {
-    pixel_format = GL_RGBA;
-    num_components = 4;
+  // stb_image converted the image to the requested rgba format
+  std::vector<pixel_data::mip_level> const levels = chain_levels(std::size_t(width), std::size_t(height), 4);
+  std::size_t const num_bytes = levels.back().offset + levels.back().size;
+
+  // keep the buffer allocated by stb_image instead of copying it, it comes
+  // from malloc and is grown for the chain, in place where realloc can
+  uint8_t* const chain_ptr = static_cast<uint8_t*>(std::realloc(data_ptr, num_bytes));
+  if (!chain_ptr) {
+    stbi_image_free(data_ptr);
+    throw std::bad_alloc{};
   }
-  else {
-    throw std::logic_error("stb_image: misinterpreted data, incorrect format");
+  pixel_data image{chain_ptr, [](std::uint8_t* ptr) { stbi_image_free(ptr); }, num_bytes,
+                   GL_RGBA, GL_UNSIGNED_BYTE, std::size_t(width), std::size_t(height)};
+  image.mip_levels = levels;
+  return image;
+}
+
+static std::vector<pixel_data::mip_level> chain_levels(std::size_t width, std::size_t height,
+                                                       std::size_t num_components) {
+  std::vector<pixel_data::mip_level> levels{};
+  std::size_t total_bytes = 0;
+  for (std::size_t level = 0; ; ++level) {
+    std::size_t const level_width = std::max(width >> level, std::size_t{1});
+    std::size_t const level_height = std::max(height >> level, std::size_t{1});
+    std::size_t const level_bytes = level_width * level_height * num_components;
+    levels.push_back(pixel_data::mip_level{total_bytes, level_bytes});
+    total_bytes += level_bytes;
+    if (level_width == 1 && level_height == 1) {
+      break;
+    }
   }
+  return levels;
+}
 
-  std::vector<uint8_t> texture_data(width * height * num_components);
-  // copy data to vector
-  std::memcpy(&texture_data[0], data_ptr, texture_data.size());
-  stbi_image_free(data_ptr);
+static void filter_chain(pixel_data& chain, texture_loader::mip_filter filter, bool srgb, simd_lanes lanes) {
+  std::size_t const num_components = chain.mip_levels[0].size / (chain.width * chain.height);
+  // alpha and non-color channels are stored linearly
+  std::size_t const srgb_components = srgb && num_components >= 3 ? 3 : 0;
 
-  return pixel_data{texture_data, pixel_format, GL_UNSIGNED_BYTE, std::size_t(width), std::size_t(height)};
-}
+  // filter in float rgba, so successive levels are not quantized and each
+  // pixel fits a simd register
+  std::vector<float> source = to_linear(chain.pixels.get(), chain.width, chain.height,
+                                        num_components, srgb_components);
+  filter_taps const taps = downsample_taps(filter);
 
-}
\ No newline at end of file
+  for (std::size_t level = 1; level < chain.num_levels(); ++level) {
+    std::vector<float> target = downsample(source, taps, chain.level_width(level - 1), chain.level_height(level - 1),
+                                           chain.level_width(level), chain.level_height(level), lanes);
+    from_linear(target, chain.level_width(level), chain.level_height(level),
+                chain.pixels.get() + chain.mip_levels[level].offset, num_components, srgb_components);
+    source = std::move(target);
+  }
+}
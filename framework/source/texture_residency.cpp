@@ -0,0 +1,206 @@
+#include "texture_residency.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+
+texture_residency::texture_residency(texture_streamer& streamer, std::size_t budget_bytes)
+ :streamer_(streamer)
+ ,budget_{budget_bytes}
+ ,resident_bytes_{0}
+ ,pending_bytes_{0}
+ ,entries_{}
+{}
+
+texture_residency::texture_id texture_residency::add(texture_object const& texture,
+                                                     std::future<pixel_data>&& pixels,
+                                                     ready_callback const& on_ready) {
+  entry texture_entry{texture, std::move(pixels), nullptr, on_ready, 0.0f, 0, 0, 0, false};
+  entries_.push_back(std::move(texture_entry));
+  return entries_.size() - 1;
+}
+
+void texture_residency::request(texture_id id, float screen_size) {
+  entries_.at(id).screen_size = screen_size;
+}
+
+void texture_residency::update() {
+  std::vector<texture_id> requests{};
+
+  for (texture_id id = 0; id < entries_.size(); ++id) {
+    entry& texture = entries_[id];
+    if (!texture.pixels) {
+      // wait for decoding to finish
+      if (texture.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        continue;
+      }
+      texture.pixels = std::make_shared<pixel_data>(texture.future.get());
+      std::size_t const num_levels = texture.pixels->num_levels();
+
+      texture.base_level = num_levels;
+      // without a mip chain the single level counts as coarse
+      texture.coarse_level = num_levels - 1;
+      while (texture.coarse_level > 0 &&
+             texture.pixels->level_width(texture.coarse_level - 1) <= coarse_size &&
+             texture.pixels->level_height(texture.coarse_level - 1) <= coarse_size) {
+        --texture.coarse_level;
+      }
+      // coarse levels are loaded regardless of the budget
+      glBindTexture(texture.texture.target, texture.texture.handle);
+      glTexParameteri(texture.texture.target, GL_TEXTURE_BASE_LEVEL, GLint(texture.coarse_level));
+      glTexParameteri(texture.texture.target, GL_TEXTURE_MAX_LEVEL, GLint(num_levels - 1));
+      load(id, texture.coarse_level);
+      continue;
+    }
+
+    // finest level which is not magnified
+    texture.wanted_level = texture.coarse_level;
+    while (texture.screen_size > 0.0f && texture.wanted_level > 0 && need(texture, texture.wanted_level) > 1.0f) {
+      --texture.wanted_level;
+    }
+
+    if (!texture.loading && texture.base_level > texture.wanted_level) {
+      requests.push_back(id);
+    }
+  }
+
+  // most magnified textures first
+  std::sort(requests.begin(), requests.end(), [this](texture_id a, texture_id b) {
+    return need(entries_[a], entries_[a].base_level - 1) > need(entries_[b], entries_[b].base_level - 1);
+  });
+
+  for (texture_id id : requests) {
+    entry const& texture = entries_[id];
+    std::size_t const level = texture.base_level - 1;
+    std::size_t const bytes = level_bytes(texture, level, texture.base_level);
+    float const requested_need = need(texture, level);
+
+    // make room by evicting levels which are needed less than the requested one
+    bool fits = true;
+    while (resident_bytes_ + pending_bytes_ + bytes > budget_) {
+      texture_id const victim = eviction_candidate();
+      if (victim == entries_.size() || need(entries_[victim], entries_[victim].base_level) >= requested_need) {
+        fits = false;
+        break;
+      }
+      evict(victim);
+    }
+    if (!fits) {
+      break;
+    }
+    load(id, level);
+  }
+
+  // budget may have been lowered
+  while (resident_bytes_ > budget_) {
+    texture_id const victim = eviction_candidate();
+    if (victim == entries_.size()) {
+      break;
+    }
+    evict(victim);
+  }
+}
+
+std::size_t texture_residency::budget() const {
+  return budget_;
+}
+
+void texture_residency::set_budget(std::size_t budget_bytes) {
+  budget_ = budget_bytes;
+}
+
+std::size_t texture_residency::resident_bytes() const {
+  return resident_bytes_;
+}
+
+std::size_t texture_residency::pending_bytes() const {
+  return pending_bytes_;
+}
+
+std::size_t texture_residency::pending() const {
+  return std::size_t(std::count_if(entries_.begin(), entries_.end(), [](entry const& texture) {
+    return !texture.pixels || texture.loading;
+  }));
+}
+
+std::size_t texture_residency::base_level(texture_id id) const {
+  return entries_.at(id).base_level;
+}
+
+float texture_residency::need(entry const& texture, std::size_t level) {
+  return texture.screen_size / float(texture.pixels->level_width(level));
+}
+
+std::size_t texture_residency::level_bytes(entry const& texture, std::size_t first_level, std::size_t end_level) {
+  std::size_t bytes = 0;
+  for (std::size_t level = first_level; level < end_level; ++level) {
+    bytes += texture.pixels->mip_levels[level].size;
+  }
+  return bytes;
+}
+
+void texture_residency::load(texture_id id, std::size_t first_level) {
+  entry& texture = entries_[id];
+  texture.loading = true;
+  pending_bytes_ += level_bytes(texture, first_level, texture.base_level);
+
+  // entries may be reallocated until the upload completes, capture the id
+  streamer_.upload_levels(texture.texture, texture.pixels, first_level, texture.base_level,
+                          [this, id, first_level](texture_object const&) {
+                            loaded(id, first_level);
+                          });
+}
+
+void texture_residency::loaded(texture_id id, std::size_t first_level) {
+  entry& texture = entries_[id];
+  std::size_t const bytes = level_bytes(texture, first_level, texture.base_level);
+  pending_bytes_ -= bytes;
+  resident_bytes_ += bytes;
+
+  bool const first_upload = texture.base_level == texture.pixels->num_levels();
+  texture.base_level = first_level;
+  texture.loading = false;
+
+  glBindTexture(texture.texture.target, texture.texture.handle);
+  glTexParameteri(texture.texture.target, GL_TEXTURE_BASE_LEVEL, GLint(first_level));
+
+  if (first_upload && texture.on_ready) {
+    texture.on_ready(texture.texture);
+  }
+}
+
+void texture_residency::evict(texture_id id) {
+  entry& texture = entries_[id];
+  std::size_t const level = texture.base_level;
+  resident_bytes_ -= level_bytes(texture, level, level + 1);
+  ++texture.base_level;
+
+  // stop sampling the level, then release its storage by respecifying it empty
+  glBindTexture(texture.texture.target, texture.texture.handle);
+  glTexParameteri(texture.texture.target, GL_TEXTURE_BASE_LEVEL, GLint(texture.base_level));
+  if (texture.pixels->channel_type == GL_NONE) {
+    glCompressedTexImage2D(texture.texture.target, GLint(level), texture.pixels->channels, 0, 0, 0, 0, NULL);
+  }
+  else {
+    glTexImage2D(texture.texture.target, GLint(level), texture.pixels->channels, 0, 0, 0,
+                 texture.pixels->channels, texture.pixels->channel_type, NULL);
+  }
+}
+
+texture_residency::texture_id texture_residency::eviction_candidate() const {
+  texture_id candidate = entries_.size();
+  for (texture_id id = 0; id < entries_.size(); ++id) {
+    entry const& texture = entries_[id];
+    // levels of textures with uploads in flight are needed by them
+    if (!texture.pixels || texture.loading || texture.base_level >= texture.coarse_level) {
+      continue;
+    }
+    if (candidate == entries_.size() ||
+        need(texture, texture.base_level) < need(entries_[candidate], entries_[candidate].base_level)) {
+      candidate = id;
+    }
+  }
+  return candidate;
+}
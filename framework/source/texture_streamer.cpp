@@ -0,0 +1,266 @@
+#include "texture_streamer.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding 
+using namespace gl;
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// bytes of one pixel with the given format and type
+static std::size_t pixel_bytes(GLenum channels, GLenum channel_type);
+// whether pixels hold blocks of a compressed format instead of pixels
+static bool is_compressed(pixel_data const& pixels);
+// edge length of the blocks which compressed formats consist of
+static std::size_t const block_size = 4;
+
+texture_streamer::texture_streamer(std::size_t num_buffers, std::size_t buffer_bytes)
+ :buffers_(num_buffers)
+ ,next_buffer_{0}
+ ,jobs_{}
+ ,placeholder_{0, GL_TEXTURE_2D}
+{
+  for (auto& buffer : buffers_) {
+    glGenBuffers(1, &buffer.handle);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.handle);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, buffer_bytes, NULL, GL_STREAM_DRAW);
+    buffer.fence = nullptr;
+    buffer.size = buffer_bytes;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // neutral grey until the real pixels arrive
+  std::uint8_t const grey[4] = {128, 128, 128, 255};
+  glGenTextures(1, &placeholder_.handle);
+  glBindTexture(placeholder_.target, placeholder_.handle);
+  glTexParameteri(placeholder_.target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(placeholder_.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(placeholder_.target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+texture_streamer::~texture_streamer() {
+  for (auto& buffer : buffers_) {
+    if (buffer.fence) {
+      glDeleteSync(buffer.fence);
+    }
+    glDeleteBuffers(1, &buffer.handle);
+  }
+  glDeleteTextures(1, &placeholder_.handle);
+}
+
+texture_object texture_streamer::placeholder() const {
+  return placeholder_;
+}
+
+void texture_streamer::upload(texture_object const& texture,
+                              std::future<pixel_data>&& pixels,
+                              completion_callback const& on_complete,
+                              bool mipmaps) {
+  upload_job job{texture, std::move(pixels), nullptr, on_complete, mipmaps, true, false, 0, 0, 0};
+  jobs_.push_back(std::move(job));
+}
+
+void texture_streamer::upload_levels(texture_object const& texture,
+                                     std::shared_ptr<pixel_data const> const& pixels,
+                                     std::size_t first_level,
+                                     std::size_t end_level,
+                                     completion_callback const& on_complete) {
+  if (first_level >= end_level || end_level > pixels->num_levels()) {
+    throw std::logic_error("texture_streamer: invalid level range");
+  }
+  upload_job job{texture, std::future<pixel_data>{}, pixels, on_complete, true, false, false,
+                 first_level, 0, end_level};
+  jobs_.push_back(std::move(job));
+}
+
+void texture_streamer::update(std::size_t max_bytes) {
+  std::size_t budget = max_bytes;
+
+  auto job = jobs_.begin();
+  while (job != jobs_.end() && budget > 0) {
+    if (!job->started) {
+      // skip textures which are still being decoded
+      if (job->future.valid()) {
+        if (job->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+          ++job;
+          continue;
+        }
+        // a file which failed to load keeps its placeholder
+        try {
+          job->pixels = std::make_shared<pixel_data>(job->future.get());
+        }
+        catch (std::exception const& error) {
+          std::cerr << error.what() << std::endl;
+          job = jobs_.erase(job);
+          continue;
+        }
+        job->end_level = job->mipmaps ? job->pixels->num_levels() : 1;
+      }
+      start(*job);
+    }
+
+    std::size_t uploaded = upload_rows(*job, budget);
+    // all buffers are in flight, continue next frame
+    if (uploaded == 0) {
+      break;
+    }
+    budget -= std::min(budget, uploaded);
+
+    if (job->level == job->end_level) {
+      glBindTexture(job->texture.target, job->texture.handle);
+      // pixels came without a mip chain, compressed formats cannot be rendered to
+      if (job->whole_texture && job->mipmaps && job->end_level == 1 && !is_compressed(*job->pixels)) {
+        glTexParameteri(job->texture.target, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(job->texture.target);
+      }
+      if (job->on_complete) {
+        job->on_complete(job->texture);
+      }
+      job = jobs_.erase(job);
+    }
+  }
+}
+
+std::size_t texture_streamer::pending() const {
+  return jobs_.size();
+}
+
+void texture_streamer::start(upload_job& job) {
+  pixel_data const& pixels = *job.pixels;
+  // allocate storage, rows are filled from the unpack buffers
+  glBindTexture(job.texture.target, job.texture.handle);
+  for (std::size_t level = job.level; level < job.end_level; ++level) {
+    if (is_compressed(pixels)) {
+      glCompressedTexImage2D(job.texture.target, GLint(level), pixels.channels,
+                             GLsizei(pixels.level_width(level)), GLsizei(pixels.level_height(level)), 0,
+                             GLsizei(pixels.mip_levels[level].size), NULL);
+    }
+    else {
+      glTexImage2D(job.texture.target, GLint(level), pixels.channels,
+                   GLsizei(pixels.level_width(level)), GLsizei(pixels.level_height(level)), 0,
+                   pixels.channels, pixels.channel_type, NULL);
+    }
+  }
+  if (job.whole_texture) {
+    glTexParameteri(job.texture.target, GL_TEXTURE_MAX_LEVEL, GLint(job.end_level - 1));
+  }
+  job.started = true;
+}
+
+texture_streamer::unpack_buffer* texture_streamer::acquire_buffer() {
+  unpack_buffer& buffer = buffers_[next_buffer_];
+  if (buffer.fence) {
+    // dont wait, the buffer is still read by the gpu
+    GLenum status = glClientWaitSync(buffer.fence, GL_NONE_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      return nullptr;
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+  }
+  // buffers are used round robin, so the oldest upload is checked first
+  next_buffer_ = (next_buffer_ + 1) % buffers_.size();
+  return &buffer;
+}
+
+std::size_t texture_streamer::upload_rows(upload_job& job, std::size_t max_bytes) {
+  pixel_data const& pixels = *job.pixels;
+
+  std::size_t uploaded = 0;
+  while (job.level < job.end_level && uploaded < max_bytes) {
+    std::size_t const width = pixels.level_width(job.level);
+    std::size_t const height = pixels.level_height(job.level);
+    // compressed levels are uploaded in rows of blocks
+    std::size_t row_height = 1;
+    std::size_t num_rows_level = height;
+    std::size_t row_bytes = width * pixel_bytes(pixels.channels, pixels.channel_type);
+    if (is_compressed(pixels)) {
+      row_height = block_size;
+      num_rows_level = (height + block_size - 1) / block_size;
+      row_bytes = pixels.mip_levels[job.level].size / num_rows_level;
+    }
+
+    unpack_buffer* buffer = acquire_buffer();
+    if (!buffer) {
+      break;
+    }
+    // at least one row per upload, even if it exceeds the budget
+    std::size_t num_rows = std::min(buffer->size, max_bytes - uploaded) / row_bytes;
+    num_rows = std::min(std::max(num_rows, std::size_t{1}), num_rows_level - job.next_row);
+    std::size_t const num_bytes = num_rows * row_bytes;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->handle);
+    // grow buffer if a single row does not fit
+    if (num_bytes > buffer->size) {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, num_bytes, NULL, GL_STREAM_DRAW);
+      buffer->size = num_bytes;
+    }
+    // fence guarantees the gpu is done with the buffer, no need to synchronize
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, num_bytes,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      throw std::runtime_error("texture_streamer: mapping of unpack buffer failed");
+    }
+    std::memcpy(mapped, static_cast<std::uint8_t const*>(pixels.ptr(job.level)) + job.next_row * row_bytes, num_bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(job.texture.target, job.texture.handle);
+    std::size_t const first_row = job.next_row * row_height;
+    std::size_t const region_height = std::min(num_rows * row_height, height - first_row);
+    if (is_compressed(pixels)) {
+      glCompressedTexSubImage2D(job.texture.target, GLint(job.level), 0, GLint(first_row),
+                                GLsizei(width), GLsizei(region_height),
+                                pixels.channels, GLsizei(num_bytes), NULL);
+    }
+    else {
+      glTexSubImage2D(job.texture.target, GLint(job.level), 0, GLint(first_row),
+                      GLsizei(width), GLsizei(region_height),
+                      pixels.channels, pixels.channel_type, NULL);
+    }
+    buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    job.next_row += num_rows;
+    uploaded += num_bytes;
+    if (job.next_row == num_rows_level) {
+      ++job.level;
+      job.next_row = 0;
+    }
+  }
+
+  return uploaded;
+}
+
+///////////////////////////// local helper functions //////////////////////////
+static std::size_t pixel_bytes(GLenum channels, GLenum channel_type) {
+  std::size_t num_components = 4;
+  if (channels == GL_RED) {
+    num_components = 1;
+  }
+  else if (channels == GL_RG) {
+    num_components = 2;
+  }
+  else if (channels == GL_RGB) {
+    num_components = 3;
+  }
+
+  std::size_t component_bytes = 1;
+  if (channel_type == GL_UNSIGNED_SHORT || channel_type == GL_HALF_FLOAT) {
+    component_bytes = 2;
+  }
+  else if (channel_type == GL_FLOAT || channel_type == GL_UNSIGNED_INT) {
+    component_bytes = 4;
+  }
+
+  return num_components * component_bytes;
+}
+
+static bool is_compressed(pixel_data const& pixels) {
+  return pixels.channel_type == GL_NONE;
+}
@@ -0,0 +1,101 @@
+#include "tile_cache.hpp"
+
+#include <iterator>
+#include <stdexcept>
+
+tile_cache::tile_key tile_cache::key(std::size_t level, std::size_t x, std::size_t y) {
+  if (level > 0xFF || x > 0xFFF || y > 0xFFF) {
+    throw std::out_of_range("tile_cache: tile coordinates out of range");
+  }
+  return tile_key(level << 24 | x << 12 | y);
+}
+
+std::size_t tile_cache::level(tile_key key) {
+  return key >> 24;
+}
+
+std::size_t tile_cache::x(tile_key key) {
+  return (key >> 12) & 0xFFF;
+}
+
+std::size_t tile_cache::y(tile_key key) {
+  return key & 0xFFF;
+}
+
+tile_cache::tile_cache(std::size_t num_slots)
+ :entries_{}
+ ,lookup_{}
+ ,free_slots_{}
+ ,capacity_{num_slots}
+{
+  // hand out the first slot first
+  for (std::size_t slot = num_slots; slot > 0; --slot) {
+    free_slots_.push_back(slot - 1);
+  }
+}
+
+std::size_t tile_cache::capacity() const {
+  return capacity_;
+}
+
+std::size_t tile_cache::size() const {
+  return entries_.size();
+}
+
+bool tile_cache::contains(tile_key key) const {
+  return lookup_.find(key) != lookup_.end();
+}
+
+std::size_t tile_cache::slot(tile_key key) const {
+  auto found = lookup_.find(key);
+  if (found == lookup_.end()) {
+    throw std::out_of_range("tile_cache: tile is not resident");
+  }
+  return found->second->slot;
+}
+
+bool tile_cache::touch(tile_key key, std::size_t frame) {
+  auto found = lookup_.find(key);
+  if (found == lookup_.end()) {
+    return false;
+  }
+  found->second->last_frame = frame;
+  // move to the front without invalidating the iterator
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return true;
+}
+
+bool tile_cache::insert(tile_key key, std::size_t frame, insertion& result, bool pinned) {
+  if (contains(key)) {
+    throw std::logic_error("tile_cache: tile is already resident");
+  }
+
+  result.evicted = false;
+  if (!free_slots_.empty()) {
+    result.slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  else {
+    // least recently used tile which is not pinned
+    auto victim = entries_.end();
+    for (auto entry = entries_.rbegin(); entry != entries_.rend(); ++entry) {
+      if (!entry->pinned) {
+        victim = std::prev(entry.base());
+        break;
+      }
+    }
+    // tiles drawn in this frame must stay
+    if (victim == entries_.end() || victim->last_frame == frame) {
+      return false;
+    }
+    result.slot = victim->slot;
+    result.evicted = true;
+    result.evicted_key = victim->key;
+    lookup_.erase(victim->key);
+    entries_.erase(victim);
+  }
+
+  entries_.push_front(entry{key, result.slot, frame, pinned});
+  lookup_[key] = entries_.begin();
+  return true;
+}
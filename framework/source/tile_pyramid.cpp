@@ -0,0 +1,365 @@
+#include "tile_pyramid.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static char const MAGIC[4] = {'V', 'T', 'E', 'X'};
+static std::uint32_t const VERSION = 1;
+
+// fields at the start of the file, tiles follow level by level in rows
+struct pyramid_header {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t tile_size;
+  std::uint32_t border;
+  std::uint32_t num_levels;
+  std::uint32_t reserved;
+};
+
+// number of levels until the image fits into a single tile
+static std::size_t count_levels(std::size_t width, std::size_t height, std::size_t tile_size);
+// pixels of a side of a level
+static std::size_t level_size(std::size_t size, std::size_t level);
+// tiles along a side of a level
+static std::size_t count_tiles(std::size_t pixels, std::size_t tile_size);
+// cut a level into tiles, written at offset of the file row of tiles by row
+// of tiles, returns the offset after the level
+static std::streamoff write_level(std::fstream& file, std::streamoff offset, std::size_t width,
+                                  std::size_t height, std::size_t tile_size, std::size_t border,
+                                  tile_pyramid::row_reader const& read_rows);
+
+// reads rows of a level back from its tiles in the file, the last row of
+// tiles read is kept since rows are read in pairs and mostly upwards
+class tile_rows {
+ public:
+  tile_rows(std::fstream& file, std::streamoff offset, std::size_t width, std::size_t height,
+            std::size_t tile_size, std::size_t border)
+   :file_(file)
+   ,offset_{offset}
+   ,width_{width}
+   ,height_{height}
+   ,tile_size_{tile_size}
+   ,border_{border}
+   ,tiles_x_{count_tiles(width, tile_size)}
+   ,tile_bytes_{(tile_size + 2 * border) * (tile_size + 2 * border) * 4}
+   ,tiles_y_read_{~std::size_t(0)}
+   ,tiles_{}
+  {}
+
+  std::size_t width() const {
+    return width_;
+  }
+
+  std::size_t height() const {
+    return height_;
+  }
+
+  // copy row of the level into pixels
+  void read(std::size_t row, std::uint8_t* pixels) {
+    std::size_t const tile_y = row / tile_size_;
+    if (tile_y != tiles_y_read_) {
+      tiles_.resize(tiles_x_ * tile_bytes_);
+      file_.seekg(offset_ + std::streamoff(tile_y * tiles_x_ * tile_bytes_));
+      file_.read(reinterpret_cast<char*>(tiles_.data()), std::streamsize(tiles_.size()));
+      if (!file_) {
+        throw std::runtime_error("tile_pyramid: reading back tiles failed");
+      }
+      tiles_y_read_ = tile_y;
+    }
+    std::size_t const side = tile_size_ + 2 * border_;
+    std::size_t const tile_row = row % tile_size_ + border_;
+    for (std::size_t x = 0; x < tiles_x_; ++x) {
+      std::size_t const columns = std::min(tile_size_, width_ - x * tile_size_);
+      std::memcpy(pixels + x * tile_size_ * 4, &tiles_[x * tile_bytes_ + (tile_row * side + border_) * 4],
+                  columns * 4);
+    }
+  }
+
+ private:
+  std::fstream& file_;
+  std::streamoff offset_;
+  std::size_t width_;
+  std::size_t height_;
+  std::size_t tile_size_;
+  std::size_t border_;
+  std::size_t tiles_x_;
+  std::size_t tile_bytes_;
+  std::size_t tiles_y_read_;
+  std::vector<std::uint8_t> tiles_;
+};
+
+// box filter pairs of rows of the finer level into rows of half the size,
+// colors are averaged in linear space
+static void reduce_rows(tile_rows& finer, std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels);
+
+void tile_pyramid::write(std::string const& file_name,
+                         std::size_t width,
+                         std::size_t height,
+                         row_reader const& read_rows,
+                         std::size_t tile_size,
+                         std::size_t border) {
+  if (width == 0 || height == 0) {
+    throw std::logic_error("tile_pyramid: empty images cannot be tiled");
+  }
+  if (tile_size == 0 || border > tile_size) {
+    throw std::logic_error("tile_pyramid: invalid tile size");
+  }
+
+  std::size_t const num_levels = count_levels(width, height, tile_size);
+  pyramid_header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = std::uint32_t(width);
+  header.height = std::uint32_t(height);
+  header.tile_size = std::uint32_t(tile_size);
+  header.border = std::uint32_t(border);
+  header.num_levels = std::uint32_t(num_levels);
+
+  // write next to the target and move it there when complete
+  std::string const temp_name = file_name + ".tmp";
+  {
+    std::fstream file{temp_name, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error("tile_pyramid: cannot write " + temp_name);
+    }
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+    std::streamoff level_offset = std::streamoff(sizeof(header));
+    std::streamoff next_offset = write_level(file, level_offset, width, height, tile_size, border, read_rows);
+    for (std::size_t level = 1; level < num_levels; ++level) {
+      tile_rows finer{file,
+                      level_offset,
+                      level_size(width, level - 1),
+                      level_size(height, level - 1),
+                      tile_size,
+                      border};
+      level_offset = next_offset;
+      next_offset = write_level(file, level_offset, level_size(width, level), level_size(height, level),
+                                tile_size, border,
+                                [&finer](std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels) {
+                                  reduce_rows(finer, first_row, num_rows, pixels);
+                                });
+    }
+    file.flush();
+    if (!file) {
+      throw std::runtime_error("tile_pyramid: writing " + temp_name + " failed");
+    }
+  }
+  std::remove(file_name.c_str());
+  if (std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+    throw std::runtime_error("tile_pyramid: cannot replace " + file_name);
+  }
+}
+
+void tile_pyramid::write(std::string const& file_name,
+                         pixel_data const& image,
+                         std::size_t tile_size,
+                         std::size_t border) {
+  if (image.channels != GL_RGBA || image.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::logic_error("tile_pyramid: only rgba8 images can be tiled");
+  }
+  std::uint8_t const* pixels = static_cast<std::uint8_t const*>(image.ptr());
+  std::size_t const row_bytes = image.width * 4;
+  write(file_name, image.width, image.height,
+        [pixels, row_bytes](std::size_t first_row, std::size_t num_rows, std::uint8_t* rows) {
+          std::memcpy(rows, pixels + first_row * row_bytes, num_rows * row_bytes);
+        },
+        tile_size, border);
+}
+
+tile_pyramid::tile_pyramid(std::string const& file_name)
+ :mapping_{}
+ ,width_{0}
+ ,height_{0}
+ ,tile_size_{0}
+ ,border_{0}
+ ,first_tiles_{}
+{
+  std::size_t file_size = 0;
+  mapping_ = utils::map_file(file_name, file_size);
+
+  pyramid_header header{};
+  if (file_size < sizeof(header)) {
+    throw std::runtime_error("tile_pyramid: " + file_name + " is truncated");
+  }
+  std::memcpy(&header, mapping_.get(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+    throw std::runtime_error("tile_pyramid: " + file_name + " is no tile pyramid");
+  }
+  width_ = header.width;
+  height_ = header.height;
+  tile_size_ = header.tile_size;
+  border_ = header.border;
+  if (tile_size_ == 0 || width_ == 0 || height_ == 0 ||
+      header.num_levels != count_levels(width_, height_, tile_size_)) {
+    throw std::runtime_error("tile_pyramid: " + file_name + " has an invalid layout");
+  }
+
+  std::size_t num_tiles = 0;
+  for (std::size_t level = 0; level < header.num_levels; ++level) {
+    first_tiles_.push_back(num_tiles);
+    num_tiles += tiles_x(level) * tiles_y(level);
+  }
+  if (file_size < sizeof(header) + num_tiles * tile_bytes()) {
+    throw std::runtime_error("tile_pyramid: " + file_name + " is truncated");
+  }
+}
+
+std::size_t tile_pyramid::width() const {
+  return width_;
+}
+
+std::size_t tile_pyramid::height() const {
+  return height_;
+}
+
+std::size_t tile_pyramid::tile_size() const {
+  return tile_size_;
+}
+
+std::size_t tile_pyramid::border() const {
+  return border_;
+}
+
+std::size_t tile_pyramid::num_levels() const {
+  return first_tiles_.size();
+}
+
+std::size_t tile_pyramid::level_width(std::size_t level) const {
+  return width_ >> level > 0 ? width_ >> level : 1;
+}
+
+std::size_t tile_pyramid::level_height(std::size_t level) const {
+  return height_ >> level > 0 ? height_ >> level : 1;
+}
+
+std::size_t tile_pyramid::tiles_x(std::size_t level) const {
+  return (level_width(level) + tile_size_ - 1) / tile_size_;
+}
+
+std::size_t tile_pyramid::tiles_y(std::size_t level) const {
+  return (level_height(level) + tile_size_ - 1) / tile_size_;
+}
+
+std::uint8_t const* tile_pyramid::tile(std::size_t level, std::size_t x, std::size_t y) const {
+  if (level >= num_levels() || x >= tiles_x(level) || y >= tiles_y(level)) {
+    throw std::out_of_range("tile_pyramid: tile does not exist");
+  }
+  std::size_t const index = first_tiles_[level] + y * tiles_x(level) + x;
+  return mapping_.get() + sizeof(pyramid_header) + index * tile_bytes();
+}
+
+std::size_t tile_pyramid::tile_bytes() const {
+  return (tile_size_ + 2 * border_) * (tile_size_ + 2 * border_) * 4;
+}
+
+///////////////////////////// local helper functions //////////////////////////
+static std::size_t level_size(std::size_t size, std::size_t level) {
+  return size >> level > 0 ? size >> level : 1;
+}
+
+static std::size_t count_tiles(std::size_t pixels, std::size_t tile_size) {
+  return (pixels + tile_size - 1) / tile_size;
+}
+
+static std::streamoff write_level(std::fstream& file, std::streamoff offset, std::size_t width,
+                                  std::size_t height, std::size_t tile_size, std::size_t border,
+                                  tile_pyramid::row_reader const& read_rows) {
+  std::size_t const side = tile_size + 2 * border;
+  std::size_t const tiles_x = count_tiles(width, tile_size);
+  std::size_t const tiles_y = count_tiles(height, tile_size);
+  std::vector<std::uint8_t> strip{};
+  std::vector<std::uint8_t> tiles(tiles_x * side * side * 4);
+
+  for (std::size_t y = 0; y < tiles_y; ++y) {
+    // rows of the tiles and their borders inside of the level
+    std::size_t const first_row = y * tile_size > border ? y * tile_size - border : 0;
+    std::size_t const end_row = std::min((y + 1) * tile_size + border, height);
+    strip.resize((end_row - first_row) * width * 4);
+    read_rows(first_row, end_row - first_row, strip.data());
+
+    for (std::size_t x = 0; x < tiles_x; ++x) {
+      std::uint8_t* tile = &tiles[x * side * side * 4];
+      // pixels outside of the level repeat its edge
+      for (std::size_t row = 0; row < side; ++row) {
+        long const source_row = long(y * tile_size + row) - long(border);
+        std::size_t const clamped_row = std::size_t(std::min(std::max(source_row, 0l), long(height) - 1));
+        std::uint8_t const* pixels = &strip[(clamped_row - first_row) * width * 4];
+        for (std::size_t column = 0; column < side; ++column) {
+          long const source_column = long(x * tile_size + column) - long(border);
+          std::size_t const clamped_column = std::size_t(std::min(std::max(source_column, 0l), long(width) - 1));
+          std::memcpy(&tile[(row * side + column) * 4], &pixels[clamped_column * 4], 4);
+        }
+      }
+    }
+    // rows of tiles follow each other in the file
+    file.seekp(offset);
+    file.write(reinterpret_cast<char const*>(tiles.data()), std::streamsize(tiles.size()));
+    offset += std::streamoff(tiles.size());
+  }
+  return offset;
+}
+
+static void reduce_rows(tile_rows& finer, std::size_t first_row, std::size_t num_rows, std::uint8_t* pixels) {
+  // C++11 guarantees thread-safe initialization
+  static std::array<float, 256> const to_linear = []() {
+    std::array<float, 256> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      double const value = double(i) / 255.0;
+      table[i] = float(value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4));
+    }
+    return table;
+  }();
+  // fine enough that the error stays below one 8 bit step
+  static std::size_t const table_size = 4096;
+  static std::array<std::uint8_t, table_size> const to_srgb = []() {
+    std::array<std::uint8_t, table_size> table{};
+    for (std::size_t i = 0; i < table.size(); ++i) {
+      double const value = double(i) / double(table_size - 1);
+      double const encoded = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+      table[i] = std::uint8_t(encoded * 255.0 + 0.5);
+    }
+    return table;
+  }();
+
+  std::size_t const finer_width = finer.width();
+  std::size_t const width = level_size(finer_width, 1);
+  std::vector<std::uint8_t> lower(finer_width * 4);
+  std::vector<std::uint8_t> upper(finer_width * 4);
+  for (std::size_t row = first_row; row < first_row + num_rows; ++row) {
+    // odd sizes drop their last row and column like the levels of gl
+    finer.read(std::min(2 * row, finer.height() - 1), lower.data());
+    finer.read(std::min(2 * row + 1, finer.height() - 1), upper.data());
+    std::uint8_t* target = pixels + (row - first_row) * width * 4;
+    for (std::size_t x = 0; x < width; ++x) {
+      std::size_t const left = std::min(2 * x, finer_width - 1) * 4;
+      std::size_t const right = std::min(2 * x + 1, finer_width - 1) * 4;
+      for (std::size_t c = 0; c < 3; ++c) {
+        float const linear = 0.25f * (to_linear[lower[left + c]] + to_linear[lower[right + c]] +
+                                      to_linear[upper[left + c]] + to_linear[upper[right + c]]);
+        target[x * 4 + c] = to_srgb[std::size_t(linear * float(table_size - 1) + 0.5f)];
+      }
+      unsigned const alpha = unsigned(lower[left + 3]) + lower[right + 3] + upper[left + 3] + upper[right + 3];
+      target[x * 4 + 3] = std::uint8_t((alpha + 2) / 4);
+    }
+  }
+}
+
+static std::size_t count_levels(std::size_t width, std::size_t height, std::size_t tile_size) {
+  std::size_t num_levels = 1;
+  while (width > tile_size || height > tile_size) {
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+    ++num_levels;
+  }
+  return num_levels;
+}
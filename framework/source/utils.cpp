@@ -10,10 +10,19 @@ using namespace gl;
 #include <glm/gtc/type_precision.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <fstream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace utils {
 
 texture_object create_texture_object(pixel_data const& tex) {
@@ -92,6 +101,25 @@ GLint get_bound_VAO() {
   return array;
 }
 
+bool supports_compressed_format(GLenum format) {
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &num_formats);
+  std::vector<GLint> formats(std::size_t(std::max(num_formats, 0)));
+  if (!formats.empty()) {
+    glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+  }
+
+  return std::find(formats.begin(), formats.end(), GLint(format)) != formats.end();
+}
+
+bool supports_version(GLint major, GLint minor) {
+  GLint context_major = 0;
+  GLint context_minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+  glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+  return context_major > major || (context_major == major && context_minor >= minor);
+}
+
 std::string file_name(std::string const& file_path) {
   return file_path.substr(file_path.find_last_of("/\\") + 1);
 }
@@ -117,6 +145,43 @@ std::string read_file(std::string const& name) {
   }
 }
 
+std::unique_ptr<std::uint8_t, std::function<void(std::uint8_t*)>> map_file(std::string const& name, std::size_t& size) {
+  typedef std::unique_ptr<std::uint8_t, std::function<void(std::uint8_t*)>> mapping_type;
+#ifdef _WIN32
+  // no mapping, read file into memory instead
+  std::ifstream file{name, std::ios::binary};
+  if (!file) {
+    throw std::invalid_argument("File \'" + name + "\' not found");
+  }
+  // one buffer of the final size, growing it would copy the contents
+  file.seekg(0, std::ios::end);
+  std::vector<std::uint8_t>* storage = new std::vector<std::uint8_t>(std::size_t(file.tellg()));
+  file.seekg(0, std::ios::beg);
+  file.read(reinterpret_cast<char*>(storage->data()), std::streamsize(storage->size()));
+  size = storage->size();
+  return mapping_type(storage->data(), [storage](std::uint8_t*) { delete storage; });
+#else
+  int descriptor = open(name.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw std::invalid_argument("File \'" + name + "\' not found");
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+    close(descriptor);
+    throw std::runtime_error("Cannot read file \'" + name + "\'");
+  }
+  std::size_t const mapped_size = std::size_t(status.st_size);
+  void* mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  // mapping stays valid after closing the file
+  close(descriptor);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Cannot map file \'" + name + "\'");
+  }
+  size = mapped_size;
+  return mapping_type(static_cast<std::uint8_t*>(mapped), [mapped, mapped_size](std::uint8_t*) { munmap(mapped, mapped_size); });
+#endif
+}
+
 std::string read_resource_path(int argc, char* argv[]) {
   std::string resource_path{};
   //first argument is resource path
@@ -146,4 +211,20 @@ glm::fmat4 calculate_projection_matrix(float aspect) {
   return glm::perspective(fov_y, aspect, 0.1f, 100.0f);
 }
 
+std::array<glm::fvec4, 6> frustum_planes(glm::fmat4 const& matrix) {
+  // rows of the matrix, glm stores columns
+  glm::fvec4 const row_x{matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]};
+  glm::fvec4 const row_y{matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]};
+  glm::fvec4 const row_z{matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]};
+  glm::fvec4 const row_w{matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]};
+
+  std::array<glm::fvec4, 6> planes{{row_w + row_x, row_w - row_x,
+                                    row_w + row_y, row_w - row_y,
+                                    row_w + row_z, row_w - row_z}};
+  for (auto& plane : planes) {
+    plane /= glm::length(glm::fvec3{plane});
+  }
+  return planes;
+}
+
 }
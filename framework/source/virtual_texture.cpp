@@ -0,0 +1,260 @@
+#include "virtual_texture.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+// tiles which may wait for the workers at once, more are requested again by
+// the next feedback
+static std::size_t const max_queued_tiles = 64;
+
+// smallest power of two not below value
+static std::size_t power_of_two(std::size_t value) {
+  std::size_t power = 1;
+  while (power < value) {
+    power *= 2;
+  }
+  return power;
+}
+
+virtual_texture::virtual_texture(std::string const& file_name,
+                                 std::size_t slots_per_side,
+                                 std::size_t num_workers)
+ :pyramid_{file_name}
+ ,cache_{slots_per_side * slots_per_side}
+ ,slots_per_side_{slots_per_side}
+ ,frame_{0}
+ ,cache_texture_{0, GL_TEXTURE_2D}
+ ,indirection_texture_{0, GL_TEXTURE_2D}
+ ,indirection_dirty_{true}
+ ,requests_{}
+ ,pending_{}
+ ,mutex_{}
+ ,condition_{}
+ ,queue_{}
+ ,loaded_{}
+ ,stop_{false}
+ ,workers_{}
+{
+  if (pyramid_.num_levels() > 0xFF || pyramid_.tiles_x(0) > 0xFFF || pyramid_.tiles_y(0) > 0xFFF) {
+    throw std::runtime_error("virtual_texture: " + file_name + " has too many tiles");
+  }
+  if (slots_per_side > 0xFF) {
+    throw std::logic_error("virtual_texture: slots do not fit the indirection texture");
+  }
+
+  // filtered within the tiles, their borders keep neighbours apart
+  glGenTextures(1, &cache_texture_.handle);
+  glBindTexture(cache_texture_.target, cache_texture_.handle);
+  glTexParameteri(cache_texture_.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(cache_texture_.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(cache_texture_.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(cache_texture_.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(cache_texture_.target, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexImage2D(cache_texture_.target, 0, GL_RGBA8, GLsizei(cache_size()), GLsizei(cache_size()), 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  // integer texture, one texel per tile in each level
+  // the levels of a complete texture halve their size rounded down, which
+  // the tile counts rounded up do not, so the grid of level 0 is padded to
+  // powers of two and the tiles of each level fill the lower left of it
+  std::size_t const grid_x = power_of_two(pyramid_.tiles_x(0));
+  std::size_t const grid_y = power_of_two(pyramid_.tiles_y(0));
+  glGenTextures(1, &indirection_texture_.handle);
+  glBindTexture(indirection_texture_.target, indirection_texture_.handle);
+  glTexParameteri(indirection_texture_.target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(indirection_texture_.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(indirection_texture_.target, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(indirection_texture_.target, GL_TEXTURE_MAX_LEVEL, GLint(pyramid_.num_levels() - 1));
+  for (std::size_t level = 0; level < pyramid_.num_levels(); ++level) {
+    glTexImage2D(indirection_texture_.target, GLint(level), GL_RGBA8UI,
+                 GLsizei(std::max(grid_x >> level, std::size_t{1})),
+                 GLsizei(std::max(grid_y >> level, std::size_t{1})), 0,
+                 GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+  }
+
+  // coarsest tile covers the whole texture, it stays as the last fallback
+  std::size_t const coarsest = pyramid_.num_levels() - 1;
+  upload(tile_cache::key(coarsest, 0, 0), pyramid_.tile(coarsest, 0, 0), true);
+  update_indirection();
+
+  for (std::size_t i = 0; i < std::max(num_workers, std::size_t{1}); ++i) {
+    workers_.emplace_back(&virtual_texture::work, this);
+  }
+}
+
+virtual_texture::~virtual_texture() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+
+  glDeleteTextures(1, &cache_texture_.handle);
+  glDeleteTextures(1, &indirection_texture_.handle);
+}
+
+tile_pyramid const& virtual_texture::pyramid() const {
+  return pyramid_;
+}
+
+texture_object virtual_texture::cache_texture() const {
+  return cache_texture_;
+}
+
+texture_object virtual_texture::indirection_texture() const {
+  return indirection_texture_;
+}
+
+std::size_t virtual_texture::cache_size() const {
+  return slots_per_side_ * (pyramid_.tile_size() + 2 * pyramid_.border());
+}
+
+void virtual_texture::request(std::size_t level, std::size_t x, std::size_t y) {
+  if (level >= pyramid_.num_levels() || x >= pyramid_.tiles_x(level) || y >= pyramid_.tiles_y(level)) {
+    return;
+  }
+  tile_cache::tile_key const key = tile_cache::key(level, x, y);
+  if (!cache_.touch(key, frame_) && pending_.insert(key).second) {
+    requests_.push_back(key);
+  }
+
+  // coarser tiles are the fallback while finer ones load
+  for (std::size_t coarser = level + 1; coarser < pyramid_.num_levels(); ++coarser) {
+    std::size_t const shift = coarser - level;
+    cache_.touch(tile_cache::key(coarser,
+                                 std::min(x >> shift, pyramid_.tiles_x(coarser) - 1),
+                                 std::min(y >> shift, pyramid_.tiles_y(coarser) - 1)),
+                 frame_);
+  }
+}
+
+void virtual_texture::update(std::size_t max_tiles) {
+  std::vector<loaded_tile> loaded{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::size_t const num_tiles = std::min(max_tiles, loaded_.size());
+    std::move(loaded_.begin(), loaded_.begin() + long(num_tiles), std::back_inserter(loaded));
+    loaded_.erase(loaded_.begin(), loaded_.begin() + long(num_tiles));
+  }
+  for (auto const& tile : loaded) {
+    pending_.erase(tile.key);
+    upload(tile.key, tile.pixels.data(), false);
+  }
+
+  // coarse tiles first, they cover more of the screen
+  std::sort(requests_.begin(), requests_.end(), [](tile_cache::tile_key a, tile_cache::tile_key b) {
+    return tile_cache::level(a) > tile_cache::level(b);
+  });
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (tile_cache::tile_key key : requests_) {
+      if (queue_.size() < max_queued_tiles) {
+        queue_.push_back(key);
+      }
+      else {
+        pending_.erase(key);
+      }
+    }
+  }
+  condition_.notify_all();
+  requests_.clear();
+
+  if (indirection_dirty_) {
+    update_indirection();
+  }
+  ++frame_;
+}
+
+std::size_t virtual_texture::resident_tiles() const {
+  return cache_.size();
+}
+
+std::size_t virtual_texture::pending_tiles() const {
+  return pending_.size();
+}
+
+void virtual_texture::work() {
+  while (true) {
+    tile_cache::tile_key key = 0;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      condition_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      key = queue_.front();
+      queue_.pop_front();
+    }
+
+    // reading the mapping pages the tile in on this thread
+    std::uint8_t const* pixels = pyramid_.tile(tile_cache::level(key), tile_cache::x(key), tile_cache::y(key));
+    loaded_tile tile{key, std::vector<std::uint8_t>(pixels, pixels + pyramid_.tile_bytes())};
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    loaded_.push_back(std::move(tile));
+  }
+}
+
+void virtual_texture::upload(tile_cache::tile_key key, std::uint8_t const* pixels, bool pinned) {
+  tile_cache::insertion slot{};
+  // all slots hold tiles of this frame, the tile is requested again later
+  if (!cache_.insert(key, frame_, slot, pinned)) {
+    return;
+  }
+
+  std::size_t const side = pyramid_.tile_size() + 2 * pyramid_.border();
+  glBindTexture(cache_texture_.target, cache_texture_.handle);
+  glTexSubImage2D(cache_texture_.target, 0,
+                  GLint(slot.slot % slots_per_side_ * side), GLint(slot.slot / slots_per_side_ * side),
+                  GLsizei(side), GLsizei(side), GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  indirection_dirty_ = true;
+}
+
+void virtual_texture::update_indirection() {
+  glBindTexture(indirection_texture_.target, indirection_texture_.handle);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // from coarse to fine, missing tiles inherit the entry of their parent
+  std::vector<std::uint8_t> coarser{};
+  for (std::size_t level = pyramid_.num_levels(); level > 0; --level) {
+    std::size_t const current = level - 1;
+    std::size_t const tiles_x = pyramid_.tiles_x(current);
+    std::size_t const tiles_y = pyramid_.tiles_y(current);
+    std::vector<std::uint8_t> entries(tiles_x * tiles_y * 4, 0);
+
+    for (std::size_t y = 0; y < tiles_y; ++y) {
+      for (std::size_t x = 0; x < tiles_x; ++x) {
+        std::uint8_t* entry = &entries[(y * tiles_x + x) * 4];
+        tile_cache::tile_key const key = tile_cache::key(current, x, y);
+        if (cache_.contains(key)) {
+          std::size_t const slot = cache_.slot(key);
+          entry[0] = std::uint8_t(slot % slots_per_side_);
+          entry[1] = std::uint8_t(slot / slots_per_side_);
+          entry[2] = std::uint8_t(current);
+          entry[3] = 255;
+        }
+        else if (!coarser.empty()) {
+          std::size_t const parent_tiles_x = pyramid_.tiles_x(current + 1);
+          std::size_t const parent_x = std::min(x / 2, parent_tiles_x - 1);
+          std::size_t const parent_y = std::min(y / 2, pyramid_.tiles_y(current + 1) - 1);
+          std::copy_n(&coarser[(parent_y * parent_tiles_x + parent_x) * 4], 4, entry);
+        }
+      }
+    }
+
+    glTexSubImage2D(indirection_texture_.target, GLint(current), 0, 0, GLsizei(tiles_x), GLsizei(tiles_y),
+                    GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+    coarser = std::move(entries);
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  indirection_dirty_ = false;
+}
@@ -0,0 +1,160 @@
+#include "virtual_texture_feedback.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_set>
+
+virtual_texture_feedback::virtual_texture_feedback(unsigned width, unsigned height, unsigned scale)
+ :width_{0}
+ ,height_{0}
+ ,scale_{std::max(scale, 1u)}
+ ,framebuffer_{0}
+ ,color_buffer_{0}
+ ,depth_buffer_{0}
+ ,pack_buffers_{0, 0}
+ ,fences_{nullptr, nullptr}
+ ,next_buffer_{0}
+ ,previous_framebuffer_{0}
+ ,previous_viewport_{0, 0, 0, 0}
+{
+  resize(width, height);
+}
+
+virtual_texture_feedback::~virtual_texture_feedback() {
+  delete_framebuffer();
+}
+
+void virtual_texture_feedback::resize(unsigned width, unsigned height) {
+  delete_framebuffer();
+  width_ = std::max(width / scale_, 1u);
+  height_ = std::max(height / scale_, 1u);
+  create_framebuffer();
+}
+
+float virtual_texture_feedback::lod_bias() const {
+  // derivatives grow with the reduced resolution
+  return -std::log2(float(scale_));
+}
+
+void virtual_texture_feedback::begin() {
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_);
+  glGetIntegerv(GL_VIEWPORT, previous_viewport_);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, GLsizei(width_), GLsizei(height_));
+  // texture id 0 marks pixels without virtual texture
+  GLuint const no_tile[4] = {0, 0, 0, 0};
+  glClearBufferuiv(GL_COLOR, 0, no_tile);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void virtual_texture_feedback::end() {
+  // unresolved frame in this buffer is dropped
+  if (fences_[next_buffer_]) {
+    glDeleteSync(fences_[next_buffer_]);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffers_[next_buffer_]);
+  glReadPixels(0, 0, GLsizei(width_), GLsizei(height_), GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  fences_[next_buffer_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_NONE_BIT);
+  next_buffer_ = (next_buffer_ + 1) % 2;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer_));
+  glViewport(previous_viewport_[0], previous_viewport_[1], previous_viewport_[2], previous_viewport_[3]);
+}
+
+void virtual_texture_feedback::resolve(tile_callback const& on_tile) {
+  // the buffer written next holds the oldest frame
+  GLsync& fence = fences_[next_buffer_];
+  if (!fence) {
+    return;
+  }
+  // dont stall, try again next frame
+  GLenum status = glClientWaitSync(fence, GL_NONE_BIT, 0);
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+
+  std::size_t const num_pixels = std::size_t(width_) * std::size_t(height_);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffers_[next_buffer_]);
+  void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(num_pixels * 4 * sizeof(std::uint16_t)),
+                                  GL_MAP_READ_BIT);
+  if (!mapped) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    throw std::runtime_error("virtual_texture_feedback: mapping of pack buffer failed");
+  }
+
+  // many pixels show the same tile
+  std::unordered_set<std::uint64_t> tiles{};
+  std::uint16_t const* pixels = static_cast<std::uint16_t const*>(mapped);
+  for (std::size_t i = 0; i < num_pixels; ++i) {
+    std::uint16_t const* pixel = pixels + i * 4;
+    if (pixel[3] != 0) {
+      tiles.insert(std::uint64_t(pixel[3]) << 48 | std::uint64_t(pixel[2]) << 32 |
+                   std::uint64_t(pixel[0]) << 16 | std::uint64_t(pixel[1]));
+    }
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  for (std::uint64_t tile : tiles) {
+    on_tile(std::size_t(tile >> 48) - 1, std::size_t(tile >> 32 & 0xFFFF),
+            std::size_t(tile >> 16 & 0xFFFF), std::size_t(tile & 0xFFFF));
+  }
+}
+
+void virtual_texture_feedback::create_framebuffer() {
+  glGenRenderbuffers(1, &color_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, GLsizei(width_), GLsizei(height_));
+
+  glGenRenderbuffers(1, &depth_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, GLsizei(width_), GLsizei(height_));
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLint previous_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+  GLenum const status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("virtual_texture_feedback: framebuffer is incomplete");
+  }
+
+  glGenBuffers(2, pack_buffers_);
+  for (GLuint buffer : pack_buffers_) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(std::size_t(width_) * height_ * 4 * sizeof(std::uint16_t)),
+                 NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void virtual_texture_feedback::delete_framebuffer() {
+  if (framebuffer_ == 0) {
+    return;
+  }
+  for (GLsync& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  glDeleteBuffers(2, pack_buffers_);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteRenderbuffers(1, &color_buffer_);
+  glDeleteRenderbuffers(1, &depth_buffer_);
+  framebuffer_ = 0;
+}
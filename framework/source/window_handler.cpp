@@ -116,6 +116,28 @@ GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigne
   return window;
 }
  
+GLFWwindow* hidden_context(unsigned ver_major, unsigned ver_minor) {
+  if (!glfwInit()) {
+    return nullptr;
+  }
+
+  glfwWindowHint(GLFW_VISIBLE, false);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, ver_major);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, ver_minor);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, true);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+  GLFWwindow* window = glfwCreateWindow(16, 16, "OpenGL Framework", NULL, NULL);
+  if (!window) {
+    glfwTerminate();
+    return nullptr;
+  }
+
+  glfwMakeContextCurrent(window);
+  glbinding::Binding::initialize();
+  return window;
+}
+
 void set_callback_object(GLFWwindow* window, Application* app) {
   // set user pointer to access this instance statically
   glfwSetWindowUserPointer(window, app);
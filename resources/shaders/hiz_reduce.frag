@@ -0,0 +1,28 @@
+#version 150
+// nearest and farthest depth of the source texels below a texel of the target
+// level, the source is sampled at its base level only
+
+uniform sampler2D source_Texture;
+// level 0 is reduced from the depth texture, which has a single channel
+uniform bool source_Depth;
+uniform ivec2 target_Size;
+
+out vec2 out_Depth;
+
+void main() {
+  ivec2 source_size = textureSize(source_Texture, 0);
+  ivec2 target = ivec2(gl_FragCoord.xy);
+  // odd sizes let a texel cover three source texels in that direction
+  ivec2 low = target * source_size / target_Size;
+  ivec2 high = min(((target + 1) * source_size + target_Size - 1) / target_Size, source_size) - 1;
+
+  vec2 depth = vec2(1.0, 0.0);
+  for (int y = low.y; y <= high.y; ++y) {
+    for (int x = low.x; x <= high.x; ++x) {
+      vec4 texel = texelFetch(source_Texture, ivec2(x, y), 0);
+      vec2 range = source_Depth ? texel.rr : texel.rg;
+      depth = vec2(min(depth.x, range.x), max(depth.y, range.y));
+    }
+  }
+  out_Depth = depth;
+}
@@ -0,0 +1,81 @@
+#version 150
+// unit sphere of the body ray traced on its impostor quad, with depth, normal
+// and texture coordinates of the sphere meshes, lit like planet.frag
+
+out vec4 out_Color;
+
+in vec3 frag_Pos;
+
+uniform mat4 ModelMatrix;
+uniform mat4 ViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+uniform vec3 light_Color;
+uniform vec3 light_Pos;
+uniform float light_Intensity;
+
+uniform sampler2D planet_Texture;
+
+float light_Cons = 1.0f;
+float light_Linear = 0.01f;
+float light_Quad = 0.005f;
+
+const float pi = 3.14159265358979;
+
+void main() {
+  mat4 model_view = ViewMatrix * ModelMatrix;
+  vec3 center = model_view[3].xyz;
+  float radius = length(model_view[0].xyz);
+
+  // closest hit of the ray from the eye, the silhouette where it misses
+  vec3 ray = normalize(frag_Pos);
+  float b = dot(ray, center);
+  float discriminant = b * b - dot(center, center) + radius * radius;
+  vec3 position = ray * (b - sqrt(max(discriminant, 0.0)));
+  vec3 normal = normalize(position - center);
+
+  vec4 clip = ProjectionMatrix * vec4(position, 1.0);
+  gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far);
+
+  // texture coordinates from the direction in object space
+  vec3 direction = normalize(inverse(mat3(model_view)) * normal);
+  vec2 uv = vec2(0.5 - atan(direction.z, direction.x) / (2.0 * pi), 0.5 - asin(clamp(direction.y, -1.0, 1.0)) / pi);
+  // u jumps at the seam, its derivatives are taken where it does not
+  vec2 seam_uv = vec2(fract(uv.x + 0.5), uv.y);
+  vec2 dx = dFdx(uv);
+  vec2 dy = dFdy(uv);
+  vec2 seam_dx = dFdx(seam_uv);
+  vec2 seam_dy = dFdy(seam_uv);
+  if (max(abs(seam_dx.x), abs(seam_dy.x)) < max(abs(dx.x), abs(dy.x))) {
+    dx = seam_dx;
+    dy = seam_dy;
+  }
+  vec3 surface_Color = textureGrad(planet_Texture, uv, dx, dy).rgb;
+
+  if (discriminant < 0.0) {
+    discard;
+  }
+
+/* --------------------------------- ambient -------------------------------- */
+  float ambient_Str = 0.1;
+  vec3 ambient_result = ambient_Str * light_Color;
+
+/* --------------------------------- diffuse -------------------------------- */
+  vec3 dir_Light = (ViewMatrix * vec4(light_Pos, 1.0)).xyz - position;
+  vec3 norm_dir_Light = normalize(dir_Light);
+  float diffuse = max(dot(norm_dir_Light, normal), 0.0);
+  vec3 diffuse_result = diffuse * surface_Color;
+
+/* -------------------------------- specular -------------------------------- */
+  vec3 view_Pos = (ViewMatrix * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+  vec3 dir_View = normalize(view_Pos - position);
+  vec3 halfway = normalize(dir_View + norm_dir_Light);
+  float specular_factor = pow(max(dot(dir_View, halfway), 0.0), 10.0);
+  vec3 specular_result = light_Color * specular_factor * surface_Color;
+
+/* ------------------------------- attenuation ------------------------------ */
+  float distance = length(dir_Light);
+  float attenuation = 1.0f / (light_Cons + light_Linear * distance + light_Quad * (distance * distance));
+
+  out_Color = vec4(attenuation * (ambient_result + diffuse_result + specular_result), 1.0);
+}
@@ -0,0 +1,27 @@
+#version 150
+// quad facing the camera which covers the silhouette of a unit sphere mesh,
+// drawn as a strip of four vertices without attributes
+
+uniform mat4 ModelMatrix;
+uniform mat4 ViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+out vec3 frag_Pos;
+
+void main(void)
+{
+	mat4 model_view = ViewMatrix * ModelMatrix;
+	vec3 center = model_view[3].xyz;
+	float radius = length(model_view[0].xyz);
+	float distance = length(center);
+
+	// the cone from the eye touching the sphere, cut through the center
+	float extent = radius * distance / sqrt(max(distance * distance - radius * radius, 1e-8));
+	vec3 forward = center / distance;
+	vec3 right = normalize(abs(forward.y) < 0.99 ? cross(forward, vec3(0.0, 1.0, 0.0)) : cross(forward, vec3(1.0, 0.0, 0.0)));
+	vec3 up = cross(right, forward);
+
+	vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+	frag_Pos = center + (right * corner.x + up * corner.y) * extent;
+	gl_Position = ProjectionMatrix * vec4(frag_Pos, 1.0);
+}
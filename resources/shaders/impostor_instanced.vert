@@ -0,0 +1,43 @@
+#version 430
+// impostor.vert for the bodies of the gpu culler, one multi draw of four
+// indices per body draws all of them and the base instance selects the body
+
+// id of the body, an instanced attribute
+layout(location = 4) in uint in_Body;
+
+// layout of the bodies in shaders/gpu_cull.comp
+struct Body {
+  mat4 model;
+  vec4 sphere;
+  uvec4 draw;
+  uvec4 layer;
+};
+
+layout(std430, binding = 0) readonly buffer Bodies {
+  Body bodies[];
+};
+
+uniform mat4 ViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+out vec3 frag_Pos;
+flat out uint pass_Body;
+
+void main(void)
+{
+	mat4 model_view = ViewMatrix * bodies[in_Body].model;
+	vec3 center = model_view[3].xyz;
+	float radius = length(model_view[0].xyz);
+	float distance = length(center);
+
+	// the cone from the eye touching the sphere, cut through the center
+	float extent = radius * distance / sqrt(max(distance * distance - radius * radius, 1e-8));
+	vec3 forward = center / distance;
+	vec3 right = normalize(abs(forward.y) < 0.99 ? cross(forward, vec3(0.0, 1.0, 0.0)) : cross(forward, vec3(1.0, 0.0, 0.0)));
+	vec3 up = cross(right, forward);
+
+	vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+	frag_Pos = center + (right * corner.x + up * corner.y) * extent;
+	gl_Position = ProjectionMatrix * vec4(frag_Pos, 1.0);
+	pass_Body = in_Body;
+}
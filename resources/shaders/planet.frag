@@ -1,50 +1,98 @@
-#version 150
-
-out vec4 out_Color;
-
-in vec3 pass_Normal;
-in vec3 frag_Pos;
-in vec3 view_Pos;
-in vec2 texture_Coord;
-in mat4 pass_ViewMatrix;
-
-uniform vec3 planet_Color;
-uniform vec3 light_Color;
-uniform vec3 light_Pos;
-uniform float light_Intensity;
-
-uniform sampler2D planet_Texture;
-
-float light_Cons = 1.0f; 
-float light_Linear = 0.01f; 
-float light_Quad = 0.005f; 
-
-void main() {
-
-/* --------------------------------- ambient -------------------------------- */
-  float ambient_Str = 0.1;
-  vec3 ambient = ambient_Str  * light_Color;
-  vec3 ambient_result = ambient_Str  * light_Color;
-
-/* --------------------------------- diffuse -------------------------------- */
-  vec3 normal = normalize(pass_Normal);
-  vec3 dir_Light = (pass_ViewMatrix*vec4(light_Pos,1.0)).xyz - frag_Pos;
-  vec3 norm_dir_Light = normalize(dir_Light);
-  float diffuse = max(dot(norm_dir_Light, normal),0); 
-  vec3 diffuse_result =  diffuse  * vec3(texture(planet_Texture,texture_Coord));
-
-/* -------------------------------- specular -------------------------------- */
-  vec3 dir_View = normalize(view_Pos - frag_Pos);
-  vec3 halfway = normalize(dir_View + norm_dir_Light);
-
-  float specularStrength = 0.2;
-  float specular_factor = pow(max(dot(dir_View, halfway), 0.0), 10.0);
-  vec3 specular_result = light_Color * specular_factor * vec3(texture(planet_Texture,texture_Coord));
-
-/* ------------------------------- attenuation ------------------------------ */
-  float distance = length((pass_ViewMatrix*vec4(light_Pos,1.0)).xyz - frag_Pos);
-  float attenuation = 1.0f / (light_Cons + light_Linear * distance + light_Quad * (distance * distance));
-
-  out_Color = vec4(attenuation*(ambient_result + diffuse_result + specular_result), 1.0);
-  
-}
+#version 150
+
+out vec4 out_Color;
+
+in vec3 pass_Normal;
+in vec3 frag_Pos;
+in vec3 view_Pos;
+in vec2 texture_Coord;
+in mat4 pass_ViewMatrix;
+
+uniform vec3 planet_Color;
+uniform vec3 light_Color;
+uniform vec3 light_Pos;
+uniform float light_Intensity;
+
+uniform sampler2D planet_Texture;
+
+// virtual texture replacing planet_Texture
+uniform bool vt_Enabled;
+// slot column, slot row and level of the tile to sample per tile and level
+uniform usampler2D vt_Indirection;
+// resident tiles with their borders
+uniform sampler2D vt_Cache;
+// size of level 0 in pixels
+uniform vec2 vt_Size;
+uniform float vt_TileSize;
+uniform float vt_Border;
+// edge length of the cache in pixels
+uniform float vt_CacheSize;
+uniform int vt_Levels;
+
+float light_Cons = 1.0f; 
+float light_Linear = 0.01f; 
+float light_Quad = 0.005f; 
+
+vec2 vt_level_size(float level) {
+  return max(floor(vt_Size / exp2(level)), vec2(1.0));
+}
+
+// sample the finest resident tile covering the level the pixel needs
+vec3 vt_color(vec2 uv) {
+  vec2 texel = uv * vt_Size;
+  vec2 dx = dFdx(texel);
+  vec2 dy = dFdy(texel);
+  float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+  float level = clamp(floor(lod), 0.0, float(vt_Levels - 1));
+
+  // texcoords continue beyond 1 across the seam
+  uv = vec2(fract(uv.x), clamp(uv.y, 0.0, 1.0));
+  // tiles of the pyramid in the level, its indirection level is padded to
+  // the power of two grid of level 0 halved and holds them at the origin
+  vec2 tiles = ceil(vt_level_size(level) / vt_TileSize);
+  vec2 tile = min(floor(uv * vt_level_size(level) / vt_TileSize), tiles - 1.0);
+  uvec4 entry = texelFetch(vt_Indirection, ivec2(tile), int(level));
+
+  // position inside the tile of the level which is resident
+  float resident = float(entry.z);
+  vec2 resident_texel = uv * vt_level_size(resident);
+  vec2 resident_tiles = ceil(vt_level_size(resident) / vt_TileSize);
+  vec2 resident_tile = min(floor(resident_texel / vt_TileSize), resident_tiles - 1.0);
+  vec2 in_tile = resident_texel - resident_tile * vt_TileSize;
+
+  vec2 physical = vec2(entry.xy) * (vt_TileSize + 2.0 * vt_Border) + vt_Border + in_tile;
+  return texture(vt_Cache, physical / vt_CacheSize).rgb;
+}
+
+void main() {
+  // derivatives are taken outside of the branch on the uniform
+  vec3 virtual_Color = vt_color(texture_Coord);
+  vec3 surface_Color = vt_Enabled ? virtual_Color : vec3(texture(planet_Texture, texture_Coord));
+
+/* --------------------------------- ambient -------------------------------- */
+  float ambient_Str = 0.1;
+  vec3 ambient = ambient_Str  * light_Color;
+  vec3 ambient_result = ambient_Str  * light_Color;
+
+/* --------------------------------- diffuse -------------------------------- */
+  vec3 normal = normalize(pass_Normal);
+  vec3 dir_Light = (pass_ViewMatrix*vec4(light_Pos,1.0)).xyz - frag_Pos;
+  vec3 norm_dir_Light = normalize(dir_Light);
+  float diffuse = max(dot(norm_dir_Light, normal),0); 
+  vec3 diffuse_result =  diffuse  * surface_Color;
+
+/* -------------------------------- specular -------------------------------- */
+  vec3 dir_View = normalize(view_Pos - frag_Pos);
+  vec3 halfway = normalize(dir_View + norm_dir_Light);
+
+  float specularStrength = 0.2;
+  float specular_factor = pow(max(dot(dir_View, halfway), 0.0), 10.0);
+  vec3 specular_result = light_Color * specular_factor * surface_Color;
+
+/* ------------------------------- attenuation ------------------------------ */
+  float distance = length((pass_ViewMatrix*vec4(light_Pos,1.0)).xyz - frag_Pos);
+  float attenuation = 1.0f / (light_Cons + light_Linear * distance + light_Quad * (distance * distance));
+
+  out_Color = vec4(attenuation*(ambient_result + diffuse_result + specular_result), 1.0);
+  
+}
@@ -4,6 +4,8 @@
 layout(location = 0) in vec3 in_Position;
 layout(location = 1) in vec3 in_Normal;
 layout(location = 2) in vec2 in_TextureCoord;
+// terrain chunks move their vertices here towards the end of their lod range
+layout(location = 3) in vec3 in_MorphTarget;
 
 //Matrix Uniforms as specified with glUniformMatrix4fv
 uniform mat4 ModelMatrix;
@@ -11,6 +13,12 @@ uniform mat4 ViewMatrix;
 uniform mat4 ProjectionMatrix;
 uniform mat4 NormalMatrix;
 
+// distances from the camera over which terrain vertices morph, both zero for
+// other geometry
+uniform vec2 morph_Range;
+// camera position in object space
+uniform vec3 camera_Position;
+
 out vec3 pass_Normal;
 out vec3 frag_Pos;
 out vec3 view_Pos;
@@ -19,10 +27,16 @@ out mat4 pass_ViewMatrix;
 
 void main(void)
 {
-	gl_Position = (ProjectionMatrix  * ViewMatrix * ModelMatrix) * vec4(in_Position, 1.0);
+	vec3 position = in_Position;
+	if (morph_Range.y > morph_Range.x) {
+		float morph = clamp((distance(in_Position, camera_Position) - morph_Range.x) / (morph_Range.y - morph_Range.x), 0.0, 1.0);
+		position = mix(in_Position, in_MorphTarget, morph);
+	}
+
+	gl_Position = (ProjectionMatrix  * ViewMatrix * ModelMatrix) * vec4(position, 1.0);
 	pass_Normal = ( NormalMatrix * vec4(in_Normal, 0.0)).xyz;
 	
-	frag_Pos = ((ViewMatrix*ModelMatrix) * vec4(in_Position, 1.0)).xyz;
+	frag_Pos = ((ViewMatrix*ModelMatrix) * vec4(position, 1.0)).xyz;
 
 	view_Pos = (ViewMatrix * vec4(0.0,0.0,0.0,1.0)).xyz;
 	texture_Coord = in_TextureCoord;
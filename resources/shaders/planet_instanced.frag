@@ -0,0 +1,50 @@
+#version 430
+// planet.frag for the bodies of the gpu culler, their textures are layers of
+// one array
+
+out vec4 out_Color;
+
+in vec3 pass_Normal;
+in vec3 frag_Pos;
+in vec3 view_Pos;
+in vec2 texture_Coord;
+flat in uint pass_Layer;
+
+uniform mat4 ViewMatrix;
+
+uniform vec3 light_Color;
+uniform vec3 light_Pos;
+uniform float light_Intensity;
+
+uniform sampler2DArray planet_Textures;
+
+float light_Cons = 1.0f;
+float light_Linear = 0.01f;
+float light_Quad = 0.005f;
+
+void main() {
+  vec3 surface_Color = texture(planet_Textures, vec3(texture_Coord, float(pass_Layer))).rgb;
+
+/* --------------------------------- ambient -------------------------------- */
+  float ambient_Str = 0.1;
+  vec3 ambient_result = ambient_Str * light_Color;
+
+/* --------------------------------- diffuse -------------------------------- */
+  vec3 normal = normalize(pass_Normal);
+  vec3 dir_Light = (ViewMatrix * vec4(light_Pos, 1.0)).xyz - frag_Pos;
+  vec3 norm_dir_Light = normalize(dir_Light);
+  float diffuse = max(dot(norm_dir_Light, normal), 0.0);
+  vec3 diffuse_result = diffuse * surface_Color;
+
+/* -------------------------------- specular -------------------------------- */
+  vec3 dir_View = normalize(view_Pos - frag_Pos);
+  vec3 halfway = normalize(dir_View + norm_dir_Light);
+  float specular_factor = pow(max(dot(dir_View, halfway), 0.0), 10.0);
+  vec3 specular_result = light_Color * specular_factor * surface_Color;
+
+/* ------------------------------- attenuation ------------------------------ */
+  float distance = length(dir_Light);
+  float attenuation = 1.0f / (light_Cons + light_Linear * distance + light_Quad * (distance * distance));
+
+  out_Color = vec4(attenuation * (ambient_result + diffuse_result + specular_result), 1.0);
+}
@@ -0,0 +1,44 @@
+#version 430
+// planet.vert for the bodies of the gpu culler, one multi draw per level of
+// detail draws all of them and the base instance selects the body
+layout(location = 0) in vec3 in_Position;
+layout(location = 1) in vec3 in_Normal;
+layout(location = 2) in vec2 in_TextureCoord;
+// id of the body, an instanced attribute
+layout(location = 4) in uint in_Body;
+
+// layout of the bodies in shaders/gpu_cull.comp
+struct Body {
+  mat4 model;
+  vec4 sphere;
+  uvec4 draw;
+  uvec4 layer;
+};
+
+layout(std430, binding = 0) readonly buffer Bodies {
+  Body bodies[];
+};
+
+uniform mat4 ViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+out vec3 pass_Normal;
+out vec3 frag_Pos;
+out vec3 view_Pos;
+out vec2 texture_Coord;
+// layer of the texture array
+flat out uint pass_Layer;
+
+void main(void)
+{
+	Body body = bodies[in_Body];
+	mat4 model_view = ViewMatrix * body.model;
+
+	gl_Position = ProjectionMatrix * model_view * vec4(in_Position, 1.0);
+	// bodies are rotated and scaled evenly, so the normals stay orthogonal
+	pass_Normal = mat3(model_view) * in_Normal;
+	frag_Pos = (model_view * vec4(in_Position, 1.0)).xyz;
+	view_Pos = (ViewMatrix * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+	texture_Coord = in_TextureCoord;
+	pass_Layer = body.layer.x;
+}
@@ -0,0 +1,12 @@
+#version 150
+// source texture stretched over a layer of the texture array
+
+in vec2 pass_TexCoord;
+
+uniform sampler2D source_Texture;
+
+out vec4 out_Color;
+
+void main() {
+  out_Color = vec4(texture(source_Texture, pass_TexCoord).rgb, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 150
+// triangle covering the whole layer, without vertex attributes
+
+out vec2 pass_TexCoord;
+
+void main() {
+  vec2 position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+  pass_TexCoord = position * 0.5 + 0.5;
+  gl_Position = vec4(position, 0.0, 1.0);
+}
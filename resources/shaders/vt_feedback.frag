@@ -0,0 +1,34 @@
+#version 150
+
+// tile column, tile row, level and virtual texture id + 1
+out uvec4 out_Tile;
+
+in vec2 texture_Coord;
+
+// size of level 0 in pixels
+uniform vec2 vt_Size;
+uniform float vt_TileSize;
+uniform int vt_Levels;
+// compensates the reduced resolution of the feedback buffer
+uniform float vt_LodBias;
+uniform int vt_Id;
+
+vec2 level_size(float level) {
+  return max(floor(vt_Size / exp2(level)), vec2(1.0));
+}
+
+void main() {
+  // level which the planet shader samples at full resolution
+  vec2 texel = texture_Coord * vt_Size;
+  vec2 dx = dFdx(texel);
+  vec2 dy = dFdy(texel);
+  float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + vt_LodBias;
+  float level = clamp(floor(lod), 0.0, float(vt_Levels - 1));
+
+  vec2 tiles = ceil(level_size(level) / vt_TileSize);
+  // texcoords continue beyond 1 across the seam
+  vec2 uv = vec2(fract(texture_Coord.x), clamp(texture_Coord.y, 0.0, 1.0));
+  vec2 tile = min(floor(uv * level_size(level) / vt_TileSize), tiles - 1.0);
+
+  out_Tile = uvec4(uvec2(tile), uint(level), uint(vt_Id + 1));
+}